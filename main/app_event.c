@@ -0,0 +1,19 @@
+/*
+ * @Description: 应用事件实现
+ */
+
+#include "app_event.h"
+#include "esp_log.h"
+
+static const char *TAG = "app_event";
+
+ESP_EVENT_DEFINE_BASE(APP_EVENT);
+
+esp_err_t app_event_post(app_event_id_t id, const void *data, size_t len)
+{
+    esp_err_t ret = esp_event_post(APP_EVENT, id, data, len, 0);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "发布事件%d失败: %s", id, esp_err_to_name(ret));
+    }
+    return ret;
+}
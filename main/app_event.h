@@ -0,0 +1,45 @@
+/*
+ * @Description: 应用事件 (CDC设备、WebSocket客户端、WiFi扫描、STA状态和网络配置变化) 头文件
+ *
+ * 事件发布到默认事件循环，订阅者用esp_event_handler_instance_register(APP_EVENT, ...)注册。
+ */
+
+#ifndef APP_EVENT_H
+#define APP_EVENT_H
+
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_event.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+ESP_EVENT_DECLARE_BASE(APP_EVENT);
+
+// 应用事件编号
+typedef enum {
+    APP_EVENT_CDC_CONNECTED = 0,        // CDC设备已打开，数据为uint8_t设备编号
+    APP_EVENT_CDC_DISCONNECTED,         // CDC设备已断开，数据为uint8_t设备编号
+    APP_EVENT_WS_CLIENT_CONNECTED,      // WebSocket客户端已加入，数据为int fd
+    APP_EVENT_WS_CLIENT_DISCONNECTED,   // WebSocket客户端已移除，数据为int fd
+    APP_EVENT_WIFI_SCAN_DONE,           // WiFi扫描已完成，数据为esp_err_t扫描结果
+    APP_EVENT_WIFI_STATUS,              // STA状态变化，数据为wifi_status_event_t (wifi_manager.h)
+    APP_EVENT_NET_PROFILE_CHANGED,      // 网络配置已切换，数据为net_profile_t (net_profile.h)
+} app_event_id_t;
+
+/**
+ * @brief 发布应用事件 (不等待，可在驱动回调中调用)
+ *
+ * @param id 事件编号
+ * @param data 事件数据 (拷贝到事件循环，可为NULL)
+ * @param len 数据长度
+ * @return esp_err_t ESP_OK成功，ESP_ERR_TIMEOUT事件队列已满
+ */
+esp_err_t app_event_post(app_event_id_t id, const void *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APP_EVENT_H */
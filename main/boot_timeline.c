@@ -0,0 +1,102 @@
+/*
+ * @Description: 启动时间线实现
+ */
+
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "boot_timeline.h"
+
+static const char *TAG = "boot";
+
+// 名称与boot_phase_t顺序一致
+static const char *const s_phase_names[BOOT_PHASE_MAX] = {
+    "app_start",
+    "nvs_ready",
+    "usb_ready",
+    "httpd_ready",
+    "wifi_started",
+    "sta_connected",
+    "got_ip",
+    "cdc_open",
+    "first_data",
+};
+
+static StaticEventGroup_t s_events_buf;
+static EventGroupHandle_t s_events = NULL;
+static uint32_t s_reached = 0;                  // 已到达阶段的位图
+static int64_t s_phase_us[BOOT_PHASE_MAX];
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t boot_timeline_init(void)
+{
+    if (s_events == NULL) {
+        s_events = xEventGroupCreateStatic(&s_events_buf);
+    }
+    boot_timeline_mark(BOOT_PHASE_APP_START);
+    return ESP_OK;
+}
+
+void boot_timeline_mark(boot_phase_t phase)
+{
+    if (phase >= BOOT_PHASE_MAX || s_events == NULL) {
+        return;
+    }
+    uint32_t bit = 1u << phase;
+    if (__atomic_load_n(&s_reached, __ATOMIC_ACQUIRE) & bit) {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    bool first = false;
+    taskENTER_CRITICAL(&s_lock);
+    if (!(s_reached & bit)) {
+        s_phase_us[phase] = now;
+        __atomic_or_fetch(&s_reached, bit, __ATOMIC_RELEASE);
+        first = true;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    if (!first) {
+        return;
+    }
+
+    xEventGroupSetBits(s_events, bit);
+    ESP_LOGI(TAG, "启动阶段 %-14s %6"PRId64" ms", s_phase_names[phase], now / 1000);
+}
+
+bool boot_timeline_wait(boot_phase_t phase, uint32_t timeout_ms)
+{
+    if (phase >= BOOT_PHASE_MAX || s_events == NULL) {
+        return false;
+    }
+    EventBits_t bit = 1u << phase;
+    return (xEventGroupWaitBits(s_events, bit, pdFALSE, pdTRUE, pdMS_TO_TICKS(timeout_ms)) & bit) != 0;
+}
+
+int64_t boot_timeline_get_us(boot_phase_t phase)
+{
+    if (phase >= BOOT_PHASE_MAX || !(__atomic_load_n(&s_reached, __ATOMIC_ACQUIRE) & (1u << phase))) {
+        return -1;
+    }
+    taskENTER_CRITICAL(&s_lock);
+    int64_t us = s_phase_us[phase];
+    taskEXIT_CRITICAL(&s_lock);
+    return us;
+}
+
+const char *boot_phase_name(boot_phase_t phase)
+{
+    return phase < BOOT_PHASE_MAX ? s_phase_names[phase] : "unknown";
+}
+
+void boot_timeline_write_json(json_writer_t *w)
+{
+    for (int i = 0; i < BOOT_PHASE_MAX; i++) {
+        int64_t us = boot_timeline_get_us(i);
+        if (us >= 0) {
+            json_writer_uint(w, s_phase_names[i], (uint32_t)(us / 1000));
+        }
+    }
+}
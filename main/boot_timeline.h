@@ -0,0 +1,77 @@
+/*
+ * @Description: 启动时间线头文件
+ *
+ * 各子系统并行启动，用到达的就绪阶段 (而不是固定延时) 同步彼此的依赖；
+ * 每个阶段第一次到达的时间 (自启动起) 记录下来，经日志和/api/metrics报告。
+ */
+
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "json_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 启动阶段
+typedef enum {
+    BOOT_PHASE_APP_START = 0,   // 进入app_main
+    BOOT_PHASE_NVS_READY,       // NVS可用
+    BOOT_PHASE_USB_READY,       // USB Host和CDC驱动已安装
+    BOOT_PHASE_HTTPD_READY,     // HTTP服务器已启动
+    BOOT_PHASE_WIFI_STARTED,    // WIFI_EVENT_STA_START
+    BOOT_PHASE_STA_CONNECTED,   // 第一次关联到AP
+    BOOT_PHASE_GOT_IP,          // 第一次获取IP
+    BOOT_PHASE_CDC_OPEN,        // 第一个CDC设备已打开
+    BOOT_PHASE_FIRST_DATA,      // 收到第一个CDC数据
+    BOOT_PHASE_MAX,
+} boot_phase_t;
+
+/**
+ * @brief 初始化启动时间线并记录BOOT_PHASE_APP_START (在app_main开头调用)
+ */
+esp_err_t boot_timeline_init(void);
+
+/**
+ * @brief 标记阶段已到达，只记录第一次 (之后再调用只是一次原子读)
+ *
+ * @param phase 启动阶段
+ */
+void boot_timeline_mark(boot_phase_t phase);
+
+/**
+ * @brief 等待阶段到达
+ *
+ * @param phase 启动阶段
+ * @param timeout_ms 超时时间
+ * @return true 已到达
+ */
+bool boot_timeline_wait(boot_phase_t phase, uint32_t timeout_ms);
+
+/**
+ * @brief 获取阶段到达时间
+ *
+ * @param phase 启动阶段
+ * @return int64_t 自启动起的时间 (微秒)，未到达时返回-1
+ */
+int64_t boot_timeline_get_us(boot_phase_t phase);
+
+/**
+ * @brief 获取阶段名称
+ */
+const char *boot_phase_name(boot_phase_t phase);
+
+/**
+ * @brief 写出已到达阶段的时间 ("阶段名": 毫秒，未到达的阶段省略)
+ */
+void boot_timeline_write_json(json_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BOOT_TIMELINE_H */
@@ -0,0 +1,366 @@
+/*
+ * @Description: CDC数据流分帧解码实现
+ *
+ * USB传输边界与设备记录边界无关，分帧阶段按配置的方式逐字节解码，
+ * 在固定大小的组装缓冲区中还原完整记录后再整体输出，
+ * 保证一条设备记录不会被拆分到多个WebSocket消息中。
+ * 所有设备使用同一分帧配置，每个设备有独立的组装状态和缓冲区。
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "cdc_framer.h"
+#include "cdc_ring.h"
+
+static const char *TAG = "cdc_framer";
+
+// 组装缓冲区大小与环形缓冲区单条记录上限一致
+#define CDC_FRAMER_BUF_SIZE       CONFIG_CDC_RING_MAX_RECORD_LEN
+#define CDC_FRAMER_LEN_HDR        2
+
+// SLIP特殊字符
+#define SLIP_END                  0xC0
+#define SLIP_ESC                  0xDB
+#define SLIP_ESC_END              0xDC
+#define SLIP_ESC_ESC              0xDD
+
+// 文本检测范围，与WebSocket发送端一致
+#define CDC_FRAMER_TEXT_MIN_CHAR  32
+#define CDC_FRAMER_TEXT_MAX_CHAR  127
+
+// 单个设备的组装状态
+typedef struct {
+    uint8_t *buf;                   // 组装缓冲区
+    uint8_t dev;                    // 设备编号
+    size_t len;                     // 已组装的数据长度 (不含hdr)
+    bool discard;                   // 当前记录出错，丢弃至下一个分隔符
+    bool slip_esc;                  // SLIP: 上一字节为转义符
+    uint8_t cobs_code;              // COBS: 当前块的编码字节
+    uint8_t cobs_left;              // COBS: 当前块剩余的数据字节数
+    uint8_t len_hdr_bytes;          // LEN16: 已收到的长度字节数
+    uint16_t len_expect;            // LEN16: 当前记录的长度
+} cdc_framer_dev_t;
+
+// 分帧上下文
+typedef struct {
+    cdc_framer_config_t config;     // 当前生效的配置 (仅USB Host任务访问)
+    cdc_framer_config_t pending;    // 待生效的配置
+    bool config_changed;
+    size_t hdr;                     // 记录数据在组装缓冲区中的起始偏移
+    cdc_framer_dev_t devs[CDC_RING_DEVICES];
+    cdc_framer_stats_t stats;
+    portMUX_TYPE lock;
+} cdc_framer_ctx_t;
+
+static uint8_t s_framer_buf[CDC_RING_DEVICES][CDC_FRAMER_BUF_SIZE];
+static cdc_framer_ctx_t s_framer = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static const char *const s_mode_names[CDC_FRAMER_MODE_MAX] = {
+    [CDC_FRAMER_RAW] = "raw",
+    [CDC_FRAMER_LINE] = "line",
+    [CDC_FRAMER_COBS] = "cobs",
+    [CDC_FRAMER_SLIP] = "slip",
+    [CDC_FRAMER_LEN16] = "len16",
+};
+
+// 检查记录是否为可打印文本
+static bool framer_is_text(const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        uint8_t byte = data[i];
+        if ((byte < CDC_FRAMER_TEXT_MIN_CHAR || byte > CDC_FRAMER_TEXT_MAX_CHAR) &&
+            byte != '\r' && byte != '\n' && byte != '\t') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 清空组装状态，开始新记录
+static void framer_reset(cdc_framer_dev_t *f)
+{
+    f->len = 0;
+    f->discard = false;
+    f->slip_esc = false;
+    f->cobs_code = 0;
+    f->cobs_left = 0;
+    f->len_hdr_bytes = 0;
+    f->len_expect = 0;
+}
+
+// 应用新配置，丢弃所有设备未完成的记录 (在临界区内调用，不输出日志)
+// 返回true表示分帧方式或输出方式发生了变化 (首次应用时也返回true)
+static bool framer_apply_config(cdc_framer_ctx_t *f)
+{
+    bool changed = f->devs[0].buf == NULL || f->config.mode != f->pending.mode ||
+                   f->config.emit != f->pending.emit;
+    f->config = f->pending;
+    f->config_changed = false;
+
+    // 二进制分帧方式合并输出时，每条记录前保留2字节长度
+    bool binary = f->config.mode == CDC_FRAMER_COBS || f->config.mode == CDC_FRAMER_SLIP ||
+                  f->config.mode == CDC_FRAMER_LEN16;
+    f->hdr = (binary && f->config.emit == CDC_FRAMER_EMIT_BATCH) ? CDC_FRAMER_LEN_HDR : 0;
+    for (uint8_t dev = 0; dev < CDC_RING_DEVICES; dev++) {
+        f->devs[dev].buf = s_framer_buf[dev];
+        f->devs[dev].dev = dev;
+        framer_reset(&f->devs[dev]);
+    }
+    return changed;
+}
+
+// 向当前记录追加一个字节，超过容量时标记丢弃
+static inline void framer_put(cdc_framer_dev_t *f, uint8_t byte)
+{
+    if (f->discard) {
+        return;
+    }
+    if (s_framer.hdr + f->len >= CDC_FRAMER_BUF_SIZE) {
+        s_framer.stats.oversize++;
+        f->discard = true;
+        return;
+    }
+    f->buf[s_framer.hdr + f->len++] = byte;
+}
+
+// 输出当前记录并开始新记录
+static void framer_emit(cdc_framer_dev_t *f, cdc_framer_sink_t sink)
+{
+    if (!f->discard && f->len > 0) {
+        uint16_t flags = 0;
+        if (s_framer.config.mode == CDC_FRAMER_LINE) {
+            flags = framer_is_text(f->buf, f->len) ? CDC_RING_FLAG_TEXT : CDC_RING_FLAG_BINARY;
+        } else {
+            flags = CDC_RING_FLAG_BINARY;
+        }
+        if (s_framer.config.emit == CDC_FRAMER_EMIT_RECORD) {
+            flags |= CDC_RING_FLAG_RECORD;
+        }
+        if (s_framer.hdr) {
+            f->buf[0] = f->len & 0xFF;
+            f->buf[1] = f->len >> 8;
+        }
+
+        s_framer.stats.records++;
+        sink(f->dev, f->buf, s_framer.hdr + f->len, flags);
+    }
+    framer_reset(f);
+}
+
+// 标记当前记录编码错误
+static inline void framer_error(cdc_framer_dev_t *f)
+{
+    if (!f->discard) {
+        s_framer.stats.errors++;
+        f->discard = true;
+    }
+}
+
+// 文本行: 以'\n'结束，行过长时按最大长度切分输出
+static void framer_input_line(cdc_framer_dev_t *f, const uint8_t *data, size_t len, cdc_framer_sink_t sink)
+{
+    while (len > 0) {
+        const uint8_t *nl = memchr(data, '\n', len);
+        size_t part = nl ? (size_t)(nl - data) + 1 : len;
+
+        while (part > 0) {
+            size_t room = CDC_FRAMER_BUF_SIZE - f->len;
+            size_t n = part < room ? part : room;
+            memcpy(f->buf + f->len, data, n);
+            f->len += n;
+            data += n;
+            len -= n;
+            part -= n;
+            if (f->len == CDC_FRAMER_BUF_SIZE && (part > 0 || !nl)) {
+                // 超长行拆分输出，保证数据不丢失
+                s_framer.stats.oversize++;
+                framer_emit(f, sink);
+            }
+        }
+
+        if (nl && f->len > 0) {
+            framer_emit(f, sink);
+        }
+    }
+}
+
+// COBS: 编码字节n表示后面有n-1个数据字节，n<0xFF时块后隐含一个0x00
+static void framer_input_cobs(cdc_framer_dev_t *f, const uint8_t *data, size_t len, cdc_framer_sink_t sink)
+{
+    for (size_t i = 0; i < len; i++) {
+        uint8_t byte = data[i];
+        if (byte == 0x00) {
+            if (f->cobs_left != 0) {
+                framer_error(f);
+            }
+            framer_emit(f, sink);
+        } else if (f->cobs_left == 0) {
+            // 新块开始，补上一块隐含的0x00
+            if (f->cobs_code != 0 && f->cobs_code != 0xFF) {
+                framer_put(f, 0x00);
+            }
+            f->cobs_code = byte;
+            f->cobs_left = byte - 1;
+        } else {
+            framer_put(f, byte);
+            f->cobs_left--;
+        }
+    }
+}
+
+// SLIP: END结束记录，ESC后跟ESC_END/ESC_ESC
+static void framer_input_slip(cdc_framer_dev_t *f, const uint8_t *data, size_t len, cdc_framer_sink_t sink)
+{
+    for (size_t i = 0; i < len; i++) {
+        uint8_t byte = data[i];
+        if (byte == SLIP_END) {
+            if (f->slip_esc) {
+                framer_error(f);
+            }
+            framer_emit(f, sink);
+        } else if (f->slip_esc) {
+            f->slip_esc = false;
+            if (byte == SLIP_ESC_END) {
+                framer_put(f, SLIP_END);
+            } else if (byte == SLIP_ESC_ESC) {
+                framer_put(f, SLIP_ESC);
+            } else {
+                framer_error(f);
+            }
+        } else if (byte == SLIP_ESC) {
+            f->slip_esc = true;
+        } else {
+            framer_put(f, byte);
+        }
+    }
+}
+
+// LEN16: 2字节小端长度后跟记录数据，超长记录跳过其数据
+static void framer_input_len16(cdc_framer_dev_t *f, const uint8_t *data, size_t len, cdc_framer_sink_t sink)
+{
+    while (len > 0) {
+        if (f->len_hdr_bytes < CDC_FRAMER_LEN_HDR) {
+            f->len_expect |= (uint16_t)data[0] << (8 * f->len_hdr_bytes);
+            f->len_hdr_bytes++;
+            data++;
+            len--;
+            if (f->len_hdr_bytes == CDC_FRAMER_LEN_HDR) {
+                if (f->len_expect == 0) {
+                    framer_reset(f);
+                } else if (s_framer.hdr + f->len_expect > CDC_FRAMER_BUF_SIZE) {
+                    s_framer.stats.oversize++;
+                    f->discard = true;
+                }
+            }
+            continue;
+        }
+
+        size_t need = f->len_expect - f->len;
+        size_t n = len < need ? len : need;
+        if (!f->discard) {
+            memcpy(f->buf + s_framer.hdr + f->len, data, n);
+        }
+        f->len += n;
+        data += n;
+        len -= n;
+        if (f->len == f->len_expect) {
+            framer_emit(f, sink);
+        }
+    }
+}
+
+esp_err_t cdc_framer_set_config(const cdc_framer_config_t *config)
+{
+    if (!config || config->mode >= CDC_FRAMER_MODE_MAX ||
+        (config->emit != CDC_FRAMER_EMIT_BATCH && config->emit != CDC_FRAMER_EMIT_RECORD)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    taskENTER_CRITICAL(&s_framer.lock);
+    s_framer.pending = *config;
+    s_framer.config_changed = true;
+    taskEXIT_CRITICAL(&s_framer.lock);
+    return ESP_OK;
+}
+
+void cdc_framer_get_config(cdc_framer_config_t *config)
+{
+    if (!config) {
+        return;
+    }
+
+    taskENTER_CRITICAL(&s_framer.lock);
+    *config = s_framer.config_changed ? s_framer.pending : s_framer.config;
+    taskEXIT_CRITICAL(&s_framer.lock);
+}
+
+void cdc_framer_input(uint8_t dev, const uint8_t *data, size_t len, cdc_framer_sink_t sink)
+{
+    if (dev >= CDC_RING_DEVICES || !data || len == 0 || !sink) {
+        return;
+    }
+
+    // 首次输入时也要应用配置，初始化各设备的组装缓冲区
+    if (s_framer.config_changed || s_framer.devs[dev].buf == NULL) {
+        taskENTER_CRITICAL(&s_framer.lock);
+        bool changed = framer_apply_config(&s_framer);
+        cdc_framer_config_t config = s_framer.config;
+        taskEXIT_CRITICAL(&s_framer.lock);
+        if (changed) {
+            ESP_LOGI(TAG, "分帧方式: %s, 输出: %s", cdc_framer_mode_name(config.mode),
+                     config.emit == CDC_FRAMER_EMIT_RECORD ? "record" : "batch");
+        }
+    }
+
+    cdc_framer_dev_t *f = &s_framer.devs[dev];
+    switch (s_framer.config.mode) {
+        case CDC_FRAMER_LINE:
+            framer_input_line(f, data, len, sink);
+            break;
+        case CDC_FRAMER_COBS:
+            framer_input_cobs(f, data, len, sink);
+            break;
+        case CDC_FRAMER_SLIP:
+            framer_input_slip(f, data, len, sink);
+            break;
+        case CDC_FRAMER_LEN16:
+            framer_input_len16(f, data, len, sink);
+            break;
+        case CDC_FRAMER_RAW:
+        default:
+            sink(dev, data, len, 0);
+            break;
+    }
+}
+
+void cdc_framer_get_stats(cdc_framer_stats_t *stats)
+{
+    if (stats) {
+        *stats = s_framer.stats;
+    }
+}
+
+const char *cdc_framer_mode_name(cdc_framer_mode_t mode)
+{
+    return mode < CDC_FRAMER_MODE_MAX ? s_mode_names[mode] : "unknown";
+}
+
+bool cdc_framer_mode_from_name(const char *name, cdc_framer_mode_t *mode)
+{
+    if (!name || !mode) {
+        return false;
+    }
+
+    for (int i = 0; i < CDC_FRAMER_MODE_MAX; i++) {
+        if (strcmp(name, s_mode_names[i]) == 0) {
+            *mode = (cdc_framer_mode_t)i;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,106 @@
+/*
+ * @Description: CDC数据流分帧解码头文件
+ */
+
+#ifndef CDC_FRAMER_H
+#define CDC_FRAMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 分帧方式
+typedef enum {
+    CDC_FRAMER_RAW = 0,     // 不分帧，按USB传输原样转发
+    CDC_FRAMER_LINE,        // 以'\n'结尾的文本行 (保留换行符)
+    CDC_FRAMER_COBS,        // COBS编码，0x00为帧分隔符
+    CDC_FRAMER_SLIP,        // SLIP编码 (RFC 1055)
+    CDC_FRAMER_LEN16,       // 2字节小端长度前缀
+    CDC_FRAMER_MODE_MAX,
+} cdc_framer_mode_t;
+
+// 记录输出方式
+typedef enum {
+    CDC_FRAMER_EMIT_BATCH = 0,  // 多条记录可合并为一个WebSocket消息
+    CDC_FRAMER_EMIT_RECORD,     // 每条记录一个WebSocket消息
+} cdc_framer_emit_t;
+
+// 分帧配置
+typedef struct {
+    cdc_framer_mode_t mode;
+    cdc_framer_emit_t emit;
+} cdc_framer_config_t;
+
+// 分帧统计信息
+typedef struct {
+    uint32_t records;       // 输出的完整记录数
+    uint32_t oversize;      // 超过最大记录长度的记录数
+    uint32_t errors;        // 编码错误的记录数
+} cdc_framer_stats_t;
+
+/**
+ * @brief 记录输出函数，由调用者提供 (通常写入CDC环形缓冲区)
+ *
+ * 二进制分帧方式在合并输出时，每条记录前带有2字节小端长度，便于客户端拆分。
+ */
+typedef esp_err_t (*cdc_framer_sink_t)(uint8_t dev, const uint8_t *data, size_t len, uint16_t flags);
+
+/**
+ * @brief 设置分帧配置，在下一次cdc_framer_input()时生效并丢弃未完成的记录
+ *
+ * @param config 分帧配置
+ * @return esp_err_t ESP_OK成功，ESP_ERR_INVALID_ARG参数错误
+ */
+esp_err_t cdc_framer_set_config(const cdc_framer_config_t *config);
+
+/**
+ * @brief 获取当前分帧配置
+ *
+ * @param config 输出的分帧配置
+ */
+void cdc_framer_get_config(cdc_framer_config_t *config);
+
+/**
+ * @brief 输入CDC数据，解码出的完整记录通过sink输出 (单生产者，在USB Host任务中调用)
+ *
+ * 每个设备有独立的组装状态，不同设备的数据可以交替输入。
+ *
+ * @param dev 设备编号
+ * @param data 数据
+ * @param len 数据长度
+ * @param sink 记录输出函数
+ */
+void cdc_framer_input(uint8_t dev, const uint8_t *data, size_t len, cdc_framer_sink_t sink);
+
+/**
+ * @brief 获取分帧统计信息
+ *
+ * @param stats 输出的统计信息
+ */
+void cdc_framer_get_stats(cdc_framer_stats_t *stats);
+
+/**
+ * @brief 分帧方式名称，如"line"
+ */
+const char *cdc_framer_mode_name(cdc_framer_mode_t mode);
+
+/**
+ * @brief 按名称查找分帧方式
+ *
+ * @param name 名称
+ * @param mode 输出的分帧方式
+ * @return true 找到
+ * @return false 未知名称
+ */
+bool cdc_framer_mode_from_name(const char *name, cdc_framer_mode_t *mode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CDC_FRAMER_H */
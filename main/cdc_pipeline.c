@@ -0,0 +1,169 @@
+/*
+ * @Description: CDC数据通路 (分帧 -> 环形缓冲区) 实现
+ */
+
+#include "cdc_pipeline.h"
+#include "sdkconfig.h"
+#include "cdc_ring.h"
+#include "cdc_framer.h"
+#include "metrics.h"
+
+#ifdef CONFIG_CDC_FLOW_LOSSLESS
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "cdc_pipeline";
+
+// 流控阈值 (该设备最慢读者的未读字节数)
+#define CDC_FLOW_HIGH_BYTES     ((size_t)CONFIG_CDC_RING_DATA_SIZE * CONFIG_CDC_FLOW_HIGH_WATER_PCT / 100)
+#define CDC_FLOW_LOW_BYTES      ((size_t)CONFIG_CDC_RING_DATA_SIZE * CONFIG_CDC_FLOW_LOW_WATER_PCT / 100)
+#define CDC_FLOW_POLL_US        (10 * 1000)
+
+_Static_assert(CONFIG_CDC_FLOW_LOW_WATER_PCT < CONFIG_CDC_FLOW_HIGH_WATER_PCT, "流控恢复阈值必须低于暂停阈值");
+
+// 每个设备独立暂停和恢复，共用一个检查定时器
+static struct {
+    uint32_t paused;                        // 已暂停的设备掩码
+    int64_t paused_us[CDC_RING_DEVICES];    // 本次暂停开始时间
+    esp_timer_handle_t timer;               // 有设备暂停时周期检查是否低于恢复阈值
+    cdc_pipeline_flow_cb_t cb;
+} s_flow;
+#endif
+
+static cdc_pipeline_notify_t s_notify;
+
+void cdc_pipeline_set_notify(cdc_pipeline_notify_t notify)
+{
+    s_notify = notify;
+}
+
+#ifdef CONFIG_CDC_FLOW_LOSSLESS
+// 暂停期间在esp_timer任务中运行，读者消费到恢复阈值以下的设备恢复发送
+static void cdc_flow_poll(void *arg)
+{
+    uint32_t paused = __atomic_load_n(&s_flow.paused, __ATOMIC_ACQUIRE);
+    uint32_t resume = 0;
+    for (uint8_t dev = 0; dev < CDC_RING_DEVICES; dev++) {
+        size_t pending;
+        if (!(paused & CDC_RING_DEV_MASK(dev))) {
+            continue;
+        }
+        cdc_ring_dev_pending(dev, &pending);
+        if (pending < CDC_FLOW_LOW_BYTES) {
+            metrics_add(METRIC_FLOW_PAUSED_MS, (uint32_t)((esp_timer_get_time() - s_flow.paused_us[dev]) / 1000));
+            resume |= CDC_RING_DEV_MASK(dev);
+        }
+    }
+    if (resume == 0) {
+        return;
+    }
+
+    // 最后一个设备恢复时先停止定时器再清除暂停状态，之后的暂停总能重新启动定时器；
+    // 期间又有设备暂停 (它看到定时器仍在运行而未启动) 时重新启动
+    bool stopped = (resume == paused);
+    if (stopped) {
+        esp_timer_stop(s_flow.timer);
+    }
+    if (__atomic_and_fetch(&s_flow.paused, ~resume, __ATOMIC_ACQ_REL) != 0 && stopped) {
+        esp_timer_start_periodic(s_flow.timer, CDC_FLOW_POLL_US);
+    }
+    if (s_flow.cb) {
+        s_flow.cb();
+    }
+}
+
+// 写入后检查设备是否超过暂停阈值
+static void cdc_flow_check(uint8_t dev, size_t pending)
+{
+    if (pending < CDC_FLOW_HIGH_BYTES) {
+        return;
+    }
+    uint32_t prev = __atomic_fetch_or(&s_flow.paused, CDC_RING_DEV_MASK(dev), __ATOMIC_ACQ_REL);
+    if (prev & CDC_RING_DEV_MASK(dev)) {
+        return;
+    }
+    s_flow.paused_us[dev] = esp_timer_get_time();
+    metrics_add(METRIC_FLOW_PAUSES, 1);
+    if (prev == 0) {
+        esp_timer_start_periodic(s_flow.timer, CDC_FLOW_POLL_US);
+    }
+    if (s_flow.cb) {
+        s_flow.cb();
+    }
+}
+#endif
+
+esp_err_t cdc_pipeline_set_flow_cb(cdc_pipeline_flow_cb_t cb)
+{
+#ifdef CONFIG_CDC_FLOW_LOSSLESS
+    if (s_flow.timer == NULL) {
+        const esp_timer_create_args_t args = {
+            .callback = cdc_flow_poll,
+            .name = "cdc_flow",
+        };
+        esp_err_t ret = esp_timer_create(&args, &s_flow.timer);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "创建流控定时器失败: %s", esp_err_to_name(ret));
+            return ret;
+        }
+    }
+    s_flow.cb = cb;
+    ESP_LOGI(TAG, "无损模式: 未读数据超过%u字节时暂停设备发送，低于%u字节时恢复",
+             (unsigned)CDC_FLOW_HIGH_BYTES, (unsigned)CDC_FLOW_LOW_BYTES);
+#else
+    (void)cb;
+#endif
+    return ESP_OK;
+}
+
+bool cdc_pipeline_flow_paused(uint8_t dev)
+{
+#ifdef CONFIG_CDC_FLOW_LOSSLESS
+    return dev < CDC_RING_DEVICES && (__atomic_load_n(&s_flow.paused, __ATOMIC_ACQUIRE) & CDC_RING_DEV_MASK(dev));
+#else
+    (void)dev;
+    return false;
+#endif
+}
+
+esp_err_t cdc_pipeline_write(uint8_t dev, const uint8_t *data, size_t len, uint16_t flags)
+{
+    esp_err_t ret = ESP_OK;
+
+    metrics_add(METRIC_FRAMED_RECORDS, 1);
+    metrics_add(METRIC_FRAMED_BYTES, len);
+    while (len > 0) {
+        size_t part = len > CONFIG_CDC_RING_MAX_RECORD_LEN ? CONFIG_CDC_RING_MAX_RECORD_LEN : len;
+        esp_err_t err = cdc_ring_write(dev, data, part, flags);
+        if (err != ESP_OK) {
+            ret = err;
+            metrics_add(METRIC_DROPPED_RECORDS, 1);
+            metrics_add(METRIC_DROPPED_BYTES, part);
+        } else {
+            metrics_add(METRIC_QUEUED_RECORDS, 1);
+            metrics_add(METRIC_QUEUED_BYTES, part);
+        }
+        data += part;
+        len -= part;
+    }
+
+    size_t pending;
+    uint32_t count = cdc_ring_dev_pending(dev, &pending);
+    metrics_hwm(METRIC_HWM_RING_PENDING, count);
+    metrics_hwm(METRIC_HWM_RING_BYTES, pending);
+#ifdef CONFIG_CDC_FLOW_LOSSLESS
+    if (s_flow.timer != NULL) {
+        cdc_flow_check(dev, pending);
+    }
+#endif
+    if (s_notify) {
+        s_notify(count, pending);
+    }
+    return ret;
+}
+
+void cdc_pipeline_input(uint8_t dev, const uint8_t *data, size_t len)
+{
+    // 经分帧阶段还原出完整记录后写入该设备的环形缓冲区，所有读者共享同一份数据
+    cdc_framer_input(dev, data, len, cdc_pipeline_write);
+}
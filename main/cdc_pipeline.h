@@ -0,0 +1,80 @@
+/*
+ * @Description: CDC数据通路 (分帧 -> 环形缓冲区) 头文件
+ *
+ * 不依赖USB和HTTP组件，可以在linux目标上编译 (见tools/pipeline_bench)。
+ */
+
+#ifndef CDC_PIPELINE_H
+#define CDC_PIPELINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 新记录写入后的通知回调，由发送方决定是否唤醒发送任务
+ *
+ * @param pending_records 该设备最慢读者的未读记录数
+ * @param pending_bytes 该设备最慢读者的未读字节数
+ */
+typedef void (*cdc_pipeline_notify_t)(uint32_t pending_records, size_t pending_bytes);
+
+/**
+ * @brief 流控状态变化通知回调 (无损模式)，由接收方调用cdc_pipeline_flow_paused()读取各设备的当前状态
+ *
+ * 可能在USB接收回调或esp_timer任务中调用，不能阻塞。
+ */
+typedef void (*cdc_pipeline_flow_cb_t)(void);
+
+/**
+ * @brief 设置新记录通知回调
+ *
+ * @param notify 回调函数 (NULL表示不通知)
+ */
+void cdc_pipeline_set_notify(cdc_pipeline_notify_t notify);
+
+/**
+ * @brief 设置流控状态变化通知回调 (只在CONFIG_CDC_FLOW_LOSSLESS时生效)
+ *
+ * @param cb 回调函数
+ * @return esp_err_t ESP_OK成功
+ */
+esp_err_t cdc_pipeline_set_flow_cb(cdc_pipeline_flow_cb_t cb);
+
+/**
+ * @brief 当前是否要求设备暂停发送
+ *
+ * @param dev 设备编号
+ */
+bool cdc_pipeline_flow_paused(uint8_t dev);
+
+/**
+ * @brief 输入一段CDC接收数据，经分帧后写入该设备的环形缓冲区
+ *
+ * @param dev 设备编号
+ * @param data 数据
+ * @param len 数据长度
+ */
+void cdc_pipeline_input(uint8_t dev, const uint8_t *data, size_t len);
+
+/**
+ * @brief 将一条记录写入设备的环形缓冲区，超过单条记录上限时分段写入
+ *
+ * @param dev 设备编号
+ * @param data 记录数据
+ * @param len 记录长度
+ * @param flags 记录标志 (CDC_RING_FLAG_*)
+ * @return esp_err_t ESP_OK成功，ESP_ERR_NO_MEM有分段因空间不足被丢弃
+ */
+esp_err_t cdc_pipeline_write(uint8_t dev, const uint8_t *data, size_t len, uint16_t flags);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CDC_PIPELINE_H */
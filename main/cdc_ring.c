@@ -0,0 +1,495 @@
+/*
+ * @Description: CDC接收数据环形缓冲区实现
+ *
+ * 数据区为静态分配的字节环，每次写入形成一条记录，记录描述符单独存放。
+ * 记录在数据区中始终连续 (不跨越末尾)，发送方可以直接以记录为切片发送，
+ * 无需额外的内存分配和拷贝。
+ *
+ * 每个CDC设备有独立的数据区和记录描述符，读者可以订阅一个或多个设备，
+ * 订阅多个设备时按记录时间戳从各设备中依次取出最早的数据。
+ *
+ * 启用CONFIG_CDC_RING_RETAIN时，已被所有读者读过的记录仍然保留直到空间不足，
+ * 新的读者可以从任意保留的记录开始读取 (回放)。
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "cdc_ring.h"
+
+static const char *TAG = "cdc_ring";
+
+// 环形缓冲区配置常量
+#define CDC_RING_DATA_SIZE        CONFIG_CDC_RING_DATA_SIZE
+#define CDC_RING_RECORDS          CONFIG_CDC_RING_RECORDS
+#define CDC_RING_MAX_RECORD_LEN   CONFIG_CDC_RING_MAX_RECORD_LEN
+#define CDC_RING_MAX_READERS      CONFIG_CDC_RING_MAX_READERS
+
+#define CDC_RING_DATA_MASK        (CDC_RING_DATA_SIZE - 1)
+#define CDC_RING_REC_MASK         (CDC_RING_RECORDS - 1)
+
+_Static_assert((CDC_RING_DATA_SIZE & CDC_RING_DATA_MASK) == 0, "CDC_RING_DATA_SIZE必须为2的幂");
+_Static_assert((CDC_RING_RECORDS & CDC_RING_REC_MASK) == 0, "CDC_RING_RECORDS必须为2的幂");
+_Static_assert(CDC_RING_MAX_RECORD_LEN <= UINT16_MAX, "单条记录长度不能超过65535");
+_Static_assert(CDC_RING_MAX_RECORD_LEN <= CDC_RING_DATA_SIZE, "单条记录长度不能超过数据区大小");
+_Static_assert(CDC_RING_DEVICES >= 1 && CDC_RING_DEVICES <= 8, "设备数必须为1~8");
+
+// 读者状态
+typedef struct {
+    uint32_t devices;                   // 订阅的设备掩码
+    uint32_t seq[CDC_RING_DEVICES];     // 每个设备下一条要读取的记录序号
+    uint32_t lost;                      // 被覆盖而丢失的记录数 (所有设备累计)
+    uint8_t busy_dev;                   // 正在发送的切片所属设备
+    bool busy;                          // 是否有切片正在发送
+    bool active;
+} cdc_ring_reader_t;
+
+// 单个设备的环形缓冲区
+typedef struct {
+    uint32_t head;          // 下一条要写入的记录序号
+    uint32_t tail;          // 最旧的保留记录序号
+    uint32_t wr_pos;        // 下一次写入的虚拟偏移
+    uint32_t written;
+    uint32_t dropped;
+    uint32_t overwritten;
+} cdc_ring_dev_t;
+
+// 环形缓冲区上下文
+typedef struct {
+    cdc_ring_reader_t readers[CDC_RING_MAX_READERS];
+    cdc_ring_dev_t devs[CDC_RING_DEVICES];
+    portMUX_TYPE lock;
+    bool is_initialized;
+} cdc_ring_ctx_t;
+
+// 数据区：启用PSRAM且允许.bss放入PSRAM时位于PSRAM，否则位于内部RAM
+EXT_RAM_BSS_ATTR static uint8_t s_ring_data[CDC_RING_DEVICES][CDC_RING_DATA_SIZE];
+EXT_RAM_BSS_ATTR static cdc_ring_rec_t s_ring_recs[CDC_RING_DEVICES][CDC_RING_RECORDS];
+static cdc_ring_ctx_t s_ring = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+// 获取设备的一条记录
+static inline cdc_ring_rec_t *ring_rec(uint8_t dev, uint32_t seq)
+{
+    return &s_ring_recs[dev][seq & CDC_RING_REC_MASK];
+}
+
+// 获取最旧记录的起始位置 (需持有锁)
+static inline uint32_t ring_tail_pos(uint8_t dev)
+{
+    const cdc_ring_dev_t *d = &s_ring.devs[dev];
+    if (d->tail == d->head) {
+        return d->wr_pos;
+    }
+    return ring_rec(dev, d->tail)->pos;
+}
+
+// 读者是否订阅了设备
+static inline bool ring_subscribed(const cdc_ring_reader_t *r, uint8_t dev)
+{
+    return r->active && (r->devices & CDC_RING_DEV_MASK(dev));
+}
+
+// 获取有效的读者 (需持有锁)
+static inline cdc_ring_reader_t *ring_reader(int reader)
+{
+    if (reader < 0 || reader >= CDC_RING_MAX_READERS || !s_ring.readers[reader].active) {
+        return NULL;
+    }
+    return &s_ring.readers[reader];
+}
+
+// 获取订阅该设备的最慢读者的读取位置，无读者时返回head (需持有锁)
+static uint32_t ring_min_reader_seq(uint8_t dev)
+{
+    uint32_t seq = s_ring.devs[dev].head;
+    for (int i = 0; i < CDC_RING_MAX_READERS; i++) {
+        const cdc_ring_reader_t *r = &s_ring.readers[i];
+        if (ring_subscribed(r, dev) && (int32_t)(r->seq[dev] - seq) < 0) {
+            seq = r->seq[dev];
+        }
+    }
+    return seq;
+}
+
+// 根据最慢的读者重新计算tail (需持有锁)
+// 保留模式下所有读者都已读过的数据也保留，仅在空间不足时淘汰，供后连接的客户端回放
+static void ring_update_tail(void)
+{
+#if !CONFIG_CDC_RING_RETAIN
+    for (uint8_t dev = 0; dev < CDC_RING_DEVICES; dev++) {
+        s_ring.devs[dev].tail = ring_min_reader_seq(dev);
+    }
+#endif
+}
+
+// 淘汰设备最旧的一条记录 (需持有锁)，记录正在被发送时返回false
+static bool ring_evict_tail(uint8_t dev)
+{
+    cdc_ring_dev_t *d = &s_ring.devs[dev];
+
+    for (int i = 0; i < CDC_RING_MAX_READERS; i++) {
+        const cdc_ring_reader_t *r = &s_ring.readers[i];
+        if (ring_subscribed(r, dev) && r->busy && r->busy_dev == dev && r->seq[dev] == d->tail) {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < CDC_RING_MAX_READERS; i++) {
+        cdc_ring_reader_t *r = &s_ring.readers[i];
+        if (ring_subscribed(r, dev) && r->seq[dev] == d->tail) {
+            r->seq[dev]++;
+            r->lost++;
+            d->overwritten++;
+        }
+    }
+    d->tail++;
+    return true;
+}
+
+// 将起始序号限制在设备仍保留的记录范围内 (需持有锁)
+static uint32_t ring_clamp_seq(uint8_t dev, uint32_t seq)
+{
+    const cdc_ring_dev_t *d = &s_ring.devs[dev];
+    if (seq == CDC_RING_SEQ_LIVE || (int32_t)(seq - d->head) > 0) {
+        return d->head;
+    }
+    if ((int32_t)(seq - d->tail) < 0) {
+        return d->tail;
+    }
+    return seq;
+}
+
+// 查找设备第一条不早于指定时间的记录序号 (需持有锁)
+static uint32_t ring_seq_at_time(uint8_t dev, int64_t timestamp_us)
+{
+    // 记录时间戳单调递增，二分查找第一条不早于timestamp_us的记录
+    uint32_t lo = s_ring.devs[dev].tail;
+    uint32_t hi = s_ring.devs[dev].head;
+    while (lo != hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (ring_rec(dev, mid)->timestamp_us < timestamp_us) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// 分配读者，起始位置由seq或timestamp_us决定 (since为true时按时间)
+static int ring_reader_alloc(uint32_t devices, uint32_t seq, bool since, int64_t timestamp_us)
+{
+    int reader = -1;
+
+    if (devices == 0 || (devices & ~CDC_RING_DEV_ALL)) {
+        return -1;
+    }
+
+    taskENTER_CRITICAL(&s_ring.lock);
+    for (int i = 0; i < CDC_RING_MAX_READERS; i++) {
+        cdc_ring_reader_t *r = &s_ring.readers[i];
+        if (r->active) {
+            continue;
+        }
+        memset(r, 0, sizeof(cdc_ring_reader_t));
+        r->devices = devices;
+        for (uint8_t dev = 0; dev < CDC_RING_DEVICES; dev++) {
+            r->seq[dev] = since ? ring_seq_at_time(dev, timestamp_us) : ring_clamp_seq(dev, seq);
+        }
+        r->active = true;
+        reader = i;
+        break;
+    }
+    ring_update_tail();
+    taskEXIT_CRITICAL(&s_ring.lock);
+
+    return reader;
+}
+
+esp_err_t cdc_ring_init(void)
+{
+    // app_main在USB启动前初始化，之后WebSocket和数据记录模块的调用直接返回
+    taskENTER_CRITICAL(&s_ring.lock);
+    if (s_ring.is_initialized) {
+        taskEXIT_CRITICAL(&s_ring.lock);
+        return ESP_OK;
+    }
+    memset(s_ring.readers, 0, sizeof(s_ring.readers));
+    memset(s_ring.devs, 0, sizeof(s_ring.devs));
+    s_ring.is_initialized = true;
+    taskEXIT_CRITICAL(&s_ring.lock);
+
+    ESP_LOGI(TAG, "环形缓冲区初始化完成: %d个设备, 每个数据区%d字节, 记录数%d",
+             CDC_RING_DEVICES, CDC_RING_DATA_SIZE, CDC_RING_RECORDS);
+    return ESP_OK;
+}
+
+esp_err_t cdc_ring_write(uint8_t dev, const uint8_t *data, size_t len, uint16_t flags)
+{
+    if (!s_ring.is_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (dev >= CDC_RING_DEVICES || !data || len == 0 || len > CDC_RING_MAX_RECORD_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    cdc_ring_dev_t *d = &s_ring.devs[dev];
+    int64_t now = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&s_ring.lock);
+
+    // 记录不跨越数据区末尾，放不下时跳到数据区开头
+    uint32_t pos = d->wr_pos;
+    uint32_t phys = pos & CDC_RING_DATA_MASK;
+    if (phys + len > CDC_RING_DATA_SIZE) {
+        pos += CDC_RING_DATA_SIZE - phys;
+    }
+
+    // 空间不足时淘汰最旧的记录
+    while (d->tail != d->head &&
+           (pos + len - ring_tail_pos(dev) > CDC_RING_DATA_SIZE ||
+            d->head - d->tail >= CDC_RING_RECORDS)) {
+        if (!ring_evict_tail(dev)) {
+            // 最旧的记录正在发送，不能覆盖，丢弃本次写入
+            d->dropped++;
+            taskEXIT_CRITICAL(&s_ring.lock);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    cdc_ring_rec_t *rec = ring_rec(dev, d->head);
+    rec->seq = d->head;
+    rec->pos = pos;
+    rec->len = (uint16_t)len;
+    rec->flags = flags;
+    rec->timestamp_us = now;
+    d->wr_pos = pos + len;
+
+    taskEXIT_CRITICAL(&s_ring.lock);
+
+    // 记录尚未发布，读者不会访问该区域，拷贝无需持锁
+    memcpy(&s_ring_data[dev][pos & CDC_RING_DATA_MASK], data, len);
+
+    taskENTER_CRITICAL(&s_ring.lock);
+    d->head++;
+    d->written++;
+    taskEXIT_CRITICAL(&s_ring.lock);
+
+    return ESP_OK;
+}
+
+int cdc_ring_reader_open(uint32_t devices)
+{
+    return ring_reader_alloc(devices, CDC_RING_SEQ_LIVE, false, 0);
+}
+
+int cdc_ring_reader_open_at(uint32_t devices, uint32_t seq)
+{
+    return ring_reader_alloc(devices, seq, false, 0);
+}
+
+int cdc_ring_reader_open_since(uint32_t devices, int64_t timestamp_us)
+{
+    return ring_reader_alloc(devices, 0, true, timestamp_us);
+}
+
+void cdc_ring_reader_close(int reader)
+{
+    taskENTER_CRITICAL(&s_ring.lock);
+    cdc_ring_reader_t *r = ring_reader(reader);
+    if (r) {
+        r->active = false;
+        r->busy = false;
+        ring_update_tail();
+    }
+    taskEXIT_CRITICAL(&s_ring.lock);
+}
+
+uint32_t cdc_ring_reader_seq(int reader, uint8_t dev)
+{
+    uint32_t seq = 0;
+
+    taskENTER_CRITICAL(&s_ring.lock);
+    cdc_ring_reader_t *r = ring_reader(reader);
+    if (r && dev < CDC_RING_DEVICES) {
+        seq = r->seq[dev];
+    }
+    taskEXIT_CRITICAL(&s_ring.lock);
+
+    return seq;
+}
+
+uint32_t cdc_ring_reader_take_lost(int reader)
+{
+    uint32_t lost = 0;
+
+    taskENTER_CRITICAL(&s_ring.lock);
+    cdc_ring_reader_t *r = ring_reader(reader);
+    if (r) {
+        lost = r->lost;
+        r->lost = 0;
+    }
+    taskEXIT_CRITICAL(&s_ring.lock);
+
+    return lost;
+}
+
+bool cdc_ring_peek(int reader, cdc_ring_slice_t *slice, size_t max_bytes)
+{
+    if (!slice || !s_ring.is_initialized) {
+        return false;
+    }
+
+    taskENTER_CRITICAL(&s_ring.lock);
+    cdc_ring_reader_t *r = ring_reader(reader);
+    if (!r) {
+        taskEXIT_CRITICAL(&s_ring.lock);
+        return false;
+    }
+
+    // 在订阅的设备中选择最早写入的未读记录
+    const cdc_ring_rec_t *rec = NULL;
+    uint8_t dev = 0;
+    for (uint8_t i = 0; i < CDC_RING_DEVICES; i++) {
+        if (!(r->devices & CDC_RING_DEV_MASK(i)) || r->seq[i] == s_ring.devs[i].head) {
+            continue;
+        }
+        const cdc_ring_rec_t *cand = ring_rec(i, r->seq[i]);
+        if (!rec || cand->timestamp_us < rec->timestamp_us) {
+            rec = cand;
+            dev = i;
+        }
+    }
+    if (!rec) {
+        taskEXIT_CRITICAL(&s_ring.lock);
+        return false;
+    }
+
+    slice->data = &s_ring_data[dev][rec->pos & CDC_RING_DATA_MASK];
+    slice->len = rec->len;
+    slice->first_seq = rec->seq;
+    slice->count = 1;
+    slice->flags = rec->flags;
+    slice->dev = dev;
+    slice->timestamp_us = rec->timestamp_us;
+
+    // 合并数据区中紧邻且标志相同的后续记录，带RECORD标志的记录单独成片
+    uint32_t next_pos = rec->pos + rec->len;
+    uint32_t head = s_ring.devs[dev].head;
+    for (uint32_t seq = r->seq[dev] + 1; seq != head && !(rec->flags & CDC_RING_FLAG_RECORD); seq++) {
+        const cdc_ring_rec_t *next = ring_rec(dev, seq);
+        if (next->pos != next_pos || next->flags != rec->flags ||
+            slice->len + next->len > max_bytes) {
+            break;
+        }
+        slice->len += next->len;
+        slice->count++;
+        next_pos += next->len;
+    }
+
+    r->busy = true;
+    r->busy_dev = dev;
+    taskEXIT_CRITICAL(&s_ring.lock);
+
+    return true;
+}
+
+uint32_t cdc_ring_pending(int reader, size_t *bytes, int64_t *oldest_us)
+{
+    uint32_t count = 0;
+    size_t total = 0;
+
+    taskENTER_CRITICAL(&s_ring.lock);
+    cdc_ring_reader_t *r = ring_reader(reader);
+    for (uint8_t dev = 0; r && dev < CDC_RING_DEVICES; dev++) {
+        const cdc_ring_dev_t *d = &s_ring.devs[dev];
+        uint32_t seq = r->seq[dev];
+        if (!(r->devices & CDC_RING_DEV_MASK(dev)) || seq == d->head) {
+            continue;
+        }
+        const cdc_ring_rec_t *rec = ring_rec(dev, seq);
+        if (oldest_us && (count == 0 || rec->timestamp_us < *oldest_us)) {
+            *oldest_us = rec->timestamp_us;
+        }
+        count += d->head - seq;
+        total += d->wr_pos - rec->pos;
+    }
+    taskEXIT_CRITICAL(&s_ring.lock);
+
+    if (bytes) {
+        *bytes = total;
+    }
+    return count;
+}
+
+uint32_t cdc_ring_dev_pending(uint8_t dev, size_t *bytes)
+{
+    uint32_t count = 0;
+    size_t total = 0;
+
+    if (dev < CDC_RING_DEVICES) {
+        taskENTER_CRITICAL(&s_ring.lock);
+        const cdc_ring_dev_t *d = &s_ring.devs[dev];
+        uint32_t seq = ring_min_reader_seq(dev);
+        count = d->head - seq;
+        if (count) {
+            total = d->wr_pos - ring_rec(dev, seq)->pos;
+        }
+        taskEXIT_CRITICAL(&s_ring.lock);
+    }
+
+    if (bytes) {
+        *bytes = total;
+    }
+    return count;
+}
+
+void cdc_ring_consume(int reader, const cdc_ring_slice_t *slice)
+{
+    if (!slice || !s_ring.is_initialized) {
+        return;
+    }
+
+    taskENTER_CRITICAL(&s_ring.lock);
+    cdc_ring_reader_t *r = ring_reader(reader);
+    if (r) {
+        if (r->busy && slice->dev == r->busy_dev && slice->first_seq == r->seq[slice->dev]) {
+            r->seq[slice->dev] += slice->count;
+        }
+        r->busy = false;
+        ring_update_tail();
+    }
+    taskEXIT_CRITICAL(&s_ring.lock);
+}
+
+void cdc_ring_get_stats(uint8_t dev, cdc_ring_stats_t *stats)
+{
+    if (!stats || dev >= CDC_RING_DEVICES) {
+        return;
+    }
+
+    taskENTER_CRITICAL(&s_ring.lock);
+    const cdc_ring_dev_t *d = &s_ring.devs[dev];
+    stats->written = d->written;
+    stats->dropped = d->dropped;
+    stats->overwritten = d->overwritten;
+    stats->used_bytes = d->wr_pos - ring_tail_pos(dev);
+    stats->capacity = CDC_RING_DATA_SIZE;
+    stats->first_seq = d->tail;
+    stats->next_seq = d->head;
+    stats->first_us = d->tail != d->head ? ring_rec(dev, d->tail)->timestamp_us : 0;
+    stats->readers = 0;
+    for (int i = 0; i < CDC_RING_MAX_READERS; i++) {
+        if (ring_subscribed(&s_ring.readers[i], dev)) {
+            stats->readers++;
+        }
+    }
+    taskEXIT_CRITICAL(&s_ring.lock);
+}
@@ -0,0 +1,197 @@
+/*
+ * @Description: CDC接收数据环形缓冲区头文件
+ */
+
+#ifndef CDC_RING_H
+#define CDC_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 记录标志
+#define CDC_RING_FLAG_BINARY    (1 << 0)   // 强制按二进制发送
+#define CDC_RING_FLAG_TEXT      (1 << 1)   // 已确认为文本，发送时无需再检查
+#define CDC_RING_FLAG_RECORD    (1 << 2)   // 完整记录，不与其他记录合并发送
+
+// 每个CDC设备一个独立的环形缓冲区，记录序号按设备分别编号
+#define CDC_RING_DEVICES        CONFIG_CDC_MAX_DEVICES
+
+// 读者订阅的设备掩码
+#define CDC_RING_DEV_MASK(dev)  (1u << (dev))
+#define CDC_RING_DEV_ALL        ((1u << CDC_RING_DEVICES) - 1)
+
+// 环形缓冲区中的一条记录 (对应一次写入)
+typedef struct {
+    uint32_t seq;           // 记录序号，单调递增
+    uint32_t pos;           // 数据起始位置 (虚拟偏移，对数据区大小取模得到物理偏移)
+    uint16_t len;           // 数据长度
+    uint16_t flags;         // 记录标志
+    int64_t timestamp_us;   // 写入时间戳 (esp_timer_get_time)
+} cdc_ring_rec_t;
+
+// 读出的数据切片，直接指向环形缓冲区内部 (零拷贝)
+typedef struct {
+    const uint8_t *data;    // 数据指针
+    size_t len;             // 数据长度
+    uint32_t first_seq;     // 第一条记录序号
+    uint32_t count;         // 包含的记录数
+    uint16_t flags;         // 记录标志 (只合并标志相同的记录)
+    uint8_t dev;            // 设备编号 (只合并同一设备的记录)
+    int64_t timestamp_us;   // 第一条记录的时间戳
+} cdc_ring_slice_t;
+
+// 单个设备的环形缓冲区统计信息
+typedef struct {
+    uint32_t written;       // 写入的记录数
+    uint32_t dropped;       // 因空间不足丢弃的写入数
+    uint32_t overwritten;   // 未读即被覆盖的记录数 (所有读者累计)
+    size_t used_bytes;      // 当前占用字节数
+    size_t capacity;        // 数据区容量
+    uint32_t first_seq;     // 最旧的保留记录序号
+    uint32_t next_seq;      // 下一条写入的记录序号
+    int64_t first_us;       // 最旧的保留记录时间戳 (无数据时为0)
+    uint8_t readers;        // 订阅该设备的读者数
+} cdc_ring_stats_t;
+
+// 表示"从最新数据开始"的起始序号
+#define CDC_RING_SEQ_LIVE       UINT32_MAX
+
+/**
+ * @brief 初始化环形缓冲区 (数据区为静态分配，启用PSRAM时位于PSRAM)
+ *
+ * @return esp_err_t ESP_OK成功，其他失败
+ */
+esp_err_t cdc_ring_init(void);
+
+/**
+ * @brief 写入一条记录 (每个设备单生产者，通常在USB Host任务中调用)
+ *
+ * 空间不足时覆盖该设备最旧的记录，最慢的读者会丢失这部分数据；
+ * 若最旧记录正在被某个读者发送则丢弃本次写入。其他设备的数据不受影响。
+ *
+ * @param dev 设备编号
+ * @param data 数据
+ * @param len 数据长度 (不能超过CONFIG_CDC_RING_MAX_RECORD_LEN)
+ * @param flags 记录标志
+ * @return esp_err_t ESP_OK成功，ESP_ERR_NO_MEM空间不足被丢弃
+ */
+esp_err_t cdc_ring_write(uint8_t dev, const uint8_t *data, size_t len, uint16_t flags);
+
+/**
+ * @brief 注册一个读者，从最新数据开始读取
+ *
+ * 订阅多个设备的读者按记录时间戳交错读出各设备的数据 (多路复用)。
+ *
+ * @param devices 订阅的设备掩码 (CDC_RING_DEV_MASK/CDC_RING_DEV_ALL)
+ * @return int 读者编号，读者已满或掩码无效时返回-1
+ */
+int cdc_ring_reader_open(uint32_t devices);
+
+/**
+ * @brief 注册一个读者，从指定序号开始读取 (用于回放)
+ *
+ * 序号早于最旧的保留记录时从最旧记录开始，CDC_RING_SEQ_LIVE表示从最新数据开始。
+ * 各设备的序号相互独立，订阅多个设备时同一序号分别用于每个设备。
+ *
+ * @param devices 订阅的设备掩码
+ * @param seq 起始记录序号
+ * @return int 读者编号，读者已满或掩码无效时返回-1
+ */
+int cdc_ring_reader_open_at(uint32_t devices, uint32_t seq);
+
+/**
+ * @brief 注册一个读者，从每个设备第一条不早于指定时间的记录开始读取
+ *
+ * @param devices 订阅的设备掩码
+ * @param timestamp_us 时间 (esp_timer_get_time)
+ * @return int 读者编号，读者已满或掩码无效时返回-1
+ */
+int cdc_ring_reader_open_since(uint32_t devices, int64_t timestamp_us);
+
+/**
+ * @brief 获取读者在指定设备上下一条要读取的记录序号
+ *
+ * @param reader 读者编号
+ * @param dev 设备编号
+ * @return uint32_t 记录序号
+ */
+uint32_t cdc_ring_reader_seq(int reader, uint8_t dev);
+
+/**
+ * @brief 注销读者
+ *
+ * @param reader 读者编号
+ */
+void cdc_ring_reader_close(int reader);
+
+/**
+ * @brief 获取并清零读者因被覆盖而丢失的记录数
+ *
+ * @param reader 读者编号
+ * @return uint32_t 丢失的记录数
+ */
+uint32_t cdc_ring_reader_take_lost(int reader);
+
+/**
+ * @brief 获取读者的下一段待发送数据
+ *
+ * 从读者最旧的未读记录开始 (订阅多个设备时取各设备中时间戳最早的一条)，
+ * 合并同一设备数据区中相邻且标志相同的记录，总长度不超过
+ * max_bytes (第一条记录总是返回)。成功后切片所指向的数据在调用cdc_ring_consume()
+ * 之前不会被覆盖。多个读者位于同一位置时得到同一块数据，无需拷贝。
+ *
+ * @param reader 读者编号
+ * @param slice 输出的数据切片
+ * @param max_bytes 切片最大长度，0表示只取一条记录
+ * @return true 有数据
+ * @return false 无数据
+ */
+bool cdc_ring_peek(int reader, cdc_ring_slice_t *slice, size_t max_bytes);
+
+/**
+ * @brief 查询读者的未读数据量 (所订阅设备的合计)
+ *
+ * @param reader 读者编号
+ * @param bytes 输出未读字节数 (可为NULL)
+ * @param oldest_us 输出最旧未读记录的时间戳 (可为NULL，无数据时不修改)
+ * @return uint32_t 未读记录数
+ */
+uint32_t cdc_ring_pending(int reader, size_t *bytes, int64_t *oldest_us);
+
+/**
+ * @brief 查询订阅指定设备的最慢读者在该设备上的未读数据量
+ *
+ * @param dev 设备编号
+ * @param bytes 输出未读字节数 (可为NULL)
+ * @return uint32_t 未读记录数，没有读者时为0
+ */
+uint32_t cdc_ring_dev_pending(uint8_t dev, size_t *bytes);
+
+/**
+ * @brief 释放cdc_ring_peek()取得的切片，读者前进到切片之后
+ *
+ * @param reader 读者编号
+ * @param slice 数据切片
+ */
+void cdc_ring_consume(int reader, const cdc_ring_slice_t *slice);
+
+/**
+ * @brief 获取指定设备的环形缓冲区统计信息
+ *
+ * @param dev 设备编号
+ * @param stats 输出的统计信息
+ */
+void cdc_ring_get_stats(uint8_t dev, cdc_ring_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CDC_RING_H */
@@ -0,0 +1,268 @@
+/*
+ * @Description: 任务CPU占用与栈使用分析实现
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "cpu_profile.h"
+#include "mem_pool.h"
+#include "metrics.h"
+
+static const char *TAG = "cpu_profile";
+
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+
+// 快照: 全部任务的状态和取快照的时间
+typedef struct {
+    TaskStatus_t status[CPU_PROFILE_MAX_TASKS];
+    UBaseType_t count;
+    int64_t time_us;
+} snapshot_t;
+
+static bool take_snapshot(snapshot_t *snap)
+{
+    snap->count = uxTaskGetSystemState(snap->status, CPU_PROFILE_MAX_TASKS, NULL);
+    snap->time_us = esp_timer_get_time();
+    if (snap->count == 0) {
+        ESP_LOGW(TAG, "任务数 (%u) 超过CONFIG_CPU_PROFILE_MAX_TASKS", (unsigned)uxTaskGetNumberOfTasks());
+        return false;
+    }
+    return true;
+}
+
+// 任务在上一次快照中的运行时间，新任务为0 (计数器为32位微秒，差值按无符号计算不受回绕影响)
+static uint32_t prev_runtime(const TaskStatus_t *prev, UBaseType_t count, TaskHandle_t handle)
+{
+    for (UBaseType_t i = 0; i < count; i++) {
+        if (prev[i].xHandle == handle) {
+            return prev[i].ulRunTimeCounter;
+        }
+    }
+    return 0;
+}
+
+static uint16_t to_permille(uint32_t runtime_us, uint32_t elapsed_us)
+{
+    uint64_t permille = elapsed_us ? (uint64_t)runtime_us * 1000 / elapsed_us : 0;
+    return permille > 1000 ? 1000 : (uint16_t)permille;
+}
+
+static int8_t task_core(const TaskStatus_t *status)
+{
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+    return status->xCoreID == tskNO_AFFINITY ? -1 : (int8_t)status->xCoreID;
+#else
+    return -1;
+#endif
+}
+
+// 由各核心空闲任务在窗口内的运行时间算出核心负载
+static void core_loads(const snapshot_t *prev, const snapshot_t *cur, uint8_t *load_pct)
+{
+    uint32_t elapsed = (uint32_t)(cur->time_us - prev->time_us);
+    for (int core = 0; core < CPU_PROFILE_CORES; core++) {
+        TaskHandle_t idle = xTaskGetIdleTaskHandleForCPU(core);
+        uint32_t idle_us = 0;
+        for (UBaseType_t i = 0; i < cur->count; i++) {
+            if (cur->status[i].xHandle == idle) {
+                idle_us = cur->status[i].ulRunTimeCounter - prev_runtime(prev->status, prev->count, idle);
+                break;
+            }
+        }
+        load_pct[core] = 100 - to_permille(idle_us, elapsed) / 10;
+    }
+}
+
+static int compare_runtime(const void *a, const void *b)
+{
+    uint32_t ra = ((const cpu_profile_task_t *)a)->runtime_us;
+    uint32_t rb = ((const cpu_profile_task_t *)b)->runtime_us;
+    return ra < rb ? 1 : ra > rb ? -1 : 0;
+}
+
+esp_err_t cpu_profile_sample(uint32_t window_ms, cpu_profile_report_t *report)
+{
+    if (report == NULL || window_ms == 0 || window_ms > CPU_PROFILE_MAX_WINDOW_MS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    snapshot_t *snap = mem_pool_alloc(sizeof(snapshot_t) * 2);
+    if (snap == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (!take_snapshot(&snap[0])) {
+        mem_pool_free(snap);
+        return ESP_ERR_NO_MEM;
+    }
+    vTaskDelay(pdMS_TO_TICKS(window_ms));
+    if (!take_snapshot(&snap[1])) {
+        mem_pool_free(snap);
+        return ESP_ERR_NO_MEM;
+    }
+
+    const snapshot_t *prev = &snap[0];
+    const snapshot_t *cur = &snap[1];
+    memset(report, 0, sizeof(*report));
+    report->window_us = (uint32_t)(cur->time_us - prev->time_us);
+    core_loads(prev, cur, report->core_load_pct);
+
+    for (UBaseType_t i = 0; i < cur->count; i++) {
+        const TaskStatus_t *s = &cur->status[i];
+        cpu_profile_task_t *t = &report->tasks[report->task_count++];
+        strlcpy(t->name, s->pcTaskName, sizeof(t->name));
+        t->core = task_core(s);
+        t->priority = (uint8_t)s->uxCurrentPriority;
+        t->state = s->eCurrentState;
+        t->runtime_us = s->ulRunTimeCounter - prev_runtime(prev->status, prev->count, s->xHandle);
+        t->cpu_permille = to_permille(t->runtime_us, report->window_us);
+        t->stack_free_min = s->usStackHighWaterMark;
+    }
+    mem_pool_free(snap);
+
+    qsort(report->tasks, report->task_count, sizeof(cpu_profile_task_t), compare_runtime);
+    return ESP_OK;
+}
+
+#if CONFIG_CPU_PROFILE_CONTINUOUS
+
+// 连续采样状态。快照只在esp_timer任务中访问，结果由s_lock保护
+static struct {
+    esp_timer_handle_t timer;
+    snapshot_t snap[2];
+    int cur;                    // snap[cur]为最近一次快照
+    bool primed;                // 已有上一次快照
+    uint32_t samples;
+    uint8_t core_load_pct[CPU_PROFILE_CORES];
+    uint8_t core_peak_pct[CPU_PROFILE_CORES];
+    TaskHandle_t handles[CPU_PROFILE_MAX_TASKS];
+    uint16_t permille[CPU_PROFILE_MAX_TASKS];
+    UBaseType_t task_count;
+} s_cont;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void cpu_profile_timer_cb(void *arg)
+{
+    int next = s_cont.cur ^ 1;
+    if (!take_snapshot(&s_cont.snap[next])) {
+        return;
+    }
+    const snapshot_t *prev = &s_cont.snap[s_cont.cur];
+    const snapshot_t *cur = &s_cont.snap[next];
+    s_cont.cur = next;
+    if (!s_cont.primed) {
+        s_cont.primed = true;
+        return;
+    }
+
+    uint32_t elapsed = (uint32_t)(cur->time_us - prev->time_us);
+    uint8_t load[CPU_PROFILE_CORES];
+    core_loads(prev, cur, load);
+
+    taskENTER_CRITICAL(&s_lock);
+    for (UBaseType_t i = 0; i < cur->count; i++) {
+        const TaskStatus_t *s = &cur->status[i];
+        s_cont.handles[i] = s->xHandle;
+        s_cont.permille[i] = to_permille(s->ulRunTimeCounter - prev_runtime(prev->status, prev->count, s->xHandle),
+                                         elapsed);
+    }
+    s_cont.task_count = cur->count;
+    bool saturated = false;
+    for (int core = 0; core < CPU_PROFILE_CORES; core++) {
+        s_cont.core_load_pct[core] = load[core];
+        if (load[core] > s_cont.core_peak_pct[core]) {
+            s_cont.core_peak_pct[core] = load[core];
+        }
+        saturated |= load[core] >= CONFIG_CPU_PROFILE_SATURATION_PCT;
+    }
+    s_cont.samples++;
+    taskEXIT_CRITICAL(&s_lock);
+
+    for (int core = 0; core < CPU_PROFILE_CORES; core++) {
+        metrics_hwm(METRIC_HWM_CPU_LOAD_PCT, load[core]);
+    }
+    if (saturated) {
+        metrics_add(METRIC_CPU_SATURATED_MS, elapsed / 1000);
+    }
+}
+
+#endif /* CONFIG_CPU_PROFILE_CONTINUOUS */
+
+esp_err_t cpu_profile_init(void)
+{
+#if CONFIG_CPU_PROFILE_CONTINUOUS
+    if (s_cont.timer != NULL) {
+        return ESP_OK;
+    }
+    const esp_timer_create_args_t args = {
+        .callback = cpu_profile_timer_cb,
+        .name = "cpu_profile",
+    };
+    esp_err_t err = esp_timer_create(&args, &s_cont.timer);
+    if (err == ESP_OK) {
+        err = esp_timer_start_periodic(s_cont.timer, (uint64_t)CONFIG_CPU_PROFILE_INTERVAL_MS * 1000);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "启动连续采样失败: %s", esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "CPU连续采样已启动，周期%dms", CONFIG_CPU_PROFILE_INTERVAL_MS);
+#endif
+    return ESP_OK;
+}
+
+void cpu_profile_get_load(cpu_profile_load_t *load)
+{
+    memset(load, 0, sizeof(*load));
+#if CONFIG_CPU_PROFILE_CONTINUOUS
+    taskENTER_CRITICAL(&s_lock);
+    load->running = s_cont.timer != NULL;
+    load->interval_ms = CONFIG_CPU_PROFILE_INTERVAL_MS;
+    load->samples = s_cont.samples;
+    memcpy(load->core_load_pct, s_cont.core_load_pct, sizeof(load->core_load_pct));
+    memcpy(load->core_peak_pct, s_cont.core_peak_pct, sizeof(load->core_peak_pct));
+    taskEXIT_CRITICAL(&s_lock);
+#endif
+}
+
+int cpu_profile_task_permille(TaskHandle_t handle)
+{
+    int permille = -1;
+#if CONFIG_CPU_PROFILE_CONTINUOUS
+    taskENTER_CRITICAL(&s_lock);
+    for (UBaseType_t i = 0; i < s_cont.task_count; i++) {
+        if (s_cont.handles[i] == handle) {
+            permille = s_cont.permille[i];
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&s_lock);
+#endif
+    return permille;
+}
+
+#else /* !CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS */
+
+esp_err_t cpu_profile_init(void)
+{
+    ESP_LOGW(TAG, "未启用CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS，CPU分析不可用");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t cpu_profile_sample(uint32_t window_ms, cpu_profile_report_t *report)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void cpu_profile_get_load(cpu_profile_load_t *load)
+{
+    memset(load, 0, sizeof(*load));
+}
+
+int cpu_profile_task_permille(TaskHandle_t handle)
+{
+    return -1;
+}
+
+#endif /* CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS */
@@ -0,0 +1,91 @@
+/*
+ * @Description: 任务CPU占用与栈使用分析头文件
+ *
+ * 基于FreeRTOS运行时间统计 (CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS，时钟为esp_timer微秒)。
+ * 两种方式:
+ *   - 按需采样: cpu_profile_sample()在给定时间窗口前后各取一次全部任务的运行时间，
+ *     算出每个任务的CPU占用、各核心负载和栈剩余量 (/api/cpu)。
+ *   - 连续采样 (CONFIG_CPU_PROFILE_CONTINUOUS): 每CONFIG_CPU_PROFILE_INTERVAL_MS由esp_timer
+ *     取一次快照，更新各核心负载和每个任务最近一个周期的占用；任一核心负载达到
+ *     CONFIG_CPU_PROFILE_SATURATION_PCT的时间计入METRIC_CPU_SATURATED_MS，
+ *     可与dropped_records等计数器对照。
+ * 每次快照只遍历一次任务列表 (期间挂起调度器几十微秒)。
+ */
+
+#ifndef CPU_PROFILE_H
+#define CPU_PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CPU_PROFILE_MAX_TASKS   CONFIG_CPU_PROFILE_MAX_TASKS
+#define CPU_PROFILE_CORES       portNUM_PROCESSORS
+#define CPU_PROFILE_MAX_WINDOW_MS 5000
+
+// 单个任务在窗口内的统计
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    int8_t core;                // 绑定的核心，-1表示不绑定
+    uint8_t priority;
+    eTaskState state;
+    uint32_t runtime_us;        // 窗口内的运行时间
+    uint16_t cpu_permille;      // 占一个核心的千分比
+    uint32_t stack_free_min;    // 栈历史最小剩余 (字节)
+} cpu_profile_task_t;
+
+// 采样结果
+typedef struct {
+    uint32_t window_us;
+    uint8_t core_load_pct[CPU_PROFILE_CORES];
+    uint16_t task_count;        // 按运行时间降序
+    cpu_profile_task_t tasks[CPU_PROFILE_MAX_TASKS];
+} cpu_profile_report_t;
+
+// 连续采样的状态
+typedef struct {
+    bool running;
+    uint32_t interval_ms;
+    uint32_t samples;
+    uint8_t core_load_pct[CPU_PROFILE_CORES];   // 最近一个周期
+    uint8_t core_peak_pct[CPU_PROFILE_CORES];   // 启动以来的最大值
+} cpu_profile_load_t;
+
+/**
+ * @brief 初始化 (启用连续采样时启动周期定时器)
+ * @return esp_err_t ESP_OK成功，ESP_ERR_NOT_SUPPORTED未启用运行时间统计
+ */
+esp_err_t cpu_profile_init(void);
+
+/**
+ * @brief 按需采样 (阻塞调用者window_ms)
+ * @param window_ms 窗口长度 (1 - CPU_PROFILE_MAX_WINDOW_MS)
+ * @param report 输出结果
+ * @return esp_err_t ESP_OK成功，ESP_ERR_INVALID_ARG参数无效，ESP_ERR_NO_MEM内存不足，
+ *         ESP_ERR_NOT_SUPPORTED未启用运行时间统计
+ */
+esp_err_t cpu_profile_sample(uint32_t window_ms, cpu_profile_report_t *report);
+
+/**
+ * @brief 获取连续采样的核心负载
+ */
+void cpu_profile_get_load(cpu_profile_load_t *load);
+
+/**
+ * @brief 获取任务最近一个连续采样周期的CPU占用
+ * @return 占一个核心的千分比，未启用连续采样或任务未知时为-1
+ */
+int cpu_profile_task_permille(TaskHandle_t handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CPU_PROFILE_H */
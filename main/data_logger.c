@@ -0,0 +1,414 @@
+/*
+ * @Description: CDC数据Flash记录实现
+ *
+ * 记录任务作为CDC环形缓冲区的一个独立读者运行，Flash擦写只发生在该任务中，
+ * 不会阻塞WebSocket转发；记录任务跟不上时由环形缓冲区覆盖并计入丢失。
+ * 数据先攒满一个扇区再写入，每个扇区每轮只擦除一次，段在分区内循环使用。
+ */
+
+#include <string.h>
+#include <inttypes.h>
+#include <sys/time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "sdkconfig.h"
+#include "cdc_ring.h"
+#include "data_logger.h"
+#include "task_config.h"
+
+static const char *TAG = "data_logger";
+
+// 记录配置常量
+#define DATA_LOGGER_PARTITION       "datalog"
+#define DATA_LOGGER_SECTOR_SIZE     4096
+#define DATA_LOGGER_SEG_SIZE        CONFIG_DATALOG_SEGMENT_SIZE
+#define DATA_LOGGER_MAX_SEGMENTS    64
+#define DATA_LOGGER_FLUSH_MS        CONFIG_DATALOG_FLUSH_MS
+#define DATA_LOGGER_POLL_MS         50
+#define DATA_LOGGER_UNFINISHED      0xFFFFFFFF
+
+_Static_assert(DATA_LOGGER_SEG_SIZE % DATA_LOGGER_SECTOR_SIZE == 0, "段大小必须为扇区大小的整数倍");
+_Static_assert(sizeof(data_logger_seg_hdr_t) == 32, "段头必须为32字节");
+
+// 记录上下文
+typedef struct {
+    const esp_partition_t *part;
+    uint32_t segments;
+    data_logger_seg_info_t index[DATA_LOGGER_MAX_SEGMENTS];
+    TaskHandle_t task_handle;
+    int reader;                 // 环形缓冲区读者编号
+    bool want_enabled;          // 请求的状态，由记录任务切换
+    bool enabled;
+    uint32_t cur;               // 当前段编号
+    uint32_t next_seq;          // 下一个段序号
+    int64_t seg_start_us;       // 当前段开始时的开机时间
+    size_t sector_off;          // 扇区缓冲区在段内的偏移
+    size_t fill;                // 扇区缓冲区已填充字节数
+    size_t flushed;             // 扇区缓冲区已写入Flash的字节数
+    int64_t last_flush_us;
+    data_logger_stats_t stats;
+    portMUX_TYPE lock;          // 保护段索引
+} data_logger_ctx_t;
+
+static uint8_t s_sector[DATA_LOGGER_SECTOR_SIZE];
+static uint8_t s_stage[CONFIG_CDC_RING_MAX_RECORD_LEN];
+static data_logger_ctx_t s_logger = {
+    .reader = -1,
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+// 段在分区内的起始地址
+static inline size_t logger_seg_addr(uint32_t index)
+{
+    return (size_t)index * DATA_LOGGER_SEG_SIZE;
+}
+
+// 写入扇区缓冲区中尚未写入的部分
+static void logger_flush(data_logger_ctx_t *l)
+{
+    if (l->fill == l->flushed) {
+        return;
+    }
+
+    esp_err_t err = esp_partition_write(l->part, logger_seg_addr(l->cur) + l->sector_off + l->flushed,
+                                        s_sector + l->flushed, l->fill - l->flushed);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "写入日志分区失败: %s", esp_err_to_name(err));
+        l->stats.write_errors++;
+    }
+    if (l->fill < DATA_LOGGER_SECTOR_SIZE) {
+        l->stats.flushes++;
+    }
+    l->flushed = l->fill;
+    l->last_flush_us = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&l->lock);
+    l->index[l->cur].used = l->sector_off + l->fill;
+    taskEXIT_CRITICAL(&l->lock);
+}
+
+// 切换到段内下一个扇区，擦除后才能写入
+static void logger_next_sector(data_logger_ctx_t *l)
+{
+    logger_flush(l);
+    l->stats.sectors_written++;
+    l->sector_off += DATA_LOGGER_SECTOR_SIZE;
+    l->fill = 0;
+    l->flushed = 0;
+
+    if (l->sector_off < DATA_LOGGER_SEG_SIZE) {
+        esp_err_t err = esp_partition_erase_range(l->part, logger_seg_addr(l->cur) + l->sector_off,
+                                                  DATA_LOGGER_SECTOR_SIZE);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "擦除日志扇区失败: %s", esp_err_to_name(err));
+            l->stats.write_errors++;
+        }
+    }
+}
+
+// 向当前段追加数据 (调用者保证不超过段末尾)
+static void logger_append(data_logger_ctx_t *l, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    while (len > 0) {
+        size_t n = DATA_LOGGER_SECTOR_SIZE - l->fill;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(s_sector + l->fill, p, n);
+        l->fill += n;
+        p += n;
+        len -= n;
+        if (l->fill == DATA_LOGGER_SECTOR_SIZE) {
+            logger_next_sector(l);
+        }
+    }
+}
+
+// 结束当前段，写入已用长度
+static void logger_close_segment(data_logger_ctx_t *l)
+{
+    logger_flush(l);
+
+    uint32_t used = l->sector_off + l->fill;
+    esp_err_t err = esp_partition_write(l->part, logger_seg_addr(l->cur) + offsetof(data_logger_seg_hdr_t, used),
+                                        &used, sizeof(used));
+    if (err != ESP_OK) {
+        l->stats.write_errors++;
+    }
+
+    taskENTER_CRITICAL(&l->lock);
+    l->index[l->cur].used = used;
+    l->index[l->cur].active = false;
+    taskEXIT_CRITICAL(&l->lock);
+
+    ESP_LOGI(TAG, "日志段%"PRIu32"已结束: %"PRIu32"字节", l->index[l->cur].seq, used);
+}
+
+// 打开下一个段，段头随第一个扇区写入
+static void logger_open_segment(data_logger_ctx_t *l, uint32_t index)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+
+    l->cur = index;
+    l->sector_off = 0;
+    l->fill = 0;
+    l->flushed = 0;
+    l->seg_start_us = esp_timer_get_time();
+    l->last_flush_us = l->seg_start_us;
+
+    esp_err_t err = esp_partition_erase_range(l->part, logger_seg_addr(index), DATA_LOGGER_SECTOR_SIZE);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "擦除日志段失败: %s", esp_err_to_name(err));
+        l->stats.write_errors++;
+    }
+
+    data_logger_seg_hdr_t hdr = {
+        .magic = DATA_LOGGER_SEG_MAGIC,
+        .seq = l->next_seq++,
+        .start_time_us = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec,
+        .start_uptime_us = l->seg_start_us,
+        .first_record = cdc_ring_reader_seq(l->reader, 0),
+        .used = DATA_LOGGER_UNFINISHED,
+    };
+    logger_append(l, &hdr, sizeof(hdr));
+
+    taskENTER_CRITICAL(&l->lock);
+    l->index[index].seq = hdr.seq;
+    l->index[index].start_time_us = hdr.start_time_us;
+    l->index[index].used = sizeof(hdr);
+    l->index[index].valid = true;
+    l->index[index].active = true;
+    taskEXIT_CRITICAL(&l->lock);
+
+    l->stats.current_seq = hdr.seq;
+    ESP_LOGI(TAG, "开始日志段%"PRIu32" (位置%"PRIu32")", hdr.seq, index);
+}
+
+// 记录一段CDC数据，当前段放不下时切换到下一个段
+static void logger_write_entry(data_logger_ctx_t *l, uint8_t dev, const uint8_t *data, size_t len,
+                               uint16_t flags, int64_t timestamp_us)
+{
+    size_t need = sizeof(data_logger_entry_hdr_t) + len;
+    if (l->sector_off + l->fill + need > DATA_LOGGER_SEG_SIZE) {
+        logger_close_segment(l);
+        logger_open_segment(l, (l->cur + 1) % l->segments);
+    }
+
+    data_logger_entry_hdr_t hdr = {
+        .len = (uint16_t)len,
+        .flags = (uint8_t)((flags & 0x0F) | (dev << 4)),
+        .tag = (uint8_t)l->index[l->cur].seq,
+        .offset_ms = (uint32_t)((timestamp_us - l->seg_start_us) / 1000),
+    };
+    logger_append(l, &hdr, sizeof(hdr));
+    logger_append(l, data, len);
+    l->stats.bytes_logged += len;
+}
+
+// 计算未正常结束的段的已用长度
+static size_t logger_scan_used(data_logger_ctx_t *l, uint32_t index, uint8_t tag)
+{
+    size_t off = sizeof(data_logger_seg_hdr_t);
+    data_logger_entry_hdr_t hdr;
+
+    while (off + sizeof(hdr) <= DATA_LOGGER_SEG_SIZE) {
+        if (esp_partition_read(l->part, logger_seg_addr(index) + off, &hdr, sizeof(hdr)) != ESP_OK ||
+            hdr.len == 0xFFFF || hdr.len == 0 || hdr.tag != tag ||
+            off + sizeof(hdr) + hdr.len > DATA_LOGGER_SEG_SIZE) {
+            break;
+        }
+        off += sizeof(hdr) + hdr.len;
+    }
+    return off;
+}
+
+// 开始记录: 从最新的数据开始，总是打开新段
+static void logger_start(data_logger_ctx_t *l)
+{
+    l->reader = cdc_ring_reader_open(CDC_RING_DEV_ALL);
+    if (l->reader < 0) {
+        ESP_LOGE(TAG, "环形缓冲区读者已满，无法开始记录");
+        l->want_enabled = false;
+        return;
+    }
+
+    // 选择最新段之后的位置
+    uint32_t index = 0;
+    uint32_t newest = 0;
+    bool found = false;
+    for (uint32_t i = 0; i < l->segments; i++) {
+        if (l->index[i].valid && (!found || (int32_t)(l->index[i].seq - newest) > 0)) {
+            newest = l->index[i].seq;
+            index = (i + 1) % l->segments;
+            found = true;
+        }
+    }
+
+    logger_open_segment(l, index);
+    l->enabled = true;
+    l->stats.enabled = true;
+}
+
+// 停止记录
+static void logger_stop(data_logger_ctx_t *l)
+{
+    logger_close_segment(l);
+    cdc_ring_reader_close(l->reader);
+    l->reader = -1;
+    l->enabled = false;
+    l->stats.enabled = false;
+}
+
+// 记录任务
+static void data_logger_task(void *arg)
+{
+    data_logger_ctx_t *l = (data_logger_ctx_t *)arg;
+    cdc_ring_slice_t slice;
+
+    while (1) {
+        // 未记录且没有启动请求时只由data_logger_enable()唤醒
+        bool polling = l->enabled || l->want_enabled;
+        ulTaskNotifyTake(pdTRUE, polling ? pdMS_TO_TICKS(DATA_LOGGER_POLL_MS) : portMAX_DELAY);
+
+        if (l->want_enabled != l->enabled) {
+            if (l->want_enabled) {
+                logger_start(l);
+            } else {
+                logger_stop(l);
+            }
+        }
+
+        if (!l->enabled) {
+            continue;
+        }
+
+        l->stats.records_lost += cdc_ring_reader_take_lost(l->reader);
+
+        // 先拷贝出切片并立即释放，Flash写入期间不占用环形缓冲区
+        while (cdc_ring_peek(l->reader, &slice, 0)) {
+            size_t len = slice.len;
+            uint16_t flags = slice.flags;
+            uint8_t dev = slice.dev;
+            int64_t timestamp_us = slice.timestamp_us;
+            memcpy(s_stage, slice.data, len);
+            cdc_ring_consume(l->reader, &slice);
+
+            logger_write_entry(l, dev, s_stage, len, flags, timestamp_us);
+        }
+
+        // 数据较少时定期写入不满一个扇区的数据，掉电最多丢失DATA_LOGGER_FLUSH_MS的数据
+        if (l->fill != l->flushed &&
+            esp_timer_get_time() - l->last_flush_us >= (int64_t)DATA_LOGGER_FLUSH_MS * 1000) {
+            logger_flush(l);
+        }
+    }
+}
+
+esp_err_t data_logger_init(void)
+{
+    data_logger_ctx_t *l = &s_logger;
+
+    if (l->part) {
+        return ESP_OK;
+    }
+
+    l->part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                       DATA_LOGGER_PARTITION);
+    if (!l->part) {
+        ESP_LOGW(TAG, "未找到日志分区 %s，不启用数据记录", DATA_LOGGER_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    l->segments = l->part->size / DATA_LOGGER_SEG_SIZE;
+    if (l->segments > DATA_LOGGER_MAX_SEGMENTS) {
+        l->segments = DATA_LOGGER_MAX_SEGMENTS;
+    }
+    if (l->segments < 2) {
+        ESP_LOGE(TAG, "日志分区过小: %"PRIu32"字节", l->part->size);
+        l->part = NULL;
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // 扫描已有的段，建立索引
+    l->next_seq = 0;
+    for (uint32_t i = 0; i < l->segments; i++) {
+        data_logger_seg_hdr_t hdr;
+        data_logger_seg_info_t *info = &l->index[i];
+        memset(info, 0, sizeof(data_logger_seg_info_t));
+        if (esp_partition_read(l->part, logger_seg_addr(i), &hdr, sizeof(hdr)) != ESP_OK ||
+            hdr.magic != DATA_LOGGER_SEG_MAGIC) {
+            continue;
+        }
+
+        info->seq = hdr.seq;
+        info->start_time_us = hdr.start_time_us;
+        info->used = hdr.used != DATA_LOGGER_UNFINISHED ? hdr.used : logger_scan_used(l, i, (uint8_t)hdr.seq);
+        info->valid = true;
+        if ((int32_t)(hdr.seq + 1 - l->next_seq) > 0) {
+            l->next_seq = hdr.seq + 1;
+        }
+    }
+
+    l->stats.segments = l->segments;
+    l->stats.segment_size = DATA_LOGGER_SEG_SIZE;
+#ifdef CONFIG_DATALOG_AUTO_START
+    l->want_enabled = true;
+#endif
+
+    // 记录任务需要环形缓冲区 (已由app_main初始化时直接返回)
+    cdc_ring_init();
+
+    BaseType_t task_created = task_config_create(TASK_CFG_DATA_LOGGER, data_logger_task, l, &l->task_handle);
+    if (task_created != pdPASS) {
+        ESP_LOGE(TAG, "创建数据记录任务失败");
+        l->part = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "数据记录初始化完成: %"PRIu32"个段, 每段%d字节", l->segments, DATA_LOGGER_SEG_SIZE);
+    return ESP_OK;
+}
+
+esp_err_t data_logger_enable(bool enable)
+{
+    if (!s_logger.part) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_logger.want_enabled = enable;
+    xTaskNotifyGive(s_logger.task_handle);
+    return ESP_OK;
+}
+
+esp_err_t data_logger_get_segment(uint32_t index, data_logger_seg_info_t *info)
+{
+    if (!s_logger.part || index >= s_logger.segments || !info) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    taskENTER_CRITICAL(&s_logger.lock);
+    *info = s_logger.index[index];
+    taskEXIT_CRITICAL(&s_logger.lock);
+    return ESP_OK;
+}
+
+esp_err_t data_logger_read(uint32_t index, size_t offset, void *buf, size_t len)
+{
+    if (!s_logger.part || index >= s_logger.segments || offset + len > DATA_LOGGER_SEG_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return esp_partition_read(s_logger.part, logger_seg_addr(index) + offset, buf, len);
+}
+
+void data_logger_get_stats(data_logger_stats_t *stats)
+{
+    if (stats) {
+        *stats = s_logger.stats;
+    }
+}
@@ -0,0 +1,114 @@
+/*
+ * @Description: CDC数据Flash记录头文件
+ */
+
+#ifndef DATA_LOGGER_H
+#define DATA_LOGGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 日志分区被划分为若干固定大小的段，循环使用。每段格式:
+ *   data_logger_seg_hdr_t (32字节)
+ *   若干条目: data_logger_entry_hdr_t + 数据
+ *   条目长度为0xFFFF (已擦除的Flash) 或条目tag与段序号低8位不符表示段结束
+ */
+#define DATA_LOGGER_SEG_MAGIC     0x474F4C44   // "DLOG"
+
+// 段头
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t seq;               // 段序号，单调递增
+    int64_t start_time_us;      // 段开始时的系统时间 (gettimeofday，未校时则从1970年开始)
+    int64_t start_uptime_us;    // 段开始时的开机时间 (esp_timer_get_time)
+    uint32_t first_record;      // 段中设备0第一条CDC记录的序号
+    uint32_t used;              // 段结束时写入的已用字节数，0xFFFFFFFF表示未正常结束
+} data_logger_seg_hdr_t;
+
+#define DATA_LOGGER_ENTRY_FLAGS(f)   ((f) & 0x0F)
+#define DATA_LOGGER_ENTRY_DEV(f)     ((f) >> 4)
+
+// 条目头
+typedef struct __attribute__((packed)) {
+    uint16_t len;               // 数据长度
+    uint8_t flags;              // 低4位为CDC记录标志，高4位为设备编号 (DATA_LOGGER_ENTRY_DEV)
+    uint8_t tag;                // 段序号低8位，用于识别上一轮残留的数据
+    uint32_t offset_ms;         // 相对段开始时间的毫秒数
+} data_logger_entry_hdr_t;
+
+// 段信息
+typedef struct {
+    uint32_t seq;
+    int64_t start_time_us;
+    size_t used;                // 已写入的字节数
+    bool valid;                 // 段是否包含数据
+    bool active;                // 是否为正在写入的段
+} data_logger_seg_info_t;
+
+// 记录统计信息
+typedef struct {
+    bool enabled;
+    uint32_t segments;          // 段总数
+    size_t segment_size;        // 单段大小
+    uint32_t current_seq;       // 当前段序号
+    uint32_t sectors_written;   // 写入的扇区数
+    uint32_t flushes;           // 不满一个扇区的超时写入次数
+    uint32_t write_errors;      // 写入失败次数
+    uint32_t records_lost;      // 因记录过慢被环形缓冲区覆盖的记录数
+    uint64_t bytes_logged;      // 记录的CDC数据字节数
+} data_logger_stats_t;
+
+/**
+ * @brief 初始化数据记录，扫描日志分区中已有的段
+ *
+ * @return esp_err_t ESP_OK成功，ESP_ERR_NOT_FOUND未找到日志分区
+ */
+esp_err_t data_logger_init(void);
+
+/**
+ * @brief 开始或停止记录，开始时总是打开一个新段
+ *
+ * @param enable 是否记录
+ * @return esp_err_t ESP_OK成功
+ */
+esp_err_t data_logger_enable(bool enable);
+
+/**
+ * @brief 获取段信息
+ *
+ * @param index 段编号 (0 ~ segments-1)
+ * @param info 输出的段信息
+ * @return esp_err_t ESP_OK成功，ESP_ERR_INVALID_ARG编号无效
+ */
+esp_err_t data_logger_get_segment(uint32_t index, data_logger_seg_info_t *info);
+
+/**
+ * @brief 读取段数据 (用于下载)
+ *
+ * @param index 段编号
+ * @param offset 段内偏移
+ * @param buf 输出缓冲区
+ * @param len 读取长度
+ * @return esp_err_t ESP_OK成功
+ */
+esp_err_t data_logger_read(uint32_t index, size_t offset, void *buf, size_t len);
+
+/**
+ * @brief 获取记录统计信息
+ *
+ * @param stats 输出的统计信息
+ */
+void data_logger_get_stats(data_logger_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DATA_LOGGER_H */
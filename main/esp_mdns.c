@@ -1,9 +1,89 @@
+#include <stdio.h>
+#include <inttypes.h>
 #include "esp_mdns.h"
 #include "esp_log.h"
+#include "esp_event.h"
 #include "mdns.h"
+#include "sdkconfig.h"
+#include "http_server.h"
+#include "usbd_cdc.h"
+#include "ws_ctrl.h"
+#include "app_event.h"
 
 static const char *TAG = "esp_mdns";
 
+// TXT记录: 公共项 (proto, baud, cdcN) + 服务自己的项
+#define TXT_COMMON_MAX (2 + USBD_CDC_MAX_DEVICES)
+#define TXT_MAX        (TXT_COMMON_MAX + 3)
+
+// TXT值的存放处 (mDNS会拷贝，这里只在构建期间使用；只在事件循环任务中访问)
+static char s_proto[4];
+static char s_baud[12];
+static char s_cdc_key[USBD_CDC_MAX_DEVICES][8];
+static char s_cdc_val[USBD_CDC_MAX_DEVICES][10];
+
+// WebSocket服务的附加项
+static const mdns_txt_item_t s_ws_txt[] = {
+    { "path", "/ws" },
+    { "enc", "auto,binary,text" },
+    { "codec", "none,lz4" },
+    { "envelope", "1" },
+};
+
+/**
+ * @brief 按当前CDC设备状态构建公共TXT项
+ * @return 项数
+ */
+static size_t build_common_txt(mdns_txt_item_t *txt)
+{
+    size_t n = 0;
+    snprintf(s_proto, sizeof(s_proto), "%d", WS_CTRL_VERSION);
+    txt[n++] = (mdns_txt_item_t){ "proto", s_proto };
+
+    usbd_cdc_config_t config;
+    usbd_cdc_get_config(&config);
+    snprintf(s_baud, sizeof(s_baud), "%"PRIu32, config.baud_rate);
+    txt[n++] = (mdns_txt_item_t){ "baud", s_baud };
+
+    for (uint8_t dev = 0; dev < USBD_CDC_MAX_DEVICES; dev++) {
+        usbd_cdc_device_info_t info;
+        if (!usbd_cdc_get_device_info(dev, &info) || !info.connected) {
+            continue;
+        }
+        snprintf(s_cdc_key[dev], sizeof(s_cdc_key[dev]), "cdc%u", dev);
+        snprintf(s_cdc_val[dev], sizeof(s_cdc_val[dev]), "%04x:%04x", info.vid, info.pid);
+        txt[n++] = (mdns_txt_item_t){ s_cdc_key[dev], s_cdc_val[dev] };
+    }
+    return n;
+}
+
+/**
+ * @brief 构建WebSocket服务的TXT项 (公共项 + 附加项)
+ */
+static size_t build_ws_txt(mdns_txt_item_t *txt)
+{
+    size_t n = build_common_txt(txt);
+    for (size_t i = 0; i < sizeof(s_ws_txt) / sizeof(s_ws_txt[0]); i++) {
+        txt[n++] = s_ws_txt[i];
+    }
+    return n;
+}
+
+// CDC设备连接或断开时更新所有服务的TXT记录 (在事件循环任务中)
+static void mdns_on_cdc_event(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    mdns_txt_item_t txt[TXT_MAX];
+    size_t n = build_common_txt(txt);
+    mdns_service_txt_set("_http", "_tcp", txt, n);
+#ifdef CONFIG_STREAM_SERVER_ENABLE
+    mdns_service_txt_set("_cdcstream", "_tcp", txt, n);
+    mdns_service_txt_set("_cdcstream", "_udp", txt, n);
+#endif
+    n = build_ws_txt(txt);
+    mdns_service_txt_set("_ws", "_tcp", txt, n);
+    ESP_LOGI(TAG, "mDNS TXT记录已更新 (CDC设备掩码0x%02"PRIx32")", usbd_cdc_connected_mask());
+}
+
 void esp_mdns_start(void)
 {
     ESP_LOGI(TAG, "Initializing mDNS");
@@ -12,8 +92,24 @@ void esp_mdns_start(void)
     ESP_ERROR_CHECK(mdns_hostname_set("esp32"));
     ESP_ERROR_CHECK(mdns_instance_name_set("ESP32 mDNS Device"));
 
-    // 注册 HTTP 服务，默认端口 80
-    ESP_ERROR_CHECK(mdns_service_add("ESP Web", "_http", "_tcp", 80, NULL, 0));
+    mdns_txt_item_t txt[TXT_MAX];
+    size_t n = build_common_txt(txt);
+
+    // 注册 HTTP 服务 (与start_webserver使用同一端口)
+    ESP_ERROR_CHECK(mdns_service_add("ESP Web", "_http", "_tcp", HTTP_SERVER_PORT, txt, n));
+
+#ifdef CONFIG_STREAM_SERVER_ENABLE
+    // 注册原始CDC数据流服务
+    ESP_ERROR_CHECK(mdns_service_add("ESP CDC Stream", "_cdcstream", "_tcp", CONFIG_STREAM_SERVER_PORT, txt, n));
+    ESP_ERROR_CHECK(mdns_service_add("ESP CDC Stream", "_cdcstream", "_udp", CONFIG_STREAM_SERVER_PORT, txt, n));
+#endif
+
+    // 注册 WebSocket 数据/控制服务 (与HTTP共用端口)
+    n = build_ws_txt(txt);
+    ESP_ERROR_CHECK(mdns_service_add("ESP WebSocket", "_ws", "_tcp", HTTP_SERVER_PORT, txt, n));
+
+    esp_event_handler_instance_register(APP_EVENT, APP_EVENT_CDC_CONNECTED, mdns_on_cdc_event, NULL, NULL);
+    esp_event_handler_instance_register(APP_EVENT, APP_EVENT_CDC_DISCONNECTED, mdns_on_cdc_event, NULL, NULL);
 
-    ESP_LOGI(TAG, "mDNS started, access via http://esp32.local/");
+    ESP_LOGI(TAG, "mDNS started, access via http://esp32.local:%d/", HTTP_SERVER_PORT);
 }
@@ -5,8 +5,18 @@ extern "C" {
 #endif
 
 /**
- * @brief 启动 mDNS 服务，并注册 http 服务
- * esp32.local:80 => Web server
+ * @brief 启动 mDNS 服务，注册 HTTP、WebSocket 和原始数据流服务
+ * esp32.local:8080 => Web server (_http._tcp)，WebSocket (_ws._tcp, path=/ws)
+ * esp32.local:CONFIG_STREAM_SERVER_PORT => 原始数据流 (_cdcstream._tcp/_udp)
+ *
+ * 各服务的TXT记录 (客户端无需探测即可连接):
+ *   proto   控制协议版本 (WS_CTRL_VERSION)
+ *   baud    CDC设备的波特率
+ *   cdcN    已连接的设备N的VID:PID (十六进制)，未连接的设备不出现
+ *   path    WebSocket路径 (仅_ws)
+ *   enc     支持的数据帧类型 (仅_ws，对应/ws?mode=)
+ *   codec   支持的压缩方式 (仅_ws，对应/ws?codec=)
+ * CDC设备连接或断开时TXT记录随之更新。
  */
 void esp_mdns_start(void);
 
@@ -7,80 +7,46 @@
 #include <esp_wifi.h>
 #include <esp_event.h>
 #include <esp_log.h>
-#include <esp_spiffs.h>
 #include <esp_system.h>
 #include <sys/param.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include "esp_heap_caps.h"
 #include "esp_netif.h"
 #include "esp_http_server.h"
+#include "esp_timer.h"
 #include "cJSON.h"
 #include "http_server.h"
-#include <sys/stat.h>
 #include "nvs_flash.h"
 #include "lwip/ip4_addr.h"
 #include "wifi_manager.h"
+#include "boot_timeline.h"
+#include "wifi_roam.h"
+#include "net_profile.h"
+#include "power_mgmt.h"
+#include "time_sync.h"
 #include "wifi_history.h"
 
 #include "web_socket.h"
+#include "cdc_ring.h"
+#include "cdc_framer.h"
+#include "stream_codec.h"
+#include "data_logger.h"
+#include "stream_server.h"
+#include "task_config.h"
+#include "trace.h"
+#include "metrics.h"
+#include "latency.h"
+#include "cpu_profile.h"
+#include "usbd_cdc.h"
+#include "mem_pool.h"
+#include "json_writer.h"
+#include "web_assets.h"
+#include "wifi_scan.h"
 
 static const char *TAG = "http_server";
 static httpd_handle_t server = NULL;
 
-// 处理根路径请求 - 返回index.html
-static esp_err_t root_get_handler(httpd_req_t *req)
-{
-    char filepath[FILE_PATH_MAX];
-    FILE *fd = NULL;
-    struct stat file_stat;
-    
-    // 构建完整的文件路径
-    strlcpy(filepath, "/spiffs/index.html", sizeof(filepath));
-    
-    // 获取文件信息
-    if (stat(filepath, &file_stat) == -1) {
-        ESP_LOGE(TAG, "Failed to stat file : %s", filepath);
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to read file");
-        return ESP_FAIL;
-    }
-    
-    fd = fopen(filepath, "r");
-    if (!fd) {
-        ESP_LOGE(TAG, "Failed to read file : %s", filepath);
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to read file");
-        return ESP_FAIL;
-    }
-    
-    // 设置Content-Type
-    httpd_resp_set_type(req, "text/html");
-    
-    // 发送文件内容
-    char *chunk = malloc(CHUNK_SIZE);
-    if (chunk == NULL) {
-        fclose(fd);
-        ESP_LOGE(TAG, "Failed to allocate memory for chunk");
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to allocate memory");
-        return ESP_FAIL;
-    }
-    
-    size_t chunksize;
-    do {
-        chunksize = fread(chunk, 1, CHUNK_SIZE, fd);
-        if (chunksize > 0) {
-            if (httpd_resp_send_chunk(req, chunk, chunksize) != ESP_OK) {
-                free(chunk);
-                fclose(fd);
-                ESP_LOGE(TAG, "File sending failed!");
-                httpd_resp_sendstr_chunk(req, NULL);
-                httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to send file");
-                return ESP_FAIL;
-            }
-        }
-    } while (chunksize != 0);
-    
-    free(chunk);
-    fclose(fd);
-    httpd_resp_send_chunk(req, NULL, 0);
-    return ESP_OK;
-}
 // 处理重置连接尝试次数的请求
 static esp_err_t reset_connection_retry_handler(httpd_req_t *req)
 {
@@ -103,40 +69,9 @@ static esp_err_t scan_get_handler(httpd_req_t *req)
 {
     ESP_LOGI(TAG, "收到WiFi扫描请求: %s", req->uri);
     
-    // 检查WiFi状态
-    wifi_mode_t mode;
-    esp_wifi_get_mode(&mode);
-    if (mode & WIFI_MODE_STA) {
-        // 检查是否正在连接
-        wifi_ap_record_t ap_info;
-        if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
-            esp_wifi_disconnect();
-            vTaskDelay(pdMS_TO_TICKS(500)); // 等待断开完成
-        }
-    }
-    
-    ESP_LOGI(TAG, "清除之前的扫描结果");
-    esp_wifi_scan_stop();  // 停止可能正在进行的扫描
-    vTaskDelay(pdMS_TO_TICKS(100)); // 等待扫描停止
-    
-    ESP_LOGI(TAG, "开始WiFi扫描...");
-    // 配置扫描参数
-    wifi_scan_config_t scan_config = {
-        .ssid = NULL,
-        .bssid = NULL,
-        .channel = 0,
-        .show_hidden = true,
-        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
-        .scan_time = {
-            .active = {
-                .min = 100,
-                .max = 300
-            }
-        }
-    };
-    
-    // 开始扫描
-    esp_err_t err = esp_wifi_scan_start(&scan_config, true);
+    // 扫描在后台进行且不断开STA；缓存过期时先回复202，扫描完成后经WebSocket推送scan_done通知
+    bool cached;
+    esp_err_t err = wifi_scan_request(CONFIG_WIFI_SCAN_CACHE_TTL_MS, &cached);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "WiFi扫描失败: %s", esp_err_to_name(err));
         char err_msg[128];
@@ -146,52 +81,24 @@ static esp_err_t scan_get_handler(httpd_req_t *req)
         return ESP_OK;
     }
 
-    // 获取扫描结果
-    uint16_t ap_count = 0;
-    esp_wifi_scan_get_ap_num(&ap_count);
-    
-    if (ap_count == 0) {
-        const char *response = "{\"status\":\"success\",\"networks\":[]}";
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_send(req, response, strlen(response));
-        return ESP_OK;
-    }
-
-    wifi_ap_record_t *ap_records = malloc(sizeof(wifi_ap_record_t) * ap_count);
-    if (ap_records == NULL) {
-        ESP_LOGE(TAG, "内存分配失败");
-        const char *response = "{\"status\":\"error\",\"message\":\"Memory allocation failed\"}";
+    if (!cached) {
+        const char *response = "{\"status\":\"scanning\"}";
+        httpd_resp_set_status(req, "202 Accepted");
         httpd_resp_set_type(req, "application/json");
         httpd_resp_send(req, response, strlen(response));
         return ESP_OK;
     }
 
-    esp_wifi_scan_get_ap_records(&ap_count, ap_records);
-    ESP_LOGI(TAG, "找到 %d 个WiFi网络", ap_count);
-
-    // 创建JSON响应
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "status", "success");
-    cJSON *networks = cJSON_AddArrayToObject(root, "networks");
-
-    for (int i = 0; i < ap_count; i++) {
-        cJSON *ap = cJSON_CreateObject();
-        cJSON_AddStringToObject(ap, "ssid", (char *)ap_records[i].ssid);
-        cJSON_AddNumberToObject(ap, "rssi", ap_records[i].rssi);
-        cJSON_AddNumberToObject(ap, "authmode", ap_records[i].authmode);
-        cJSON_AddItemToArray(networks, ap);
-    }
-
-    char *response = cJSON_PrintUnformatted(root);
-    ESP_LOGI(TAG, "WiFi扫描完成，发送响应");
-    
+    // 边生成边发送JSON响应
+    char buf[JSON_WRITER_BUF_SIZE];
+    json_writer_t w;
     httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr(req, response);
-
-    free(response);
-    free(ap_records);
-    cJSON_Delete(root);
-    return ESP_OK;
+    json_writer_init(&w, req, buf, sizeof(buf));
+    json_writer_begin_object(&w, NULL);
+    json_writer_string(&w, "status", "success");
+    wifi_scan_write_json(&w);
+    json_writer_end_object(&w);
+    return json_writer_finish(&w);
 }
 
 // 处理配网请求
@@ -228,41 +135,18 @@ static esp_err_t configure_post_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
     
-    // 配置WiFi连接
-    wifi_config_t wifi_config = {0};
-    strlcpy((char *)wifi_config.sta.ssid, ssid->valuestring, sizeof(wifi_config.sta.ssid));
-    if (password && cJSON_IsString(password)) {
-        strlcpy((char *)wifi_config.sta.password, password->valuestring, sizeof(wifi_config.sta.password));
-    }
-    
-    // 保存WiFi配置到NVS
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open("wifi_config", NVS_READWRITE, &nvs_handle);
-    if (err == ESP_OK) {
-        err = nvs_set_blob(nvs_handle, "sta_config", &wifi_config, sizeof(wifi_config_t));
-        if (err == ESP_OK) {
-            err = nvs_commit(nvs_handle);
-        }
-        nvs_close(nvs_handle);
-    }
-    
+    // 未给出密码时使用保存的密码 (网页从已保存列表连接时只发送SSID)
+    esp_err_t err = wifi_connect_network(ssid->valuestring,
+                                         password && cJSON_IsString(password) ? password->valuestring : NULL);
+    cJSON_Delete(root);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "保存WiFi配置失败: %s", esp_err_to_name(err));
-    } else {
-        ESP_LOGI(TAG, "WiFi配置已保存到NVS");
+        char err_msg[96];
+        snprintf(err_msg, sizeof(err_msg), "{\"status\":\"error\",\"message\":\"%s\"}", esp_err_to_name(err));
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_sendstr(req, err_msg);
+        return ESP_OK;
     }
     
-    // 添加到WiFi历史记录
-    wifi_history_add_network(ssid->valuestring, 
-                            password && cJSON_IsString(password) ? password->valuestring : "",
-                            NULL, 0, WIFI_AUTH_OPEN, -50);
-    
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config));
-    ESP_ERROR_CHECK(esp_wifi_connect());
-    
-    cJSON_Delete(root);
-    
     const char *response = "{\"status\":\"success\",\"message\":\"WiFi配置已提交，正在连接...\"}";
     httpd_resp_set_type(req, "application/json");
     httpd_resp_send(req, response, strlen(response));
@@ -270,92 +154,59 @@ static esp_err_t configure_post_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
-// 获取WiFi连接状态
+// 获取WiFi连接状态 (订阅了WebSocket状态通道的客户端无需轮询)
 static esp_err_t wifi_status_get_handler(httpd_req_t *req)
 {
-    wifi_ap_record_t ap_info;
-    char *response = NULL;
-    cJSON *root = cJSON_CreateObject();
-    
-    if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
-        cJSON_AddStringToObject(root, "status", "connected");
-        cJSON_AddStringToObject(root, "ssid", (char *)ap_info.ssid);
-        cJSON_AddNumberToObject(root, "rssi", ap_info.rssi);
-        char bssid_str[18];
-        sprintf(bssid_str, "%02X:%02X:%02X:%02X:%02X:%02X",
-                ap_info.bssid[0], ap_info.bssid[1], ap_info.bssid[2],
-                ap_info.bssid[3], ap_info.bssid[4], ap_info.bssid[5]);
-        cJSON_AddStringToObject(root, "bssid", bssid_str);
-        
-        // 获取并添加IP地址
-        wifi_mode_t mode;
-        esp_wifi_get_mode(&mode);
-        if (mode & WIFI_MODE_STA) {
-            esp_netif_ip_info_t ip_info;
-            esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
-            if (netif && esp_netif_get_ip_info(netif, &ip_info) == ESP_OK) {
-                char ip_str[16];
-                snprintf(ip_str, sizeof(ip_str), IPSTR, IP2STR(&ip_info.ip));
-                cJSON_AddStringToObject(root, "ip", ip_str);
-                ESP_LOGI(TAG, "当前IP地址: %s", ip_str);
-            } else {
-                ESP_LOGE(TAG, "获取IP地址失败");
-            }
-        }
-    } else {
-        cJSON_AddStringToObject(root, "status", "disconnected");
-    }
-    
-    response = cJSON_PrintUnformatted(root);
+    char buf[JSON_WRITER_BUF_SIZE];
+    json_writer_t w;
     httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr(req, response);
-    
-    free(response);
-    cJSON_Delete(root);
-    return ESP_OK;
+    json_writer_init(&w, req, buf, sizeof(buf));
+    json_writer_begin_object(&w, NULL);
+    wifi_status_write_json(&w);
+    json_writer_end_object(&w);
+    return json_writer_finish(&w);
 }
 
-// 获取已保存的WiFi列表
+static bool saved_wifi_write_entry(const wifi_history_entry_t *entry, void *arg)
+{
+    json_writer_t *w = arg;
+    json_writer_begin_object(w, NULL);
+    json_writer_string(w, "ssid", entry->ssid);
+    json_writer_uint(w, "priority", entry->priority);
+    json_writer_uint(w, "connect_count", entry->connect_count);
+    json_writer_uint(w, "last_connected", entry->last_connected);
+    json_writer_end_object(w);
+    return true;
+}
+
+// 获取已保存的WiFi列表 (逐条流式输出，保存的网络再多也不占用额外内存)
 static esp_err_t saved_wifi_get_handler(httpd_req_t *req)
 {
-    cJSON *root = cJSON_CreateArray();
-    char *response = NULL;
+    char buf[JSON_WRITER_BUF_SIZE];
+    json_writer_t w;
+
+    httpd_resp_set_type(req, "application/json");
+    json_writer_init(&w, req, buf, sizeof(buf));
+    json_writer_begin_array(&w, NULL);
 
     // 从WiFi历史记录获取网络列表
-    wifi_history_entry_t networks[WIFI_HISTORY_MAX_NETWORKS];
-    uint8_t count = WIFI_HISTORY_MAX_NETWORKS;
-    
-    esp_err_t err = wifi_history_get_networks(networks, &count);
-    if (err == ESP_OK) {
-        for (int i = 0; i < count; i++) {
-            cJSON *wifi = cJSON_CreateObject();
-            cJSON_AddStringToObject(wifi, "ssid", networks[i].ssid);
-            cJSON_AddNumberToObject(wifi, "priority", networks[i].priority);
-            cJSON_AddNumberToObject(wifi, "connect_count", networks[i].connect_count);
-            cJSON_AddNumberToObject(wifi, "last_connected", networks[i].last_connected);
-            cJSON_AddItemToArray(root, wifi);
-        }
-    } else {
+    esp_err_t err = wifi_history_foreach(saved_wifi_write_entry, &w);
+    if (err != ESP_OK) {
         // 回退到旧方法
         wifi_config_t wifi_config;
         err = esp_wifi_get_config(ESP_IF_WIFI_STA, &wifi_config);
         if (err == ESP_OK && strlen((char*)wifi_config.sta.ssid) > 0) {
-            cJSON *wifi = cJSON_CreateObject();
-            cJSON_AddStringToObject(wifi, "ssid", (char*)wifi_config.sta.ssid);
-            cJSON_AddNumberToObject(wifi, "priority", 100);
-            cJSON_AddNumberToObject(wifi, "connect_count", 1);
-            cJSON_AddNumberToObject(wifi, "last_connected", 0);
-            cJSON_AddItemToArray(root, wifi);
+            json_writer_begin_object(&w, NULL);
+            json_writer_string(&w, "ssid", (char*)wifi_config.sta.ssid);
+            json_writer_uint(&w, "priority", 100);
+            json_writer_uint(&w, "connect_count", 1);
+            json_writer_uint(&w, "last_connected", 0);
+            json_writer_end_object(&w);
         }
     }
 
-    response = cJSON_PrintUnformatted(root);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr(req, response);
-
-    free(response);
-    cJSON_Delete(root);
-    return ESP_OK;
+    json_writer_end_array(&w);
+    return json_writer_finish(&w);
 }
 
 // 删除保存的WiFi
@@ -381,62 +232,1131 @@ static esp_err_t delete_wifi_post_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
 
-    // 从WiFi历史记录中删除
-    esp_err_t err = wifi_history_remove_network(ssid->valuestring);
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "已从WiFi历史记录中删除: %s", ssid->valuestring);
+    wifi_forget_network(ssid->valuestring);
+
+    cJSON_Delete(root);
+    httpd_resp_sendstr(req, "{\"status\":\"ok\"}");
+    return ESP_OK;
+}
+
+// 获取CDC数据转发配置和统计
+static esp_err_t stream_get_handler(httpd_req_t *req)
+{
+    ws_batch_config_t batch;
+    ws_stream_stats_t stats;
+    websocket_get_batch_config(&batch);
+    websocket_get_stream_stats(&stats);
+
+    char buf[JSON_WRITER_BUF_SIZE];
+    json_writer_t w;
+    httpd_resp_set_type(req, "application/json");
+    json_writer_init(&w, req, buf, sizeof(buf));
+    json_writer_begin_object(&w, NULL);
+
+    json_writer_begin_object(&w, "batch");
+    json_writer_uint(&w, "max_frame_len", batch.max_frame_len);
+    json_writer_uint(&w, "flush_bytes", batch.flush_bytes);
+    json_writer_uint(&w, "flush_timeout_ms", batch.flush_timeout_ms);
+    json_writer_end_object(&w);
+
+    cdc_framer_config_t framing;
+    cdc_framer_stats_t framer_stats;
+    cdc_framer_get_config(&framing);
+    cdc_framer_get_stats(&framer_stats);
+    json_writer_begin_object(&w, "framing");
+    json_writer_string(&w, "mode", cdc_framer_mode_name(framing.mode));
+    json_writer_string(&w, "emit", framing.emit == CDC_FRAMER_EMIT_RECORD ? "record" : "batch");
+    json_writer_uint(&w, "records", framer_stats.records);
+    json_writer_uint(&w, "oversize", framer_stats.oversize);
+    json_writer_uint(&w, "errors", framer_stats.errors);
+    json_writer_end_object(&w);
+
+    json_writer_begin_object(&w, "stats");
+    json_writer_uint(&w, "frames_sent", stats.frames_sent);
+    json_writer_uint(&w, "records_sent", stats.records_sent);
+    json_writer_uint(&w, "bytes_sent", stats.bytes_sent);
+    json_writer_uint(&w, "records_lost", stats.records_lost);
+    json_writer_uint(&w, "clients", websocket_client_count());
+    json_writer_end_object(&w);
+
+    // 每个设备一个环形缓冲区，记录序号按设备编号
+    json_writer_begin_array(&w, "rings");
+    for (uint8_t dev = 0; dev < CDC_RING_DEVICES; dev++) {
+        cdc_ring_stats_t ring;
+        cdc_ring_get_stats(dev, &ring);
+        json_writer_begin_object(&w, NULL);
+        json_writer_uint(&w, "dev", dev);
+        json_writer_uint(&w, "written", ring.written);
+        json_writer_uint(&w, "dropped", ring.dropped);
+        json_writer_uint(&w, "overwritten", ring.overwritten);
+        json_writer_uint(&w, "used", ring.used_bytes);
+        json_writer_uint(&w, "capacity", ring.capacity);
+        json_writer_uint(&w, "first_seq", ring.first_seq);
+        json_writer_uint(&w, "next_seq", ring.next_seq);
+        json_writer_uint(&w, "readers", ring.readers);
+        json_writer_end_object(&w);
     }
-    
-    wifi_config_t wifi_config;
-    if (esp_wifi_get_config(ESP_IF_WIFI_STA, &wifi_config) == ESP_OK) {
-        if (strcmp((char*)wifi_config.sta.ssid, ssid->valuestring) == 0) {
-            // 先断开WiFi连接
-            esp_wifi_disconnect();
-            vTaskDelay(pdMS_TO_TICKS(1000));  // 等待断开连接
-            
-            // 清除运行时的WiFi配置
-            memset(&wifi_config, 0, sizeof(wifi_config_t));
-            esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config);
-            
-            // 清除自定义NVS中的WiFi配置
-            nvs_handle_t nvs_handle;
-            err = nvs_open("wifi_config", NVS_READWRITE, &nvs_handle);
-            if (err == ESP_OK) {
-                err = nvs_erase_all(nvs_handle);
-                if (err == ESP_OK) {
-                    err = nvs_commit(nvs_handle);
-                    ESP_LOGI(TAG, "已清除自定义NVS中的WiFi配置");
-                }
-                nvs_close(nvs_handle);
+    json_writer_end_array(&w);
+
+    stream_codec_stats_t codec;
+    stream_codec_get_stats(&codec);
+    json_writer_begin_object(&w, "codec");
+    json_writer_uint(&w, "blocks", codec.blocks);
+    json_writer_uint(&w, "stored", codec.stored);
+    json_writer_uint(&w, "bytes_in", codec.bytes_in);
+    json_writer_uint(&w, "bytes_out", codec.bytes_out);
+    json_writer_number(&w, "ratio", codec.bytes_in ? (double)codec.bytes_out / codec.bytes_in : 1.0);
+    json_writer_end_object(&w);
+
+    usbd_cdc_tx_stats_t tx;
+    usbd_cdc_get_tx_stats(&tx);
+    json_writer_begin_object(&w, "cdc_tx");
+    json_writer_uint(&w, "transfers", tx.transfers);
+    json_writer_uint(&w, "requests_ok", tx.requests_ok);
+    json_writer_uint(&w, "requests_failed", tx.requests_failed);
+    json_writer_uint(&w, "requests_rejected", tx.requests_rejected);
+    json_writer_uint(&w, "queued_blocks", tx.queued_blocks);
+    json_writer_uint(&w, "bytes", tx.bytes);
+    json_writer_end_object(&w);
+
+    stream_server_stats_t raw;
+    stream_server_get_stats(&raw);
+    json_writer_begin_object(&w, "raw_server");
+    json_writer_bool(&w, "tcp_connected", raw.tcp_connected);
+    json_writer_bool(&w, "udp_active", raw.udp_active);
+    json_writer_uint(&w, "tcp_sessions", raw.tcp_sessions);
+    json_writer_uint(&w, "tcp_bytes", raw.tcp_bytes);
+    json_writer_uint(&w, "udp_datagrams", raw.udp_datagrams);
+    json_writer_uint(&w, "udp_bytes", raw.udp_bytes);
+    json_writer_uint(&w, "records_lost", raw.records_lost);
+    json_writer_uint(&w, "commands", raw.commands);
+    if (raw.dev == STREAM_DEV_ALL) {
+        json_writer_string(&w, "dev", "all");
+    } else {
+        json_writer_int(&w, "dev", raw.dev);
+    }
+    json_writer_end_object(&w);
+
+    json_writer_end_object(&w);
+    return json_writer_finish(&w);
+}
+
+// 修改CDC数据转发配置
+static esp_err_t stream_post_handler(httpd_req_t *req)
+{
+    char buf[200];
+    int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
+    if (ret <= 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed to receive data");
+        return ESP_FAIL;
+    }
+    buf[ret] = '\0';
+
+    cJSON *root = cJSON_Parse(buf);
+    if (!root) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
+    }
+
+    ws_batch_config_t batch;
+    websocket_get_batch_config(&batch);
+
+    // 预设模式: latency 来一条发一条, throughput 攒满一帧或到截止时间再发
+    cJSON *mode = cJSON_GetObjectItem(root, "mode");
+    if (mode && cJSON_IsString(mode)) {
+        if (strcmp(mode->valuestring, "latency") == 0) {
+            batch.flush_bytes = 0;
+            batch.flush_timeout_ms = 0;
+        } else if (strcmp(mode->valuestring, "throughput") == 0) {
+            batch.flush_bytes = batch.max_frame_len;
+            batch.flush_timeout_ms = CONFIG_WS_BATCH_FLUSH_TIMEOUT_MS;
+        }
+    }
+
+    cJSON *item = cJSON_GetObjectItem(root, "max_frame_len");
+    if (item && cJSON_IsNumber(item)) {
+        batch.max_frame_len = item->valueint;
+    }
+    item = cJSON_GetObjectItem(root, "flush_bytes");
+    if (item && cJSON_IsNumber(item)) {
+        batch.flush_bytes = item->valueint;
+    }
+    item = cJSON_GetObjectItem(root, "flush_timeout_ms");
+    if (item && cJSON_IsNumber(item)) {
+        batch.flush_timeout_ms = item->valueint;
+    }
+
+    // 分帧配置: {"framing":"line","emit":"record"}
+    cdc_framer_config_t framing;
+    cdc_framer_get_config(&framing);
+    bool framing_ok = true;
+    item = cJSON_GetObjectItem(root, "framing");
+    if (item && cJSON_IsString(item)) {
+        framing_ok = cdc_framer_mode_from_name(item->valuestring, &framing.mode);
+    }
+    item = cJSON_GetObjectItem(root, "emit");
+    if (item && cJSON_IsString(item)) {
+        if (strcmp(item->valuestring, "record") == 0) {
+            framing.emit = CDC_FRAMER_EMIT_RECORD;
+        } else if (strcmp(item->valuestring, "batch") == 0) {
+            framing.emit = CDC_FRAMER_EMIT_BATCH;
+        } else {
+            framing_ok = false;
+        }
+    }
+
+    // 原始流服务器转发的设备: {"raw_dev":"all"} 或 {"raw_dev":1}
+    bool raw_dev_ok = true;
+    item = cJSON_GetObjectItem(root, "raw_dev");
+    if (cJSON_IsString(item) && strcmp(item->valuestring, "all") == 0) {
+        raw_dev_ok = stream_server_set_device(STREAM_DEV_ALL) == ESP_OK;
+    } else if (cJSON_IsNumber(item)) {
+        raw_dev_ok = stream_server_set_device(item->valueint) == ESP_OK;
+    } else if (item) {
+        raw_dev_ok = false;
+    }
+    cJSON_Delete(root);
+
+    const char *response;
+    if (!raw_dev_ok) {
+        response = "{\"status\":\"error\",\"message\":\"Invalid raw_dev\"}";
+    } else if (!framing_ok || cdc_framer_set_config(&framing) != ESP_OK) {
+        response = "{\"status\":\"error\",\"message\":\"Invalid framing config\"}";
+    } else if (websocket_set_batch_config(&batch) == ESP_OK) {
+        response = "{\"status\":\"success\"}";
+    } else {
+        response = "{\"status\":\"error\",\"message\":\"Invalid batch config\"}";
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, response);
+    return ESP_OK;
+}
+
+static const char *const s_cdc_parity_names[] = { "none", "odd", "even", "mark", "space" };
+static const char *const s_cdc_stop_bits_names[] = { "1", "1.5", "2" };
+
+// 从JSON读取VID/PID，支持数字和 "0x0483" 形式的字符串
+static bool cdc_json_get_id(const cJSON *obj, const char *key, uint16_t *out)
+{
+    const cJSON *item = cJSON_GetObjectItem(obj, key);
+    unsigned long v;
+    if (cJSON_IsNumber(item)) {
+        v = (unsigned long)item->valuedouble;
+    } else if (cJSON_IsString(item)) {
+        char *end;
+        v = strtoul(item->valuestring, &end, 0);
+        if (end == item->valuestring || *end != '\0') {
+            return false;
+        }
+    } else {
+        return false;
+    }
+    if (v > 0xFFFF) {
+        return false;
+    }
+    *out = (uint16_t)v;
+    return true;
+}
+
+// 获取CDC串口参数和设备匹配表
+static esp_err_t cdc_config_get_handler(httpd_req_t *req)
+{
+    usbd_cdc_config_t cfg;
+    usbd_cdc_get_config(&cfg);
+    usbd_cdc_match_t table[USBD_CDC_MAX_MATCH];
+    size_t count = usbd_cdc_get_match_table(table);
+
+    char buf[JSON_WRITER_BUF_SIZE];
+    json_writer_t w;
+    httpd_resp_set_type(req, "application/json");
+    json_writer_init(&w, req, buf, sizeof(buf));
+    json_writer_begin_object(&w, NULL);
+    json_writer_bool(&w, "connected", usbd_cdc_connected_mask() != 0);
+    json_writer_uint(&w, "baud", cfg.baud_rate);
+    json_writer_uint(&w, "data_bits", cfg.data_bits);
+    json_writer_string(&w, "parity", s_cdc_parity_names[cfg.parity]);
+    json_writer_string(&w, "stop_bits", s_cdc_stop_bits_names[cfg.stop_bits]);
+    json_writer_uint(&w, "in_buffer_size", cfg.in_buffer_size);
+    json_writer_uint(&w, "out_buffer_size", cfg.out_buffer_size);
+    json_writer_begin_array(&w, "devices");
+    for (size_t i = 0; i < count; i++) {
+        char id[8];
+        json_writer_begin_object(&w, NULL);
+        snprintf(id, sizeof(id), "0x%04x", table[i].vid);
+        json_writer_string(&w, "vid", id);
+        snprintf(id, sizeof(id), "0x%04x", table[i].pid);
+        json_writer_string(&w, "pid", id);
+        json_writer_end_object(&w);
+    }
+    json_writer_end_array(&w);
+
+    // 当前打开的设备，下标即设备编号 (/ws?dev=N)
+    json_writer_begin_array(&w, "ports");
+    for (uint8_t i = 0; i < USBD_CDC_MAX_DEVICES; i++) {
+        usbd_cdc_device_info_t info;
+        usbd_cdc_get_device_info(i, &info);
+        char id[8];
+        json_writer_begin_object(&w, NULL);
+        json_writer_uint(&w, "dev", i);
+        json_writer_bool(&w, "connected", info.connected);
+        snprintf(id, sizeof(id), "0x%04x", info.vid);
+        json_writer_string(&w, "vid", id);
+        snprintf(id, sizeof(id), "0x%04x", info.pid);
+        json_writer_string(&w, "pid", id);
+        json_writer_bool(&w, "rx_paused", info.rx_paused);
+        json_writer_uint(&w, "rx_bytes", info.rx_bytes);
+        json_writer_uint(&w, "tx_bytes", info.tx_bytes);
+        json_writer_end_object(&w);
+    }
+    json_writer_end_array(&w);
+
+    json_writer_end_object(&w);
+    return json_writer_finish(&w);
+}
+
+// 修改CDC串口参数和设备匹配表: {"baud":921600,"parity":"none","devices":[{"vid":"0x0483","pid":"0x5740"}],"reopen":true}
+static esp_err_t cdc_config_post_handler(httpd_req_t *req)
+{
+    char buf[512];
+    int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
+    if (ret <= 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed to receive data");
+        return ESP_FAIL;
+    }
+    buf[ret] = '\0';
+
+    cJSON *root = cJSON_Parse(buf);
+    if (!root) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
+    }
+
+    usbd_cdc_config_t cfg;
+    usbd_cdc_get_config(&cfg);
+    bool cfg_changed = false;
+    bool ok = true;
+
+    cJSON *item = cJSON_GetObjectItem(root, "baud");
+    if (cJSON_IsNumber(item)) {
+        cfg.baud_rate = (uint32_t)item->valuedouble;
+        cfg_changed = true;
+    }
+    item = cJSON_GetObjectItem(root, "data_bits");
+    if (cJSON_IsNumber(item)) {
+        cfg.data_bits = item->valueint;
+        cfg_changed = true;
+    }
+    item = cJSON_GetObjectItem(root, "parity");
+    if (cJSON_IsString(item)) {
+        size_t i;
+        for (i = 0; i < sizeof(s_cdc_parity_names) / sizeof(s_cdc_parity_names[0]); i++) {
+            if (strcmp(item->valuestring, s_cdc_parity_names[i]) == 0) {
+                break;
             }
-            
-            // 清除连接失败计数
-            err = nvs_open("wifi_state", NVS_READWRITE, &nvs_handle);
-            if (err == ESP_OK) {
-                nvs_set_u8(nvs_handle, "connection_failed", 0);
-                nvs_commit(nvs_handle);
-                nvs_close(nvs_handle);
+        }
+        ok = ok && i < sizeof(s_cdc_parity_names) / sizeof(s_cdc_parity_names[0]);
+        cfg.parity = i;
+        cfg_changed = true;
+    }
+    item = cJSON_GetObjectItem(root, "stop_bits");
+    if (cJSON_IsString(item)) {
+        size_t i;
+        for (i = 0; i < sizeof(s_cdc_stop_bits_names) / sizeof(s_cdc_stop_bits_names[0]); i++) {
+            if (strcmp(item->valuestring, s_cdc_stop_bits_names[i]) == 0) {
+                break;
             }
-            
-            // 停止并重启WiFi以确保配置被完全清除
-            esp_wifi_stop();
-            vTaskDelay(pdMS_TO_TICKS(500));
-            esp_wifi_start();
-            
-            ESP_LOGI(TAG, "WiFi配置已完全删除");
         }
+        ok = ok && i < sizeof(s_cdc_stop_bits_names) / sizeof(s_cdc_stop_bits_names[0]);
+        cfg.stop_bits = i;
+        cfg_changed = true;
+    } else if (cJSON_IsNumber(item)) {
+        // 数字只接受1和2
+        ok = ok && (item->valueint == 1 || item->valueint == 2);
+        cfg.stop_bits = item->valueint == 2 ? 2 : 0;
+        cfg_changed = true;
+    }
+    item = cJSON_GetObjectItem(root, "in_buffer_size");
+    if (cJSON_IsNumber(item)) {
+        ok = ok && item->valueint > 0 && item->valueint <= UINT16_MAX;
+        cfg.in_buffer_size = item->valueint;
+        cfg_changed = true;
+    }
+    item = cJSON_GetObjectItem(root, "out_buffer_size");
+    if (cJSON_IsNumber(item)) {
+        ok = ok && item->valueint > 0 && item->valueint <= UINT16_MAX;
+        cfg.out_buffer_size = item->valueint;
+        cfg_changed = true;
     }
 
+    usbd_cdc_match_t table[USBD_CDC_MAX_MATCH];
+    size_t count = 0;
+    cJSON *devices = cJSON_GetObjectItem(root, "devices");
+    if (devices) {
+        cJSON *dev;
+        ok = ok && cJSON_IsArray(devices) && cJSON_GetArraySize(devices) > 0 &&
+             cJSON_GetArraySize(devices) <= USBD_CDC_MAX_MATCH;
+        cJSON_ArrayForEach(dev, devices) {
+            if (!ok) {
+                break;
+            }
+            ok = cdc_json_get_id(dev, "vid", &table[count].vid) && cdc_json_get_id(dev, "pid", &table[count].pid);
+            count++;
+        }
+    }
+    bool reopen = cJSON_IsTrue(cJSON_GetObjectItem(root, "reopen"));
     cJSON_Delete(root);
-    httpd_resp_sendstr(req, "{\"status\":\"ok\"}");
+
+    const char *response = "{\"status\":\"success\"}";
+    if (!ok || (cfg_changed && usbd_cdc_set_config(&cfg) == ESP_ERR_INVALID_ARG)) {
+        response = "{\"status\":\"error\",\"message\":\"Invalid CDC config\"}";
+    } else {
+        if (count > 0) {
+            usbd_cdc_set_match_table(table, count);
+        }
+        if (reopen) {
+            usbd_cdc_reopen();
+        }
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, response);
     return ESP_OK;
 }
 
+// 获取当前网络配置
+static esp_err_t net_profile_get_handler(httpd_req_t *req)
+{
+    char buf[JSON_WRITER_BUF_SIZE];
+    json_writer_t w;
+    httpd_resp_set_type(req, "application/json");
+    json_writer_init(&w, req, buf, sizeof(buf));
+    json_writer_begin_object(&w, NULL);
+    net_profile_write_json(&w);
+    json_writer_end_object(&w);
+    return json_writer_finish(&w);
+}
+
+// 切换网络配置，{"profile":"throughput"|"latency"|"power"}
+static esp_err_t net_profile_post_handler(httpd_req_t *req)
+{
+    char buf[64];
+    int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
+    if (ret <= 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed to receive data");
+        return ESP_FAIL;
+    }
+    buf[ret] = '\0';
+
+    cJSON *root = cJSON_Parse(buf);
+    cJSON *name = root ? cJSON_GetObjectItem(root, "profile") : NULL;
+    net_profile_t profile;
+    if (!name || !cJSON_IsString(name) || net_profile_from_name(name->valuestring, &profile) != ESP_OK) {
+        cJSON_Delete(root);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid profile");
+        return ESP_FAIL;
+    }
+    cJSON_Delete(root);
+
+    net_profile_set(profile);
+    return net_profile_get_handler(req);
+}
+
+// 获取数据记录状态和段列表
+static esp_err_t log_get_handler(httpd_req_t *req)
+{
+    data_logger_stats_t stats;
+    data_logger_get_stats(&stats);
+
+    char buf[JSON_WRITER_BUF_SIZE];
+    json_writer_t w;
+    httpd_resp_set_type(req, "application/json");
+    json_writer_init(&w, req, buf, sizeof(buf));
+    json_writer_begin_object(&w, NULL);
+    json_writer_bool(&w, "enabled", stats.enabled);
+    json_writer_uint(&w, "segment_size", stats.segment_size);
+    json_writer_uint(&w, "sectors_written", stats.sectors_written);
+    json_writer_uint(&w, "flushes", stats.flushes);
+    json_writer_uint(&w, "write_errors", stats.write_errors);
+    json_writer_uint(&w, "records_lost", stats.records_lost);
+    json_writer_uint(&w, "bytes_logged", stats.bytes_logged);
+
+    json_writer_begin_array(&w, "segments");
+    for (uint32_t i = 0; i < stats.segments; i++) {
+        data_logger_seg_info_t info;
+        if (data_logger_get_segment(i, &info) != ESP_OK || !info.valid) {
+            continue;
+        }
+        json_writer_begin_object(&w, NULL);
+        json_writer_uint(&w, "id", i);
+        json_writer_uint(&w, "seq", info.seq);
+        json_writer_int(&w, "start_time", info.start_time_us / 1000000);
+        json_writer_uint(&w, "size", info.used);
+        json_writer_bool(&w, "active", info.active);
+        json_writer_end_object(&w);
+    }
+    json_writer_end_array(&w);
+
+    json_writer_end_object(&w);
+    return json_writer_finish(&w);
+}
+
+// 开始或停止数据记录
+static esp_err_t log_post_handler(httpd_req_t *req)
+{
+    char buf[64];
+    int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
+    if (ret <= 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed to receive data");
+        return ESP_FAIL;
+    }
+    buf[ret] = '\0';
+
+    cJSON *root = cJSON_Parse(buf);
+    cJSON *enabled = root ? cJSON_GetObjectItem(root, "enabled") : NULL;
+    if (!enabled || !cJSON_IsBool(enabled)) {
+        cJSON_Delete(root);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
+    }
+    bool enable = cJSON_IsTrue(enabled);
+    cJSON_Delete(root);
+
+    const char *response;
+    if (data_logger_enable(enable) == ESP_OK) {
+        response = "{\"status\":\"success\"}";
+    } else {
+        response = "{\"status\":\"error\",\"message\":\"Data logger not available\"}";
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, response);
+    return ESP_OK;
+}
+
+// 下载已结束的日志段
+static esp_err_t log_segment_get_handler(httpd_req_t *req)
+{
+    char query[32];
+    char value[8];
+    data_logger_seg_info_t info;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+        httpd_query_key_value(query, "id", value, sizeof(value)) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing segment id");
+        return ESP_FAIL;
+    }
+
+    uint32_t id = strtoul(value, NULL, 10);
+    if (data_logger_get_segment(id, &info) != ESP_OK || !info.valid) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Segment not found");
+        return ESP_FAIL;
+    }
+    if (info.active) {
+        httpd_resp_set_status(req, "409 Conflict");
+        httpd_resp_sendstr(req, "Segment is still being written");
+        return ESP_OK;
+    }
+
+    char disposition[64];
+    snprintf(disposition, sizeof(disposition), "attachment; filename=\"cdc_%06"PRIu32".dlog\"", info.seq);
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Content-Disposition", disposition);
+
+    // 分块读取并发送段数据
+    char *chunk = mem_pool_alloc(CHUNK_SIZE);
+    if (chunk == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate memory for chunk");
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to allocate memory");
+        return ESP_FAIL;
+    }
+
+    for (size_t off = 0; off < info.used; ) {
+        size_t n = info.used - off > CHUNK_SIZE ? CHUNK_SIZE : info.used - off;
+        if (data_logger_read(id, off, chunk, n) != ESP_OK ||
+            httpd_resp_send_chunk(req, chunk, n) != ESP_OK) {
+            mem_pool_free(chunk);
+            ESP_LOGE(TAG, "Log segment sending failed!");
+            httpd_resp_sendstr_chunk(req, NULL);
+            return ESP_FAIL;
+        }
+        off += n;
+    }
+
+    mem_pool_free(chunk);
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+// 获取运行指标 (JSON)
+static esp_err_t metrics_get_handler(httpd_req_t *req)
+{
+    char buf[JSON_WRITER_BUF_SIZE];
+    json_writer_t w;
+    httpd_resp_set_type(req, "application/json");
+    json_writer_init(&w, req, buf, sizeof(buf));
+    json_writer_begin_object(&w, NULL);
+
+    json_writer_begin_object(&w, "counters");
+    for (int i = 0; i < METRIC_COUNTER_MAX; i++) {
+        json_writer_uint(&w, metrics_counter_desc(i)->name, metrics_counter_get(i));
+    }
+    json_writer_end_object(&w);
+
+    json_writer_begin_object(&w, "hwm");
+    for (int i = 0; i < METRIC_HWM_MAX; i++) {
+        json_writer_uint(&w, metrics_hwm_desc(i)->name, metrics_hwm_get(i));
+    }
+    json_writer_end_object(&w);
+
+    // 环形缓冲区与流控为各设备合计，devices中给出每个设备的值
+    cdc_ring_stats_t rings[CDC_RING_DEVICES];
+    size_t used = 0, capacity = 0;
+    bool paused = false;
+    for (uint8_t dev = 0; dev < CDC_RING_DEVICES; dev++) {
+        cdc_ring_get_stats(dev, &rings[dev]);
+        used += rings[dev].used_bytes;
+        capacity += rings[dev].capacity;
+        paused |= usbd_cdc_rx_paused(dev);
+    }
+    json_writer_begin_object(&w, "gauges");
+    json_writer_uint(&w, "ring_used_bytes", used);
+    json_writer_uint(&w, "ring_capacity_bytes", capacity);
+    json_writer_uint(&w, "ws_clients", websocket_client_count());
+#ifdef CONFIG_CDC_FLOW_LOSSLESS
+    json_writer_string(&w, "flow_mode", "lossless");
+#else
+    json_writer_string(&w, "flow_mode", "lossy");
+#endif
+    json_writer_bool(&w, "flow_paused", paused);
+    json_writer_begin_array(&w, "devices");
+    for (uint8_t dev = 0; dev < CDC_RING_DEVICES; dev++) {
+        json_writer_begin_object(&w, NULL);
+        json_writer_uint(&w, "ring_used_bytes", rings[dev].used_bytes);
+        json_writer_uint(&w, "ring_readers", rings[dev].readers);
+        json_writer_bool(&w, "connected", usbd_cdc_is_connected(dev));
+        json_writer_bool(&w, "flow_paused", usbd_cdc_rx_paused(dev));
+        json_writer_end_object(&w);
+    }
+    json_writer_end_array(&w);
+    json_writer_end_object(&w);
+
+    json_writer_begin_object(&w, "heap");
+    json_writer_uint(&w, "free", esp_get_free_heap_size());
+    json_writer_uint(&w, "min_free", esp_get_minimum_free_heap_size());
+    json_writer_uint(&w, "internal_free", heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+    json_writer_uint(&w, "largest_free_block", heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+    json_writer_uint(&w, "pool_oversize_allocs", mem_pool_oversize_count());
+    json_writer_end_object(&w);
+
+    // 固定大小块池，fallbacks为块池已满退回到堆分配的次数
+    json_writer_begin_array(&w, "mem_pools");
+    for (int i = 0; i < mem_pool_class_count(); i++) {
+        mem_pool_stats_t ps;
+        mem_pool_get_stats(i, &ps);
+        json_writer_begin_object(&w, NULL);
+        json_writer_uint(&w, "block_size", ps.block_size);
+        json_writer_uint(&w, "blocks", ps.blocks);
+        json_writer_uint(&w, "used", ps.used);
+        json_writer_uint(&w, "hwm", ps.hwm);
+        json_writer_uint(&w, "allocs", ps.allocs);
+        json_writer_uint(&w, "fallbacks", ps.fallbacks);
+        json_writer_end_object(&w);
+    }
+    json_writer_end_array(&w);
+
+    // WiFi扫描服务，cache_hits/shared为未发起新扫描的请求数
+    wifi_scan_stats_t scan;
+    wifi_scan_get_stats(&scan);
+    json_writer_begin_object(&w, "wifi_scan");
+    json_writer_uint(&w, "scans", scan.scans);
+    json_writer_uint(&w, "cache_hits", scan.cache_hits);
+    json_writer_uint(&w, "shared", scan.shared);
+    json_writer_uint(&w, "failures", scan.failures);
+    json_writer_end_object(&w);
+
+    // 漫游 (btm_roams为AP的BSS转移请求触发的切换)
+    wifi_roam_stats_t roam;
+    wifi_roam_get_stats(&roam);
+    json_writer_begin_object(&w, "wifi_roam");
+    json_writer_uint(&w, "triggers", roam.triggers);
+    json_writer_uint(&w, "neighbor_reports", roam.neighbor_reports);
+    json_writer_uint(&w, "btm_queries", roam.btm_queries);
+    json_writer_uint(&w, "scans", roam.scans);
+    json_writer_uint(&w, "roams", roam.roams);
+    json_writer_uint(&w, "btm_roams", roam.btm_roams);
+    json_writer_uint(&w, "failures", roam.failures);
+    json_writer_uint(&w, "last_gap_ms", roam.last_gap_ms);
+    json_writer_end_object(&w);
+
+    // 当前网络配置及其WiFi/套接字参数
+    json_writer_begin_object(&w, "net_profile");
+    net_profile_write_json(&w);
+    json_writer_end_object(&w);
+
+    // 电源状态 (idle时允许浅睡眠) 和各状态的累计时间
+    json_writer_begin_object(&w, "power");
+    power_mgmt_write_json(&w);
+    json_writer_end_object(&w);
+
+    // SNTP同步状态
+    json_writer_begin_object(&w, "time_sync");
+    time_sync_write_json(&w);
+    json_writer_end_object(&w);
+
+    // 启动时间线 (各阶段自启动起的毫秒数)
+    json_writer_begin_object(&w, "boot");
+    boot_timeline_write_json(&w);
+    json_writer_end_object(&w);
+
+    // 自动连接各路径的次数和最近一次耗时
+    json_writer_begin_object(&w, "wifi_connect");
+    for (int i = 0; i < WIFI_CONNECT_PATH_MAX; i++) {
+        wifi_connect_path_stats_t conn;
+        wifi_get_connect_stats(i, &conn);
+        json_writer_begin_object(&w, wifi_connect_path_name(i));
+        json_writer_uint(&w, "attempts", conn.attempts);
+        json_writer_uint(&w, "successes", conn.successes);
+        json_writer_uint(&w, "last_ms", conn.last_ms);
+        json_writer_end_object(&w);
+    }
+    json_writer_end_object(&w);
+
+    // 连续采样的核心负载 (%)，peak为启动以来的最大值
+    cpu_profile_load_t cpu;
+    cpu_profile_get_load(&cpu);
+    json_writer_begin_object(&w, "cpu");
+    json_writer_bool(&w, "running", cpu.running);
+    json_writer_uint(&w, "interval_ms", cpu.interval_ms);
+    json_writer_uint(&w, "samples", cpu.samples);
+    json_writer_begin_array(&w, "core_load_pct");
+    for (int i = 0; i < CPU_PROFILE_CORES; i++) {
+        json_writer_uint(&w, NULL, cpu.core_load_pct[i]);
+    }
+    json_writer_end_array(&w);
+    json_writer_begin_array(&w, "core_peak_pct");
+    for (int i = 0; i < CPU_PROFILE_CORES; i++) {
+        json_writer_uint(&w, NULL, cpu.core_peak_pct[i]);
+    }
+    json_writer_end_array(&w);
+    json_writer_end_object(&w);
+
+    // 各任务栈的历史最小剩余量和最近一个采样周期的CPU占用
+    json_writer_begin_array(&w, "tasks");
+    for (int i = 0; i < TASK_CFG_MAX; i++) {
+        TaskHandle_t handle = task_config_handle(i);
+        if (handle == NULL) {
+            continue;
+        }
+        const task_config_t *cfg = task_config_get(i);
+        json_writer_begin_object(&w, NULL);
+        json_writer_string(&w, "name", cfg->name);
+        json_writer_uint(&w, "stack_size", cfg->stack_size);
+        json_writer_uint(&w, "stack_free_min", uxTaskGetStackHighWaterMark(handle));
+        int permille = cpu_profile_task_permille(handle);
+        if (permille >= 0) {
+            json_writer_number(&w, "cpu_pct", permille / 10.0);
+        }
+        json_writer_end_object(&w);
+    }
+    json_writer_end_array(&w);
+
+    // 延迟直方图，buckets[i]为上限latency_bucket_upper_us(i)的桶内样本数
+    json_writer_begin_object(&w, "latency");
+    json_writer_uint(&w, "bucket_base_us", LATENCY_BUCKET_BASE_US);
+    for (int i = 0; i < LATENCY_HIST_MAX; i++) {
+        latency_summary_t sum;
+        latency_get(i, &sum);
+        json_writer_begin_object(&w, latency_name(i));
+        json_writer_uint(&w, "count", sum.count);
+        json_writer_uint(&w, "mean_us", sum.count ? sum.sum_us / sum.count : 0);
+        json_writer_uint(&w, "p50_us", sum.p50_us);
+        json_writer_uint(&w, "p99_us", sum.p99_us);
+        json_writer_uint(&w, "max_us", sum.max_us);
+        json_writer_begin_array(&w, "buckets");
+        for (int b = 0; b < LATENCY_BUCKETS; b++) {
+            json_writer_uint(&w, NULL, sum.buckets[b]);
+        }
+        json_writer_end_array(&w);
+        json_writer_end_object(&w);
+    }
+    json_writer_end_object(&w);
+
+    json_writer_end_object(&w);
+    return json_writer_finish(&w);
+}
+
+// 清零运行指标，{"reset":"all"|"counters"|"latency"}，无请求体时全部清零
+static esp_err_t metrics_post_handler(httpd_req_t *req)
+{
+    char buf[64];
+    bool counters = true;
+    bool latency = true;
+
+    if (req->content_len > 0) {
+        int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
+        if (ret <= 0) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed to receive data");
+            return ESP_FAIL;
+        }
+        buf[ret] = '\0';
+
+        cJSON *root = cJSON_Parse(buf);
+        cJSON *reset = root ? cJSON_GetObjectItem(root, "reset") : NULL;
+        if (!cJSON_IsString(reset) ||
+            (strcmp(reset->valuestring, "all") != 0 && strcmp(reset->valuestring, "counters") != 0 &&
+             strcmp(reset->valuestring, "latency") != 0)) {
+            cJSON_Delete(root);
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+            return ESP_FAIL;
+        }
+        counters = strcmp(reset->valuestring, "latency") != 0;
+        latency = strcmp(reset->valuestring, "counters") != 0;
+        cJSON_Delete(root);
+    }
+
+    if (counters) {
+        metrics_reset();
+    }
+    if (latency) {
+        latency_reset();
+    }
+    ESP_LOGI(TAG, "运行指标已清零 (计数器: %d, 延迟: %d)", counters, latency);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, "{\"status\":\"success\"}");
+    return ESP_OK;
+}
+
+// Prometheus文本分块输出
+typedef struct {
+    httpd_req_t *req;
+    char *buf;
+    size_t len;
+    esp_err_t err;
+} prom_writer_t;
+
+static void prom_printf(prom_writer_t *w, const char *fmt, ...)
+{
+    char line[256];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (n <= 0 || w->err != ESP_OK) {
+        return;
+    }
+    if ((size_t)n >= sizeof(line)) {
+        n = sizeof(line) - 1;
+    }
+    if (w->len + n > CHUNK_SIZE) {
+        w->err = httpd_resp_send_chunk(w->req, w->buf, w->len);
+        w->len = 0;
+    }
+    memcpy(w->buf + w->len, line, n);
+    w->len += n;
+}
+
+// 输出一个Prometheus指标
+static void prom_metric(prom_writer_t *w, const char *type, const char *name, const char *help, double value)
+{
+    prom_printf(w, "# HELP datareader_%s %s\n# TYPE datareader_%s %s\ndatareader_%s %.0f\n",
+                name, help, name, type, name, value);
+}
+
+// 获取运行指标 (Prometheus文本格式)
+static esp_err_t metrics_prometheus_get_handler(httpd_req_t *req)
+{
+    prom_writer_t w = { .req = req, .buf = mem_pool_alloc(CHUNK_SIZE), .len = 0, .err = ESP_OK };
+    if (w.buf == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to allocate memory");
+        return ESP_FAIL;
+    }
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+
+    for (int i = 0; i < METRIC_COUNTER_MAX; i++) {
+        const metric_desc_t *desc = metrics_counter_desc(i);
+        prom_printf(&w, "# HELP datareader_%s_total %s\n# TYPE datareader_%s_total counter\n"
+                        "datareader_%s_total %"PRIu32"\n",
+                    desc->name, desc->help, desc->name, desc->name, metrics_counter_get(i));
+    }
+    for (int i = 0; i < METRIC_HWM_MAX; i++) {
+        const metric_desc_t *desc = metrics_hwm_desc(i);
+        prom_metric(&w, "gauge", desc->name, desc->help, metrics_hwm_get(i));
+    }
+
+    // 每个设备一组环形缓冲区和流控指标
+    prom_printf(&w, "# HELP datareader_ring_used_bytes Bytes currently held in the CDC ring\n"
+                    "# TYPE datareader_ring_used_bytes gauge\n");
+    for (uint8_t dev = 0; dev < CDC_RING_DEVICES; dev++) {
+        cdc_ring_stats_t ring;
+        cdc_ring_get_stats(dev, &ring);
+        prom_printf(&w, "datareader_ring_used_bytes{dev=\"%u\"} %u\n", dev, (unsigned)ring.used_bytes);
+    }
+    prom_metric(&w, "gauge", "ring_capacity_bytes", "CDC ring data capacity per device", CONFIG_CDC_RING_DATA_SIZE);
+    prom_printf(&w, "# HELP datareader_cdc_connected 1 while the CDC device is open\n"
+                    "# TYPE datareader_cdc_connected gauge\n");
+    for (uint8_t dev = 0; dev < CDC_RING_DEVICES; dev++) {
+        prom_printf(&w, "datareader_cdc_connected{dev=\"%u\"} %d\n", dev, usbd_cdc_is_connected(dev));
+    }
+    prom_metric(&w, "gauge", "ws_clients", "Connected WebSocket clients", websocket_client_count());
+    prom_metric(&w, "gauge", "flow_lossless", "1 when RTS flow control (lossless mode) is built in",
+#ifdef CONFIG_CDC_FLOW_LOSSLESS
+                1);
+#else
+                0);
+#endif
+    prom_printf(&w, "# HELP datareader_flow_paused 1 while the CDC device is paused by RTS\n"
+                    "# TYPE datareader_flow_paused gauge\n");
+    for (uint8_t dev = 0; dev < CDC_RING_DEVICES; dev++) {
+        prom_printf(&w, "datareader_flow_paused{dev=\"%u\"} %d\n", dev, usbd_cdc_rx_paused(dev));
+    }
+    prom_printf(&w, "# HELP datareader_net_profile 1 for the active network profile\n"
+                    "# TYPE datareader_net_profile gauge\n");
+    for (int i = 0; i < NET_PROFILE_MAX; i++) {
+        prom_printf(&w, "datareader_net_profile{profile=\"%s\"} %d\n", net_profile_name(i), net_profile_get() == i);
+    }
+    power_mgmt_stats_t power;
+    power_mgmt_get_stats(&power);
+    prom_printf(&w, "# HELP datareader_power_state 1 for the current power state\n"
+                    "# TYPE datareader_power_state gauge\n");
+    for (int i = 0; i < POWER_STATE_MAX; i++) {
+        prom_printf(&w, "datareader_power_state{state=\"%s\"} %d\n", power_state_name(i), power.state == i);
+    }
+    prom_printf(&w, "# HELP datareader_power_residency_seconds_total Time spent in each power state\n"
+                    "# TYPE datareader_power_residency_seconds_total counter\n");
+    for (int i = 0; i < POWER_STATE_MAX; i++) {
+        prom_printf(&w, "datareader_power_residency_seconds_total{state=\"%s\"} %.3f\n",
+                    power_state_name(i), power.residency_us[i] / 1e6);
+    }
+    prom_metric(&w, "gauge", "heap_free_bytes", "Free heap", esp_get_free_heap_size());
+    prom_metric(&w, "gauge", "heap_min_free_bytes", "Lowest free heap since boot", esp_get_minimum_free_heap_size());
+    prom_metric(&w, "gauge", "heap_largest_free_block_bytes", "Largest free heap block",
+                heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+
+    prom_printf(&w, "# HELP datareader_mem_pool_used_blocks Blocks in use per pool\n"
+                    "# TYPE datareader_mem_pool_used_blocks gauge\n");
+    for (int i = 0; i < mem_pool_class_count(); i++) {
+        mem_pool_stats_t ps;
+        mem_pool_get_stats(i, &ps);
+        prom_printf(&w, "datareader_mem_pool_used_blocks{size=\"%u\"} %u\n", (unsigned)ps.block_size, ps.used);
+    }
+    prom_printf(&w, "# HELP datareader_mem_pool_fallbacks_total Allocations that fell back to the heap because the pool was full\n"
+                    "# TYPE datareader_mem_pool_fallbacks_total counter\n");
+    for (int i = 0; i < mem_pool_class_count(); i++) {
+        mem_pool_stats_t ps;
+        mem_pool_get_stats(i, &ps);
+        prom_printf(&w, "datareader_mem_pool_fallbacks_total{size=\"%u\"} %"PRIu32"\n",
+                    (unsigned)ps.block_size, ps.fallbacks);
+    }
+
+    prom_printf(&w, "# HELP datareader_task_stack_free_min_bytes Lowest free stack since task start\n"
+                    "# TYPE datareader_task_stack_free_min_bytes gauge\n");
+    for (int i = 0; i < TASK_CFG_MAX; i++) {
+        TaskHandle_t handle = task_config_handle(i);
+        if (handle != NULL) {
+            prom_printf(&w, "datareader_task_stack_free_min_bytes{task=\"%s\"} %u\n",
+                        task_config_get(i)->name, (unsigned)uxTaskGetStackHighWaterMark(handle));
+        }
+    }
+
+    cpu_profile_load_t cpu;
+    cpu_profile_get_load(&cpu);
+    if (cpu.running) {
+        prom_printf(&w, "# HELP datareader_cpu_load_percent CPU core load over the last sampling interval\n"
+                        "# TYPE datareader_cpu_load_percent gauge\n");
+        for (int i = 0; i < CPU_PROFILE_CORES; i++) {
+            prom_printf(&w, "datareader_cpu_load_percent{core=\"%d\"} %u\n", i, cpu.core_load_pct[i]);
+        }
+    }
+
+    // 延迟直方图 (秒)，桶为累计计数
+    for (int i = 0; i < LATENCY_HIST_MAX; i++) {
+        latency_summary_t sum;
+        latency_get(i, &sum);
+        const char *name = latency_name(i);
+        prom_printf(&w, "# HELP datareader_latency_%s_seconds Latency histogram (%s)\n"
+                        "# TYPE datareader_latency_%s_seconds histogram\n", name, name, name);
+        uint32_t acc = 0;
+        for (int b = 0; b < LATENCY_BUCKETS - 1; b++) {
+            acc += sum.buckets[b];
+            prom_printf(&w, "datareader_latency_%s_seconds_bucket{le=\"%.6f\"} %"PRIu32"\n",
+                        name, latency_bucket_upper_us(b) / 1e6, acc);
+        }
+        prom_printf(&w, "datareader_latency_%s_seconds_bucket{le=\"+Inf\"} %"PRIu32"\n"
+                        "datareader_latency_%s_seconds_sum %.6f\n"
+                        "datareader_latency_%s_seconds_count %"PRIu32"\n",
+                    name, sum.count, name, sum.sum_us / 1e6, name, sum.count);
+        prom_printf(&w, "# HELP datareader_latency_%s_max_seconds Highest latency (%s)\n"
+                        "# TYPE datareader_latency_%s_max_seconds gauge\n"
+                        "datareader_latency_%s_max_seconds %.6f\n",
+                    name, name, name, name, sum.max_us / 1e6);
+    }
+
+    if (w.err == ESP_OK && w.len > 0) {
+        w.err = httpd_resp_send_chunk(req, w.buf, w.len);
+    }
+    mem_pool_free(w.buf);
+    if (w.err != ESP_OK) {
+        ESP_LOGE(TAG, "Metrics sending failed!");
+        httpd_resp_sendstr_chunk(req, NULL);
+        return ESP_FAIL;
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+#ifdef CONFIG_TRACE_ENABLE
+// 导出事件跟踪 (按时间合并各核心的事件)，?clear=1导出后清空
+static esp_err_t trace_get_handler(httpd_req_t *req)
+{
+    const size_t per_core = CONFIG_TRACE_RING_EVENTS;
+    trace_event_t *events = mem_pool_alloc(sizeof(trace_event_t) * per_core * portNUM_PROCESSORS);
+    char *chunk = mem_pool_alloc(CHUNK_SIZE);
+    if (events == NULL || chunk == NULL) {
+        mem_pool_free(events);
+        mem_pool_free(chunk);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to allocate memory");
+        return ESP_FAIL;
+    }
+
+    size_t count[portNUM_PROCESSORS];
+    size_t pos[portNUM_PROCESSORS] = { 0 };
+    for (int c = 0; c < portNUM_PROCESSORS; c++) {
+        count[c] = trace_snapshot(c, events + c * per_core, per_core);
+    }
+
+    char query[32];
+    char value[8];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "clear", value, sizeof(value)) == ESP_OK && strcmp(value, "1") == 0) {
+        trace_clear();
+    }
+
+    // 事件数较多，用分块缓冲区作为输出缓冲区
+    json_writer_t w;
+    httpd_resp_set_type(req, "application/json");
+    json_writer_init(&w, req, chunk, CHUNK_SIZE);
+    json_writer_begin_object(&w, NULL);
+    json_writer_int(&w, "now_us", esp_timer_get_time());
+    json_writer_begin_array(&w, "events");
+
+    while (w.err == ESP_OK) {
+        // 取各核心中最早的下一个事件 (时间戳为32位，按差值比较以处理回绕)
+        int core = -1;
+        for (int c = 0; c < portNUM_PROCESSORS; c++) {
+            if (pos[c] < count[c] &&
+                (core < 0 || (int32_t)(events[c * per_core + pos[c]].timestamp_us -
+                                       events[core * per_core + pos[core]].timestamp_us) < 0)) {
+                core = c;
+            }
+        }
+        if (core < 0) {
+            break;
+        }
+
+        const trace_event_t *e = &events[core * per_core + pos[core]++];
+        json_writer_begin_object(&w, NULL);
+        json_writer_uint(&w, "t", e->timestamp_us);
+        json_writer_int(&w, "core", core);
+        json_writer_string(&w, "id", trace_event_name(e->id));
+        json_writer_uint(&w, "arg", e->arg);
+        json_writer_uint(&w, "len", e->len);
+        json_writer_end_object(&w);
+    }
+
+    json_writer_end_array(&w);
+    json_writer_end_object(&w);
+    esp_err_t ret = json_writer_finish(&w);
+    mem_pool_free(events);
+    mem_pool_free(chunk);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Trace sending failed!");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+#endif
+
+// 任务状态名
+static const char *task_state_name(eTaskState state)
+{
+    switch (state) {
+    case eRunning:   return "running";
+    case eReady:     return "ready";
+    case eBlocked:   return "blocked";
+    case eSuspended: return "suspended";
+    case eDeleted:   return "deleted";
+    default:         return "invalid";
+    }
+}
+
+// 按需采样各任务的CPU占用，?window_ms=N (默认1000，最大CPU_PROFILE_MAX_WINDOW_MS)
+// 采样期间httpd任务被阻塞，窗口应尽量短
+static esp_err_t cpu_get_handler(httpd_req_t *req)
+{
+    uint32_t window_ms = 1000;
+    char query[32];
+    char value[8];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "window_ms", value, sizeof(value)) == ESP_OK) {
+        window_ms = strtoul(value, NULL, 10);
+    }
+
+    cpu_profile_report_t *report = mem_pool_alloc(sizeof(cpu_profile_report_t));
+    if (report == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to allocate memory");
+        return ESP_FAIL;
+    }
+    esp_err_t err = cpu_profile_sample(window_ms, report);
+    if (err != ESP_OK) {
+        mem_pool_free(report);
+        if (err == ESP_ERR_INVALID_ARG) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid window_ms");
+        } else {
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, esp_err_to_name(err));
+        }
+        return ESP_FAIL;
+    }
+
+    char buf[JSON_WRITER_BUF_SIZE];
+    json_writer_t w;
+    httpd_resp_set_type(req, "application/json");
+    json_writer_init(&w, req, buf, sizeof(buf));
+    json_writer_begin_object(&w, NULL);
+    json_writer_uint(&w, "window_us", report->window_us);
+    json_writer_begin_array(&w, "core_load_pct");
+    for (int i = 0; i < CPU_PROFILE_CORES; i++) {
+        json_writer_uint(&w, NULL, report->core_load_pct[i]);
+    }
+    json_writer_end_array(&w);
+
+    // 按运行时间降序，cpu_pct为占一个核心的百分比
+    json_writer_begin_array(&w, "tasks");
+    for (int i = 0; i < report->task_count; i++) {
+        const cpu_profile_task_t *t = &report->tasks[i];
+        json_writer_begin_object(&w, NULL);
+        json_writer_string(&w, "name", t->name);
+        json_writer_int(&w, "core", t->core);
+        json_writer_uint(&w, "priority", t->priority);
+        json_writer_string(&w, "state", task_state_name(t->state));
+        json_writer_uint(&w, "runtime_us", t->runtime_us);
+        json_writer_number(&w, "cpu_pct", t->cpu_permille / 10.0);
+        json_writer_uint(&w, "stack_free_min", t->stack_free_min);
+        json_writer_end_object(&w);
+    }
+    json_writer_end_array(&w);
+    json_writer_end_object(&w);
+    mem_pool_free(report);
+    return json_writer_finish(&w);
+}
+
 // URI处理结构
-static const httpd_uri_t root = {
-    .uri       = "/",
+// 其他GET路径都作为静态资源处理，须在最后注册
+static const httpd_uri_t web_assets = {
+    .uri       = "/*",
     .method    = HTTP_GET,
-    .handler   = root_get_handler,
+    .handler   = web_assets_get_handler,
     .user_ctx  = NULL
 };
 
@@ -495,6 +1415,106 @@ static const httpd_uri_t reset_retry = {
     .user_ctx  = NULL
 };
 
+static const httpd_uri_t stream_get = {
+    .uri       = "/api/stream",
+    .method    = HTTP_GET,
+    .handler   = stream_get_handler,
+    .user_ctx  = NULL
+};
+
+static const httpd_uri_t stream_post = {
+    .uri       = "/api/stream",
+    .method    = HTTP_POST,
+    .handler   = stream_post_handler,
+    .user_ctx  = NULL
+};
+
+static const httpd_uri_t cdc_config_get = {
+    .uri       = "/api/cdc/config",
+    .method    = HTTP_GET,
+    .handler   = cdc_config_get_handler,
+    .user_ctx  = NULL
+};
+
+static const httpd_uri_t cdc_config_post = {
+    .uri       = "/api/cdc/config",
+    .method    = HTTP_POST,
+    .handler   = cdc_config_post_handler,
+    .user_ctx  = NULL
+};
+
+static const httpd_uri_t net_profile_uri_get = {
+    .uri       = "/api/net_profile",
+    .method    = HTTP_GET,
+    .handler   = net_profile_get_handler,
+    .user_ctx  = NULL
+};
+
+static const httpd_uri_t net_profile_uri_post = {
+    .uri       = "/api/net_profile",
+    .method    = HTTP_POST,
+    .handler   = net_profile_post_handler,
+    .user_ctx  = NULL
+};
+
+static const httpd_uri_t log_get = {
+    .uri       = "/api/log",
+    .method    = HTTP_GET,
+    .handler   = log_get_handler,
+    .user_ctx  = NULL
+};
+
+static const httpd_uri_t log_post = {
+    .uri       = "/api/log",
+    .method    = HTTP_POST,
+    .handler   = log_post_handler,
+    .user_ctx  = NULL
+};
+
+static const httpd_uri_t log_segment_get = {
+    .uri       = "/api/log/segment",
+    .method    = HTTP_GET,
+    .handler   = log_segment_get_handler,
+    .user_ctx  = NULL
+};
+
+static const httpd_uri_t metrics_get = {
+    .uri       = "/api/metrics",
+    .method    = HTTP_GET,
+    .handler   = metrics_get_handler,
+    .user_ctx  = NULL
+};
+
+static const httpd_uri_t metrics_post = {
+    .uri       = "/api/metrics",
+    .method    = HTTP_POST,
+    .handler   = metrics_post_handler,
+    .user_ctx  = NULL
+};
+
+static const httpd_uri_t metrics_prometheus_get = {
+    .uri       = "/metrics",
+    .method    = HTTP_GET,
+    .handler   = metrics_prometheus_get_handler,
+    .user_ctx  = NULL
+};
+
+static const httpd_uri_t cpu_get = {
+    .uri       = "/api/cpu",
+    .method    = HTTP_GET,
+    .handler   = cpu_get_handler,
+    .user_ctx  = NULL
+};
+
+#ifdef CONFIG_TRACE_ENABLE
+static const httpd_uri_t trace_get = {
+    .uri       = "/api/trace",
+    .method    = HTTP_GET,
+    .handler   = trace_get_handler,
+    .user_ctx  = NULL
+};
+#endif
+
 // 启动Web服务器
 esp_err_t start_webserver(void)
 {
@@ -508,14 +1528,25 @@ esp_err_t start_webserver(void)
 
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.lru_purge_enable = true;
-    config.max_uri_handlers = 10;
-    config.server_port = 8080;
+    const task_config_t *httpd_task = task_config_get(TASK_CFG_HTTPD);
+    config.task_priority = httpd_task->priority;
+    config.stack_size = httpd_task->stack_size;
+    config.core_id = httpd_task->core;
+    config.max_uri_handlers = 28;
+    // 由WebSocket模块在会话关闭时清理客户端表
+    config.close_fn = websocket_on_session_close;
+    config.server_port = HTTP_SERVER_PORT;
+    config.uri_match_fn = httpd_uri_match_wildcard;
+
+    // 网页资源映射失败时只提供API
+    if (web_assets_init() != ESP_OK) {
+        ESP_LOGW(TAG, "网页资源不可用，只提供API");
+    }
     
     ESP_LOGI(TAG, "Starting server on port: '%d'", config.server_port);
     
     if (httpd_start(&server, &config) == ESP_OK) {
         ESP_LOGI(TAG, "Registering URI handlers");
-        httpd_register_uri_handler(server, &root);
         httpd_register_uri_handler(server, &scan);        // 旧的扫描路径
         httpd_register_uri_handler(server, &api_scan);    // 新的API扫描路径
         httpd_register_uri_handler(server, &configure_old); // 旧的配置路径
@@ -524,7 +1555,24 @@ esp_err_t start_webserver(void)
         httpd_register_uri_handler(server, &saved_wifi);
         httpd_register_uri_handler(server, &delete_wifi);
         httpd_register_uri_handler(server, &reset_retry);
+        httpd_register_uri_handler(server, &stream_get);
+        httpd_register_uri_handler(server, &stream_post);
+        httpd_register_uri_handler(server, &cdc_config_get);
+        httpd_register_uri_handler(server, &cdc_config_post);
+        httpd_register_uri_handler(server, &net_profile_uri_get);
+        httpd_register_uri_handler(server, &net_profile_uri_post);
+        httpd_register_uri_handler(server, &log_get);
+        httpd_register_uri_handler(server, &log_post);
+        httpd_register_uri_handler(server, &log_segment_get);
+        httpd_register_uri_handler(server, &metrics_get);
+        httpd_register_uri_handler(server, &metrics_post);
+        httpd_register_uri_handler(server, &metrics_prometheus_get);
+        httpd_register_uri_handler(server, &cpu_get);
+#ifdef CONFIG_TRACE_ENABLE
+        httpd_register_uri_handler(server, &trace_get);
+#endif
         websocket_start(server);
+        httpd_register_uri_handler(server, &web_assets);
         return ESP_OK;
     }
     
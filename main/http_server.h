@@ -12,6 +12,9 @@
 #define FILE_PATH_MAX (128 + 128)
 #define CHUNK_SIZE    (4096)
 
+// HTTP/WebSocket服务端口 (mDNS按此端口广播)
+#define HTTP_SERVER_PORT 8080
+
 // 启动Web服务器
 esp_err_t start_webserver(void);
 
@@ -0,0 +1,242 @@
+/*
+ * @Description: 流式JSON输出实现
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include "json_writer.h"
+
+// 缓冲区写满时发送一个分块；只写缓冲区时记为溢出
+static void jw_flush(json_writer_t *w)
+{
+    if (w->err != ESP_OK) {
+        return;
+    }
+    if (w->req == NULL) {
+        w->err = ESP_ERR_NO_MEM;
+        return;
+    }
+    if (w->len > 0) {
+        w->err = httpd_resp_send_chunk(w->req, w->buf, w->len);
+        w->chunked = true;
+        w->len = 0;
+    }
+}
+
+// 只写缓冲区时保留一个字节给结尾的'\0'
+static inline size_t jw_room(const json_writer_t *w)
+{
+    return w->cap - w->len - (w->req ? 0 : 1);
+}
+
+static void jw_write(json_writer_t *w, const char *data, size_t len)
+{
+    while (len > 0 && w->err == ESP_OK) {
+        size_t room = jw_room(w);
+        if (room == 0) {
+            jw_flush(w);
+            continue;
+        }
+        size_t n = len < room ? len : room;
+        memcpy(w->buf + w->len, data, n);
+        w->len += n;
+        data += n;
+        len -= n;
+    }
+}
+
+static inline void jw_putc(json_writer_t *w, char c)
+{
+    jw_write(w, &c, 1);
+}
+
+static void jw_escaped(json_writer_t *w, const char *s)
+{
+    jw_putc(w, '"');
+    const char *run = s;
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        // 先写出前面不需要转义的部分
+        jw_write(w, run, s - run);
+        run = s + 1;
+
+        char esc[8];
+        switch (c) {
+        case '"':  jw_write(w, "\\\"", 2); break;
+        case '\\': jw_write(w, "\\\\", 2); break;
+        case '\n': jw_write(w, "\\n", 2); break;
+        case '\r': jw_write(w, "\\r", 2); break;
+        case '\t': jw_write(w, "\\t", 2); break;
+        default:
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            jw_write(w, esc, 6);
+            break;
+        }
+    }
+    jw_write(w, run, s - run);
+    jw_putc(w, '"');
+}
+
+// 元素之间的逗号和对象中的键
+static void jw_prefix(json_writer_t *w, const char *key)
+{
+    uint32_t bit = 1UL << w->depth;
+    if (w->has_items & bit) {
+        jw_putc(w, ',');
+    }
+    w->has_items |= bit;
+    if (key) {
+        jw_escaped(w, key);
+        jw_putc(w, ':');
+    }
+}
+
+static void jw_begin(json_writer_t *w, const char *key, char open)
+{
+    if (w->depth + 1 >= JSON_WRITER_MAX_DEPTH) {
+        if (w->err == ESP_OK) {
+            w->err = ESP_ERR_INVALID_SIZE;
+        }
+        return;
+    }
+    jw_prefix(w, key);
+    jw_putc(w, open);
+    w->depth++;
+    w->has_items &= ~(1UL << w->depth);
+}
+
+static void jw_end(json_writer_t *w, char close)
+{
+    if (w->depth == 0) {
+        if (w->err == ESP_OK) {
+            w->err = ESP_ERR_INVALID_STATE;
+        }
+        return;
+    }
+    w->depth--;
+    jw_putc(w, close);
+}
+
+void json_writer_init(json_writer_t *w, httpd_req_t *req, char *buf, size_t cap)
+{
+    memset(w, 0, sizeof(*w));
+    w->req = req;
+    w->buf = buf;
+    w->cap = cap;
+    if (buf == NULL || cap < 2) {
+        w->err = ESP_ERR_INVALID_ARG;
+    }
+}
+
+void json_writer_begin_object(json_writer_t *w, const char *key)
+{
+    jw_begin(w, key, '{');
+}
+
+void json_writer_begin_array(json_writer_t *w, const char *key)
+{
+    jw_begin(w, key, '[');
+}
+
+void json_writer_end_object(json_writer_t *w)
+{
+    jw_end(w, '}');
+}
+
+void json_writer_end_array(json_writer_t *w)
+{
+    jw_end(w, ']');
+}
+
+void json_writer_string(json_writer_t *w, const char *key, const char *value)
+{
+    jw_prefix(w, key);
+    if (value) {
+        jw_escaped(w, value);
+    } else {
+        jw_write(w, "null", 4);
+    }
+}
+
+void json_writer_int(json_writer_t *w, const char *key, int64_t value)
+{
+    char num[24];
+    jw_prefix(w, key);
+    jw_write(w, num, snprintf(num, sizeof(num), "%" PRId64, value));
+}
+
+void json_writer_uint(json_writer_t *w, const char *key, uint64_t value)
+{
+    char num[24];
+    jw_prefix(w, key);
+    jw_write(w, num, snprintf(num, sizeof(num), "%" PRIu64, value));
+}
+
+void json_writer_number(json_writer_t *w, const char *key, double value)
+{
+    char num[32];
+    jw_prefix(w, key);
+    if (!isfinite(value)) {
+        jw_write(w, "null", 4);
+        return;
+    }
+    // 与cJSON一致: 整数值不带小数部分，其他保留15位有效数字
+    int n;
+    if (fabs(value) < 1e15 && value == (double)(int64_t)value) {
+        n = snprintf(num, sizeof(num), "%" PRId64, (int64_t)value);
+    } else {
+        n = snprintf(num, sizeof(num), "%1.15g", value);
+    }
+    jw_write(w, num, n);
+}
+
+void json_writer_bool(json_writer_t *w, const char *key, bool value)
+{
+    jw_prefix(w, key);
+    if (value) {
+        jw_write(w, "true", 4);
+    } else {
+        jw_write(w, "false", 5);
+    }
+}
+
+void json_writer_null(json_writer_t *w, const char *key)
+{
+    jw_prefix(w, key);
+    jw_write(w, "null", 4);
+}
+
+esp_err_t json_writer_finish(json_writer_t *w)
+{
+    if (w->err == ESP_OK && w->depth != 0) {
+        w->err = ESP_ERR_INVALID_STATE;
+    }
+
+    if (w->req == NULL) {
+        if (w->buf) {
+            w->buf[w->len] = '\0';
+        }
+        return w->err;
+    }
+
+    if (w->err == ESP_OK) {
+        if (!w->chunked) {
+            // 整个响应都在缓冲区中，按普通响应发送
+            w->err = httpd_resp_send(w->req, w->buf, w->len);
+        } else {
+            jw_flush(w);
+            if (w->err == ESP_OK) {
+                w->err = httpd_resp_send_chunk(w->req, NULL, 0);
+            }
+        }
+    } else if (w->chunked) {
+        // 已开始分块发送后出错，结束分块响应
+        httpd_resp_send_chunk(w->req, NULL, 0);
+    }
+    return w->err;
+}
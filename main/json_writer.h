@@ -0,0 +1,105 @@
+/*
+ * @Description: 流式JSON输出头文件
+ *
+ * HTTP处理函数边生成边输出JSON，不再构建cJSON节点树再打印成第二份字符串。
+ * 输出先写入调用方提供的缓冲区 (通常在栈上)，写满时作为一个分块发送；
+ * 整个响应不超过缓冲区时在结束时一次发送并带Content-Length。
+ * req为NULL时只写入缓冲区，超出容量返回ESP_ERR_NO_MEM。
+ *
+ * 用法:
+ *   char buf[JSON_WRITER_BUF_SIZE];
+ *   json_writer_t w;
+ *   httpd_resp_set_type(req, "application/json");
+ *   json_writer_init(&w, req, buf, sizeof(buf));
+ *   json_writer_begin_object(&w, NULL);
+ *   json_writer_string(&w, "status", "success");
+ *   json_writer_end_object(&w);
+ *   return json_writer_finish(&w);
+ *
+ * 数组元素的key传NULL。
+ */
+
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 处理函数中栈上输出缓冲区的建议大小
+#define JSON_WRITER_BUF_SIZE    512
+
+// 最大嵌套层数
+#define JSON_WRITER_MAX_DEPTH   32
+
+typedef struct {
+    httpd_req_t *req;           // NULL表示只写入缓冲区
+    char *buf;
+    size_t cap;
+    size_t len;
+    esp_err_t err;              // 第一个发送或溢出错误，之后的写入被忽略
+    bool chunked;               // 已发送过分块
+    uint8_t depth;
+    uint32_t has_items;         // 每层一位: 该层已有元素，下一个元素前需要逗号
+} json_writer_t;
+
+/**
+ * @brief 初始化输出 (响应类型须在此之前由httpd_resp_set_type()设置)
+ *
+ * @param w 输出状态
+ * @param req HTTP请求，NULL表示只写入缓冲区
+ * @param buf 输出缓冲区
+ * @param cap 缓冲区大小
+ */
+void json_writer_init(json_writer_t *w, httpd_req_t *req, char *buf, size_t cap);
+
+/**
+ * @brief 开始一个对象或数组
+ *
+ * @param w 输出状态
+ * @param key 在对象中的键，数组元素或顶层为NULL
+ */
+void json_writer_begin_object(json_writer_t *w, const char *key);
+void json_writer_begin_array(json_writer_t *w, const char *key);
+
+/**
+ * @brief 结束当前对象或数组
+ */
+void json_writer_end_object(json_writer_t *w);
+void json_writer_end_array(json_writer_t *w);
+
+/**
+ * @brief 写入一个值 (字符串会转义，NULL字符串写为null，非有限浮点数写为null)
+ *
+ * @param w 输出状态
+ * @param key 在对象中的键，数组元素为NULL
+ */
+void json_writer_string(json_writer_t *w, const char *key, const char *value);
+void json_writer_int(json_writer_t *w, const char *key, int64_t value);
+void json_writer_uint(json_writer_t *w, const char *key, uint64_t value);
+void json_writer_number(json_writer_t *w, const char *key, double value);
+void json_writer_bool(json_writer_t *w, const char *key, bool value);
+void json_writer_null(json_writer_t *w, const char *key);
+
+/**
+ * @brief 结束输出
+ *
+ * 有req时发送剩余数据 (未分块时一次发送，否则发送最后的分块和结束分块)；
+ * 只写缓冲区时在末尾补'\0'。
+ *
+ * @param w 输出状态
+ * @return esp_err_t ESP_OK成功，否则为第一个发送错误或ESP_ERR_NO_MEM (缓冲区不足)
+ */
+esp_err_t json_writer_finish(json_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JSON_WRITER_H */
@@ -0,0 +1,238 @@
+/*
+ * @Description: 端到端延迟直方图与回环探测实现
+ *
+ * 环形缓冲区记录在USB接收回调中写入时打上esp_timer时间戳，发送成功时用当前时间
+ * 减去该时间戳得到USB IN到发送的延迟。直方图桶按2的幂划分，p50/p99取所在桶的上限。
+ */
+
+#include "latency.h"
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+
+// 同时未完成的回环探测数，超时的探测被新探测覆盖
+#define LATENCY_PROBE_SLOTS         8
+#define LATENCY_PROBE_TIMEOUT_US    (5 * 1000 * 1000)
+#define LATENCY_PROBE_PREFIX_LEN    (sizeof(LATENCY_PROBE_PREFIX) - 1)
+
+typedef struct {
+    uint32_t count;
+    uint64_t sum_us;
+    uint32_t max_us;
+    uint32_t buckets[LATENCY_BUCKETS];
+} latency_hist_data_t;
+
+typedef struct {
+    bool active;
+    uint32_t id;
+    int fd;
+    int64_t start_us;
+} latency_probe_t;
+
+static latency_hist_data_t s_hist[LATENCY_HIST_MAX];
+static latency_probe_t s_probes[LATENCY_PROBE_SLOTS];
+static uint32_t s_probes_active;
+static portMUX_TYPE s_latency_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// 直方图名称，与latency_hist_t顺序一致
+static const char *const s_hist_names[LATENCY_HIST_MAX] = {
+    "usb_to_ws",
+    "usb_to_raw",
+    "echo_rtt",
+    "wifi_fast_to_ip",
+    "wifi_scan_to_ip",
+    "wifi_roam_gap",
+};
+
+static int latency_bucket_of(uint32_t us)
+{
+    int bucket = 0;
+    uint32_t upper = LATENCY_BUCKET_BASE_US;
+    while (bucket < LATENCY_BUCKETS - 1 && us > upper) {
+        upper <<= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+uint32_t latency_bucket_upper_us(int bucket)
+{
+    if (bucket < 0 || bucket >= LATENCY_BUCKETS - 1) {
+        return UINT32_MAX;
+    }
+    return (uint32_t)LATENCY_BUCKET_BASE_US << bucket;
+}
+
+void latency_record(latency_hist_t hist, int64_t us)
+{
+    if (hist >= LATENCY_HIST_MAX) {
+        return;
+    }
+    uint32_t v = us < 0 ? 0 : (us > UINT32_MAX ? UINT32_MAX : (uint32_t)us);
+    int bucket = latency_bucket_of(v);
+
+    latency_hist_data_t *h = &s_hist[hist];
+    portENTER_CRITICAL(&s_latency_mux);
+    h->count++;
+    h->sum_us += v;
+    if (v > h->max_us) {
+        h->max_us = v;
+    }
+    h->buckets[bucket]++;
+    portEXIT_CRITICAL(&s_latency_mux);
+}
+
+// 返回累计数达到target的桶的上限，最后一个桶用最大值代替
+static uint32_t latency_percentile(const latency_summary_t *s, uint64_t target)
+{
+    uint64_t acc = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        acc += s->buckets[i];
+        if (acc >= target) {
+            uint32_t upper = latency_bucket_upper_us(i);
+            return upper < s->max_us ? upper : s->max_us;
+        }
+    }
+    return s->max_us;
+}
+
+void latency_get(latency_hist_t hist, latency_summary_t *summary)
+{
+    if (!summary) {
+        return;
+    }
+    memset(summary, 0, sizeof(*summary));
+    if (hist >= LATENCY_HIST_MAX) {
+        return;
+    }
+
+    latency_hist_data_t *h = &s_hist[hist];
+    portENTER_CRITICAL(&s_latency_mux);
+    summary->count = h->count;
+    summary->sum_us = h->sum_us;
+    summary->max_us = h->max_us;
+    memcpy(summary->buckets, h->buckets, sizeof(summary->buckets));
+    portEXIT_CRITICAL(&s_latency_mux);
+
+    if (summary->count > 0) {
+        summary->p50_us = latency_percentile(summary, ((uint64_t)summary->count * 50 + 99) / 100);
+        summary->p99_us = latency_percentile(summary, ((uint64_t)summary->count * 99 + 99) / 100);
+    }
+}
+
+void latency_reset(void)
+{
+    portENTER_CRITICAL(&s_latency_mux);
+    memset(s_hist, 0, sizeof(s_hist));
+    portEXIT_CRITICAL(&s_latency_mux);
+}
+
+const char *latency_name(latency_hist_t hist)
+{
+    return hist < LATENCY_HIST_MAX ? s_hist_names[hist] : "unknown";
+}
+
+// 解析前缀后的十进制编号，至少一位数字
+static bool latency_parse_id(const uint8_t *p, size_t len, uint32_t *id)
+{
+    size_t i = 0;
+    uint32_t v = 0;
+    while (i < len && i < 10 && p[i] >= '0' && p[i] <= '9') {
+        v = v * 10 + (p[i] - '0');
+        i++;
+    }
+    if (i == 0) {
+        return false;
+    }
+    *id = v;
+    return true;
+}
+
+bool latency_probe_start(const uint8_t *data, size_t len, int fd)
+{
+    uint32_t id;
+    if (!data || len <= LATENCY_PROBE_PREFIX_LEN ||
+        memcmp(data, LATENCY_PROBE_PREFIX, LATENCY_PROBE_PREFIX_LEN) != 0 ||
+        !latency_parse_id(data + LATENCY_PROBE_PREFIX_LEN, len - LATENCY_PROBE_PREFIX_LEN, &id)) {
+        return false;
+    }
+
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_latency_mux);
+    // 空闲槽位 > 超时或编号相同的槽位 > 最早的槽位
+    int slot = 0;
+    for (int i = 0; i < LATENCY_PROBE_SLOTS; i++) {
+        latency_probe_t *p = &s_probes[i];
+        if (!p->active || now - p->start_us > LATENCY_PROBE_TIMEOUT_US ||
+            (p->id == id && p->fd == fd)) {
+            slot = i;
+            break;
+        }
+        if (p->start_us < s_probes[slot].start_us) {
+            slot = i;
+        }
+    }
+    if (!s_probes[slot].active) {
+        s_probes_active++;
+    }
+    s_probes[slot] = (latency_probe_t){ .active = true, .id = id, .fd = fd, .start_us = now };
+    portEXIT_CRITICAL(&s_latency_mux);
+    return true;
+}
+
+int latency_probe_scan(const uint8_t *data, size_t len, latency_probe_result_t *results, int max)
+{
+    // 数据通路上的快速路径
+    if (__atomic_load_n(&s_probes_active, __ATOMIC_RELAXED) == 0 || !data || !results || max <= 0) {
+        return 0;
+    }
+
+    int64_t now = esp_timer_get_time();
+    int found = 0;
+    const uint8_t *p = data;
+
+    // 回显丢失的探测超时后释放，恢复快速路径
+    portENTER_CRITICAL(&s_latency_mux);
+    for (int i = 0; i < LATENCY_PROBE_SLOTS; i++) {
+        if (s_probes[i].active && now - s_probes[i].start_us > LATENCY_PROBE_TIMEOUT_US) {
+            s_probes[i].active = false;
+            s_probes_active--;
+        }
+    }
+    portEXIT_CRITICAL(&s_latency_mux);
+    const uint8_t *end = data + len;
+
+    while (found < max && (size_t)(end - p) > LATENCY_PROBE_PREFIX_LEN) {
+        const uint8_t *hit = memchr(p, LATENCY_PROBE_PREFIX[0], end - p - LATENCY_PROBE_PREFIX_LEN);
+        if (!hit) {
+            break;
+        }
+        p = hit + 1;
+        uint32_t id;
+        if (memcmp(hit, LATENCY_PROBE_PREFIX, LATENCY_PROBE_PREFIX_LEN) != 0 ||
+            !latency_parse_id(hit + LATENCY_PROBE_PREFIX_LEN, end - hit - LATENCY_PROBE_PREFIX_LEN, &id)) {
+            continue;
+        }
+
+        portENTER_CRITICAL(&s_latency_mux);
+        for (int i = 0; i < LATENCY_PROBE_SLOTS; i++) {
+            latency_probe_t *slot = &s_probes[i];
+            if (slot->active && slot->id == id) {
+                results[found].id = id;
+                results[found].fd = slot->fd;
+                results[found].rtt_us = (uint32_t)(now - slot->start_us);
+                slot->active = false;
+                s_probes_active--;
+                found++;
+                break;
+            }
+        }
+        portEXIT_CRITICAL(&s_latency_mux);
+    }
+
+    for (int i = 0; i < found; i++) {
+        latency_record(LATENCY_ECHO_RTT, results[i].rtt_us);
+    }
+    return found;
+}
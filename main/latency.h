@@ -0,0 +1,111 @@
+/*
+ * @Description: 端到端延迟直方图与回环探测头文件
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 直方图桶数，第i个桶的上限为 LATENCY_BUCKET_BASE_US << i，最后一个桶无上限
+#define LATENCY_BUCKETS         18
+#define LATENCY_BUCKET_BASE_US  64
+
+// 直方图
+typedef enum {
+    LATENCY_USB_TO_WS = 0,      // USB IN到WebSocket帧发送成功
+    LATENCY_USB_TO_RAW,         // USB IN到原始TCP/UDP流发送完成
+    LATENCY_ECHO_RTT,           // 回环探测往返时间 (WebSocket -> CDC设备 -> WebSocket)
+    LATENCY_WIFI_FAST_TO_IP,    // 快速重连 (不扫描) 发起到获取IP
+    LATENCY_WIFI_SCAN_TO_IP,    // 扫描连接发起到获取IP
+    LATENCY_WIFI_ROAM_GAP,      // 漫游切换从断开到重新获取IP
+    LATENCY_HIST_MAX,
+} latency_hist_t;
+
+// 直方图摘要
+typedef struct {
+    uint32_t count;
+    uint64_t sum_us;
+    uint32_t max_us;
+    uint32_t p50_us;            // 按桶上限估计
+    uint32_t p99_us;
+    uint32_t buckets[LATENCY_BUCKETS];
+} latency_summary_t;
+
+/*
+ * 回环探测: 客户端发送以LATENCY_PROBE_PREFIX开头、后跟十进制编号的消息，
+ * 如 "#PROBE:42\n"。消息照常转发给CDC设备，设备原样回显后，
+ * 从发出到收到回显的时间计入LATENCY_ECHO_RTT。
+ */
+#define LATENCY_PROBE_PREFIX    "#PROBE:"
+
+// 回环探测结果
+typedef struct {
+    uint32_t id;
+    int fd;                     // 发起探测的客户端
+    uint32_t rtt_us;
+} latency_probe_result_t;
+
+/**
+ * @brief 记录一个延迟样本
+ *
+ * @param hist 直方图
+ * @param us 延迟 (微秒)
+ */
+void latency_record(latency_hist_t hist, int64_t us);
+
+/**
+ * @brief 获取直方图摘要
+ *
+ * @param hist 直方图
+ * @param summary 输出的摘要
+ */
+void latency_get(latency_hist_t hist, latency_summary_t *summary);
+
+/**
+ * @brief 清空所有直方图
+ */
+void latency_reset(void);
+
+/**
+ * @brief 获取直方图名称
+ */
+const char *latency_name(latency_hist_t hist);
+
+/**
+ * @brief 获取桶上限 (微秒)，最后一个桶返回UINT32_MAX
+ */
+uint32_t latency_bucket_upper_us(int bucket);
+
+/**
+ * @brief 检查客户端消息是否为回环探测，是则开始计时
+ *
+ * @param data 消息
+ * @param len 消息长度
+ * @param fd 客户端套接字
+ * @return true 是回环探测
+ */
+bool latency_probe_start(const uint8_t *data, size_t len, int fd);
+
+/**
+ * @brief 在CDC接收数据中查找回环探测的回显 (无未完成的探测时立即返回)
+ *
+ * @param data CDC数据
+ * @param len 数据长度
+ * @param results 输出的探测结果
+ * @param max 最多输出的结果数
+ * @return int 匹配到的探测数
+ */
+int latency_probe_scan(const uint8_t *data, size_t len, latency_probe_result_t *results, int max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LATENCY_H */
@@ -11,71 +11,99 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_netif.h"
 #include "nvs_flash.h"
-#include "esp_spiffs.h"
 #include "wifi_manager.h"
 #include "http_server.h"
 #include "web_socket.h"
 #include "usbd_cdc.h"
+#include "cdc_pipeline.h"
+#include "cdc_ring.h"
+#include "data_logger.h"
+#include "stream_server.h"
+#include "task_config.h"
+#include "app_event.h"
+#include "mem_pool.h"
+#include "json_writer.h"
+#include "boot_timeline.h"
+#include "net_profile.h"
+#include "cpu_profile.h"
+#include "power_mgmt.h"
+#include "time_sync.h"
 
 static const char *TAG = "main";
 
-// 系统监控配置常量
-#define SYSTEM_INIT_DELAY_MS     5000
-#define SYSTEM_MONITOR_INTERVAL_MS 3000
-#define WEBSOCKET_CONNECT_DELAY_MS 1000
-#define SYSTEM_MONITOR_TASK_PRIORITY 2
-#define SYSTEM_MONITOR_STACK_SIZE 4096
-
-// 简单的状态结构
-static struct {
-    bool cdc_connected;
-    bool ws_connected;
-} system_status = {false, false};
-
-// 安全发送WebSocket消息 (非阻塞方式)
-static void notify_status_change(const char *event) {
-    // 只有在WebSocket连接时才发送
-    if (websocket_is_connected() && event != NULL) {
-        char msg[32];
-        snprintf(msg, sizeof(msg), "{\"event\":\"%s\"}", event);
-        websocket_server_send_text(msg);
-    }
+// 发送设备状态事件消息 (fd为-1时广播)
+static void notify_status_change(int fd, const char *event, uint8_t dev) {
+    char msg[48];
+    snprintf(msg, sizeof(msg), "{\"event\":\"%s\",\"dev\":%u}", event, dev);
+    websocket_send_text_to(fd, msg);
 }
 
-// 初始化SPIFFS
-static esp_err_t init_spiffs(void)
-{
-    ESP_LOGI(TAG, "Initializing SPIFFS");
-
-    esp_vfs_spiffs_conf_t conf = {
-        .base_path = "/spiffs",
-        .partition_label = NULL,
-        .max_files = 5,
-        .format_if_mount_failed = false
-    };
+// 推送扫描完成通知 (结果已缓存，客户端随后GET /scan即可取得)
+static void notify_scan_done(esp_err_t result) {
+    char msg[96];
+    snprintf(msg, sizeof(msg), "{\"event\":\"scan_done\",\"status\":\"%s\"}",
+             result == ESP_OK ? "success" : esp_err_to_name(result));
+    websocket_send_text_to(-1, msg);
+}
 
-    esp_err_t ret = esp_vfs_spiffs_register(&conf);
-    if (ret != ESP_OK) {
-        if (ret == ESP_FAIL) {
-            ESP_LOGE(TAG, "Failed to mount or format filesystem");
-        } else if (ret == ESP_ERR_NOT_FOUND) {
-            ESP_LOGE(TAG, "Failed to find SPIFFS partition");
-        } else {
-            ESP_LOGE(TAG, "Failed to initialize SPIFFS (%s)", esp_err_to_name(ret));
-        }
-        return ret;
+// 向状态通道推送STA状态 (fd为-1时发给所有订阅者)，消息为{"event":"wifi","change":...}加/api/status的字段
+static void notify_wifi_status(int fd, const char *change, const wifi_status_event_t *event) {
+    char msg[WEBSOCKET_TEXT_MAX_LEN];
+    json_writer_t w;
+    json_writer_init(&w, NULL, msg, sizeof(msg));
+    json_writer_begin_object(&w, NULL);
+    json_writer_string(&w, "event", "wifi");
+    json_writer_string(&w, "change", change);
+    if (event != NULL && event->change == WIFI_STATUS_DISCONNECTED) {
+        json_writer_uint(&w, "reason", event->reason);
     }
-
-    size_t total = 0, used = 0;
-    ret = esp_spiffs_info(NULL, &total, &used);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to get SPIFFS partition information (%s)", esp_err_to_name(ret));
-        return ret;
+    wifi_status_write_json(&w);
+    json_writer_end_object(&w);
+    if (json_writer_finish(&w) == ESP_OK) {
+        websocket_send_status(fd, msg);
     }
+}
 
-    ESP_LOGI(TAG, "Partition size: total: %d, used: %d", total, used);
-    return ESP_OK;
+// 应用事件处理 (在默认事件循环任务中执行)，状态变化立即推送给WebSocket客户端
+static void app_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    switch (event_id) {
+        case APP_EVENT_CDC_CONNECTED:
+            ESP_LOGI(TAG, "CDC设备%u连接状态变化: 已连接", *(uint8_t *)event_data);
+            if (websocket_is_connected()) {
+                notify_status_change(-1, "cdc_connect", *(uint8_t *)event_data);
+            }
+            break;
+        case APP_EVENT_CDC_DISCONNECTED:
+            ESP_LOGI(TAG, "CDC设备%u连接状态变化: 已断开", *(uint8_t *)event_data);
+            if (websocket_is_connected()) {
+                notify_status_change(-1, "cdc_disconnect", *(uint8_t *)event_data);
+            }
+            break;
+        case APP_EVENT_WS_CLIENT_CONNECTED:
+            // 新客户端先收到各设备当前的CDC状态，订阅了状态通道的再收到一次WiFi状态快照
+            for (uint8_t dev = 0; dev < USBD_CDC_MAX_DEVICES; dev++) {
+                notify_status_change(*(int *)event_data,
+                                     usbd_cdc_is_connected(dev) ? "cdc_connect" : "cdc_disconnect", dev);
+            }
+            notify_wifi_status(*(int *)event_data, "snapshot", NULL);
+            break;
+        case APP_EVENT_WIFI_STATUS:
+            if (websocket_has_status_subscribers()) {
+                const wifi_status_event_t *status = event_data;
+                notify_wifi_status(-1, wifi_status_change_name(status->change), status);
+            }
+            break;
+        case APP_EVENT_WIFI_SCAN_DONE:
+            if (websocket_is_connected()) {
+                notify_scan_done(*(esp_err_t *)event_data);
+            }
+            break;
+        default:
+            break;
+    }
 }
 
 // 初始化USB CDC Host
@@ -89,52 +117,45 @@ static esp_err_t init_usb_cdc(void)
         ESP_LOGE(TAG, "初始化USB CDC Host失败: %s", esp_err_to_name(ret));
         return ret;
     }
+
+#ifdef CONFIG_CDC_FLOW_LOSSLESS
+    // 无损模式: 环形缓冲区积压超过阈值时通过RTS暂停设备发送
+    usbd_cdc_set_flow_query(cdc_pipeline_flow_paused);
+    cdc_pipeline_set_flow_cb(usbd_cdc_flow_update);
+#endif
     
     ESP_LOGI(TAG, "USB CDC Host初始化成功，等待设备连接...");
     return ESP_OK;
 }
 
-// 系统状态监控任务
-static void system_monitor_task(void *pvParameters)
+// 启动时初始化WiFi (与USB和HTTP服务器并行)，完成后退出
+static void boot_wifi_task(void *arg)
 {
-    // 等待系统初始化稳定
-    vTaskDelay(pdMS_TO_TICKS(SYSTEM_INIT_DELAY_MS));
-    ESP_LOGI(TAG, "系统监控任务开始运行");
-
-    while (1) {
-        // 检查CDC连接状态
-        bool cdc_connected = usbd_cdc_is_connected();
-        if (cdc_connected != system_status.cdc_connected) {
-            ESP_LOGI(TAG, "CDC连接状态变化: %s", cdc_connected ? "已连接" : "已断开");
-            system_status.cdc_connected = cdc_connected;
-            
-            // 状态变化时通知WebSocket (如果连接)
-            if (system_status.ws_connected) {
-                notify_status_change(cdc_connected ? "cdc_connect" : "cdc_disconnect");
-            }
-        }
-        
-        // 检查WebSocket连接状态
-        bool ws_connected = websocket_is_connected();
-        if (ws_connected != system_status.ws_connected) {
-            ESP_LOGI(TAG, "WebSocket连接状态变化: %s", ws_connected ? "已连接" : "已断开");
-            system_status.ws_connected = ws_connected;
-            
-            // 如果WebSocket新连接，并且CDC已连接，发送CDC状态
-            if (ws_connected && system_status.cdc_connected) {
-                // 等待连接稳定后再发送
-                vTaskDelay(pdMS_TO_TICKS(WEBSOCKET_CONNECT_DELAY_MS));
-                notify_status_change("cdc_connect");
-            }
-        }
+    ESP_LOGI(TAG, "Starting WiFi in AP mode with smart connect");
+    ESP_ERROR_CHECK(wifi_init_softap());
+    vTaskDelete(NULL);
+}
 
-        // 定期检查系统状态
-        vTaskDelay(pdMS_TO_TICKS(SYSTEM_MONITOR_INTERVAL_MS));
+// 在单独的任务中启动WiFi，不阻塞USB和HTTP服务器的初始化
+static esp_err_t start_wifi(void)
+{
+    if (task_config_create(TASK_CFG_BOOT_WIFI, boot_wifi_task, NULL, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "创建WiFi初始化任务失败");
+        return ESP_ERR_NO_MEM;
     }
+    return ESP_OK;
 }
 
 void app_main(void)
 {
+    boot_timeline_init();
+
+    // 打印任务核心与优先级分配方案
+    task_config_log_plan();
+
+    // 初始化内存块池 (cJSON从此改用块池分配)
+    ESP_ERROR_CHECK(mem_pool_init());
+
     // 初始化NVS
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -142,22 +163,51 @@ void app_main(void)
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    boot_timeline_mark(BOOT_PHASE_NVS_READY);
 
-    // 初始化SPIFFS
-    ESP_ERROR_CHECK(init_spiffs());
+    // 读取保存的网络配置 (WiFi启动和套接字打开时应用)
+    net_profile_init();
 
-    // 初始化并启动WiFi AP (包含智能连接功能)
-    ESP_LOGI(TAG, "Starting WiFi in AP mode with smart connect");
-    ESP_ERROR_CHECK(wifi_init_softap());
+    // 各子系统共用的TCP/IP堆栈和默认事件循环
+    ESP_ERROR_CHECK(esp_netif_init());
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
 
-    // 初始化USB CDC Host
+    // 电源管理 (订阅CDC设备和客户端事件，须在USB和HTTP服务器启动前)
+    power_mgmt_init();
+
+    // STA获取IP后启动SNTP (数据信封和日志段的绝对时间)
+    time_sync_init();
+
+    // 订阅CDC设备和WebSocket客户端状态事件
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(APP_EVENT, ESP_EVENT_ANY_ID,
+                                                        app_event_handler, NULL, NULL));
+
+    // 初始化并启动WiFi AP (包含智能连接功能)，之后的连接由STA_START/GOT_IP事件驱动
+    ESP_ERROR_CHECK(start_wifi());
+
+    // 环形缓冲区须先于USB就绪: 启动时已接入的设备可能在HTTP服务器启动前就送来数据
+    ESP_ERROR_CHECK(cdc_ring_init());
+
+    // 同时初始化USB CDC Host，设备枚举和打开在USB任务中进行
     ESP_ERROR_CHECK(init_usb_cdc());
+    boot_timeline_mark(BOOT_PHASE_USB_READY);
 
-    // 启动HTTP服务器
+    // 启动HTTP服务器 (不依赖STA连接，AP上即可访问)
     ESP_ERROR_CHECK(start_webserver());
+    boot_timeline_mark(BOOT_PHASE_HTTPD_READY);
+
+    // 初始化Flash数据记录 (没有日志分区时不启用)
+    data_logger_init();
+
+#ifdef CONFIG_STREAM_SERVER_ENABLE
+    // 启动原始TCP/UDP流服务器 (供PC端采集工具使用)
+    if (stream_server_start() != ESP_OK) {
+        ESP_LOGE(TAG, "启动流服务器失败");
+    }
+#endif
     
-    // 创建系统监控任务，设置更低的优先级
-    xTaskCreate(system_monitor_task, "system_monitor", SYSTEM_MONITOR_STACK_SIZE, NULL, SYSTEM_MONITOR_TASK_PRIORITY, NULL);
-    
+    // 启动CPU负载连续采样 (未启用运行时间统计时只打印警告)
+    cpu_profile_init();
+
     ESP_LOGI(TAG, "系统初始化完成");
 }
\ No newline at end of file
@@ -0,0 +1,225 @@
+/*
+ * @Description: 固定大小内存块池实现
+ *
+ * 每个块池是一段静态数组，空闲块通过块内的下一块编号串成单链表。
+ * 释放时按地址范围判断所属块池，不需要额外的块头。
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "cJSON.h"
+#include "sdkconfig.h"
+#include "mem_pool.h"
+
+static const char *TAG = "mem_pool";
+
+#ifdef CONFIG_MEM_POOL_ENABLE
+
+#define MEM_POOL_END            UINT16_MAX
+
+// 块池容量: 小块主要是cJSON节点和键名，中等块是cJSON输出缓冲区，
+// 4096字节与CHUNK_SIZE一致，用于文件和日志下载的分块缓冲区
+#define MEM_POOL_32_BLOCKS      64
+#define MEM_POOL_64_BLOCKS      96
+#define MEM_POOL_128_BLOCKS     32
+#define MEM_POOL_256_BLOCKS     16
+#define MEM_POOL_512_BLOCKS     8
+#define MEM_POOL_1024_BLOCKS    4
+#define MEM_POOL_4096_BLOCKS    CONFIG_MEM_POOL_CHUNK_BLOCKS
+
+// 块池存储区 (大块在启用PSRAM时位于PSRAM)
+static uint8_t s_arena_32[MEM_POOL_32_BLOCKS][32] __attribute__((aligned(8)));
+static uint8_t s_arena_64[MEM_POOL_64_BLOCKS][64] __attribute__((aligned(8)));
+static uint8_t s_arena_128[MEM_POOL_128_BLOCKS][128] __attribute__((aligned(8)));
+static uint8_t s_arena_256[MEM_POOL_256_BLOCKS][256] __attribute__((aligned(8)));
+static uint8_t s_arena_512[MEM_POOL_512_BLOCKS][512] __attribute__((aligned(8)));
+EXT_RAM_BSS_ATTR static uint8_t s_arena_1024[MEM_POOL_1024_BLOCKS][1024] __attribute__((aligned(8)));
+EXT_RAM_BSS_ATTR static uint8_t s_arena_4096[MEM_POOL_4096_BLOCKS][4096] __attribute__((aligned(8)));
+
+typedef struct {
+    uint8_t *base;
+    size_t block_size;
+    uint16_t blocks;
+    uint16_t free_head;         // 第一个空闲块编号，MEM_POOL_END表示已满
+    uint16_t used;
+    uint16_t hwm;
+    uint32_t allocs;
+    uint32_t fallbacks;
+} mem_pool_class_t;
+
+// 按块大小升序排列
+static mem_pool_class_t s_classes[] = {
+    { (uint8_t *)s_arena_32, 32, MEM_POOL_32_BLOCKS },
+    { (uint8_t *)s_arena_64, 64, MEM_POOL_64_BLOCKS },
+    { (uint8_t *)s_arena_128, 128, MEM_POOL_128_BLOCKS },
+    { (uint8_t *)s_arena_256, 256, MEM_POOL_256_BLOCKS },
+    { (uint8_t *)s_arena_512, 512, MEM_POOL_512_BLOCKS },
+    { (uint8_t *)s_arena_1024, 1024, MEM_POOL_1024_BLOCKS },
+    { (uint8_t *)s_arena_4096, 4096, MEM_POOL_4096_BLOCKS },
+};
+
+#define MEM_POOL_CLASSES        (int)(sizeof(s_classes) / sizeof(s_classes[0]))
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_oversize;
+static bool s_initialized;
+
+// 空闲块的前两个字节存放下一个空闲块编号
+static inline uint16_t *block_next(mem_pool_class_t *c, uint16_t index)
+{
+    return (uint16_t *)(c->base + (size_t)index * c->block_size);
+}
+
+esp_err_t mem_pool_init(void)
+{
+    if (s_initialized) {
+        return ESP_OK;
+    }
+
+    size_t total = 0;
+    for (int i = 0; i < MEM_POOL_CLASSES; i++) {
+        mem_pool_class_t *c = &s_classes[i];
+        for (uint16_t b = 0; b < c->blocks; b++) {
+            *block_next(c, b) = (b + 1 < c->blocks) ? b + 1 : MEM_POOL_END;
+        }
+        c->free_head = c->blocks > 0 ? 0 : MEM_POOL_END;
+        total += c->block_size * c->blocks;
+    }
+    s_initialized = true;
+
+    cJSON_Hooks hooks = {
+        .malloc_fn = mem_pool_alloc,
+        .free_fn = mem_pool_free,
+    };
+    cJSON_InitHooks(&hooks);
+
+    ESP_LOGI(TAG, "内存块池已初始化: %d种块大小，共%u字节", MEM_POOL_CLASSES, (unsigned)total);
+    return ESP_OK;
+}
+
+void *mem_pool_alloc(size_t size)
+{
+    if (!s_initialized) {
+        return malloc(size);
+    }
+
+    for (int i = 0; i < MEM_POOL_CLASSES; i++) {
+        mem_pool_class_t *c = &s_classes[i];
+        if (size > c->block_size) {
+            continue;
+        }
+
+        void *ptr = NULL;
+        taskENTER_CRITICAL(&s_lock);
+        if (c->free_head != MEM_POOL_END) {
+            uint16_t index = c->free_head;
+            c->free_head = *block_next(c, index);
+            ptr = block_next(c, index);
+            c->used++;
+            c->allocs++;
+            if (c->used > c->hwm) {
+                c->hwm = c->used;
+            }
+        } else {
+            c->fallbacks++;
+        }
+        taskEXIT_CRITICAL(&s_lock);
+
+        // 该块池已满时直接退回到堆，不占用更大的块
+        return ptr ? ptr : malloc(size);
+    }
+
+    __atomic_fetch_add(&s_oversize, 1, __ATOMIC_RELAXED);
+    return malloc(size);
+}
+
+void mem_pool_free(void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+
+    uint8_t *p = (uint8_t *)ptr;
+    for (int i = 0; i < MEM_POOL_CLASSES; i++) {
+        mem_pool_class_t *c = &s_classes[i];
+        if (p < c->base || p >= c->base + c->block_size * c->blocks) {
+            continue;
+        }
+        uint16_t index = (uint16_t)((p - c->base) / c->block_size);
+        taskENTER_CRITICAL(&s_lock);
+        *block_next(c, index) = c->free_head;
+        c->free_head = index;
+        c->used--;
+        taskEXIT_CRITICAL(&s_lock);
+        return;
+    }
+    free(ptr);
+}
+
+int mem_pool_class_count(void)
+{
+    return MEM_POOL_CLASSES;
+}
+
+void mem_pool_get_stats(int index, mem_pool_stats_t *stats)
+{
+    if (!stats || index < 0 || index >= MEM_POOL_CLASSES) {
+        return;
+    }
+    const mem_pool_class_t *c = &s_classes[index];
+    taskENTER_CRITICAL(&s_lock);
+    stats->block_size = c->block_size;
+    stats->blocks = c->blocks;
+    stats->used = c->used;
+    stats->hwm = c->hwm;
+    stats->allocs = c->allocs;
+    stats->fallbacks = c->fallbacks;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+uint32_t mem_pool_oversize_count(void)
+{
+    return __atomic_load_n(&s_oversize, __ATOMIC_RELAXED);
+}
+
+#else /* !CONFIG_MEM_POOL_ENABLE */
+
+// 未启用时直接使用堆分配
+esp_err_t mem_pool_init(void)
+{
+    ESP_LOGI(TAG, "内存块池未启用");
+    return ESP_OK;
+}
+
+void *mem_pool_alloc(size_t size)
+{
+    return malloc(size);
+}
+
+void mem_pool_free(void *ptr)
+{
+    free(ptr);
+}
+
+int mem_pool_class_count(void)
+{
+    return 0;
+}
+
+void mem_pool_get_stats(int index, mem_pool_stats_t *stats)
+{
+    (void)index;
+    if (stats) {
+        memset(stats, 0, sizeof(*stats));
+    }
+}
+
+uint32_t mem_pool_oversize_count(void)
+{
+    return 0;
+}
+
+#endif /* CONFIG_MEM_POOL_ENABLE */
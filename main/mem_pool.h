@@ -0,0 +1,74 @@
+/*
+ * @Description: 固定大小内存块池头文件
+ *
+ * HTTP处理函数的临时缓冲区和cJSON节点按大小归入若干固定块大小，
+ * 从静态分配的块池中取用，长时间运行后不会因反复malloc/free使内部RAM碎片化。
+ * 超过最大块大小或对应块池已用完时退回到堆分配。
+ */
+
+#ifndef MEM_POOL_H
+#define MEM_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 单个块池的统计信息
+typedef struct {
+    size_t block_size;          // 块大小
+    uint16_t blocks;            // 块数
+    uint16_t used;              // 当前已用块数
+    uint16_t hwm;               // 历史最大已用块数
+    uint32_t allocs;            // 从该块池分配的次数
+    uint32_t fallbacks;         // 该块池已满退回到堆分配的次数
+} mem_pool_stats_t;
+
+/**
+ * @brief 初始化块池并将cJSON的内存分配切换到块池 (须在使用cJSON之前调用)
+ *
+ * @return esp_err_t ESP_OK成功
+ */
+esp_err_t mem_pool_init(void);
+
+/**
+ * @brief 分配内存，从不小于size的最小块池中取一块
+ *
+ * @param size 字节数
+ * @return void* 内存指针，失败返回NULL
+ */
+void *mem_pool_alloc(size_t size);
+
+/**
+ * @brief 释放mem_pool_alloc()分配的内存 (NULL时不做任何事)
+ *
+ * @param ptr 内存指针
+ */
+void mem_pool_free(void *ptr);
+
+/**
+ * @brief 块池数量
+ */
+int mem_pool_class_count(void);
+
+/**
+ * @brief 获取块池统计信息
+ *
+ * @param index 块池编号 (0到mem_pool_class_count()-1，按块大小升序)
+ * @param stats 输出的统计信息
+ */
+void mem_pool_get_stats(int index, mem_pool_stats_t *stats);
+
+/**
+ * @brief 获取不属于任何块池的堆分配次数 (请求大于最大块大小)
+ */
+uint32_t mem_pool_oversize_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MEM_POOL_H */
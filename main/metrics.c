@@ -0,0 +1,75 @@
+/*
+ * @Description: 数据通路运行指标实现
+ *
+ * 各模块在数据通路上直接原子累加计数器，不加锁、不打印日志。
+ * 指标通过/api/metrics (JSON) 和/metrics (Prometheus文本格式) 导出。
+ */
+
+#include "metrics.h"
+
+uint32_t g_metric_counters[METRIC_COUNTER_MAX];
+uint32_t g_metric_hwm[METRIC_HWM_MAX];
+
+// 计数器描述，与metric_counter_t顺序一致
+static const metric_desc_t s_counter_desc[METRIC_COUNTER_MAX] = {
+    [METRIC_USB_IN_PACKETS]     = { "usb_in_packets",     "USB IN transfers received from the CDC device" },
+    [METRIC_USB_IN_BYTES]       = { "usb_in_bytes",       "Bytes received from the CDC device" },
+    [METRIC_FRAMED_RECORDS]     = { "framed_records",     "Records emitted by the framing stage" },
+    [METRIC_FRAMED_BYTES]       = { "framed_bytes",       "Bytes emitted by the framing stage" },
+    [METRIC_QUEUED_RECORDS]     = { "queued_records",     "Records written to the CDC ring" },
+    [METRIC_QUEUED_BYTES]       = { "queued_bytes",       "Bytes written to the CDC ring" },
+    [METRIC_DROPPED_RECORDS]    = { "dropped_records",    "Records dropped because the CDC ring was full" },
+    [METRIC_DROPPED_BYTES]      = { "dropped_bytes",      "Bytes dropped because the CDC ring was full" },
+    [METRIC_DISCARDED_BYTES]    = { "discarded_bytes",    "CDC bytes discarded while no client was connected" },
+    [METRIC_LOST_RECORDS]       = { "lost_records",       "Records overwritten before a WebSocket client sent them" },
+    [METRIC_WS_SENT_FRAMES]     = { "ws_sent_frames",     "WebSocket frames sent" },
+    [METRIC_WS_SENT_BYTES]      = { "ws_sent_bytes",      "WebSocket payload bytes sent" },
+    [METRIC_WS_SEND_ERRORS]     = { "ws_send_errors",     "Failed httpd_ws_send_frame_async calls" },
+    [METRIC_WS_MSG_QUEUE_FULL]  = { "ws_msg_queue_full",  "Control messages dropped because the queue was full" },
+    [METRIC_WS_RX_BYTES]        = { "ws_rx_bytes",        "Bytes received from WebSocket clients" },
+    [METRIC_CDC_TX_BYTES]       = { "cdc_tx_bytes",       "Bytes sent to the CDC device" },
+    [METRIC_CDC_TX_REJECTED]    = { "cdc_tx_rejected",    "CDC TX requests rejected because the queue was full" },
+    [METRIC_RAW_SENT_BYTES]     = { "raw_sent_bytes",     "Bytes sent by the raw TCP/UDP stream server" },
+    [METRIC_FLOW_PAUSES]        = { "flow_pauses",        "Times the CDC device was asked to pause (lossless mode)" },
+    [METRIC_FLOW_PAUSED_MS]     = { "flow_paused_ms",     "Milliseconds the CDC device was paused (lossless mode)" },
+    [METRIC_CPU_SATURATED_MS]   = { "cpu_saturated_ms",   "Milliseconds any CPU core was at or above the saturation threshold" },
+};
+
+// 高水位描述，与metric_hwm_t顺序一致
+static const metric_desc_t s_hwm_desc[METRIC_HWM_MAX] = {
+    [METRIC_HWM_WS_MSG_QUEUE]   = { "ws_msg_queue_hwm",   "Highest WebSocket control message queue depth" },
+    [METRIC_HWM_CDC_TX_QUEUE]   = { "cdc_tx_queue_hwm",   "Highest CDC TX queue depth in blocks" },
+    [METRIC_HWM_RING_BYTES]     = { "ring_bytes_hwm",     "Highest unread byte count of the slowest ring reader" },
+    [METRIC_HWM_RING_PENDING]   = { "ring_pending_hwm",   "Highest unread record count of the slowest ring reader" },
+    [METRIC_HWM_CPU_LOAD_PCT]   = { "cpu_load_pct_hwm",   "Highest per-core CPU load over one sampling interval (percent)" },
+};
+
+const metric_desc_t *metrics_counter_desc(metric_counter_t id)
+{
+    return id < METRIC_COUNTER_MAX ? &s_counter_desc[id] : NULL;
+}
+
+const metric_desc_t *metrics_hwm_desc(metric_hwm_t id)
+{
+    return id < METRIC_HWM_MAX ? &s_hwm_desc[id] : NULL;
+}
+
+uint32_t metrics_counter_get(metric_counter_t id)
+{
+    return id < METRIC_COUNTER_MAX ? __atomic_load_n(&g_metric_counters[id], __ATOMIC_RELAXED) : 0;
+}
+
+uint32_t metrics_hwm_get(metric_hwm_t id)
+{
+    return id < METRIC_HWM_MAX ? __atomic_load_n(&g_metric_hwm[id], __ATOMIC_RELAXED) : 0;
+}
+
+void metrics_reset(void)
+{
+    for (int i = 0; i < METRIC_COUNTER_MAX; i++) {
+        __atomic_store_n(&g_metric_counters[i], 0, __ATOMIC_RELAXED);
+    }
+    for (int i = 0; i < METRIC_HWM_MAX; i++) {
+        __atomic_store_n(&g_metric_hwm[i], 0, __ATOMIC_RELAXED);
+    }
+}
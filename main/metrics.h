@@ -0,0 +1,111 @@
+/*
+ * @Description: 数据通路运行指标头文件
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 计数器 (32位，溢出后从0开始，Prometheus按计数器重置处理)
+typedef enum {
+    METRIC_USB_IN_PACKETS = 0,      // USB IN传输数
+    METRIC_USB_IN_BYTES,
+    METRIC_FRAMED_RECORDS,          // 分帧阶段输出的记录数
+    METRIC_FRAMED_BYTES,
+    METRIC_QUEUED_RECORDS,          // 写入环形缓冲区的记录数
+    METRIC_QUEUED_BYTES,
+    METRIC_DROPPED_RECORDS,         // 环形缓冲区空间不足被丢弃的记录数
+    METRIC_DROPPED_BYTES,
+    METRIC_DISCARDED_BYTES,         // 无客户端时丢弃的CDC数据
+    METRIC_LOST_RECORDS,            // 客户端发送过慢被覆盖的记录数
+    METRIC_WS_SENT_FRAMES,          // WebSocket发送成功的帧数
+    METRIC_WS_SENT_BYTES,
+    METRIC_WS_SEND_ERRORS,          // httpd_ws_send_frame_async失败次数
+    METRIC_WS_MSG_QUEUE_FULL,       // 控制消息队列已满被丢弃的消息数
+    METRIC_WS_RX_BYTES,             // 客户端发来的数据
+    METRIC_CDC_TX_BYTES,            // 发送到CDC设备的数据
+    METRIC_CDC_TX_REJECTED,         // CDC发送队列已满被拒绝的请求数
+    METRIC_RAW_SENT_BYTES,          // 原始TCP/UDP流发送的数据
+    METRIC_FLOW_PAUSES,             // 无损模式下要求设备暂停发送的次数
+    METRIC_FLOW_PAUSED_MS,          // 无损模式下设备暂停发送的累计时间
+    METRIC_CPU_SATURATED_MS,        // 任一核心负载达到饱和阈值的累计时间 (连续CPU采样)
+    METRIC_COUNTER_MAX,
+} metric_counter_t;
+
+// 高水位 (历史最大值)
+typedef enum {
+    METRIC_HWM_WS_MSG_QUEUE = 0,    // WebSocket控制消息队列深度
+    METRIC_HWM_CDC_TX_QUEUE,        // CDC异步发送队列深度 (数据块)
+    METRIC_HWM_RING_BYTES,          // 最慢读者的未读字节数
+    METRIC_HWM_RING_PENDING,        // 最慢读者的未读记录数
+    METRIC_HWM_CPU_LOAD_PCT,        // 单个核心在一个采样周期内的最高负载 (%)
+    METRIC_HWM_MAX,
+} metric_hwm_t;
+
+// 计数器和高水位存储，由内联函数原子更新
+extern uint32_t g_metric_counters[METRIC_COUNTER_MAX];
+extern uint32_t g_metric_hwm[METRIC_HWM_MAX];
+
+/**
+ * @brief 累加计数器 (原子操作，可在任意任务中调用)
+ */
+static inline void metrics_add(metric_counter_t id, uint32_t value)
+{
+    __atomic_fetch_add(&g_metric_counters[id], value, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief 更新高水位 (原子操作，只在超过历史最大值时写入)
+ */
+static inline void metrics_hwm(metric_hwm_t id, uint32_t value)
+{
+    uint32_t cur = __atomic_load_n(&g_metric_hwm[id], __ATOMIC_RELAXED);
+    while (value > cur &&
+           !__atomic_compare_exchange_n(&g_metric_hwm[id], &cur, value, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+// 指标描述，用于JSON和Prometheus输出
+typedef struct {
+    const char *name;               // 指标名 (snake_case)
+    const char *help;               // 说明
+} metric_desc_t;
+
+/**
+ * @brief 获取计数器描述
+ */
+const metric_desc_t *metrics_counter_desc(metric_counter_t id);
+
+/**
+ * @brief 获取高水位描述
+ */
+const metric_desc_t *metrics_hwm_desc(metric_hwm_t id);
+
+/**
+ * @brief 读取计数器当前值
+ */
+uint32_t metrics_counter_get(metric_counter_t id);
+
+/**
+ * @brief 读取高水位当前值
+ */
+uint32_t metrics_hwm_get(metric_hwm_t id);
+
+/**
+ * @brief 清零所有计数器和高水位
+ */
+void metrics_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* METRICS_H */
@@ -0,0 +1,174 @@
+/*
+ * @Description: 网络性能配置实现
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "lwip/sockets.h"
+#include "net_profile.h"
+#include "app_event.h"
+#include "power_mgmt.h"
+
+static const char *TAG = "net_profile";
+
+#define NVS_NAMESPACE "net_profile"
+#define NVS_KEY_PROFILE "profile"
+
+#define PROTOCOL_BGN (WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N)
+
+// 顺序与net_profile_t一致
+static const char *const s_names[NET_PROFILE_MAX] = {
+    "throughput",
+    "latency",
+    "power",
+};
+
+static const net_profile_params_t s_params[NET_PROFILE_MAX] = {
+    [NET_PROFILE_THROUGHPUT] = {
+        .ps = WIFI_PS_NONE,
+        .bandwidth = WIFI_BW_HT40,
+        .max_tx_power = 80,     // 20dBm
+        .protocol = PROTOCOL_BGN,
+        .tcp_nodelay = false,
+    },
+    [NET_PROFILE_LATENCY] = {
+        .ps = WIFI_PS_NONE,
+        .bandwidth = WIFI_BW_HT20,
+        .max_tx_power = 80,
+        .protocol = PROTOCOL_BGN,
+        .tcp_nodelay = true,
+    },
+    [NET_PROFILE_POWER] = {
+        .ps = WIFI_PS_MAX_MODEM,  // 按listen_interval (默认3个信标间隔) 醒来
+        .bandwidth = WIFI_BW_HT20,
+        .max_tx_power = 60,     // 15dBm
+        .protocol = PROTOCOL_BGN,
+        .tcp_nodelay = false,
+    },
+};
+
+#if defined(CONFIG_NET_PROFILE_DEFAULT_THROUGHPUT)
+#define DEFAULT_PROFILE NET_PROFILE_THROUGHPUT
+#elif defined(CONFIG_NET_PROFILE_DEFAULT_POWER)
+#define DEFAULT_PROFILE NET_PROFILE_POWER
+#else
+#define DEFAULT_PROFILE NET_PROFILE_LATENCY
+#endif
+
+static net_profile_t s_profile = DEFAULT_PROFILE;
+
+esp_err_t net_profile_init(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (err == ESP_OK) {
+        uint8_t value;
+        if (nvs_get_u8(nvs_handle, NVS_KEY_PROFILE, &value) == ESP_OK && value < NET_PROFILE_MAX) {
+            s_profile = (net_profile_t)value;
+        }
+        nvs_close(nvs_handle);
+    }
+    ESP_LOGI(TAG, "网络配置: %s", s_names[s_profile]);
+    return ESP_OK;
+}
+
+net_profile_t net_profile_get(void)
+{
+    return __atomic_load_n(&s_profile, __ATOMIC_RELAXED);
+}
+
+const net_profile_params_t *net_profile_params(net_profile_t profile)
+{
+    return profile < NET_PROFILE_MAX ? &s_params[profile] : NULL;
+}
+
+const char *net_profile_name(net_profile_t profile)
+{
+    return profile < NET_PROFILE_MAX ? s_names[profile] : "unknown";
+}
+
+esp_err_t net_profile_from_name(const char *name, net_profile_t *profile)
+{
+    if (name == NULL || profile == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < NET_PROFILE_MAX; i++) {
+        if (strcmp(name, s_names[i]) == 0) {
+            *profile = (net_profile_t)i;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t net_profile_set(net_profile_t profile)
+{
+    if (profile >= NET_PROFILE_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err == ESP_OK) {
+        err = nvs_set_u8(nvs_handle, NVS_KEY_PROFILE, (uint8_t)profile);
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs_handle);
+        }
+        nvs_close(nvs_handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "保存网络配置失败: %s", esp_err_to_name(err));
+    }
+
+    net_profile_t old = __atomic_exchange_n(&s_profile, profile, __ATOMIC_RELAXED);
+    if (old == profile) {
+        return ESP_OK;
+    }
+    ESP_LOGI(TAG, "网络配置切换: %s -> %s", s_names[old], s_names[profile]);
+    net_profile_apply_wifi();
+    app_event_post(APP_EVENT_NET_PROFILE_CHANGED, &profile, sizeof(profile));
+    return ESP_OK;
+}
+
+void net_profile_apply_wifi(void)
+{
+    const net_profile_params_t *p = &s_params[net_profile_get()];
+
+    // 协议和带宽在下次关联时生效
+    esp_err_t err = esp_wifi_set_protocol(WIFI_IF_STA, p->protocol);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "设置协议失败: %s", esp_err_to_name(err));
+    }
+    err = esp_wifi_set_bandwidth(WIFI_IF_STA, p->bandwidth);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "设置带宽失败: %s", esp_err_to_name(err));
+    }
+    // 空闲时由电源管理改为每个DTIM醒来
+    err = esp_wifi_set_ps(power_mgmt_wifi_ps(p->ps));
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "设置省电模式失败: %s", esp_err_to_name(err));
+    }
+    err = esp_wifi_set_max_tx_power(p->max_tx_power);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "设置发射功率失败: %s", esp_err_to_name(err));
+    }
+}
+
+void net_profile_apply_socket(int fd)
+{
+    int opt = s_params[net_profile_get()].tcp_nodelay;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+}
+
+void net_profile_write_json(json_writer_t *w)
+{
+    net_profile_t profile = net_profile_get();
+    const net_profile_params_t *p = &s_params[profile];
+    json_writer_string(w, "active", s_names[profile]);
+    json_writer_string(w, "power_save", p->ps == WIFI_PS_NONE ? "none" :
+                                         p->ps == WIFI_PS_MIN_MODEM ? "min_modem" : "max_modem");
+    json_writer_uint(w, "bandwidth_mhz", p->bandwidth == WIFI_BW_HT40 ? 40 : 20);
+    json_writer_int(w, "max_tx_power_qdbm", p->max_tx_power);
+    json_writer_bool(w, "tcp_nodelay", p->tcp_nodelay);
+}
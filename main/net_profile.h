@@ -0,0 +1,92 @@
+/*
+ * @Description: 网络性能配置 (吞吐/延迟/功耗) 头文件
+ *
+ * 一个配置同时决定WiFi驱动参数 (省电模式、带宽、发射功率、协议) 和
+ * 数据套接字 (WebSocket客户端、流服务器TCP连接) 的选项，保存在NVS中，可在运行时切换。
+ * 切换后WiFi参数立即生效 (带宽和协议在下次关联时生效)，已打开的套接字
+ * 由各自的模块收到APP_EVENT_NET_PROFILE_CHANGED后更新。
+ */
+
+#ifndef NET_PROFILE_H
+#define NET_PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_wifi.h"
+#include "json_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 网络配置
+typedef enum {
+    NET_PROFILE_THROUGHPUT = 0, // 最大吞吐: 不省电，HT40，允许Nagle合并小包
+    NET_PROFILE_LATENCY,        // 低延迟: 不省电，HT20，数据套接字关闭Nagle
+    NET_PROFILE_POWER,          // 低功耗: 最大省电模式，HT20，降低发射功率
+    NET_PROFILE_MAX,
+} net_profile_t;
+
+// 配置参数
+typedef struct {
+    wifi_ps_type_t ps;          // STA省电模式
+    wifi_bandwidth_t bandwidth; // STA带宽
+    int8_t max_tx_power;        // 最大发射功率 (0.25dBm)
+    uint8_t protocol;           // STA协议位图 (WIFI_PROTOCOL_11B等)
+    bool tcp_nodelay;           // 数据套接字是否关闭Nagle算法
+} net_profile_params_t;
+
+/**
+ * @brief 从NVS读取保存的配置 (在NVS初始化后、WiFi启动前调用)
+ */
+esp_err_t net_profile_init(void);
+
+/**
+ * @brief 获取当前配置
+ */
+net_profile_t net_profile_get(void);
+
+/**
+ * @brief 获取配置的参数 (静态表，不会改变)
+ */
+const net_profile_params_t *net_profile_params(net_profile_t profile);
+
+/**
+ * @brief 切换配置：保存到NVS，更新WiFi参数并发布APP_EVENT_NET_PROFILE_CHANGED
+ * @return esp_err_t ESP_OK成功，ESP_ERR_INVALID_ARG配置无效
+ */
+esp_err_t net_profile_set(net_profile_t profile);
+
+/**
+ * @brief 配置名称 ("throughput"/"latency"/"power")
+ */
+const char *net_profile_name(net_profile_t profile);
+
+/**
+ * @brief 按名称查找配置
+ * @return esp_err_t ESP_OK成功，ESP_ERR_NOT_FOUND名称无效
+ */
+esp_err_t net_profile_from_name(const char *name, net_profile_t *profile);
+
+/**
+ * @brief 把当前配置的WiFi参数应用到驱动 (在esp_wifi_start之后调用)
+ */
+void net_profile_apply_wifi(void);
+
+/**
+ * @brief 把当前配置的套接字选项应用到数据套接字
+ * @param fd TCP套接字
+ */
+void net_profile_apply_socket(int fd);
+
+/**
+ * @brief 在当前JSON对象中写入配置和参数 (用于/api/metrics和/api/net_profile)
+ */
+void net_profile_write_json(json_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NET_PROFILE_H */
@@ -0,0 +1,241 @@
+/*
+ * @Description: 电源管理实现
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_pm.h"
+#include "freertos/FreeRTOS.h"
+#include "power_mgmt.h"
+#include "app_event.h"
+#include "net_profile.h"
+#include "usbd_cdc.h"
+#include "web_socket.h"
+
+static const char *TAG = "power_mgmt";
+
+#if CONFIG_PM_ENABLE
+#define POWER_MIN_FREQ_MHZ      CONFIG_POWER_MIN_FREQ_MHZ
+#else
+#define POWER_MIN_FREQ_MHZ      CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+#endif
+#define POWER_DATA_IDLE_MS      CONFIG_POWER_DATA_IDLE_MS
+
+static struct {
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_handle_t freq_lock;     // STREAMING时持有
+    esp_pm_lock_handle_t sleep_lock;    // ACTIVE和STREAMING时持有
+#endif
+    esp_timer_handle_t idle_timer;      // STREAMING期间周期检查数据是否已停止
+    bool streaming;                     // 原子访问
+    bool awake;                         // 有CDC设备或客户端，原子访问
+    uint32_t last_data_ms;              // 最近一次收到CDC数据，原子访问
+    uint32_t cdc_mask;                  // 已连接的设备 (只在事件循环任务中修改)
+    uint8_t ws_clients;                 // 客户端数 (只在事件循环任务中修改)
+    // 以下由s_lock保护
+    power_state_t state;
+    int64_t state_since_us;
+    uint64_t residency_us[POWER_STATE_MAX];
+    uint32_t transitions;
+} s_pm;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *s_state_names[POWER_STATE_MAX] = { "idle", "active", "streaming" };
+
+static inline uint32_t now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+// 按当前标志更新状态并累计上一状态的时间 (在临界区内读取标志，多个任务同时调用时以最后一次为准)
+static void power_update_state(void)
+{
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&s_lock);
+    power_state_t state = __atomic_load_n(&s_pm.streaming, __ATOMIC_ACQUIRE) ? POWER_STATE_STREAMING :
+                          __atomic_load_n(&s_pm.awake, __ATOMIC_ACQUIRE) ? POWER_STATE_ACTIVE : POWER_STATE_IDLE;
+    if (state != s_pm.state) {
+        s_pm.residency_us[s_pm.state] += now - s_pm.state_since_us;
+        s_pm.state = state;
+        s_pm.state_since_us = now;
+        s_pm.transitions++;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+// STREAMING期间在esp_timer任务中运行，数据停止超过POWER_DATA_IDLE_MS后释放CPU频率锁。
+// 先停定时器再清标志，收到新数据时标志为false就说明定时器已停，可以重新启动
+static void power_idle_check(void *arg)
+{
+    if (now_ms() - __atomic_load_n(&s_pm.last_data_ms, __ATOMIC_RELAXED) < POWER_DATA_IDLE_MS) {
+        return;
+    }
+    esp_timer_stop(s_pm.idle_timer);
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_release(s_pm.freq_lock);
+#endif
+    __atomic_store_n(&s_pm.streaming, false, __ATOMIC_RELEASE);
+    power_update_state();
+}
+
+void power_mgmt_data_activity(void)
+{
+    __atomic_store_n(&s_pm.last_data_ms, now_ms(), __ATOMIC_RELAXED);
+    if (__atomic_load_n(&s_pm.streaming, __ATOMIC_RELAXED) || s_pm.idle_timer == NULL) {
+        return;
+    }
+    if (__atomic_exchange_n(&s_pm.streaming, true, __ATOMIC_ACQ_REL)) {
+        return;
+    }
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_acquire(s_pm.freq_lock);
+#endif
+    esp_timer_start_periodic(s_pm.idle_timer, (uint64_t)POWER_DATA_IDLE_MS * 1000 / 4);
+    power_update_state();
+}
+
+wifi_ps_type_t power_mgmt_wifi_ps(wifi_ps_type_t profile_ps)
+{
+#if CONFIG_POWER_IDLE_MODEM_SLEEP
+    if (profile_ps == WIFI_PS_NONE && !__atomic_load_n(&s_pm.awake, __ATOMIC_RELAXED)) {
+        return WIFI_PS_MIN_MODEM;
+    }
+#endif
+    return profile_ps;
+}
+
+// CDC设备和WebSocket客户端变化 (在默认事件循环任务中执行)，进出空闲时切换浅睡眠锁和WiFi省电模式。
+// 事件以0超时发布，队列满时会丢失，因此每次都重新读取实际的设备和客户端状态，而不是按事件增减计数
+static void power_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    switch (event_id) {
+        case APP_EVENT_CDC_CONNECTED:
+        case APP_EVENT_CDC_DISCONNECTED:
+        case APP_EVENT_WS_CLIENT_CONNECTED:
+        case APP_EVENT_WS_CLIENT_DISCONNECTED:
+            break;
+        default:
+            return;
+    }
+    s_pm.cdc_mask = usbd_cdc_connected_mask();
+    s_pm.ws_clients = (uint8_t)websocket_client_count();
+
+    bool awake = s_pm.cdc_mask != 0 || s_pm.ws_clients > 0;
+    if (awake == __atomic_load_n(&s_pm.awake, __ATOMIC_RELAXED)) {
+        return;
+    }
+    __atomic_store_n(&s_pm.awake, awake, __ATOMIC_RELEASE);
+#if CONFIG_PM_ENABLE
+    if (awake) {
+        esp_pm_lock_acquire(s_pm.sleep_lock);
+    } else {
+        esp_pm_lock_release(s_pm.sleep_lock);
+    }
+#endif
+    power_update_state();
+
+    // 网络配置本身已省电时不变
+    esp_err_t err = esp_wifi_set_ps(power_mgmt_wifi_ps(net_profile_params(net_profile_get())->ps));
+    if (err != ESP_OK && err != ESP_ERR_WIFI_NOT_INIT) {
+        ESP_LOGW(TAG, "设置省电模式失败: %s", esp_err_to_name(err));
+    }
+    ESP_LOGI(TAG, awake ? "退出空闲" : "进入空闲，允许浅睡眠");
+}
+
+esp_err_t power_mgmt_init(void)
+{
+    s_pm.state_since_us = esp_timer_get_time();
+
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = POWER_MIN_FREQ_MHZ,
+#if CONFIG_POWER_LIGHT_SLEEP
+        .light_sleep_enable = true,
+#endif
+    };
+    esp_err_t err = esp_pm_configure(&pm_config);
+    if (err == ESP_OK) {
+        err = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "data", &s_pm.freq_lock);
+    }
+    if (err == ESP_OK) {
+        err = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "active", &s_pm.sleep_lock);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "配置电源管理失败: %s", esp_err_to_name(err));
+        return err;
+    }
+#endif
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = power_idle_check,
+        .name = "power_idle",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &s_pm.idle_timer);
+    if (ret == ESP_OK) {
+        ret = esp_event_handler_instance_register(APP_EVENT, ESP_EVENT_ANY_ID, power_event_handler, NULL, NULL);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "初始化电源管理失败: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "电源管理: CPU %d-%dMHz, 浅睡眠%s", POWER_MIN_FREQ_MHZ, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+#if CONFIG_POWER_LIGHT_SLEEP
+             "启用"
+#else
+             "禁用"
+#endif
+             );
+    return ESP_OK;
+}
+
+void power_mgmt_get_stats(power_mgmt_stats_t *stats)
+{
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&s_lock);
+    stats->state = s_pm.state;
+    stats->transitions = s_pm.transitions;
+    memcpy(stats->residency_us, s_pm.residency_us, sizeof(stats->residency_us));
+    stats->residency_us[s_pm.state] += now - s_pm.state_since_us;
+    taskEXIT_CRITICAL(&s_lock);
+    stats->cdc_devices = __builtin_popcount(s_pm.cdc_mask);
+    stats->ws_clients = s_pm.ws_clients;
+}
+
+const char *power_state_name(power_state_t state)
+{
+    return state < POWER_STATE_MAX ? s_state_names[state] : "unknown";
+}
+
+void power_mgmt_write_json(json_writer_t *w)
+{
+    power_mgmt_stats_t stats;
+    power_mgmt_get_stats(&stats);
+    wifi_ps_type_t ps = WIFI_PS_NONE;
+    esp_wifi_get_ps(&ps);
+
+#if CONFIG_PM_ENABLE
+    json_writer_bool(w, "pm_enabled", true);
+#else
+    json_writer_bool(w, "pm_enabled", false);
+#endif
+#if CONFIG_POWER_LIGHT_SLEEP
+    json_writer_bool(w, "light_sleep", true);
+#else
+    json_writer_bool(w, "light_sleep", false);
+#endif
+    json_writer_uint(w, "min_freq_mhz", POWER_MIN_FREQ_MHZ);
+    json_writer_uint(w, "max_freq_mhz", CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+    json_writer_string(w, "state", power_state_name(stats.state));
+    json_writer_string(w, "wifi_ps", ps == WIFI_PS_NONE ? "none" : ps == WIFI_PS_MIN_MODEM ? "min_modem" : "max_modem");
+    json_writer_uint(w, "cdc_devices", stats.cdc_devices);
+    json_writer_uint(w, "ws_clients", stats.ws_clients);
+    json_writer_uint(w, "transitions", stats.transitions);
+    json_writer_begin_object(w, "residency_ms");
+    for (int i = 0; i < POWER_STATE_MAX; i++) {
+        json_writer_uint(w, s_state_names[i], stats.residency_us[i] / 1000);
+    }
+    json_writer_end_object(w);
+}
@@ -0,0 +1,78 @@
+/*
+ * @Description: 电源管理头文件
+ *
+ * 按是否有数据和客户端分三种状态，用PM锁控制CPU频率和自动浅睡眠 (CONFIG_PM_ENABLE + 无滴答空闲):
+ *   - STREAMING: 最近CONFIG_POWER_DATA_IDLE_MS内收到过CDC数据，持有CPU_FREQ_MAX锁
+ *   - ACTIVE:    有CDC设备或WebSocket客户端但没有数据，持有NO_LIGHT_SLEEP锁，CPU按需降频
+ *   - IDLE:      都没有，释放全部锁，允许浅睡眠；WiFi改为每个DTIM信标醒来一次的省电模式
+ * 各状态的累计时间和当前模式通过/api/metrics的"power"对象和Prometheus报告。
+ */
+
+#ifndef POWER_MGMT_H
+#define POWER_MGMT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_wifi.h"
+#include "json_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 电源状态
+typedef enum {
+    POWER_STATE_IDLE = 0,
+    POWER_STATE_ACTIVE,
+    POWER_STATE_STREAMING,
+    POWER_STATE_MAX,
+} power_state_t;
+
+// 状态和累计时间
+typedef struct {
+    power_state_t state;
+    uint32_t transitions;                       // 状态切换次数
+    uint64_t residency_us[POWER_STATE_MAX];     // 各状态的累计时间 (含当前状态到现在的时间)
+    uint8_t cdc_devices;                        // 已连接的CDC设备数
+    uint8_t ws_clients;                         // WebSocket客户端数
+} power_mgmt_stats_t;
+
+/**
+ * @brief 配置CPU频率和浅睡眠，创建PM锁并订阅CDC设备和WebSocket客户端事件
+ *        (在默认事件循环创建后、USB和HTTP服务器启动前调用)
+ */
+esp_err_t power_mgmt_init(void);
+
+/**
+ * @brief 收到CDC数据时调用 (USB接收回调中，不阻塞)
+ */
+void power_mgmt_data_activity(void);
+
+/**
+ * @brief 计算实际使用的WiFi省电模式 (空闲时把不省电改为每个DTIM醒来)
+ *
+ * @param profile_ps 网络配置指定的省电模式
+ */
+wifi_ps_type_t power_mgmt_wifi_ps(wifi_ps_type_t profile_ps);
+
+/**
+ * @brief 获取当前状态和各状态的累计时间
+ */
+void power_mgmt_get_stats(power_mgmt_stats_t *stats);
+
+/**
+ * @brief 获取状态名
+ */
+const char *power_state_name(power_state_t state);
+
+/**
+ * @brief 输出电源管理配置和状态的JSON字段 (调用者负责外层对象)
+ */
+void power_mgmt_write_json(json_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* POWER_MGMT_H */
@@ -0,0 +1,153 @@
+/*
+ * @Description: CDC数据流压缩编码实现
+ *
+ * 使用LZ4块格式的贪婪匹配压缩，哈希表静态分配，不需要动态内存。
+ * 重复性高的数值遥测数据通常可以压缩到原来的1/3以下，以少量CPU换取WiFi空口时间。
+ * 客户端可以使用任意标准LZ4块解码器解码。
+ */
+
+#include <string.h>
+#include "stream_codec.h"
+
+// LZ4块格式常量
+#define LZ4_MIN_MATCH       4
+#define LZ4_LAST_LITERALS   5       // 最后5个字节必须为字面量
+#define LZ4_MF_LIMIT        12      // 最后一个匹配必须在结尾12字节之前开始
+#define LZ4_MAX_OFFSET      65535
+#define LZ4_HASH_LOG        10
+
+// 哈希表 (只在WebSocket发送任务中使用)
+static uint16_t s_hash_table[1 << LZ4_HASH_LOG];
+static stream_codec_stats_t s_stats;
+
+static inline uint32_t codec_read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t codec_hash(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - LZ4_HASH_LOG);
+}
+
+// 写入扩展长度 (每字节255，直到最后一个字节小于255)
+static inline uint8_t *codec_write_len(uint8_t *op, size_t len)
+{
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+// 写入一个序列: token + 字面量 + 偏移 + 匹配长度，空间不足返回NULL
+static uint8_t *codec_write_sequence(uint8_t *op, const uint8_t *op_end,
+                                     const uint8_t *lit, size_t lit_len,
+                                     size_t offset, size_t match_len)
+{
+    size_t need = 1 + lit_len + lit_len / 255 + 1 + (match_len ? 2 + match_len / 255 + 1 : 0);
+    if ((size_t)(op_end - op) < need) {
+        return NULL;
+    }
+
+    uint8_t *token = op++;
+    *token = (lit_len >= 15 ? 15 : lit_len) << 4;
+    if (lit_len >= 15) {
+        op = codec_write_len(op, lit_len - 15);
+    }
+    memcpy(op, lit, lit_len);
+    op += lit_len;
+
+    if (match_len) {
+        *op++ = offset & 0xFF;
+        *op++ = offset >> 8;
+        size_t ml = match_len - LZ4_MIN_MATCH;
+        *token |= ml >= 15 ? 15 : ml;
+        if (ml >= 15) {
+            op = codec_write_len(op, ml - 15);
+        }
+    }
+    return op;
+}
+
+// LZ4块压缩，输出不超过cap时返回压缩后长度，否则返回0
+static size_t codec_lz4_compress(const uint8_t *src, size_t len, uint8_t *dst, size_t cap)
+{
+    const uint8_t *ip = src;
+    const uint8_t *anchor = src;
+    const uint8_t *end = src + len;
+    uint8_t *op = dst;
+    const uint8_t *op_end = dst + cap;
+
+    if (len > LZ4_MF_LIMIT) {
+        const uint8_t *mf_limit = end - LZ4_MF_LIMIT;
+        const uint8_t *match_limit = end - LZ4_LAST_LITERALS;
+        memset(s_hash_table, 0, sizeof(s_hash_table));
+
+        while (ip < mf_limit) {
+            uint32_t seq = codec_read32(ip);
+            uint32_t h = codec_hash(seq);
+            const uint8_t *ref = src + s_hash_table[h];
+            s_hash_table[h] = (uint16_t)(ip - src);
+
+            if (ref >= ip || ip - ref > LZ4_MAX_OFFSET || codec_read32(ref) != seq) {
+                ip++;
+                continue;
+            }
+
+            size_t match_len = LZ4_MIN_MATCH;
+            while (ip + match_len < match_limit && ref[match_len] == ip[match_len]) {
+                match_len++;
+            }
+
+            op = codec_write_sequence(op, op_end, anchor, ip - anchor, ip - ref, match_len);
+            if (!op) {
+                return 0;
+            }
+            ip += match_len;
+            anchor = ip;
+        }
+    }
+
+    // 剩余数据作为最后的字面量
+    op = codec_write_sequence(op, op_end, anchor, end - anchor, 0, 0);
+    return op ? (size_t)(op - dst) : 0;
+}
+
+size_t stream_codec_encode(const uint8_t *src, size_t len, bool is_text, uint8_t *dst, size_t cap)
+{
+    if (!src || !dst || len > STREAM_CODEC_MAX_INPUT || cap < STREAM_CODEC_HDR_LEN + len) {
+        return 0;
+    }
+
+    uint8_t text_flag = is_text ? STREAM_CODEC_FLAG_TEXT : 0;
+    dst[1] = len & 0xFF;
+    dst[2] = len >> 8;
+
+    // 压缩结果必须比原始数据小，否则按原样存放
+    size_t out = codec_lz4_compress(src, len, dst + STREAM_CODEC_HDR_LEN, len > 0 ? len - 1 : 0);
+    if (out > 0) {
+        dst[0] = STREAM_CODEC_LZ4 | text_flag;
+    } else {
+        dst[0] = STREAM_CODEC_STORED | text_flag;
+        memcpy(dst + STREAM_CODEC_HDR_LEN, src, len);
+        out = len;
+        s_stats.stored++;
+    }
+    out += STREAM_CODEC_HDR_LEN;
+
+    s_stats.blocks++;
+    s_stats.bytes_in += len;
+    s_stats.bytes_out += out;
+    return out;
+}
+
+void stream_codec_get_stats(stream_codec_stats_t *stats)
+{
+    if (stats) {
+        *stats = s_stats;
+    }
+}
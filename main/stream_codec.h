@@ -0,0 +1,65 @@
+/*
+ * @Description: CDC数据流压缩编码头文件
+ */
+
+#ifndef STREAM_CODEC_H
+#define STREAM_CODEC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 编码后的消息格式 (WebSocket二进制帧):
+ *   byte 0     : 低4位为编码方式 (STREAM_CODEC_STORED/STREAM_CODEC_LZ4)，
+ *                bit7置位表示原始数据为文本
+ *   byte 1..2  : 原始数据长度 (小端)
+ *   byte 3..   : STORED为原始数据，LZ4为LZ4块格式 (不含帧头)
+ */
+#define STREAM_CODEC_STORED         0x00
+#define STREAM_CODEC_LZ4            0x01
+#define STREAM_CODEC_FLAG_TEXT      0x80
+#define STREAM_CODEC_HDR_LEN        3
+
+// 单块最大输入长度
+#define STREAM_CODEC_MAX_INPUT      UINT16_MAX
+
+// 编码输出所需的最大空间
+#define STREAM_CODEC_BOUND(len)     (STREAM_CODEC_HDR_LEN + (len) + (len) / 255 + 16)
+
+// 压缩统计信息
+typedef struct {
+    uint32_t blocks;        // 编码的块数
+    uint32_t stored;        // 压缩无收益、按原样存放的块数
+    uint64_t bytes_in;      // 原始字节数
+    uint64_t bytes_out;     // 编码后字节数 (含头部)
+} stream_codec_stats_t;
+
+/**
+ * @brief 编码一块数据，压缩后不变小时按原样存放
+ *
+ * @param src 原始数据
+ * @param len 原始数据长度 (不超过STREAM_CODEC_MAX_INPUT)
+ * @param is_text 原始数据是否为文本
+ * @param dst 输出缓冲区
+ * @param cap 输出缓冲区大小 (至少STREAM_CODEC_BOUND(len))
+ * @return size_t 编码后的长度，参数错误返回0
+ */
+size_t stream_codec_encode(const uint8_t *src, size_t len, bool is_text, uint8_t *dst, size_t cap);
+
+/**
+ * @brief 获取压缩统计信息
+ *
+ * @param stats 输出的统计信息
+ */
+void stream_codec_get_stats(stream_codec_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STREAM_CODEC_H */
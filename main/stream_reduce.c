@@ -0,0 +1,147 @@
+/*
+ * @Description: CDC数据流降采样与窗口聚合实现
+ *
+ * 浏览器端无法实时绘制kHz级别的遥测数据，按客户端订阅在设备端降低数据率，
+ * 只有请求全速率的客户端才会收到全部数据。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "stream_reduce.h"
+
+// 单条记录参与解析的最大长度
+#define STREAM_REDUCE_LINE_MAX      128
+
+// 数值之间的分隔符
+static inline bool reduce_is_separator(char c)
+{
+    return c == ',' || c == ' ' || c == ';' || c == '\t';
+}
+
+esp_err_t stream_reduce_init(stream_reduce_t *r, const stream_reduce_config_t *config)
+{
+    if (!r || !config) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if ((config->mode == STREAM_REDUCE_DECIMATE && config->decimate == 0) ||
+        (config->mode == STREAM_REDUCE_AGGREGATE && config->window_ms == 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(r, 0, sizeof(stream_reduce_t));
+    r->config = *config;
+    return ESP_OK;
+}
+
+bool stream_reduce_decimate(stream_reduce_t *r)
+{
+    bool pass = (r->counter == 0);
+    if (++r->counter >= r->config.decimate) {
+        r->counter = 0;
+    }
+    return pass;
+}
+
+bool stream_reduce_window_due(const stream_reduce_t *r, int64_t now_us)
+{
+    return r->count > 0 && now_us - r->window_start_us >= (int64_t)r->config.window_ms * 1000;
+}
+
+int64_t stream_reduce_window_remaining(const stream_reduce_t *r, int64_t now_us)
+{
+    if (r->count == 0) {
+        return -1;
+    }
+    int64_t remaining = r->window_start_us + (int64_t)r->config.window_ms * 1000 - now_us;
+    return remaining > 0 ? remaining : 0;
+}
+
+void stream_reduce_feed(stream_reduce_t *r, const uint8_t *data, size_t len, int64_t timestamp_us)
+{
+    char line[STREAM_REDUCE_LINE_MAX + 1];
+    if (len > STREAM_REDUCE_LINE_MAX) {
+        len = STREAM_REDUCE_LINE_MAX;
+    }
+    memcpy(line, data, len);
+    line[len] = '\0';
+
+    if (r->count == 0) {
+        r->window_start_us = timestamp_us;
+        r->channels = 0;
+    }
+
+    // 逐个解析数值字段
+    char *p = line;
+    uint8_t ch = 0;
+    while (ch < STREAM_REDUCE_MAX_CHANNELS) {
+        while (reduce_is_separator(*p)) {
+            p++;
+        }
+        char *end;
+        float v = strtof(p, &end);
+        if (end == p) {
+            break;
+        }
+        p = end;
+
+        // 本窗口首次出现的通道
+        if (ch >= r->channels) {
+            r->sum[ch] = 0;
+            r->samples[ch] = 0;
+            r->channels = ch + 1;
+        }
+        // nan、inf和超出float范围的值 (如1e99) 不参与统计，但仍占一个通道位置
+        if (isfinite(v)) {
+            if (r->samples[ch] == 0 || v < r->min[ch]) {
+                r->min[ch] = v;
+            }
+            if (r->samples[ch] == 0 || v > r->max[ch]) {
+                r->max[ch] = v;
+            }
+            r->sum[ch] += v;
+            r->samples[ch]++;
+        }
+        ch++;
+    }
+
+    if (ch > 0) {
+        r->count++;
+    }
+}
+
+// 输出一个JSON数值数组，返回新的写入位置 (没有有效样本或累加溢出的通道输出null)
+static size_t reduce_format_array(char *out, size_t cap, size_t pos, const char *name,
+                                  const float *values, const uint32_t *samples, uint8_t n)
+{
+    pos += snprintf(out + pos, pos < cap ? cap - pos : 0, ",\"%s\":[", name);
+    for (uint8_t i = 0; i < n; i++) {
+        const char *sep = i ? "," : "";
+        if (samples[i] == 0 || !isfinite(values[i])) {
+            pos += snprintf(out + pos, pos < cap ? cap - pos : 0, "%snull", sep);
+        } else {
+            pos += snprintf(out + pos, pos < cap ? cap - pos : 0, "%s%.6g", sep, values[i]);
+        }
+    }
+    pos += snprintf(out + pos, pos < cap ? cap - pos : 0, "]");
+    return pos;
+}
+
+size_t stream_reduce_format(stream_reduce_t *r, char *out, size_t cap)
+{
+    size_t pos = snprintf(out, cap, "{\"event\":\"agg\",\"t\":%lld,\"n\":%lu",
+                          (long long)(r->window_start_us / 1000), (unsigned long)r->count);
+    pos = reduce_format_array(out, cap, pos, "min", r->min, r->samples, r->channels);
+    pos = reduce_format_array(out, cap, pos, "max", r->max, r->samples, r->channels);
+    float mean[STREAM_REDUCE_MAX_CHANNELS];
+    for (uint8_t i = 0; i < r->channels; i++) {
+        mean[i] = r->samples[i] ? r->sum[i] / r->samples[i] : 0;
+    }
+    pos = reduce_format_array(out, cap, pos, "mean", mean, r->samples, r->channels);
+    pos += snprintf(out + pos, pos < cap ? cap - pos : 0, "}");
+
+    r->count = 0;
+    r->channels = 0;
+    return pos < cap ? pos : cap - 1;
+}
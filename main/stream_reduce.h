@@ -0,0 +1,110 @@
+/*
+ * @Description: CDC数据流降采样与窗口聚合头文件
+ */
+
+#ifndef STREAM_REDUCE_H
+#define STREAM_REDUCE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 每条记录最多聚合的数值通道数
+#define STREAM_REDUCE_MAX_CHANNELS  8
+
+// 降采样方式
+typedef enum {
+    STREAM_REDUCE_NONE = 0,     // 全速率转发
+    STREAM_REDUCE_DECIMATE,     // 每N条记录转发1条
+    STREAM_REDUCE_AGGREGATE,    // 按时间窗口输出每个通道的最小值/最大值/平均值
+} stream_reduce_mode_t;
+
+// 降采样配置
+typedef struct {
+    stream_reduce_mode_t mode;
+    uint32_t decimate;          // DECIMATE: 每decimate条记录转发1条
+    uint32_t window_ms;         // AGGREGATE: 窗口长度
+} stream_reduce_config_t;
+
+// 降采样状态 (每个客户端一份)
+typedef struct {
+    stream_reduce_config_t config;
+    uint32_t counter;           // DECIMATE: 已收到的记录数
+    int64_t window_start_us;    // AGGREGATE: 当前窗口起始时间
+    uint32_t count;             // AGGREGATE: 当前窗口内的记录数
+    uint8_t channels;           // AGGREGATE: 当前窗口内出现的最大通道数
+    float min[STREAM_REDUCE_MAX_CHANNELS];
+    float max[STREAM_REDUCE_MAX_CHANNELS];
+    float sum[STREAM_REDUCE_MAX_CHANNELS];
+    uint32_t samples[STREAM_REDUCE_MAX_CHANNELS];   // 各通道的数值个数 (记录的字段数可能不同)
+} stream_reduce_t;
+
+/**
+ * @brief 初始化降采样状态
+ *
+ * @param r 降采样状态
+ * @param config 配置
+ * @return esp_err_t ESP_OK成功，ESP_ERR_INVALID_ARG配置无效
+ */
+esp_err_t stream_reduce_init(stream_reduce_t *r, const stream_reduce_config_t *config);
+
+/**
+ * @brief DECIMATE: 判断一条记录是否需要转发
+ *
+ * @param r 降采样状态
+ * @return true 转发该记录
+ */
+bool stream_reduce_decimate(stream_reduce_t *r);
+
+/**
+ * @brief AGGREGATE: 当前窗口是否已结束、需要先输出
+ *
+ * @param r 降采样状态
+ * @param now_us 当前时间或下一条记录的时间戳
+ * @return true 窗口已结束且包含数据
+ */
+bool stream_reduce_window_due(const stream_reduce_t *r, int64_t now_us);
+
+/**
+ * @brief AGGREGATE: 当前窗口剩余时间
+ *
+ * @param r 降采样状态
+ * @param now_us 当前时间
+ * @return int64_t 剩余微秒数，窗口内无数据时返回-1
+ */
+int64_t stream_reduce_window_remaining(const stream_reduce_t *r, int64_t now_us);
+
+/**
+ * @brief AGGREGATE: 将一条文本记录中的数值累加到当前窗口
+ *
+ * 数值以逗号、空格、分号或制表符分隔，第一个非数值字段之后的内容被忽略。
+ *
+ * @param r 降采样状态
+ * @param data 记录数据
+ * @param len 记录长度
+ * @param timestamp_us 记录时间戳
+ */
+void stream_reduce_feed(stream_reduce_t *r, const uint8_t *data, size_t len, int64_t timestamp_us);
+
+/**
+ * @brief AGGREGATE: 以JSON格式输出当前窗口并开始新窗口
+ *
+ * 格式: {"event":"agg","t":窗口起始毫秒,"n":记录数,"min":[..],"max":[..],"mean":[..]}
+ *
+ * @param r 降采样状态
+ * @param out 输出缓冲区
+ * @param cap 输出缓冲区大小
+ * @return size_t 输出长度
+ */
+size_t stream_reduce_format(stream_reduce_t *r, char *out, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STREAM_REDUCE_H */
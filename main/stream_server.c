@@ -0,0 +1,434 @@
+/*
+ * @Description: CDC数据原始TCP/UDP流服务器实现
+ *
+ * PC端采集工具不需要浏览器兼容的协议，绕过httpd和WebSocket分帧，
+ * 由独立任务直接从CDC环形缓冲区读取数据写入套接字。
+ * TCP和UDP各占用一个环形缓冲区读者，与WebSocket客户端互不影响。
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include "stream_server.h"
+#include "cdc_ring.h"
+#include "usbd_cdc.h"
+#include "task_config.h"
+#include "metrics.h"
+#include "latency.h"
+#include "net_profile.h"
+#include "app_event.h"
+
+#define STREAM_SERVER_PORT          CONFIG_STREAM_SERVER_PORT
+#define STREAM_UDP_PAYLOAD          CONFIG_STREAM_SERVER_UDP_PAYLOAD
+#define STREAM_UDP_TIMEOUT_US       ((int64_t)CONFIG_STREAM_SERVER_UDP_TIMEOUT_S * 1000000)
+#define STREAM_POLL_MS              10      // 无数据时的轮询间隔，决定最大附加延迟
+#define STREAM_TCP_MAX_SLICE        4096    // 每次发送的最大切片长度
+#define STREAM_RX_BUF_SIZE          512
+
+static const char *TAG = "stream_server";
+
+// 单个传输方向的发送状态
+typedef struct {
+    int reader;                 // 环形缓冲区读者，-1表示未连接
+    bool mux;                   // 订阅了多个设备 (TCP每段数据前加stream_tcp_hdr_t)
+    uint8_t dev;                // 订阅单个设备时的设备编号，也是命令的目标设备
+    cdc_ring_slice_t slice;     // 正在发送的切片
+    bool busy;                  // slice有效
+    size_t offset;              // 切片中已发送的字节数 (TCP多设备时包含段头)
+} stream_tx_t;
+
+static struct {
+    int listen_fd;
+    int tcp_fd;
+    int udp_fd;
+    stream_tx_t tcp;
+    stream_tx_t udp;
+    struct sockaddr_in udp_peer;
+    int64_t udp_last_rx_us;     // 最后一次收到UDP客户端数据报的时间
+    uint32_t udp_seq;
+    TaskHandle_t task_handle;
+    stream_server_stats_t stats;
+    int dev;                    // 新连接转发的设备，STREAM_DEV_ALL表示全部
+} s_srv = {
+    .listen_fd = -1,
+    .tcp_fd = -1,
+    .udp_fd = -1,
+    .tcp = { .reader = -1 },
+    .udp = { .reader = -1 },
+    .dev = STREAM_DEV_ALL,
+};
+
+// 接收缓冲区和UDP发送缓冲区 (只在服务器任务中使用)
+static uint8_t s_rx_buf[STREAM_RX_BUF_SIZE];
+static uint8_t s_udp_buf[sizeof(stream_udp_hdr_t) + STREAM_UDP_PAYLOAD];
+
+// 打开发送方向 (注册环形缓冲区读者)
+static bool stream_tx_open(stream_tx_t *tx)
+{
+    int dev = __atomic_load_n(&s_srv.dev, __ATOMIC_RELAXED);
+    uint32_t devices = dev == STREAM_DEV_ALL ? CDC_RING_DEV_ALL : CDC_RING_DEV_MASK(dev);
+    tx->reader = cdc_ring_reader_open(devices);
+    tx->mux = (devices & (devices - 1)) != 0;
+    tx->dev = dev == STREAM_DEV_ALL ? 0 : (uint8_t)dev;
+    tx->busy = false;
+    tx->offset = 0;
+    return tx->reader >= 0;
+}
+
+// 关闭发送方向，释放未发送完的切片
+static void stream_tx_close(stream_tx_t *tx)
+{
+    if (tx->reader >= 0) {
+        cdc_ring_reader_close(tx->reader);
+    }
+    tx->reader = -1;
+    tx->busy = false;
+    tx->offset = 0;
+}
+
+// 取下一段待发送数据，返回false表示没有数据
+static bool stream_tx_next(stream_tx_t *tx, size_t max_bytes)
+{
+    if (tx->busy) {
+        return true;
+    }
+
+    uint32_t lost = cdc_ring_reader_take_lost(tx->reader);
+    if (lost > 0) {
+        s_srv.stats.records_lost += lost;
+        ESP_LOGW(TAG, "发送过慢，丢失%"PRIu32"条记录", lost);
+    }
+
+    if (!cdc_ring_peek(tx->reader, &tx->slice, max_bytes)) {
+        return false;
+    }
+    tx->busy = true;
+    tx->offset = 0;
+    return true;
+}
+
+// 当前切片已全部发送
+static void stream_tx_done(stream_tx_t *tx)
+{
+    latency_record(LATENCY_USB_TO_RAW, esp_timer_get_time() - tx->slice.timestamp_us);
+    cdc_ring_consume(tx->reader, &tx->slice);
+    tx->busy = false;
+    tx->offset = 0;
+}
+
+// 将收到的数据转发给该连接对应的CDC设备
+static void stream_forward_to_cdc(const stream_tx_t *tx, const uint8_t *data, size_t len)
+{
+    if (len == 0) {
+        return;
+    }
+    esp_err_t ret = usbd_cdc_send_data(tx->dev, data, len);
+    if (ret == ESP_OK) {
+        s_srv.stats.commands++;
+    } else {
+        ESP_LOGW(TAG, "转发到CDC设备失败: %s", esp_err_to_name(ret));
+    }
+}
+
+// 创建并绑定套接字
+static int stream_open_socket(int type)
+{
+    int fd = socket(AF_INET, type, type == SOCK_STREAM ? IPPROTO_TCP : IPPROTO_UDP);
+    if (fd < 0) {
+        ESP_LOGE(TAG, "创建套接字失败: errno %d", errno);
+        return -1;
+    }
+
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(STREAM_SERVER_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        (type == SOCK_STREAM && listen(fd, 1) != 0)) {
+        ESP_LOGE(TAG, "绑定端口%d失败: errno %d", STREAM_SERVER_PORT, errno);
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+// 关闭TCP客户端
+static void stream_tcp_close(void)
+{
+    if (s_srv.tcp_fd >= 0) {
+        close(s_srv.tcp_fd);
+        ESP_LOGI(TAG, "TCP客户端已断开");
+    }
+    s_srv.tcp_fd = -1;
+    stream_tx_close(&s_srv.tcp);
+    s_srv.stats.tcp_connected = false;
+}
+
+// 接受新的TCP连接，替换已有的连接
+static void stream_tcp_accept(void)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int fd = accept(s_srv.listen_fd, (struct sockaddr *)&addr, &addr_len);
+    if (fd < 0) {
+        return;
+    }
+
+    stream_tcp_close();
+    if (!stream_tx_open(&s_srv.tcp)) {
+        ESP_LOGW(TAG, "环形缓冲区读者已满，拒绝TCP连接");
+        close(fd);
+        return;
+    }
+
+    net_profile_apply_socket(fd);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    s_srv.tcp_fd = fd;
+    s_srv.stats.tcp_connected = true;
+    s_srv.stats.tcp_sessions++;
+    ESP_LOGI(TAG, "TCP客户端已连接: %s", inet_ntoa(addr.sin_addr));
+}
+
+// 读取TCP客户端发来的命令
+static void stream_tcp_receive(void)
+{
+    int len = recv(s_srv.tcp_fd, s_rx_buf, sizeof(s_rx_buf), 0);
+    if (len > 0) {
+        stream_forward_to_cdc(&s_srv.tcp, s_rx_buf, len);
+    } else if (len == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+        stream_tcp_close();
+    }
+}
+
+// 尽量发送TCP数据，直到没有数据或套接字不可写
+static void stream_tcp_flush(void)
+{
+    while (s_srv.tcp_fd >= 0 && stream_tx_next(&s_srv.tcp, STREAM_TCP_MAX_SLICE)) {
+        stream_tx_t *tx = &s_srv.tcp;
+        size_t hdr_len = tx->mux ? sizeof(stream_tcp_hdr_t) : 0;
+        size_t total = hdr_len + tx->slice.len;
+        int sent;
+        if (tx->offset < hdr_len) {
+            // 段头与数据一起发送，发送部分段头时下次从剩余的段头开始
+            stream_tcp_hdr_t hdr = {
+                .dev = tx->slice.dev,
+                .flags = (uint8_t)tx->slice.flags,
+                .len = (uint16_t)tx->slice.len,
+            };
+            struct iovec iov[2] = {
+                { .iov_base = (uint8_t *)&hdr + tx->offset, .iov_len = hdr_len - tx->offset },
+                { .iov_base = (void *)tx->slice.data, .iov_len = tx->slice.len },
+            };
+            struct msghdr msg = { .msg_iov = iov, .msg_iovlen = 2 };
+            sent = sendmsg(s_srv.tcp_fd, &msg, MSG_DONTWAIT);
+        } else {
+            sent = send(s_srv.tcp_fd, tx->slice.data + (tx->offset - hdr_len), total - tx->offset, MSG_DONTWAIT);
+        }
+        if (sent < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                ESP_LOGW(TAG, "TCP发送失败: errno %d", errno);
+                stream_tcp_close();
+            }
+            return;
+        }
+        s_srv.stats.tcp_bytes += sent;
+        metrics_add(METRIC_RAW_SENT_BYTES, sent);
+        tx->offset += sent;
+        if (tx->offset < total) {
+            return;
+        }
+        stream_tx_done(tx);
+    }
+}
+
+// 读取UDP客户端数据报，第一个数据报注册客户端地址
+static void stream_udp_receive(void)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int len = recvfrom(s_srv.udp_fd, s_rx_buf, sizeof(s_rx_buf), 0, (struct sockaddr *)&addr, &addr_len);
+    if (len < 0) {
+        return;
+    }
+
+    if (s_srv.udp.reader < 0 || addr.sin_addr.s_addr != s_srv.udp_peer.sin_addr.s_addr ||
+        addr.sin_port != s_srv.udp_peer.sin_port) {
+        // 新的UDP客户端替换旧的客户端，从最新数据开始发送
+        stream_tx_close(&s_srv.udp);
+        if (!stream_tx_open(&s_srv.udp)) {
+            ESP_LOGW(TAG, "环形缓冲区读者已满，忽略UDP客户端");
+            return;
+        }
+        s_srv.udp_peer = addr;
+        s_srv.udp_seq = 0;
+        s_srv.stats.udp_active = true;
+        ESP_LOGI(TAG, "UDP客户端已注册: %s:%d", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+    }
+    s_srv.udp_last_rx_us = esp_timer_get_time();
+    stream_forward_to_cdc(&s_srv.udp, s_rx_buf, len);
+}
+
+// 发送UDP数据报，切片超过负载长度时分片发送
+static void stream_udp_flush(void)
+{
+    if (s_srv.udp.reader < 0) {
+        return;
+    }
+    if (esp_timer_get_time() - s_srv.udp_last_rx_us > STREAM_UDP_TIMEOUT_US) {
+        ESP_LOGI(TAG, "UDP客户端超时");
+        stream_tx_close(&s_srv.udp);
+        s_srv.stats.udp_active = false;
+        return;
+    }
+
+    stream_tx_t *tx = &s_srv.udp;
+    while (stream_tx_next(tx, STREAM_UDP_PAYLOAD)) {
+        size_t len = tx->slice.len - tx->offset;
+        if (len > STREAM_UDP_PAYLOAD) {
+            len = STREAM_UDP_PAYLOAD;
+        }
+
+        stream_udp_hdr_t hdr = {
+            .seq = s_srv.udp_seq,
+            .record_seq = tx->slice.first_seq,
+            .offset = (uint16_t)tx->offset,
+            .flags = (tx->offset + len == tx->slice.len) ? STREAM_UDP_FLAG_END : 0,
+            .dev = tx->slice.dev,
+        };
+        memcpy(s_udp_buf, &hdr, sizeof(hdr));
+        memcpy(s_udp_buf + sizeof(hdr), tx->slice.data + tx->offset, len);
+
+        // 协议栈缓冲区不足时保留切片，下次轮询重试
+        if (sendto(s_srv.udp_fd, s_udp_buf, sizeof(hdr) + len, 0,
+                   (struct sockaddr *)&s_srv.udp_peer, sizeof(s_srv.udp_peer)) < 0) {
+            return;
+        }
+        s_srv.udp_seq++;
+        s_srv.stats.udp_datagrams++;
+        s_srv.stats.udp_bytes += len;
+        metrics_add(METRIC_RAW_SENT_BYTES, len);
+        tx->offset += len;
+        if (tx->offset == tx->slice.len) {
+            stream_tx_done(tx);
+        }
+    }
+}
+
+// 网络配置切换后更新已连接的TCP客户端 (在事件循环任务中；套接字此时已关闭时setsockopt只是失败)
+static void stream_on_profile_changed(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    int fd = __atomic_load_n(&s_srv.tcp_fd, __ATOMIC_RELAXED);
+    if (fd >= 0) {
+        net_profile_apply_socket(fd);
+    }
+}
+
+// 流服务器任务
+static void stream_server_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "流服务器已启动，TCP/UDP端口%d", STREAM_SERVER_PORT);
+
+    while (1) {
+        fd_set rfds, wfds;
+        FD_ZERO(&rfds);
+        FD_ZERO(&wfds);
+        FD_SET(s_srv.listen_fd, &rfds);
+        FD_SET(s_srv.udp_fd, &rfds);
+        int max_fd = s_srv.listen_fd > s_srv.udp_fd ? s_srv.listen_fd : s_srv.udp_fd;
+
+        if (s_srv.tcp_fd >= 0) {
+            FD_SET(s_srv.tcp_fd, &rfds);
+            // 有未发送的数据时等待可写，否则按轮询间隔检查新数据
+            if (s_srv.tcp.busy || cdc_ring_pending(s_srv.tcp.reader, NULL, NULL) > 0) {
+                FD_SET(s_srv.tcp_fd, &wfds);
+            }
+            if (s_srv.tcp_fd > max_fd) {
+                max_fd = s_srv.tcp_fd;
+            }
+        }
+
+        // 没有TCP客户端和UDP对端时没有数据要发，只等待新连接，不再轮询
+        struct timeval tv = { .tv_sec = 0, .tv_usec = STREAM_POLL_MS * 1000 };
+        bool idle = s_srv.tcp_fd < 0 && s_srv.udp.reader < 0;
+        if (select(max_fd + 1, &rfds, &wfds, NULL, idle ? NULL : &tv) < 0) {
+            vTaskDelay(pdMS_TO_TICKS(STREAM_POLL_MS));
+            continue;
+        }
+
+        if (FD_ISSET(s_srv.listen_fd, &rfds)) {
+            stream_tcp_accept();
+        }
+        if (s_srv.tcp_fd >= 0 && FD_ISSET(s_srv.tcp_fd, &rfds)) {
+            stream_tcp_receive();
+        }
+        if (FD_ISSET(s_srv.udp_fd, &rfds)) {
+            stream_udp_receive();
+        }
+
+        stream_tcp_flush();
+        stream_udp_flush();
+    }
+}
+
+esp_err_t stream_server_start(void)
+{
+    if (s_srv.task_handle != NULL) {
+        return ESP_OK;
+    }
+
+    s_srv.listen_fd = stream_open_socket(SOCK_STREAM);
+    s_srv.udp_fd = stream_open_socket(SOCK_DGRAM);
+    if (s_srv.listen_fd < 0 || s_srv.udp_fd < 0) {
+        if (s_srv.listen_fd >= 0) {
+            close(s_srv.listen_fd);
+        }
+        if (s_srv.udp_fd >= 0) {
+            close(s_srv.udp_fd);
+        }
+        s_srv.listen_fd = -1;
+        s_srv.udp_fd = -1;
+        return ESP_FAIL;
+    }
+
+    esp_event_handler_instance_register(APP_EVENT, APP_EVENT_NET_PROFILE_CHANGED,
+                                        stream_on_profile_changed, NULL, NULL);
+
+    BaseType_t task_created = task_config_create(TASK_CFG_STREAM_SERVER, stream_server_task, NULL, &s_srv.task_handle);
+    if (task_created != pdPASS) {
+        ESP_LOGE(TAG, "创建流服务器任务失败");
+        close(s_srv.listen_fd);
+        close(s_srv.udp_fd);
+        s_srv.listen_fd = -1;
+        s_srv.udp_fd = -1;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t stream_server_set_device(int dev)
+{
+    if (dev != STREAM_DEV_ALL && (dev < 0 || dev >= CDC_RING_DEVICES)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    __atomic_store_n(&s_srv.dev, dev, __ATOMIC_RELAXED);
+    return ESP_OK;
+}
+
+void stream_server_get_stats(stream_server_stats_t *stats)
+{
+    if (stats) {
+        *stats = s_srv.stats;
+        stats->dev = __atomic_load_n(&s_srv.dev, __ATOMIC_RELAXED);
+    }
+}
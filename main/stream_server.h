@@ -0,0 +1,87 @@
+/*
+ * @Description: CDC数据原始TCP/UDP流服务器头文件
+ */
+
+#ifndef STREAM_SERVER_H
+#define STREAM_SERVER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * TCP: 连接后直接收到CDC原始字节流，发送到该连接的数据原样转发给CDC设备。
+ *      同时只服务一个TCP客户端，新连接会替换旧连接。
+ * UDP: 向端口发送任意数据报 (可为空) 即完成注册，之后持续收到带序号的数据报;
+ *      非空数据报的内容转发给CDC设备。超过CONFIG_STREAM_SERVER_UDP_TIMEOUT_S
+ *      未收到客户端的数据报则停止发送。
+ *
+ * UDP数据报格式: stream_udp_hdr_t + 数据
+ *
+ * 多设备: 默认转发所有设备的数据，命令发往设备0；stream_server_set_device()
+ * 可以只转发一个设备并把命令发往该设备 (对之后的连接生效)。转发多个设备时
+ * TCP流中每段数据前加stream_tcp_hdr_t，UDP数据报头中带设备编号。
+ */
+#define STREAM_UDP_FLAG_END     (1 << 0)   // 切片的最后一个分片
+#define STREAM_DEV_ALL          (-1)
+
+// UDP数据报头 (小端)
+typedef struct __attribute__((packed)) {
+    uint32_t seq;               // 数据报序号，用于检测丢包和乱序
+    uint32_t record_seq;        // 切片中第一条CDC记录的序号 (按设备编号)，用于检测环形缓冲区覆盖
+    uint16_t offset;            // 分片在切片中的字节偏移
+    uint8_t flags;              // STREAM_UDP_FLAG_*
+    uint8_t dev;                // 设备编号
+} stream_udp_hdr_t;
+
+// 转发多个设备时TCP流中每段数据的头 (小端)
+typedef struct __attribute__((packed)) {
+    uint8_t dev;                // 设备编号
+    uint8_t flags;              // 记录标志 (CDC_RING_FLAG_*)
+    uint16_t len;               // 之后的数据长度
+} stream_tcp_hdr_t;
+
+// 流服务器统计信息
+typedef struct {
+    bool tcp_connected;
+    bool udp_active;
+    uint32_t tcp_sessions;      // 累计TCP连接数
+    uint64_t tcp_bytes;         // TCP发送字节数
+    uint32_t udp_datagrams;     // UDP发送数据报数
+    uint64_t udp_bytes;         // UDP发送字节数 (不含报头)
+    uint32_t records_lost;      // 因发送过慢被覆盖的记录数
+    uint32_t commands;          // 转发给CDC设备的命令数
+    int dev;                    // 转发的设备，STREAM_DEV_ALL表示全部
+} stream_server_stats_t;
+
+/**
+ * @brief 启动流服务器任务，在CONFIG_STREAM_SERVER_PORT上监听TCP和UDP
+ *
+ * @return esp_err_t ESP_OK成功，其他失败
+ */
+esp_err_t stream_server_start(void);
+
+/**
+ * @brief 选择转发的设备，对之后建立的TCP连接和注册的UDP客户端生效
+ *
+ * @param dev 设备编号，STREAM_DEV_ALL表示全部设备
+ * @return esp_err_t ESP_OK成功，ESP_ERR_INVALID_ARG设备编号无效
+ */
+esp_err_t stream_server_set_device(int dev);
+
+/**
+ * @brief 获取流服务器统计信息
+ *
+ * @param stats 输出的统计信息
+ */
+void stream_server_get_stats(stream_server_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STREAM_SERVER_H */
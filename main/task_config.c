@@ -0,0 +1,134 @@
+/*
+ * @Description: 任务核心亲和性、优先级与栈大小配置表实现
+ *
+ * ESP32-S3为双核，USB Host和CDC转发链路绑定到一个核心，WiFi/lwIP及
+ * 网络相关任务绑定到另一个核心，避免两者在同一核心上相互抢占。
+ * 所有参数来自Kconfig ("Task Affinity and Priority")。
+ */
+
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "task_config.h"
+
+static const char *TAG = "task_config";
+
+// Kconfig中-1表示不绑定核心，单核系统总是不绑定
+#if CONFIG_FREERTOS_UNICORE
+#define TASK_CORE(core)     tskNO_AFFINITY
+#else
+#define TASK_CORE(core)     ((core) < 0 ? tskNO_AFFINITY : (BaseType_t)(core))
+#endif
+
+#define TASK_CORE_USB       TASK_CORE(CONFIG_TASK_USB_CORE)
+#define TASK_CORE_NET       TASK_CORE(CONFIG_TASK_NET_CORE)
+
+// WiFi驱动任务所在核心 (由WiFi组件配置决定)
+#ifdef CONFIG_ESP_WIFI_TASK_PINNED_TO_CORE_1
+#define TASK_WIFI_CORE      1
+#else
+#define TASK_WIFI_CORE      0
+#endif
+
+static const task_config_t s_task_table[TASK_CFG_MAX] = {
+    // USB Host与CDC转发链路
+    [TASK_CFG_USB_LIB] = {
+        "usb_lib", CONFIG_TASK_USB_LIB_STACK, CONFIG_TASK_USB_LIB_PRIORITY, TASK_CORE_USB
+    },
+    [TASK_CFG_USB_CDC_HOST] = {
+        "usb_cdc_host", CONFIG_TASK_USB_CDC_HOST_STACK, CONFIG_TASK_USB_CDC_HOST_PRIORITY, TASK_CORE_USB
+    },
+    [TASK_CFG_CDC_ACM_DRIVER] = {
+        "USB-CDC", CONFIG_TASK_CDC_ACM_DRIVER_STACK, CONFIG_TASK_CDC_ACM_DRIVER_PRIORITY, TASK_CORE_USB
+    },
+    [TASK_CFG_USB_CDC_TX] = {
+        "usb_cdc_tx", CONFIG_TASK_USB_CDC_TX_STACK, CONFIG_TASK_USB_CDC_TX_PRIORITY, TASK_CORE_USB
+    },
+    [TASK_CFG_DATA_LOGGER] = {
+        "data_logger", CONFIG_TASK_DATA_LOGGER_STACK, CONFIG_TASK_DATA_LOGGER_PRIORITY, TASK_CORE_USB
+    },
+    // 网络相关任务
+    [TASK_CFG_WS_SEND] = {
+        "ws_send_task", CONFIG_TASK_WS_SEND_STACK, CONFIG_TASK_WS_SEND_PRIORITY, TASK_CORE_NET
+    },
+    [TASK_CFG_HTTPD] = {
+        "httpd", CONFIG_TASK_HTTPD_STACK, CONFIG_TASK_HTTPD_PRIORITY, TASK_CORE_NET
+    },
+    [TASK_CFG_STREAM_SERVER] = {
+        "stream_server", CONFIG_TASK_STREAM_SERVER_STACK, CONFIG_TASK_STREAM_SERVER_PRIORITY, TASK_CORE_NET
+    },
+    [TASK_CFG_WIFI_AUTO_CONNECT] = {
+        "wifi_auto_connect", CONFIG_TASK_WIFI_AUTO_CONNECT_STACK, CONFIG_TASK_WIFI_AUTO_CONNECT_PRIORITY, TASK_CORE_NET
+    },
+    [TASK_CFG_BOOT_WIFI] = {
+        "boot_wifi", CONFIG_TASK_BOOT_WIFI_STACK, CONFIG_TASK_BOOT_WIFI_PRIORITY, TASK_CORE_NET
+    },
+    [TASK_CFG_WIFI_HISTORY_SAVE] = {
+        "wifi_hist_save", CONFIG_TASK_WIFI_HISTORY_SAVE_STACK, CONFIG_TASK_WIFI_HISTORY_SAVE_PRIORITY, TASK_CORE_NET
+    },
+};
+
+// 已创建的任务句柄
+static TaskHandle_t s_task_handles[TASK_CFG_MAX];
+
+const task_config_t *task_config_get(task_cfg_id_t id)
+{
+    if (id >= TASK_CFG_MAX) {
+        return NULL;
+    }
+    return &s_task_table[id];
+}
+
+BaseType_t task_config_create(task_cfg_id_t id, TaskFunction_t fn, void *arg, TaskHandle_t *handle)
+{
+    const task_config_t *cfg = task_config_get(id);
+    if (!cfg) {
+        return pdFAIL;
+    }
+    TaskHandle_t task = NULL;
+    BaseType_t ret = xTaskCreatePinnedToCore(fn, cfg->name, cfg->stack_size, arg, cfg->priority, &task, cfg->core);
+    if (ret == pdPASS) {
+        s_task_handles[id] = task;
+        if (handle) {
+            *handle = task;
+        }
+    }
+    return ret;
+}
+
+TaskHandle_t task_config_handle(task_cfg_id_t id)
+{
+    const task_config_t *cfg = task_config_get(id);
+    if (!cfg) {
+        return NULL;
+    }
+    // 组件内部创建的任务 (httpd、CDC-ACM驱动) 或已退出后重建的任务按名称查找
+    return s_task_handles[id] ? s_task_handles[id] : xTaskGetHandle(cfg->name);
+}
+
+// 核心编号的显示名称
+static const char *task_core_name(BaseType_t core)
+{
+    if (core == tskNO_AFFINITY) {
+        return "any";
+    }
+    return core == 0 ? "0" : "1";
+}
+
+void task_config_log_plan(void)
+{
+    ESP_LOGI(TAG, "任务分配方案: USB核心=%s, 网络核心=%s",
+             task_core_name(TASK_CORE_USB), task_core_name(TASK_CORE_NET));
+    ESP_LOGI(TAG, "  %-18s %-5s %-5s %s", "任务", "核心", "优先级", "栈");
+    for (int i = 0; i < TASK_CFG_MAX; i++) {
+        const task_config_t *cfg = &s_task_table[i];
+        ESP_LOGI(TAG, "  %-18s %-5s %-5u %lu", cfg->name, task_core_name(cfg->core),
+                 (unsigned)cfg->priority, (unsigned long)cfg->stack_size);
+    }
+    ESP_LOGI(TAG, "  %-18s %-5s", "wifi", task_core_name(TASK_WIFI_CORE));
+    ESP_LOGI(TAG, "  %-18s %-5s %-5d %d", "tiT (lwIP)", task_core_name(CONFIG_LWIP_TCPIP_TASK_AFFINITY),
+             CONFIG_LWIP_TCPIP_TASK_PRIO, CONFIG_LWIP_TCPIP_TASK_STACK_SIZE);
+
+    if (TASK_CORE_USB != tskNO_AFFINITY && TASK_CORE_USB == TASK_WIFI_CORE) {
+        ESP_LOGW(TAG, "USB任务与WiFi驱动位于同一核心，高数据率时可能相互抢占");
+    }
+}
@@ -0,0 +1,76 @@
+/*
+ * @Description: 任务核心亲和性、优先级与栈大小配置表头文件
+ */
+
+#ifndef TASK_CONFIG_H
+#define TASK_CONFIG_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 应用任务编号
+typedef enum {
+    TASK_CFG_USB_LIB = 0,
+    TASK_CFG_USB_CDC_HOST,
+    TASK_CFG_CDC_ACM_DRIVER,    // 由CDC-ACM驱动创建 (任务名USB-CDC)，只提供参数
+    TASK_CFG_USB_CDC_TX,
+    TASK_CFG_DATA_LOGGER,
+    TASK_CFG_WS_SEND,
+    TASK_CFG_HTTPD,             // 由httpd创建，只提供参数
+    TASK_CFG_STREAM_SERVER,
+    TASK_CFG_WIFI_AUTO_CONNECT,
+    TASK_CFG_BOOT_WIFI,         // 启动时初始化WiFi，完成后退出
+    TASK_CFG_WIFI_HISTORY_SAVE,
+    TASK_CFG_MAX,
+} task_cfg_id_t;
+
+// 单个任务的配置
+typedef struct {
+    const char *name;
+    uint32_t stack_size;
+    UBaseType_t priority;
+    BaseType_t core;            // 核心编号，tskNO_AFFINITY表示不绑定
+} task_config_t;
+
+/**
+ * @brief 获取任务配置
+ *
+ * @param id 任务编号
+ * @return const task_config_t* 任务配置
+ */
+const task_config_t *task_config_get(task_cfg_id_t id);
+
+/**
+ * @brief 按配置表创建任务并绑定核心
+ *
+ * @param id 任务编号
+ * @param fn 任务函数
+ * @param arg 任务参数
+ * @param handle 输出的任务句柄 (可为NULL)
+ * @return BaseType_t pdPASS成功
+ */
+BaseType_t task_config_create(task_cfg_id_t id, TaskFunction_t fn, void *arg, TaskHandle_t *handle);
+
+/**
+ * @brief 获取任务句柄 (由组件自行创建的任务按名称查找)
+ *
+ * @param id 任务编号
+ * @return TaskHandle_t 任务句柄，任务不存在时返回NULL
+ */
+TaskHandle_t task_config_handle(task_cfg_id_t id);
+
+/**
+ * @brief 打印生效的任务分配方案 (包括WiFi和lwIP任务所在核心)
+ */
+void task_config_log_plan(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TASK_CONFIG_H */
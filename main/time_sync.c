@@ -0,0 +1,101 @@
+/*
+ * @Description: SNTP时间同步实现
+ */
+
+#include <inttypes.h>
+#include <sys/time.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_sntp.h"
+#include "freertos/FreeRTOS.h"
+#include "time_sync.h"
+#include "app_event.h"
+#include "wifi_manager.h"
+
+static const char *TAG = "time_sync";
+
+static struct {
+    bool started;               // 只在事件循环任务中访问
+    bool synced;
+    int64_t offset_us;          // Unix时间 - esp_timer时间
+    int64_t last_sync_us;       // 最近一次同步的esp_timer时间
+    uint32_t syncs;
+} s_sync;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#if CONFIG_TIME_SYNC_ENABLE
+// SNTP同步完成 (在lwIP任务中调用)
+static void time_sync_notify(struct timeval *tv)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t unix_us = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+    taskENTER_CRITICAL(&s_lock);
+    int64_t step = s_sync.synced ? unix_us - now - s_sync.offset_us : 0;
+    s_sync.offset_us = unix_us - now;
+    s_sync.last_sync_us = now;
+    s_sync.synced = true;
+    uint32_t syncs = ++s_sync.syncs;
+    taskEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "时间已同步 (第%"PRIu32"次, 校正%lldus)", syncs, (long long)step);
+}
+
+// 第一次获取IP时启动SNTP，之后由SNTP按周期自行同步
+static void time_sync_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    const wifi_status_event_t *status = event_data;
+    if (event_id != APP_EVENT_WIFI_STATUS || status->change != WIFI_STATUS_GOT_IP || s_sync.started) {
+        return;
+    }
+    s_sync.started = true;
+    esp_sntp_setoperatingmode(ESP_SNTP_OPMODE_POLL);
+    esp_sntp_setservername(0, CONFIG_TIME_SYNC_SERVER);
+    sntp_set_time_sync_notification_cb(time_sync_notify);
+    esp_sntp_init();
+    ESP_LOGI(TAG, "SNTP已启动: %s", CONFIG_TIME_SYNC_SERVER);
+}
+#endif /* CONFIG_TIME_SYNC_ENABLE */
+
+esp_err_t time_sync_init(void)
+{
+#if CONFIG_TIME_SYNC_ENABLE
+    return esp_event_handler_instance_register(APP_EVENT, APP_EVENT_WIFI_STATUS, time_sync_event_handler, NULL, NULL);
+#else
+    return ESP_OK;
+#endif
+}
+
+bool time_sync_is_synced(void)
+{
+    return __atomic_load_n(&s_sync.synced, __ATOMIC_RELAXED);
+}
+
+bool time_sync_unix_us(int64_t mono_us, int64_t *unix_us)
+{
+    taskENTER_CRITICAL(&s_lock);
+    bool synced = s_sync.synced;
+    int64_t offset = s_sync.offset_us;
+    taskEXIT_CRITICAL(&s_lock);
+    if (synced) {
+        *unix_us = mono_us + offset;
+    }
+    return synced;
+}
+
+void time_sync_write_json(json_writer_t *w)
+{
+    taskENTER_CRITICAL(&s_lock);
+    bool synced = s_sync.synced;
+    uint32_t syncs = s_sync.syncs;
+    int64_t last_sync_us = s_sync.last_sync_us;
+    taskEXIT_CRITICAL(&s_lock);
+
+    json_writer_bool(w, "synced", synced);
+    json_writer_uint(w, "syncs", syncs);
+    if (synced) {
+        int64_t now_unix_us = 0;
+        int64_t now = esp_timer_get_time();
+        time_sync_unix_us(now, &now_unix_us);
+        json_writer_uint(w, "last_sync_age_ms", (now - last_sync_us) / 1000);
+        json_writer_int(w, "unix_ms", now_unix_us / 1000);
+    }
+}
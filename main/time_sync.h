@@ -0,0 +1,49 @@
+/*
+ * @Description: SNTP时间同步头文件
+ *
+ * STA第一次获取IP后启动SNTP，每次同步记录系统时间与esp_timer单调时钟的差值。
+ * 数据时间戳一律用esp_timer_get_time()采集 (不受对时跳变影响)，
+ * 需要绝对时间时再用time_sync_unix_us()换算。
+ */
+
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "json_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 订阅STA状态事件，获取IP后启动SNTP (在默认事件循环创建后调用)
+ */
+esp_err_t time_sync_init(void);
+
+/**
+ * @brief 是否已至少同步过一次
+ */
+bool time_sync_is_synced(void);
+
+/**
+ * @brief 把esp_timer时间换算为Unix时间
+ *
+ * @param mono_us esp_timer_get_time()的值
+ * @param unix_us 输出的Unix时间 (微秒)
+ * @return true 已同步，false 未同步 (unix_us不变)
+ */
+bool time_sync_unix_us(int64_t mono_us, int64_t *unix_us);
+
+/**
+ * @brief 输出同步状态的JSON字段 (调用者负责外层对象)
+ */
+void time_sync_write_json(json_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TIME_SYNC_H */
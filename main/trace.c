@@ -0,0 +1,99 @@
+/*
+ * @Description: 数据通路事件跟踪实现
+ *
+ * 每个核心一个环形缓冲区，写入位置用原子加法分配，同一核心上被抢占的写入者
+ * 各自得到不同的槽位。事件结构最后写入序号，读取时序号不符的事件 (正在写入或
+ * 已被覆盖) 被跳过。
+ */
+
+#include "trace.h"
+
+#ifdef CONFIG_TRACE_ENABLE
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#define TRACE_RING_EVENTS   CONFIG_TRACE_RING_EVENTS
+#define TRACE_RING_MASK     (TRACE_RING_EVENTS - 1)
+#define TRACE_SEQ_INVALID   UINT32_MAX
+
+_Static_assert((TRACE_RING_EVENTS & TRACE_RING_MASK) == 0, "CONFIG_TRACE_RING_EVENTS必须为2的幂");
+
+typedef struct {
+    uint32_t head;              // 下一个事件序号
+    uint32_t base;              // 清空时的序号，之前的事件不再输出
+    trace_event_t events[TRACE_RING_EVENTS];
+} trace_ring_t;
+
+static trace_ring_t s_trace[portNUM_PROCESSORS];
+
+// 事件名称，与trace_event_id_t顺序一致
+static const char *const s_event_names[TRACE_EVT_MAX] = {
+    "cdc_rx",
+    "cdc_rx_discard",
+    "cdc_tx",
+    "cdc_tx_fail",
+    "ws_cdc_in",
+    "ws_binary",
+    "ws_queue_text",
+    "ws_send",
+    "ws_rx",
+};
+
+void trace_record(trace_event_id_t id, uint16_t arg, uint32_t len)
+{
+    trace_ring_t *r = &s_trace[xPortGetCoreID()];
+    uint32_t seq = __atomic_fetch_add(&r->head, 1, __ATOMIC_RELAXED);
+    trace_event_t *e = &r->events[seq & TRACE_RING_MASK];
+
+    __atomic_store_n(&e->seq, TRACE_SEQ_INVALID, __ATOMIC_RELAXED);
+    e->timestamp_us = (uint32_t)esp_timer_get_time();
+    e->id = id;
+    e->arg = arg;
+    e->len = len;
+    __atomic_store_n(&e->seq, seq, __ATOMIC_RELEASE);
+}
+
+size_t trace_snapshot(int core, trace_event_t *out, size_t max)
+{
+    if (core < 0 || core >= portNUM_PROCESSORS || !out) {
+        return 0;
+    }
+
+    trace_ring_t *r = &s_trace[core];
+    uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    uint32_t start = head - r->base > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : r->base;
+    if (head - start > max) {
+        start = head - max;
+    }
+
+    size_t n = 0;
+    for (uint32_t seq = start; seq != head; seq++) {
+        const trace_event_t *e = &r->events[seq & TRACE_RING_MASK];
+        if (__atomic_load_n(&e->seq, __ATOMIC_ACQUIRE) != seq) {
+            continue;
+        }
+        out[n] = *e;
+        // 复制期间被覆盖则丢弃
+        if (__atomic_load_n(&e->seq, __ATOMIC_ACQUIRE) == seq) {
+            n++;
+        }
+    }
+    return n;
+}
+
+void trace_clear(void)
+{
+    for (int i = 0; i < portNUM_PROCESSORS; i++) {
+        s_trace[i].base = __atomic_load_n(&s_trace[i].head, __ATOMIC_ACQUIRE);
+    }
+}
+
+const char *trace_event_name(uint16_t id)
+{
+    return id < TRACE_EVT_MAX ? s_event_names[id] : "unknown";
+}
+
+#endif /* CONFIG_TRACE_ENABLE */
@@ -0,0 +1,91 @@
+/*
+ * @Description: 数据通路事件跟踪头文件
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 数据通路上每个包都会经过的位置不再打印日志 (115200波特率的日志输出会拖慢整个
+ * 通路)，而是记录固定长度的二进制事件。每个核心一个环形缓冲区，写入无锁。
+ * 未启用CONFIG_TRACE_ENABLE时TRACE_EVENT()展开为空，不占用任何代码和内存。
+ */
+
+// 事件编号
+typedef enum {
+    TRACE_EVT_CDC_RX = 0,           // USB IN数据到达 (len=字节数)
+    TRACE_EVT_CDC_RX_DISCARD,       // 无客户端时丢弃的CDC数据
+    TRACE_EVT_CDC_TX,               // 同步发送到CDC设备 (len=字节数)
+    TRACE_EVT_CDC_TX_FAIL,          // 同步发送失败
+    TRACE_EVT_WS_CDC_IN,            // CDC数据进入分帧阶段
+    TRACE_EVT_WS_BINARY,            // 二进制数据写入环形缓冲区
+    TRACE_EVT_WS_QUEUE_TEXT,        // 文本控制消息入队 (arg=目标fd)
+    TRACE_EVT_WS_SEND,              // WebSocket帧发送成功 (arg=fd)
+    TRACE_EVT_WS_RX,                // 收到客户端数据帧 (arg=fd)
+    TRACE_EVT_MAX,
+} trace_event_id_t;
+
+// 单个事件 (16字节)
+typedef struct {
+    uint32_t seq;                   // 所在核心的事件序号，用于检测未写完的事件
+    uint32_t timestamp_us;          // esp_timer_get_time()的低32位
+    uint16_t id;                    // trace_event_id_t
+    uint16_t arg;                   // 事件参数
+    uint32_t len;                   // 数据长度
+} trace_event_t;
+
+#ifdef CONFIG_TRACE_ENABLE
+
+/**
+ * @brief 记录一个事件到当前核心的环形缓冲区 (无锁，可在任意任务中调用)
+ *
+ * @param id 事件编号
+ * @param arg 事件参数
+ * @param len 数据长度
+ */
+void trace_record(trace_event_id_t id, uint16_t arg, uint32_t len);
+
+/**
+ * @brief 按时间顺序复制一个核心的事件
+ *
+ * @param core 核心编号
+ * @param out 输出缓冲区
+ * @param max 最多复制的事件数
+ * @return size_t 复制的事件数
+ */
+size_t trace_snapshot(int core, trace_event_t *out, size_t max);
+
+/**
+ * @brief 清空所有核心的事件
+ */
+void trace_clear(void);
+
+/**
+ * @brief 获取事件名称
+ *
+ * @param id 事件编号
+ * @return const char* 名称
+ */
+const char *trace_event_name(uint16_t id);
+
+#define TRACE_EVENT(id, arg, len)   trace_record((id), (uint16_t)(arg), (uint32_t)(len))
+
+#else
+
+#define TRACE_EVENT(id, arg, len)   ((void)0)
+
+#endif /* CONFIG_TRACE_ENABLE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRACE_H */
@@ -1,84 +1,171 @@
 /*
  * @Description: USB CDC Host 虚拟串口通信实现
+ *
+ * 通过USB Hub最多同时打开USBD_CDC_MAX_DEVICES个设备，每个设备占用一个端口槽位，
+ * 槽位编号即设备编号。设备接入时分配编号最小的空闲槽位。
  */
 
 #include <stdio.h>
 #include <string.h>
+#include <inttypes.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "freertos/queue.h"
 #include "esp_log.h"
+#include "nvs.h"
 #include "usb/usb_host.h"
 #include "usb/cdc_acm_host.h"
 #include "usbd_cdc.h"
+#include "task_config.h"
+#include "trace.h"
+#include "metrics.h"
+#include "app_event.h"
+#include "boot_timeline.h"
+#include "power_mgmt.h"
 
 static const char *TAG = "usbd_cdc";
 
-// 任务配置常量
-#define CDC_HOST_TASK_PRIORITY    5
-#define CDC_HOST_TASK_STACK_SIZE  4096
-#define CDC_DEVICE_CHECK_INTERVAL_MS 500
+// 任务配置常量 (优先级、栈大小和核心见task_config)
 #define CDC_DATA_BUFFER_SIZE      1024
 
-// STM32 Virtual COM Port VID/PID
+// 默认匹配的设备: STM32 Virtual COM Port VID/PID
 #define STM32_USB_DEVICE_VID      (0x0483)
 #define STM32_USB_DEVICE_PID      (0x5740)
 
-// 串口通信参数
+// 默认串口通信参数
 #define CDC_BAUD_RATE             115200
 #define CDC_DATA_BITS             8
 #define CDC_STOP_BITS             0  // 1位停止位
 #define CDC_PARITY                0  // 无校验
 
+// 运行时配置 (NVS)
+#define CDC_NVS_NAMESPACE         "usbd_cdc"
+#define CDC_NVS_KEY_CONFIG        "config"
+#define CDC_NVS_KEY_MATCH         "match"
+#define CDC_USB_MPS               64      // 全速批量端点最大包长
+#define CDC_BUFFER_SIZE_MAX       16384
+
 // 超时和重试配置
-#define CDC_CONNECTION_TIMEOUT_MS 5000
+#define CDC_CONNECTION_TIMEOUT_MS 1000  // 设备已枚举，只需等待接口就绪
 #define CDC_TX_TIMEOUT_MS         1000
 #define CDC_MUTEX_TIMEOUT_MS      100
 #define CDC_TASK_EXIT_TIMEOUT_MS  1000
 
+// 异步发送队列配置
+#define CDC_TX_BLOCK_SIZE         CDC_DATA_BUFFER_SIZE   // 与OUT传输缓冲区一致
+#define CDC_TX_BLOCK_COUNT        CONFIG_CDC_TX_QUEUE_BLOCKS
+// 每个设备最多占用的数据块数，一个设备发送阻塞时不会占满整个数据块池
+#define CDC_TX_DEV_BLOCKS         ((CDC_TX_BLOCK_COUNT + USBD_CDC_MAX_DEVICES - 1) / USBD_CDC_MAX_DEVICES)
+
+_Static_assert(CDC_TX_BLOCK_COUNT <= 255, "TX block index must fit in uint8_t");
+
+// CDC Host任务通知位
+#define CDC_NOTIFY_NEW_DEV        (1 << 0)   // 新设备已枚举
+#define CDC_NOTIFY_DISCONNECTED   (1 << 1)   // 设备已断开，需要关闭句柄
+#define CDC_NOTIFY_FLOW           (1 << 2)   // 流控状态可能已变化
+#define CDC_NOTIFY_EXIT           (1 << 3)   // 反初始化，任务退出
+#define CDC_NOTIFY_REOPEN         (1 << 4)   // 按新参数重新打开设备
+
+// 发送队列中的一个数据块
+typedef struct {
+    uint8_t block;                  // 数据块编号
+    uint8_t dev;                    // 目标设备编号
+    uint8_t last;                   // 是否为该请求的最后一个块
+    uint16_t len;                   // 数据长度
+    uint32_t id;                    // 请求编号 (由调用者指定)
+    size_t total_len;               // 请求总长度
+    usbd_cdc_tx_done_cb_t done_cb;  // 完成回调
+    void *arg;                      // 回调参数
+} cdc_tx_item_t;
+
 // USB CDC设备状态
 typedef enum {
     CDC_DEVICE_STATE_DISCONNECTED = 0,
     CDC_DEVICE_STATE_CONNECTED,
 } cdc_device_state_t;
 
-// USB CDC设备上下文
+// 一个设备槽位
 typedef struct {
     cdc_acm_dev_hdl_t cdc_hdl;
     cdc_device_state_t state;
+    SemaphoreHandle_t mutex;        // 保护句柄，发送与控制传输互斥
+    uint8_t id;                     // 设备编号 (槽位下标)
+    uint16_t vid;
+    uint16_t pid;
+    bool rx_paused;                 // 已发给设备的RTS状态 (true表示RTS无效)
+    bool tx_failed;                 // 当前请求已有数据块发送失败
+    uint8_t tx_blocks;              // 排队中的数据块数 (不超过CDC_TX_DEV_BLOCKS)
+    uint64_t rx_bytes;
+    uint64_t tx_bytes;
+} cdc_port_t;
+
+// USB CDC Host上下文
+typedef struct {
+    cdc_port_t ports[USBD_CDC_MAX_DEVICES];
     usbd_cdc_rx_callback_t rx_cb;
-    uint8_t rx_buffer[CDC_DATA_BUFFER_SIZE];
-    SemaphoreHandle_t mutex;
     TaskHandle_t task_handle;
+    TaskHandle_t tx_task_handle;
+    QueueHandle_t tx_queue;         // 待发送的数据块
+    QueueHandle_t tx_free;          // 空闲的数据块编号
+    uint32_t new_devs[USBD_CDC_MAX_DEVICES];    // 新设备回调匹配到的VID<<16|PID，0表示空
+    usbd_cdc_flow_query_t flow_query;
+    usbd_cdc_tx_stats_t tx_stats;
     bool is_initialized;
 } cdc_dev_context_t;
 
 static cdc_dev_context_t s_cdc_dev = {0};
-static SemaphoreHandle_t device_disconnected_sem;
+
+// 发送数据块池 (静态分配) 与合并发送缓冲区
+static uint8_t s_tx_pool[CDC_TX_BLOCK_COUNT][CDC_TX_BLOCK_SIZE];
+static uint8_t s_tx_stage[CDC_TX_BLOCK_SIZE];
+
+// 运行时配置，由s_cfg_lock保护，在打开设备时读取
+static usbd_cdc_config_t s_cdc_cfg = {
+    .baud_rate = CDC_BAUD_RATE,
+    .data_bits = CDC_DATA_BITS,
+    .parity = CDC_PARITY,
+    .stop_bits = CDC_STOP_BITS,
+    .in_buffer_size = CDC_DATA_BUFFER_SIZE,
+    .out_buffer_size = CDC_DATA_BUFFER_SIZE,
+};
+static usbd_cdc_match_t s_cdc_match[USBD_CDC_MAX_MATCH] = {
+    { STM32_USB_DEVICE_VID, STM32_USB_DEVICE_PID },
+};
+static size_t s_cdc_match_count = 1;
+static portMUX_TYPE s_cfg_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void cdc_config_load(void);
+
+// 通知CDC Host任务 (可在驱动回调中调用)
+static void cdc_host_notify(uint32_t bits)
+{
+    if (s_cdc_dev.task_handle != NULL) {
+        xTaskNotify(s_cdc_dev.task_handle, bits, eSetBits);
+    }
+}
 
 // CDC设备事件回调
 static void cdc_device_event_callback(const cdc_acm_host_dev_event_data_t *event, void *user_ctx)
 {
-    cdc_dev_context_t *dev = (cdc_dev_context_t *)user_ctx;
+    cdc_port_t *port = (cdc_port_t *)user_ctx;
     
     switch (event->type) {
         case CDC_ACM_HOST_DEVICE_DISCONNECTED:
-            ESP_LOGW(TAG, "CDC设备已断开");
-            dev->state = CDC_DEVICE_STATE_DISCONNECTED;
-            dev->cdc_hdl = NULL;
-            if (device_disconnected_sem) {
-                xSemaphoreGive(device_disconnected_sem);
-            }
+            ESP_LOGW(TAG, "CDC设备%u已断开", port->id);
+            // 句柄由CDC Host任务关闭，发送任务看到断开状态后不再使用句柄
+            port->state = CDC_DEVICE_STATE_DISCONNECTED;
+            cdc_host_notify(CDC_NOTIFY_DISCONNECTED);
+            app_event_post(APP_EVENT_CDC_DISCONNECTED, &port->id, sizeof(port->id));
             break;
         case CDC_ACM_HOST_ERROR:
-            ESP_LOGE(TAG, "CDC设备发生错误: %d", event->data.error);
+            ESP_LOGE(TAG, "CDC设备%u发生错误: %d", port->id, event->data.error);
             break;
         case CDC_ACM_HOST_SERIAL_STATE:
-            ESP_LOGI(TAG, "CDC设备串口状态变化: 0x%02x", event->data.serial_state.val);
+            ESP_LOGI(TAG, "CDC设备%u串口状态变化: 0x%02x", port->id, event->data.serial_state.val);
             break;
         case CDC_ACM_HOST_NETWORK_CONNECTION:
-            ESP_LOGI(TAG, "CDC设备网络连接状态变化: %d", event->data.network_connected);
+            ESP_LOGI(TAG, "CDC设备%u网络连接状态变化: %d", port->id, event->data.network_connected);
             break;
         default:
             ESP_LOGW(TAG, "未知CDC设备事件: %d", event->type);
@@ -89,13 +176,18 @@ static void cdc_device_event_callback(const cdc_acm_host_dev_event_data_t *event
 // CDC数据接收回调
 static bool cdc_data_received_callback(const uint8_t *data, size_t data_len, void *user_ctx)
 {
-    cdc_dev_context_t *dev = (cdc_dev_context_t *)user_ctx;
+    cdc_port_t *port = (cdc_port_t *)user_ctx;
     
-    ESP_LOGI(TAG, "接收到CDC数据: %d字节", data_len);
+    TRACE_EVENT(TRACE_EVT_CDC_RX, port->id, data_len);
+    metrics_add(METRIC_USB_IN_PACKETS, 1);
+    metrics_add(METRIC_USB_IN_BYTES, data_len);
+    port->rx_bytes += data_len;
+    power_mgmt_data_activity();
     
-    if (dev->rx_cb && data_len > 0) {
+    if (s_cdc_dev.rx_cb && data_len > 0) {
+        boot_timeline_mark(BOOT_PHASE_FIRST_DATA);
         // 调用用户注册的回调函数
-        dev->rx_cb(data, data_len);
+        s_cdc_dev.rx_cb(port->id, data, data_len);
     }
     
     return true;
@@ -118,93 +210,396 @@ static void usb_lib_task(void *arg)
     }
 }
 
-// USB CDC Host任务
-static void usb_cdc_host_task(void *arg)
+// 按流控查询结果更新RTS (在CDC Host任务中调用，控制传输会阻塞)
+static void cdc_flow_apply(cdc_dev_context_t *dev, cdc_port_t *port)
 {
-    cdc_dev_context_t *dev = (cdc_dev_context_t *)arg;
+    if (dev->flow_query == NULL || port->state != CDC_DEVICE_STATE_CONNECTED) {
+        return;
+    }
+    bool paused = dev->flow_query(port->id);
+    if (paused == port->rx_paused) {
+        return;
+    }
+
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    if (xSemaphoreTake(port->mutex, pdMS_TO_TICKS(CDC_MUTEX_TIMEOUT_MS)) == pdTRUE) {
+        if (port->state == CDC_DEVICE_STATE_CONNECTED && port->cdc_hdl != NULL) {
+            err = cdc_acm_host_set_control_line_state(port->cdc_hdl, true, !paused);
+        }
+        xSemaphoreGive(port->mutex);
+    }
+    if (err != ESP_OK) {
+        // 下次通知或定时检查时重试
+        ESP_LOGW(TAG, "设备%u设置RTS失败: %s", port->id, esp_err_to_name(err));
+        return;
+    }
+    port->rx_paused = paused;
+    ESP_LOGI(TAG, "设备%u流控: %s", port->id, paused ? "RTS无效，设备暂停发送" : "RTS有效，设备恢复发送");
+}
+
+// 检查VID/PID是否在匹配表中
+static bool cdc_match_device(uint16_t vid, uint16_t pid)
+{
+    bool found = false;
+    taskENTER_CRITICAL(&s_cfg_lock);
+    for (size_t i = 0; i < s_cdc_match_count; i++) {
+        if (s_cdc_match[i].vid == vid && s_cdc_match[i].pid == pid) {
+            found = true;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&s_cfg_lock);
+    return found;
+}
+
+// 新设备枚举回调 (在CDC-ACM驱动任务中执行)，只通知CDC Host任务，打开设备不能在回调中进行
+static void cdc_new_dev_callback(usb_device_handle_t usb_dev)
+{
+    const usb_device_desc_t *desc;
+    if (usb_host_get_device_descriptor(usb_dev, &desc) != ESP_OK ||
+        !cdc_match_device(desc->idVendor, desc->idProduct)) {
+        return;
+    }
+    // 多个设备可能同时枚举 (Hub上电)，每个待打开的设备占用一项
+    uint32_t id = ((uint32_t)desc->idVendor << 16) | desc->idProduct;
+    for (int i = 0; i < USBD_CDC_MAX_DEVICES; i++) {
+        uint32_t empty = 0;
+        if (__atomic_compare_exchange_n(&s_cdc_dev.new_devs[i], &empty, id, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+    }
+    cdc_host_notify(CDC_NOTIFY_NEW_DEV);
+}
+
+// 获取编号最小的空闲槽位，已满时返回NULL
+static cdc_port_t *cdc_port_alloc(cdc_dev_context_t *dev)
+{
+    for (int i = 0; i < USBD_CDC_MAX_DEVICES; i++) {
+        if (dev->ports[i].state == CDC_DEVICE_STATE_DISCONNECTED && dev->ports[i].cdc_hdl == NULL) {
+            return &dev->ports[i];
+        }
+    }
+    return NULL;
+}
+
+// 打开一个CDC设备到空闲槽位并设置串口参数
+static esp_err_t cdc_port_open(cdc_dev_context_t *dev, const usbd_cdc_config_t *cfg,
+                               uint16_t vid, uint16_t pid, uint32_t timeout_ms)
+{
+    cdc_port_t *port = cdc_port_alloc(dev);
+    if (port == NULL) {
+        ESP_LOGW(TAG, "已打开%d个CDC设备，忽略%04x:%04x", USBD_CDC_MAX_DEVICES, vid, pid);
+        return ESP_ERR_NO_MEM;
+    }
+
     cdc_acm_host_device_config_t dev_config = {
-        .connection_timeout_ms = CDC_CONNECTION_TIMEOUT_MS,
-        .out_buffer_size = CDC_DATA_BUFFER_SIZE,
-        .in_buffer_size = CDC_DATA_BUFFER_SIZE,
+        .connection_timeout_ms = timeout_ms,
+        .out_buffer_size = cfg->out_buffer_size,
+        .in_buffer_size = cfg->in_buffer_size,
         .event_cb = cdc_device_event_callback,
         .data_cb = cdc_data_received_callback,
-        .user_arg = dev,
+        .user_arg = port,
     };
-    
-    int retry_count = 0;
-    
-    while (dev->is_initialized) {
-        if (dev->state == CDC_DEVICE_STATE_DISCONNECTED) {
-            // 尝试打开CDC设备
-            ESP_LOGI(TAG, "尝试打开CDC设备 (第%d次尝试)...", ++retry_count);
-            
-            // 尝试使用STM32的VID/PID打开设备
-            esp_err_t err = cdc_acm_host_open(STM32_USB_DEVICE_VID, STM32_USB_DEVICE_PID, 0, &dev_config, &dev->cdc_hdl);
-            if (err == ESP_OK) {
-                ESP_LOGI(TAG, "CDC设备已打开成功 (STM32 VCP)");
-                dev->state = CDC_DEVICE_STATE_CONNECTED;
-                
-                // 打印设备描述符信息
-                cdc_acm_host_desc_print(dev->cdc_hdl);
-                
-                // 设置串口参数 (115200 8N1)
-                cdc_acm_line_coding_t line_coding = {
-                    .dwDTERate = CDC_BAUD_RATE,
-                    .bCharFormat = CDC_STOP_BITS,  // 1位停止位
-                    .bParityType = CDC_PARITY,     // 无校验
-                    .bDataBits = CDC_DATA_BITS     // 8位数据位
-                };
-                
-                err = cdc_acm_host_line_coding_set(dev->cdc_hdl, &line_coding);
-                if (err != ESP_OK) {
-                    ESP_LOGW(TAG, "设置串口参数失败: %s", esp_err_to_name(err));
-                }
-                
-                // 设置DTR和RTS信号
-                err = cdc_acm_host_set_control_line_state(dev->cdc_hdl, true, true);
-                if (err != ESP_OK) {
-                    ESP_LOGW(TAG, "设置控制线状态失败: %s", esp_err_to_name(err));
-                }
-                
-<<<<<<< Updated upstream
-                // // 发送测试数据
-=======
-                // 发送测试数据
->>>>>>> Stashed changes
-                // const char *test_str = "CDC test initialized!";
-                // err = cdc_acm_host_data_tx_blocking(dev->cdc_hdl, (const uint8_t *)test_str, strlen(test_str), CDC_TX_TIMEOUT_MS);
-                // if (err != ESP_OK) {
-                //     ESP_LOGW(TAG, "发送测试数据失败: %s", esp_err_to_name(err));
-                // } else {
-                //     ESP_LOGI(TAG, "发送测试数据成功");
-                // }
-                
-                retry_count = 0;
-            } else {
-                if (err == ESP_ERR_NOT_FOUND) {
-                    ESP_LOGW(TAG, "未找到STM32 CDC设备，等待设备连接...");
-                } else {
-                    ESP_LOGE(TAG, "打开CDC设备失败: %s", esp_err_to_name(err));
-                }
-                vTaskDelay(pdMS_TO_TICKS(CDC_DEVICE_CHECK_INTERVAL_MS));
+
+    cdc_acm_dev_hdl_t hdl = NULL;
+    esp_err_t err = cdc_acm_host_open(vid, pid, 0, &dev_config, &hdl);
+    if (err != ESP_OK) {
+        return err;
+    }
+    ESP_LOGI(TAG, "CDC设备%u已打开成功 (%04x:%04x, IN缓冲区%u字节, OUT缓冲区%u字节)",
+             port->id, vid, pid, cfg->in_buffer_size, cfg->out_buffer_size);
+
+    // 打印设备描述符信息
+    cdc_acm_host_desc_print(hdl);
+
+    // 设置串口参数
+    cdc_acm_line_coding_t line_coding = {
+        .dwDTERate = cfg->baud_rate,
+        .bCharFormat = cfg->stop_bits,
+        .bParityType = cfg->parity,
+        .bDataBits = cfg->data_bits,
+    };
+
+    err = cdc_acm_host_line_coding_set(hdl, &line_coding);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "设置串口参数失败: %s", esp_err_to_name(err));
+    }
+
+    // 设置DTR和RTS信号 (无损模式下RTS按当前流控状态设置)
+    port->rx_paused = dev->flow_query ? dev->flow_query(port->id) : false;
+    err = cdc_acm_host_set_control_line_state(hdl, true, !port->rx_paused);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "设置控制线状态失败: %s", esp_err_to_name(err));
+    }
+
+    xSemaphoreTake(port->mutex, portMAX_DELAY);
+    port->cdc_hdl = hdl;
+    port->vid = vid;
+    port->pid = pid;
+    port->state = CDC_DEVICE_STATE_CONNECTED;
+    xSemaphoreGive(port->mutex);
+    boot_timeline_mark(BOOT_PHASE_CDC_OPEN);
+    app_event_post(APP_EVENT_CDC_CONNECTED, &port->id, sizeof(port->id));
+    return ESP_OK;
+}
+
+// 读取当前的串口参数和匹配表
+static size_t cdc_config_snapshot(usbd_cdc_config_t *cfg, usbd_cdc_match_t *table)
+{
+    taskENTER_CRITICAL(&s_cfg_lock);
+    *cfg = s_cdc_cfg;
+    size_t count = s_cdc_match_count;
+    memcpy(table, s_cdc_match, count * sizeof(usbd_cdc_match_t));
+    taskEXIT_CRITICAL(&s_cfg_lock);
+    return count;
+}
+
+// 打开新设备回调记录的设备 (已枚举，等待接口就绪)
+static void cdc_open_new_devices(cdc_dev_context_t *dev)
+{
+    usbd_cdc_config_t cfg;
+    usbd_cdc_match_t table[USBD_CDC_MAX_MATCH];
+    cdc_config_snapshot(&cfg, table);
+
+    for (int i = 0; i < USBD_CDC_MAX_DEVICES; i++) {
+        uint32_t id = __atomic_exchange_n(&dev->new_devs[i], 0, __ATOMIC_ACQ_REL);
+        if (id == 0) {
+            continue;
+        }
+        esp_err_t err = cdc_port_open(dev, &cfg, id >> 16, id & 0xFFFF, CDC_CONNECTION_TIMEOUT_MS);
+        if (err != ESP_OK && err != ESP_ERR_NO_MEM) {
+            ESP_LOGE(TAG, "打开CDC设备%04"PRIx32":%04"PRIx32"失败: %s", id >> 16, id & 0xFFFF, esp_err_to_name(err));
+        }
+    }
+}
+
+// 按匹配表打开所有已接入的设备 (启动时和重新打开时)，每项尝试到找不到更多设备为止
+static void cdc_open_all(cdc_dev_context_t *dev)
+{
+    usbd_cdc_config_t cfg;
+    usbd_cdc_match_t table[USBD_CDC_MAX_MATCH];
+    size_t count = cdc_config_snapshot(&cfg, table);
+
+    int opened = 0;
+    for (size_t i = 0; i < count; i++) {
+        esp_err_t err;
+        while ((err = cdc_port_open(dev, &cfg, table[i].vid, table[i].pid, 0)) == ESP_OK) {
+            opened++;
+        }
+        if (err == ESP_ERR_NO_MEM) {
+            break;
+        }
+        if (err != ESP_ERR_NOT_FOUND) {
+            ESP_LOGE(TAG, "打开CDC设备失败: %s", esp_err_to_name(err));
+        }
+    }
+    if (opened == 0) {
+        ESP_LOGI(TAG, "未找到匹配的CDC设备，等待设备连接...");
+    }
+}
+
+// 关闭CDC设备句柄 (设备断开或任务退出时)
+static void cdc_port_close(cdc_port_t *port)
+{
+    xSemaphoreTake(port->mutex, portMAX_DELAY);
+    cdc_acm_dev_hdl_t hdl = port->cdc_hdl;
+    // 设备仍在线时主动关闭 (重新打开)，断开事件由这里发出
+    bool was_connected = port->state == CDC_DEVICE_STATE_CONNECTED;
+    port->cdc_hdl = NULL;
+    port->state = CDC_DEVICE_STATE_DISCONNECTED;
+    xSemaphoreGive(port->mutex);
+
+    if (hdl) {
+        cdc_acm_host_close(hdl);
+    }
+    if (was_connected) {
+        app_event_post(APP_EVENT_CDC_DISCONNECTED, &port->id, sizeof(port->id));
+    }
+}
+
+// USB CDC Host任务：设备接入、断开和流控都由通知驱动，空闲时不唤醒
+static void usb_cdc_host_task(void *arg)
+{
+    cdc_dev_context_t *dev = (cdc_dev_context_t *)arg;
+
+    // 驱动安装前已接入的设备不会触发新设备回调，启动时先尝试打开一次
+    uint32_t bits = CDC_NOTIFY_REOPEN;
+
+    while (dev->is_initialized && !(bits & CDC_NOTIFY_EXIT)) {
+        for (int i = 0; i < USBD_CDC_MAX_DEVICES; i++) {
+            cdc_port_t *port = &dev->ports[i];
+            // 已断开的设备关闭句柄，重新打开时关闭全部设备
+            if ((bits & CDC_NOTIFY_REOPEN) ||
+                ((bits & CDC_NOTIFY_DISCONNECTED) && port->state == CDC_DEVICE_STATE_DISCONNECTED)) {
+                cdc_port_close(port);
             }
-        } else {
-            // 设备已连接，等待事件
-            vTaskDelay(pdMS_TO_TICKS(1000));
-            ESP_LOGI(TAG, "CDC设备连接状态: %s", dev->state == CDC_DEVICE_STATE_CONNECTED ? "已连接" : "未连接");
         }
+        if (bits & CDC_NOTIFY_REOPEN) {
+            // 按匹配表打开全部设备，已记录的新设备也在其中
+            for (int i = 0; i < USBD_CDC_MAX_DEVICES; i++) {
+                __atomic_store_n(&dev->new_devs[i], 0, __ATOMIC_RELEASE);
+            }
+            cdc_open_all(dev);
+        } else if (bits & CDC_NOTIFY_NEW_DEV) {
+            cdc_open_new_devices(dev);
+        }
+        if (bits & CDC_NOTIFY_FLOW) {
+            for (int i = 0; i < USBD_CDC_MAX_DEVICES; i++) {
+                cdc_flow_apply(dev, &dev->ports[i]);
+            }
+        }
+        xTaskNotifyWait(0, UINT32_MAX, &bits, portMAX_DELAY);
     }
-    
+
     // 清理并退出任务
-    if (dev->cdc_hdl) {
-        cdc_acm_host_close(dev->cdc_hdl);
-        dev->cdc_hdl = NULL;
+    for (int i = 0; i < USBD_CDC_MAX_DEVICES; i++) {
+        cdc_port_close(&dev->ports[i]);
     }
-    
+
     dev->task_handle = NULL;
     vTaskDelete(NULL);
 }
 
+// 完成一个数据块：归还数据块，若为请求的最后一块则回调通知结果
+static void cdc_tx_complete(cdc_dev_context_t *dev, const cdc_tx_item_t *item, esp_err_t err)
+{
+    cdc_port_t *port = &dev->ports[item->dev];
+
+    xQueueSend(dev->tx_free, &item->block, 0);
+    __atomic_sub_fetch(&port->tx_blocks, 1, __ATOMIC_RELEASE);
+
+    if (err != ESP_OK) {
+        port->tx_failed = true;
+    }
+    if (!item->last) {
+        return;
+    }
+
+    esp_err_t result = port->tx_failed ? ESP_FAIL : ESP_OK;
+    if (port->tx_failed && err != ESP_OK) {
+        result = err;
+    }
+    port->tx_failed = false;
+
+    if (result == ESP_OK) {
+        dev->tx_stats.requests_ok++;
+    } else {
+        dev->tx_stats.requests_failed++;
+    }
+    if (item->done_cb) {
+        item->done_cb(item->id, result, item->total_len, item->arg);
+    }
+}
+
+// CDC异步发送任务：连续取出队列中的数据块，同一设备相邻的小块合并为一次OUT传输
+static void usb_cdc_tx_task(void *arg)
+{
+    cdc_dev_context_t *dev = (cdc_dev_context_t *)arg;
+    cdc_tx_item_t batch[CDC_TX_BLOCK_COUNT];
+
+    while (1) {
+        if (xQueueReceive(dev->tx_queue, &batch[0], portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        // 合并后续已排队的数据块，总长度不超过一次OUT传输
+        int count = 1;
+        size_t total = batch[0].len;
+        cdc_tx_item_t next;
+        while (count < CDC_TX_BLOCK_COUNT &&
+               xQueuePeek(dev->tx_queue, &next, 0) == pdTRUE &&
+               next.dev == batch[0].dev &&
+               total + next.len <= CDC_TX_BLOCK_SIZE) {
+            xQueueReceive(dev->tx_queue, &batch[count++], 0);
+            total += next.len;
+        }
+
+        // 单个数据块直接发送，多个数据块拷贝到合并缓冲区后一次发送
+        const uint8_t *buf = s_tx_pool[batch[0].block];
+        if (count > 1) {
+            size_t off = 0;
+            for (int i = 0; i < count; i++) {
+                memcpy(s_tx_stage + off, s_tx_pool[batch[i].block], batch[i].len);
+                off += batch[i].len;
+            }
+            buf = s_tx_stage;
+        }
+
+        cdc_port_t *port = &dev->ports[batch[0].dev];
+        esp_err_t err = ESP_ERR_NOT_FOUND;
+        if (xSemaphoreTake(port->mutex, portMAX_DELAY) == pdTRUE) {
+            if (port->state == CDC_DEVICE_STATE_CONNECTED && port->cdc_hdl != NULL) {
+                err = cdc_acm_host_data_tx_blocking(port->cdc_hdl, buf, total, CDC_TX_TIMEOUT_MS);
+            }
+            xSemaphoreGive(port->mutex);
+        }
+
+        if (err == ESP_OK) {
+            dev->tx_stats.transfers++;
+            dev->tx_stats.bytes += total;
+            port->tx_bytes += total;
+            metrics_add(METRIC_CDC_TX_BYTES, total);
+        } else {
+            ESP_LOGW(TAG, "设备%u异步发送失败: %s (%d字节)", port->id, esp_err_to_name(err), total);
+        }
+
+        for (int i = 0; i < count; i++) {
+            cdc_tx_complete(dev, &batch[i], err);
+        }
+    }
+}
+
+// 创建异步发送队列和任务
+static esp_err_t cdc_tx_queue_init(cdc_dev_context_t *dev)
+{
+    dev->tx_queue = xQueueCreate(CDC_TX_BLOCK_COUNT, sizeof(cdc_tx_item_t));
+    dev->tx_free = xQueueCreate(CDC_TX_BLOCK_COUNT, sizeof(uint8_t));
+    if (dev->tx_queue == NULL || dev->tx_free == NULL) {
+        ESP_LOGE(TAG, "创建CDC发送队列失败");
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (uint8_t i = 0; i < CDC_TX_BLOCK_COUNT; i++) {
+        xQueueSend(dev->tx_free, &i, 0);
+    }
+
+    BaseType_t task_created = task_config_create(TASK_CFG_USB_CDC_TX, usb_cdc_tx_task, dev, &dev->tx_task_handle);
+    if (task_created != pdPASS) {
+        ESP_LOGE(TAG, "创建CDC发送任务失败");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+// 释放异步发送队列和任务
+static void cdc_tx_queue_deinit(cdc_dev_context_t *dev)
+{
+    if (dev->tx_task_handle) {
+        vTaskDelete(dev->tx_task_handle);
+        dev->tx_task_handle = NULL;
+    }
+    if (dev->tx_queue) {
+        vQueueDelete(dev->tx_queue);
+        dev->tx_queue = NULL;
+    }
+    if (dev->tx_free) {
+        vQueueDelete(dev->tx_free);
+        dev->tx_free = NULL;
+    }
+}
+
+// 删除各槽位的互斥锁
+static void cdc_port_mutex_delete(void)
+{
+    for (int i = 0; i < USBD_CDC_MAX_DEVICES; i++) {
+        if (s_cdc_dev.ports[i].mutex) {
+            vSemaphoreDelete(s_cdc_dev.ports[i].mutex);
+            s_cdc_dev.ports[i].mutex = NULL;
+        }
+    }
+}
+
 esp_err_t usbd_cdc_init(usbd_cdc_rx_callback_t rx_cb)
 {
     esp_err_t ret = ESP_OK;
@@ -214,19 +609,22 @@ esp_err_t usbd_cdc_init(usbd_cdc_rx_callback_t rx_cb)
         return ESP_ERR_INVALID_STATE;
     }
     
-    // 创建信号量
-    device_disconnected_sem = xSemaphoreCreateBinary();
-    if (device_disconnected_sem == NULL) {
-        ESP_LOGE(TAG, "创建设备断开信号量失败");
-        return ESP_ERR_NO_MEM;
-    }
-    
-    // 初始化互斥锁
-    s_cdc_dev.mutex = xSemaphoreCreateMutex();
-    if (s_cdc_dev.mutex == NULL) {
-        ESP_LOGE(TAG, "创建互斥锁失败");
-        vSemaphoreDelete(device_disconnected_sem);
-        return ESP_ERR_NO_MEM;
+    // 初始化设备上下文
+    memset(&s_cdc_dev, 0, sizeof(cdc_dev_context_t));
+    s_cdc_dev.rx_cb = rx_cb;
+    cdc_config_load();
+
+    // 初始化各槽位的互斥锁
+    for (int i = 0; i < USBD_CDC_MAX_DEVICES; i++) {
+        cdc_port_t *port = &s_cdc_dev.ports[i];
+        port->id = i;
+        port->state = CDC_DEVICE_STATE_DISCONNECTED;
+        port->mutex = xSemaphoreCreateMutex();
+        if (port->mutex == NULL) {
+            ESP_LOGE(TAG, "创建互斥锁失败");
+            cdc_port_mutex_delete();
+            return ESP_ERR_NO_MEM;
+        }
     }
     
     // 初始化USB Host
@@ -239,66 +637,64 @@ esp_err_t usbd_cdc_init(usbd_cdc_rx_callback_t rx_cb)
     ret = usb_host_install(&host_config);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "安装USB Host失败: %s", esp_err_to_name(ret));
-        vSemaphoreDelete(s_cdc_dev.mutex);
-        vSemaphoreDelete(device_disconnected_sem);
+        cdc_port_mutex_delete();
         return ret;
     }
     
     // 创建USB库处理任务
     TaskHandle_t usb_lib_task_handle;
-    BaseType_t task_created = xTaskCreate(
-        usb_lib_task,
-        "usb_lib",
-        4096,
-        NULL,
-        CDC_HOST_TASK_PRIORITY,
-        &usb_lib_task_handle
-    );
+    BaseType_t task_created = task_config_create(TASK_CFG_USB_LIB, usb_lib_task, NULL, &usb_lib_task_handle);
     
     if (task_created != pdPASS) {
         ESP_LOGE(TAG, "创建USB库任务失败");
         usb_host_uninstall();
-        vSemaphoreDelete(s_cdc_dev.mutex);
-        vSemaphoreDelete(device_disconnected_sem);
+        cdc_port_mutex_delete();
         return ESP_ERR_NO_MEM;
     }
     
     // 初始化CDC ACM Host
     ESP_LOGI(TAG, "正在安装CDC ACM Host驱动...");
-    ret = cdc_acm_host_install(NULL);  // 使用默认配置
+    // 驱动任务处理所有IN传输回调，与USB库任务位于同一核心
+    const task_config_t *drv_task = task_config_get(TASK_CFG_CDC_ACM_DRIVER);
+    const cdc_acm_host_driver_config_t driver_config = {
+        .driver_task_stack_size = drv_task->stack_size,
+        .driver_task_priority = drv_task->priority,
+        .xCoreID = drv_task->core,
+        .new_dev_cb = cdc_new_dev_callback,
+    };
+    ret = cdc_acm_host_install(&driver_config);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "安装CDC ACM Host驱动失败: %s", esp_err_to_name(ret));
         vTaskDelete(usb_lib_task_handle);
         usb_host_uninstall();
-        vSemaphoreDelete(s_cdc_dev.mutex);
-        vSemaphoreDelete(device_disconnected_sem);
+        cdc_port_mutex_delete();
         return ret;
     }
     
-    // 初始化设备上下文
-    memset(&s_cdc_dev, 0, sizeof(cdc_dev_context_t));
-    s_cdc_dev.state = CDC_DEVICE_STATE_DISCONNECTED;
-    s_cdc_dev.rx_cb = rx_cb;
+    // 创建异步发送队列
+    ret = cdc_tx_queue_init(&s_cdc_dev);
+    if (ret != ESP_OK) {
+        cdc_tx_queue_deinit(&s_cdc_dev);
+        cdc_acm_host_uninstall();
+        vTaskDelete(usb_lib_task_handle);
+        usb_host_uninstall();
+        cdc_port_mutex_delete();
+        return ret;
+    }
+
     s_cdc_dev.is_initialized = true;
     
     // 创建CDC Host任务
     ESP_LOGI(TAG, "创建USB CDC Host任务...");
-    task_created = xTaskCreate(
-        usb_cdc_host_task,
-        "usb_cdc_host",
-        CDC_HOST_TASK_STACK_SIZE,
-        &s_cdc_dev,
-        CDC_HOST_TASK_PRIORITY - 1,
-        &s_cdc_dev.task_handle
-    );
+    task_created = task_config_create(TASK_CFG_USB_CDC_HOST, usb_cdc_host_task, &s_cdc_dev, &s_cdc_dev.task_handle);
     
     if (task_created != pdPASS) {
         ESP_LOGE(TAG, "创建USB CDC Host任务失败");
+        cdc_tx_queue_deinit(&s_cdc_dev);
         cdc_acm_host_uninstall();
         vTaskDelete(usb_lib_task_handle);
         usb_host_uninstall();
-        vSemaphoreDelete(s_cdc_dev.mutex);
-        vSemaphoreDelete(device_disconnected_sem);
+        cdc_port_mutex_delete();
         s_cdc_dev.is_initialized = false;
         return ESP_ERR_NO_MEM;
     }
@@ -307,48 +703,274 @@ esp_err_t usbd_cdc_init(usbd_cdc_rx_callback_t rx_cb)
     return ESP_OK;
 }
 
-esp_err_t usbd_cdc_send_data(const uint8_t* data, size_t len)
+esp_err_t usbd_cdc_send_data(uint8_t dev, const uint8_t* data, size_t len)
 {
     if (!s_cdc_dev.is_initialized) {
         ESP_LOGW(TAG, "USB CDC Host未初始化");
         return ESP_ERR_INVALID_STATE;
     }
     
-    if (!data || len == 0) {
+    if (!data || len == 0 || dev >= USBD_CDC_MAX_DEVICES) {
         return ESP_ERR_INVALID_ARG;
     }
     
-    if (s_cdc_dev.state != CDC_DEVICE_STATE_CONNECTED || s_cdc_dev.cdc_hdl == NULL) {
-        ESP_LOGW(TAG, "CDC设备未连接");
+    cdc_port_t *port = &s_cdc_dev.ports[dev];
+    if (port->state != CDC_DEVICE_STATE_CONNECTED || port->cdc_hdl == NULL) {
+        ESP_LOGW(TAG, "CDC设备%u未连接", dev);
         return ESP_ERR_NOT_FOUND;
     }
     
     // 获取互斥锁
-    if (xSemaphoreTake(s_cdc_dev.mutex, pdMS_TO_TICKS(CDC_MUTEX_TIMEOUT_MS)) != pdTRUE) {
+    if (xSemaphoreTake(port->mutex, pdMS_TO_TICKS(CDC_MUTEX_TIMEOUT_MS)) != pdTRUE) {
         ESP_LOGW(TAG, "获取互斥锁超时");
         return ESP_ERR_TIMEOUT;
     }
 
-    ESP_LOGI(TAG, "发送数据到CDC设备: %d字节", len);
-    esp_err_t ret = cdc_acm_host_data_tx_blocking(s_cdc_dev.cdc_hdl, data, len, CDC_TX_TIMEOUT_MS);
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    if (port->cdc_hdl != NULL) {
+        ret = cdc_acm_host_data_tx_blocking(port->cdc_hdl, data, len, CDC_TX_TIMEOUT_MS);
+    }
     
     // 释放互斥锁
-    xSemaphoreGive(s_cdc_dev.mutex);
+    xSemaphoreGive(port->mutex);
     
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "发送数据失败: %s", esp_err_to_name(ret));
+        TRACE_EVENT(TRACE_EVT_CDC_TX_FAIL, dev, len);
+        ESP_LOGE(TAG, "设备%u发送数据失败: %s", dev, esp_err_to_name(ret));
         return ret;
     }
     
-    ESP_LOGI(TAG, "数据发送成功");
+    TRACE_EVENT(TRACE_EVT_CDC_TX, dev, len);
+    metrics_add(METRIC_CDC_TX_BYTES, len);
+    port->tx_bytes += len;
+    return ESP_OK;
+}
+
+esp_err_t usbd_cdc_send_async(uint8_t dev, const uint8_t *data, size_t len, uint32_t id,
+                              usbd_cdc_tx_done_cb_t done_cb, void *arg)
+{
+    if (!s_cdc_dev.is_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (!data || len == 0 || dev >= USBD_CDC_MAX_DEVICES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    cdc_port_t *port = &s_cdc_dev.ports[dev];
+    if (port->state != CDC_DEVICE_STATE_CONNECTED || port->cdc_hdl == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // 整个请求必须一次放入队列，空间不足或超过该设备的份额时立即返回，调用者不会等待USB
+    size_t blocks = (len + CDC_TX_BLOCK_SIZE - 1) / CDC_TX_BLOCK_SIZE;
+    if (blocks > uxQueueMessagesWaiting(s_cdc_dev.tx_free) ||
+        blocks + __atomic_load_n(&port->tx_blocks, __ATOMIC_ACQUIRE) > CDC_TX_DEV_BLOCKS) {
+        s_cdc_dev.tx_stats.requests_rejected++;
+        metrics_add(METRIC_CDC_TX_REJECTED, 1);
+        return ESP_ERR_NO_MEM;
+    }
+
+    cdc_tx_item_t item = {
+        .dev = dev,
+        .id = id,
+        .total_len = len,
+        .done_cb = done_cb,
+        .arg = arg,
+    };
+    size_t off = 0;
+    while (off < len) {
+        if (xQueueReceive(s_cdc_dev.tx_free, &item.block, 0) != pdTRUE) {
+            // 每个设备只有一个生产者，且各设备份额之和不会长时间超过数据块总数
+            s_cdc_dev.tx_stats.requests_rejected++;
+            return ESP_ERR_NO_MEM;
+        }
+        __atomic_add_fetch(&port->tx_blocks, 1, __ATOMIC_RELEASE);
+        item.len = (len - off) > CDC_TX_BLOCK_SIZE ? CDC_TX_BLOCK_SIZE : (len - off);
+        item.last = (off + item.len == len);
+        memcpy(s_tx_pool[item.block], data + off, item.len);
+        xQueueSend(s_cdc_dev.tx_queue, &item, 0);
+        off += item.len;
+    }
+    metrics_hwm(METRIC_HWM_CDC_TX_QUEUE, uxQueueMessagesWaiting(s_cdc_dev.tx_queue));
+
     return ESP_OK;
 }
 
-bool usbd_cdc_is_connected(void)
+void usbd_cdc_get_tx_stats(usbd_cdc_tx_stats_t *stats)
+{
+    if (!stats) {
+        return;
+    }
+    *stats = s_cdc_dev.tx_stats;
+    stats->queued_blocks = s_cdc_dev.tx_queue ? uxQueueMessagesWaiting(s_cdc_dev.tx_queue) : 0;
+}
+
+// 检查串口与传输参数
+static bool cdc_config_valid(const usbd_cdc_config_t *cfg)
+{
+    return cfg->baud_rate > 0 &&
+           (cfg->data_bits == 5 || cfg->data_bits == 6 || cfg->data_bits == 7 ||
+            cfg->data_bits == 8 || cfg->data_bits == 16) &&
+           cfg->parity <= 4 && cfg->stop_bits <= 2 &&
+           cfg->in_buffer_size >= CDC_USB_MPS && cfg->in_buffer_size <= CDC_BUFFER_SIZE_MAX &&
+           cfg->in_buffer_size % CDC_USB_MPS == 0 &&
+           cfg->out_buffer_size >= CDC_TX_BLOCK_SIZE && cfg->out_buffer_size <= CDC_BUFFER_SIZE_MAX;
+}
+
+// 保存配置到NVS
+static esp_err_t cdc_nvs_save(const char *key, const void *data, size_t len)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(CDC_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(nvs, key, data, len);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
+
+// 从NVS加载配置，不存在或无效时保留默认值
+static void cdc_config_load(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(CDC_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+
+    usbd_cdc_config_t cfg;
+    size_t len = sizeof(cfg);
+    if (nvs_get_blob(nvs, CDC_NVS_KEY_CONFIG, &cfg, &len) == ESP_OK && len == sizeof(cfg) &&
+        cdc_config_valid(&cfg)) {
+        s_cdc_cfg = cfg;
+    }
+
+    usbd_cdc_match_t table[USBD_CDC_MAX_MATCH];
+    len = sizeof(table);
+    if (nvs_get_blob(nvs, CDC_NVS_KEY_MATCH, table, &len) == ESP_OK &&
+        len >= sizeof(usbd_cdc_match_t) && len % sizeof(usbd_cdc_match_t) == 0) {
+        memcpy(s_cdc_match, table, len);
+        s_cdc_match_count = len / sizeof(usbd_cdc_match_t);
+    }
+    nvs_close(nvs);
+
+    ESP_LOGI(TAG, "CDC参数: %"PRIu32" %u%c%s, IN缓冲区%u字节, OUT缓冲区%u字节, 匹配%u种设备",
+             s_cdc_cfg.baud_rate, s_cdc_cfg.data_bits, "NOEMS"[s_cdc_cfg.parity],
+             s_cdc_cfg.stop_bits == 0 ? "1" : (s_cdc_cfg.stop_bits == 1 ? "1.5" : "2"),
+             s_cdc_cfg.in_buffer_size, s_cdc_cfg.out_buffer_size, (unsigned)s_cdc_match_count);
+}
+
+void usbd_cdc_get_config(usbd_cdc_config_t *config)
+{
+    if (!config) {
+        return;
+    }
+    taskENTER_CRITICAL(&s_cfg_lock);
+    *config = s_cdc_cfg;
+    taskEXIT_CRITICAL(&s_cfg_lock);
+}
+
+esp_err_t usbd_cdc_set_config(const usbd_cdc_config_t *config)
+{
+    if (!config || !cdc_config_valid(config)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    taskENTER_CRITICAL(&s_cfg_lock);
+    s_cdc_cfg = *config;
+    taskEXIT_CRITICAL(&s_cfg_lock);
+
+    esp_err_t err = cdc_nvs_save(CDC_NVS_KEY_CONFIG, config, sizeof(*config));
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "保存CDC参数失败: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+size_t usbd_cdc_get_match_table(usbd_cdc_match_t *table)
+{
+    if (!table) {
+        return 0;
+    }
+    taskENTER_CRITICAL(&s_cfg_lock);
+    size_t count = s_cdc_match_count;
+    memcpy(table, s_cdc_match, count * sizeof(usbd_cdc_match_t));
+    taskEXIT_CRITICAL(&s_cfg_lock);
+    return count;
+}
+
+esp_err_t usbd_cdc_set_match_table(const usbd_cdc_match_t *table, size_t count)
 {
-    return s_cdc_dev.is_initialized && 
-           s_cdc_dev.state == CDC_DEVICE_STATE_CONNECTED && 
-           s_cdc_dev.cdc_hdl != NULL;
+    if (!table || count == 0 || count > USBD_CDC_MAX_MATCH) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    taskENTER_CRITICAL(&s_cfg_lock);
+    memcpy(s_cdc_match, table, count * sizeof(usbd_cdc_match_t));
+    s_cdc_match_count = count;
+    taskEXIT_CRITICAL(&s_cfg_lock);
+
+    esp_err_t err = cdc_nvs_save(CDC_NVS_KEY_MATCH, table, count * sizeof(usbd_cdc_match_t));
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "保存设备匹配表失败: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+void usbd_cdc_reopen(void)
+{
+    cdc_host_notify(CDC_NOTIFY_REOPEN);
+}
+
+void usbd_cdc_set_flow_query(usbd_cdc_flow_query_t query)
+{
+    s_cdc_dev.flow_query = query;
+    usbd_cdc_flow_update();
+}
+
+void usbd_cdc_flow_update(void)
+{
+    cdc_host_notify(CDC_NOTIFY_FLOW);
+}
+
+bool usbd_cdc_rx_paused(uint8_t dev)
+{
+    return dev < USBD_CDC_MAX_DEVICES && s_cdc_dev.ports[dev].rx_paused;
+}
+
+bool usbd_cdc_is_connected(uint8_t dev)
+{
+    return s_cdc_dev.is_initialized && dev < USBD_CDC_MAX_DEVICES &&
+           s_cdc_dev.ports[dev].state == CDC_DEVICE_STATE_CONNECTED && 
+           s_cdc_dev.ports[dev].cdc_hdl != NULL;
+}
+
+uint32_t usbd_cdc_connected_mask(void)
+{
+    uint32_t mask = 0;
+    for (uint8_t i = 0; i < USBD_CDC_MAX_DEVICES; i++) {
+        if (usbd_cdc_is_connected(i)) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+}
+
+bool usbd_cdc_get_device_info(uint8_t dev, usbd_cdc_device_info_t *info)
+{
+    if (!info || dev >= USBD_CDC_MAX_DEVICES) {
+        return false;
+    }
+    const cdc_port_t *port = &s_cdc_dev.ports[dev];
+    info->connected = usbd_cdc_is_connected(dev);
+    info->vid = port->vid;
+    info->pid = port->pid;
+    info->rx_paused = port->rx_paused;
+    info->rx_bytes = port->rx_bytes;
+    info->tx_bytes = port->tx_bytes;
+    return true;
 }
 
 esp_err_t usbd_cdc_deinit(void)
@@ -360,6 +982,7 @@ esp_err_t usbd_cdc_deinit(void)
     
     // 标记为未初始化，通知任务退出
     s_cdc_dev.is_initialized = false;
+    cdc_host_notify(CDC_NOTIFY_EXIT);
     
     // 等待任务退出
     int timeout_count = CDC_TASK_EXIT_TIMEOUT_MS / 100; // 转换为100ms的计数
@@ -375,10 +998,16 @@ esp_err_t usbd_cdc_deinit(void)
         s_cdc_dev.task_handle = NULL;
     }
     
+    // 停止异步发送
+    cdc_tx_queue_deinit(&s_cdc_dev);
+
     // 关闭CDC设备
-    if (s_cdc_dev.cdc_hdl) {
-        cdc_acm_host_close(s_cdc_dev.cdc_hdl);
-        s_cdc_dev.cdc_hdl = NULL;
+    for (int i = 0; i < USBD_CDC_MAX_DEVICES; i++) {
+        cdc_port_t *port = &s_cdc_dev.ports[i];
+        if (port->cdc_hdl) {
+            cdc_acm_host_close(port->cdc_hdl);
+            port->cdc_hdl = NULL;
+        }
     }
     
     // 卸载CDC ACM Host驱动
@@ -387,16 +1016,8 @@ esp_err_t usbd_cdc_deinit(void)
     // 卸载USB Host
     usb_host_uninstall();
     
-    // 删除互斥锁和信号量
-    if (s_cdc_dev.mutex) {
-        vSemaphoreDelete(s_cdc_dev.mutex);
-        s_cdc_dev.mutex = NULL;
-    }
-    
-    if (device_disconnected_sem) {
-        vSemaphoreDelete(device_disconnected_sem);
-        device_disconnected_sem = NULL;
-    }
+    // 删除互斥锁
+    cdc_port_mutex_delete();
     
     ESP_LOGI(TAG, "USB CDC Host已反初始化");
     return ESP_OK;
@@ -7,10 +7,60 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "esp_err.h"
+#include "sdkconfig.h"
 
-// 接收数据的回调函数类型
-typedef void (*usbd_cdc_rx_callback_t)(const uint8_t* data, size_t len);
+// 同时打开的设备数上限，设备编号为0到USBD_CDC_MAX_DEVICES-1
+#define USBD_CDC_MAX_DEVICES    CONFIG_CDC_MAX_DEVICES
+
+// 接收数据的回调函数类型 (dev为设备编号)
+typedef void (*usbd_cdc_rx_callback_t)(uint8_t dev, const uint8_t* data, size_t len);
+
+// 异步发送完成回调 (在CDC发送任务中调用，不应阻塞)
+typedef void (*usbd_cdc_tx_done_cb_t)(uint32_t id, esp_err_t result, size_t len, void *arg);
+
+// 设备匹配表最大条目数
+#define USBD_CDC_MAX_MATCH      8
+
+// 串口与传输参数 (保存在NVS中，下次打开设备时生效)
+typedef struct {
+    uint32_t baud_rate;         // 波特率
+    uint8_t data_bits;          // 数据位 (5/6/7/8/16)
+    uint8_t parity;             // 0无校验 1奇 2偶 3mark 4space
+    uint8_t stop_bits;          // 0为1位 1为1.5位 2为2位 (CDC bCharFormat)
+    uint16_t in_buffer_size;    // IN传输缓冲区大小 (64的整数倍)
+    uint16_t out_buffer_size;   // OUT传输缓冲区大小 (不小于发送数据块)
+} usbd_cdc_config_t;
+
+// 允许打开的设备
+typedef struct {
+    uint16_t vid;
+    uint16_t pid;
+} usbd_cdc_match_t;
+
+// 流控查询函数，返回true表示要求该设备暂停发送 (RTS无效)
+typedef bool (*usbd_cdc_flow_query_t)(uint8_t dev);
+
+// 单个设备的状态
+typedef struct {
+    bool connected;
+    bool rx_paused;             // 已通过RTS要求设备暂停发送
+    uint16_t vid;               // 最近一次打开的设备
+    uint16_t pid;
+    uint64_t rx_bytes;          // 累计接收字节数
+    uint64_t tx_bytes;          // 累计发送字节数
+} usbd_cdc_device_info_t;
+
+// 异步发送统计信息
+typedef struct {
+    uint32_t transfers;         // 完成的OUT传输次数 (合并后)
+    uint32_t requests_ok;       // 发送成功的请求数
+    uint32_t requests_failed;   // 发送失败的请求数
+    uint32_t requests_rejected; // 因队列已满被拒绝的请求数
+    uint32_t queued_blocks;     // 当前排队的数据块数
+    uint64_t bytes;             // 发送的字节数
+} usbd_cdc_tx_stats_t;
 
 /**
  * @brief 初始化USB CDC Host
@@ -23,19 +73,115 @@ esp_err_t usbd_cdc_init(usbd_cdc_rx_callback_t rx_cb);
 /**
  * @brief 发送数据到USB CDC设备
  * 
+ * @param dev 设备编号
  * @param data 要发送的数据
  * @param len 数据长度
  * @return esp_err_t ESP_OK成功，其他失败
  */
-esp_err_t usbd_cdc_send_data(const uint8_t* data, size_t len);
+esp_err_t usbd_cdc_send_data(uint8_t dev, const uint8_t* data, size_t len);
+
+/**
+ * @brief 异步发送数据到USB CDC设备
+ *
+ * 数据被拷贝到发送队列后立即返回，由CDC发送任务按顺序连续发送，
+ * 结果通过done_cb通知。队列空间不足或超过该设备的份额时不等待，直接返回ESP_ERR_NO_MEM。
+ *
+ * @param dev 设备编号
+ * @param data 要发送的数据
+ * @param len 数据长度
+ * @param id 请求编号，原样传给done_cb
+ * @param done_cb 完成回调 (可为NULL)
+ * @param arg 回调参数
+ * @return esp_err_t ESP_OK已入队，ESP_ERR_NO_MEM队列已满，ESP_ERR_NOT_FOUND设备未连接
+ */
+esp_err_t usbd_cdc_send_async(uint8_t dev, const uint8_t *data, size_t len, uint32_t id,
+                              usbd_cdc_tx_done_cb_t done_cb, void *arg);
+
+/**
+ * @brief 获取异步发送统计信息
+ *
+ * @param stats 输出的统计信息
+ */
+void usbd_cdc_get_tx_stats(usbd_cdc_tx_stats_t *stats);
+
+/**
+ * @brief 获取当前的串口与传输参数
+ *
+ * @param config 输出的参数
+ */
+void usbd_cdc_get_config(usbd_cdc_config_t *config);
+
+/**
+ * @brief 设置串口与传输参数并保存到NVS，下次打开设备时生效
+ *
+ * @param config 参数
+ * @return esp_err_t ESP_OK成功，ESP_ERR_INVALID_ARG参数无效
+ */
+esp_err_t usbd_cdc_set_config(const usbd_cdc_config_t *config);
+
+/**
+ * @brief 获取设备匹配表
+ *
+ * @param table 输出的匹配表 (至少USBD_CDC_MAX_MATCH项)
+ * @return size_t 条目数
+ */
+size_t usbd_cdc_get_match_table(usbd_cdc_match_t *table);
+
+/**
+ * @brief 设置设备匹配表并保存到NVS，新接入的设备按新表匹配
+ *
+ * @param table 匹配表
+ * @param count 条目数 (1到USBD_CDC_MAX_MATCH)
+ * @return esp_err_t ESP_OK成功，ESP_ERR_INVALID_ARG参数无效
+ */
+esp_err_t usbd_cdc_set_match_table(const usbd_cdc_match_t *table, size_t count);
+
+/**
+ * @brief 关闭所有设备并按新参数重新打开 (不阻塞)
+ */
+void usbd_cdc_reopen(void);
+
+/**
+ * @brief 设置流控查询函数 (NULL表示不流控，RTS始终有效)
+ *
+ * @param query 查询函数
+ */
+void usbd_cdc_set_flow_query(usbd_cdc_flow_query_t query);
+
+/**
+ * @brief 通知流控状态可能已变化，由CDC Host任务查询后更新RTS (不阻塞，可在回调中调用)
+ */
+void usbd_cdc_flow_update(void);
+
+/**
+ * @brief 当前是否已通过RTS要求设备暂停发送
+ *
+ * @param dev 设备编号
+ */
+bool usbd_cdc_rx_paused(uint8_t dev);
 
 /**
  * @brief 检查USB CDC设备是否已连接
  * 
+ * @param dev 设备编号
  * @return true 已连接
  * @return false 未连接
  */
-bool usbd_cdc_is_connected(void);
+bool usbd_cdc_is_connected(uint8_t dev);
+
+/**
+ * @brief 获取已连接设备的掩码 (bit N对应设备N)
+ */
+uint32_t usbd_cdc_connected_mask(void);
+
+/**
+ * @brief 获取单个设备的状态
+ *
+ * @param dev 设备编号
+ * @param info 输出的状态
+ * @return true 成功，false 设备编号无效
+ */
+bool usbd_cdc_get_device_info(uint8_t dev, usbd_cdc_device_info_t *info);
 
 /**
  * @brief 反初始化USB CDC Host
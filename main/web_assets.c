@@ -0,0 +1,343 @@
+/*
+ * @Description: 静态网页资源实现
+ *
+ * 资源表只在HTTP服务器任务中读写 (初始化和处理函数)，不需要加锁。
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "http_server.h"
+#include "web_assets.h"
+#ifdef CONFIG_WEB_ASSETS_PARTITION
+#include "esp_partition.h"
+#else
+#include <sys/stat.h>
+#include "esp_spiffs.h"
+#include "mem_pool.h"
+#endif
+
+static const char *TAG = "web_assets";
+
+#define WEB_ASSET_NAME_MAX      28      // SPIFFS文件名上限32字节，含开头的'/'和".gz"
+#define WEB_ASSET_ETAG_MAX      20      // 带引号的16个十六进制字符
+
+typedef struct {
+    char name[WEB_ASSET_NAME_MAX];      // 相对路径，例如"index.html"
+    char etag[WEB_ASSET_ETAG_MAX];      // 带引号的强ETag
+    size_t size;                        // 压缩后大小
+#ifdef CONFIG_WEB_ASSETS_PARTITION
+    const char *data;                   // 映射后的压缩内容
+#endif
+} web_asset_t;
+
+static web_asset_t s_assets[CONFIG_WEB_ASSETS_MAX];
+static int s_asset_count;
+static char s_cache_control[32];
+static bool s_load_tried;
+static esp_err_t s_load_ret = ESP_ERR_INVALID_STATE;
+
+static const struct {
+    const char *ext;
+    const char *type;
+} s_mime_types[] = {
+    { ".html", "text/html; charset=utf-8" },
+    { ".js",   "application/javascript" },
+    { ".css",  "text/css" },
+    { ".json", "application/json" },
+    { ".svg",  "image/svg+xml" },
+    { ".png",  "image/png" },
+    { ".ico",  "image/x-icon" },
+};
+
+static const char *web_asset_mime_type(const char *name)
+{
+    const char *ext = strrchr(name, '.');
+    if (ext != NULL) {
+        for (size_t i = 0; i < sizeof(s_mime_types) / sizeof(s_mime_types[0]); i++) {
+            if (strcmp(ext, s_mime_types[i].ext) == 0) {
+                return s_mime_types[i].type;
+            }
+        }
+    }
+    return "application/octet-stream";
+}
+
+static bool web_asset_is_html(const char *name)
+{
+    const char *ext = strrchr(name, '.');
+    return ext != NULL && strcmp(ext, ".html") == 0;
+}
+
+static const web_asset_t *web_asset_find(const char *name)
+{
+    for (int i = 0; i < s_asset_count; i++) {
+        if (strcmp(s_assets[i].name, name) == 0) {
+            return &s_assets[i];
+        }
+    }
+    return NULL;
+}
+
+#ifdef CONFIG_WEB_ASSETS_PARTITION
+#define WEB_ASSETS_PARTITION    "www"
+#define WEB_PACK_MAGIC          0x314B5057      // "WPK1"
+
+// www分区镜像格式 (由tools/gzip_assets.py --pack生成，小端)
+typedef struct {
+    uint32_t magic;
+    uint32_t count;             // 资源数
+    uint32_t total;             // 镜像总长
+    uint32_t reserved;
+} web_pack_header_t;
+
+typedef struct {
+    char name[WEB_ASSET_NAME_MAX];
+    char etag[WEB_ASSET_ETAG_MAX];
+    uint32_t offset;            // 数据相对镜像开头的偏移
+    uint32_t size;
+} web_pack_entry_t;
+
+_Static_assert(sizeof(web_pack_entry_t) == 56, "与tools/gzip_assets.py中的索引格式一致");
+
+// 映射www分区，资源表直接指向映射后的数据，发送时不再复制
+static esp_err_t web_assets_load(void)
+{
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                                           WEB_ASSETS_PARTITION);
+    if (part == NULL) {
+        ESP_LOGE(TAG, "未找到网页资源分区 %s", WEB_ASSETS_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    web_pack_header_t hdr;
+    esp_err_t ret = esp_partition_read(part, 0, &hdr, sizeof(hdr));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (hdr.magic != WEB_PACK_MAGIC || hdr.total > part->size ||
+        hdr.count > (hdr.total - sizeof(hdr)) / sizeof(web_pack_entry_t)) {
+        ESP_LOGE(TAG, "网页资源分区内容无效 (未烧录www.bin?)");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // 只映射镜像实际大小，映射在程序运行期间一直保留
+    const void *map;
+    esp_partition_mmap_handle_t handle;
+    ret = esp_partition_mmap(part, 0, hdr.total, ESP_PARTITION_MMAP_DATA, &map, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "映射网页资源分区失败: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    const web_pack_entry_t *entries = (const web_pack_entry_t *)((const char *)map + sizeof(hdr));
+    s_asset_count = 0;
+    for (uint32_t i = 0; i < hdr.count && s_asset_count < CONFIG_WEB_ASSETS_MAX; i++) {
+        const web_pack_entry_t *e = &entries[i];
+        if (e->offset > hdr.total || e->size > hdr.total - e->offset ||
+            memchr(e->name, '\0', sizeof(e->name)) == NULL || memchr(e->etag, '\0', sizeof(e->etag)) == NULL) {
+            ESP_LOGW(TAG, "跳过无效的资源索引 %"PRIu32, i);
+            continue;
+        }
+        web_asset_t *asset = &s_assets[s_asset_count++];
+        memcpy(asset->name, e->name, sizeof(asset->name));
+        memcpy(asset->etag, e->etag, sizeof(asset->etag));
+        asset->size = e->size;
+        asset->data = (const char *)map + e->offset;
+    }
+    if (hdr.count > CONFIG_WEB_ASSETS_MAX) {
+        ESP_LOGW(TAG, "资源数超过上限%d，其余资源被忽略", CONFIG_WEB_ASSETS_MAX);
+    }
+
+    ESP_LOGI(TAG, "已映射%d个网页资源 (%"PRIu32"字节)", s_asset_count, hdr.total);
+    return ESP_OK;
+}
+
+#else /* CONFIG_WEB_ASSETS_SPIFFS */
+#define WEB_ASSETS_MANIFEST     WEB_ASSETS_BASE_PATH "/assets.idx"
+
+// 挂载SPIFFS并读取资源清单
+static esp_err_t web_assets_load(void)
+{
+    // 处理函数同时只打开一个资源文件
+    esp_vfs_spiffs_conf_t conf = {
+        .base_path = WEB_ASSETS_BASE_PATH,
+        .partition_label = NULL,
+        .max_files = 2,
+        .format_if_mount_failed = false
+    };
+
+    esp_err_t ret = esp_vfs_spiffs_register(&conf);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "挂载SPIFFS失败: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    FILE *fd = fopen(WEB_ASSETS_MANIFEST, "r");
+    if (fd == NULL) {
+        ESP_LOGE(TAG, "资源清单%s不存在", WEB_ASSETS_MANIFEST);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    char line[64];
+    s_asset_count = 0;
+    while (fgets(line, sizeof(line), fd) != NULL) {
+        web_asset_t *asset = &s_assets[s_asset_count];
+        char etag[WEB_ASSET_ETAG_MAX - 2];
+        if (sscanf(line, "%27s %17s", asset->name, etag) != 2) {
+            continue;
+        }
+
+        char path[FILE_PATH_MAX];
+        struct stat st;
+        snprintf(path, sizeof(path), WEB_ASSETS_BASE_PATH "/%s.gz", asset->name);
+        if (stat(path, &st) != 0) {
+            ESP_LOGW(TAG, "资源文件%s不存在", path);
+            continue;
+        }
+        snprintf(asset->etag, sizeof(asset->etag), "\"%s\"", etag);
+        asset->size = st.st_size;
+
+        if (++s_asset_count == CONFIG_WEB_ASSETS_MAX) {
+            ESP_LOGW(TAG, "资源数超过上限%d，其余资源被忽略", CONFIG_WEB_ASSETS_MAX);
+            break;
+        }
+    }
+    fclose(fd);
+
+    ESP_LOGI(TAG, "已加载%d个网页资源", s_asset_count);
+    return ESP_OK;
+}
+#endif
+
+// 只尝试一次，失败后所有资源请求返回404
+static esp_err_t web_assets_ensure_loaded(void)
+{
+    if (!s_load_tried) {
+        s_load_tried = true;
+        s_load_ret = web_assets_load();
+    }
+    return s_load_ret;
+}
+
+esp_err_t web_assets_init(void)
+{
+    if (CONFIG_WEB_ASSET_MAX_AGE > 0) {
+        snprintf(s_cache_control, sizeof(s_cache_control), "public, max-age=%d", CONFIG_WEB_ASSET_MAX_AGE);
+    } else {
+        strlcpy(s_cache_control, "no-cache", sizeof(s_cache_control));
+    }
+
+#ifdef CONFIG_WEB_ASSETS_PARTITION
+    // 映射分区只是建立页表，启动时完成
+    return web_assets_ensure_loaded();
+#else
+    // SPIFFS在第一次请求网页资源时才挂载
+    return ESP_OK;
+#endif
+}
+
+// If-None-Match中是否包含该资源的ETag (可以是逗号分隔的列表或"*")
+static bool web_asset_not_modified(httpd_req_t *req, const web_asset_t *asset)
+{
+    char inm[96];
+    size_t len = httpd_req_get_hdr_value_len(req, "If-None-Match");
+    if (len == 0 || len >= sizeof(inm) ||
+        httpd_req_get_hdr_value_str(req, "If-None-Match", inm, sizeof(inm)) != ESP_OK) {
+        return false;
+    }
+    return strstr(inm, asset->etag) != NULL || strcmp(inm, "*") == 0;
+}
+
+esp_err_t web_assets_get_handler(httpd_req_t *req)
+{
+    // 去掉查询参数 (HTML中对资源的引用带有?v=<ETag>)，目录对应其下的index.html
+    char name[WEB_ASSET_NAME_MAX];
+    const char *uri = req->uri[0] == '/' ? req->uri + 1 : req->uri;
+    size_t len = strcspn(uri, "?#");
+    if (len >= sizeof(name)) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Not found");
+        return ESP_FAIL;
+    }
+    memcpy(name, uri, len);
+    name[len] = '\0';
+    if (len == 0 || name[len - 1] == '/') {
+        if (strlcpy(name + len, "index.html", sizeof(name) - len) >= sizeof(name) - len) {
+            httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Not found");
+            return ESP_FAIL;
+        }
+    }
+
+    const web_asset_t *asset = web_assets_ensure_loaded() == ESP_OK ? web_asset_find(name) : NULL;
+    if (asset == NULL) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Not found");
+        return ESP_FAIL;
+    }
+
+    // HTML每次都用ETag重新验证，其引用的资源URL随内容变化，可以按max-age缓存
+    httpd_resp_set_hdr(req, "ETag", asset->etag);
+    httpd_resp_set_hdr(req, "Cache-Control", web_asset_is_html(asset->name) ? "no-cache" : s_cache_control);
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+
+    if (web_asset_not_modified(req, asset)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    // 只有压缩后的版本，所有浏览器都支持gzip
+    httpd_resp_set_type(req, web_asset_mime_type(asset->name));
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+
+#ifdef CONFIG_WEB_ASSETS_PARTITION
+    // 直接从映射的Flash发送
+    if (httpd_resp_send(req, asset->data, asset->size) != ESP_OK) {
+        ESP_LOGE(TAG, "File sending failed!");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+#else
+    char path[FILE_PATH_MAX];
+    snprintf(path, sizeof(path), WEB_ASSETS_BASE_PATH "/%s.gz", asset->name);
+    FILE *fd = fopen(path, "r");
+    if (fd == NULL) {
+        ESP_LOGE(TAG, "Failed to read file : %s", path);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to read file");
+        return ESP_FAIL;
+    }
+
+    char *chunk = mem_pool_alloc(CHUNK_SIZE);
+    if (chunk == NULL) {
+        fclose(fd);
+        ESP_LOGE(TAG, "Failed to allocate memory for chunk");
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to allocate memory");
+        return ESP_FAIL;
+    }
+
+    esp_err_t ret = ESP_OK;
+    if (asset->size <= CHUNK_SIZE) {
+        // 一个缓冲区放得下时直接发送，响应带Content-Length
+        size_t n = fread(chunk, 1, CHUNK_SIZE, fd);
+        ret = httpd_resp_send(req, chunk, n);
+    } else {
+        size_t n;
+        while (ret == ESP_OK && (n = fread(chunk, 1, CHUNK_SIZE, fd)) > 0) {
+            ret = httpd_resp_send_chunk(req, chunk, n);
+        }
+        if (ret == ESP_OK) {
+            ret = httpd_resp_send_chunk(req, NULL, 0);
+        } else {
+            httpd_resp_sendstr_chunk(req, NULL);
+        }
+    }
+
+    mem_pool_free(chunk);
+    fclose(fd);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "File sending failed!");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+#endif
+}
@@ -0,0 +1,44 @@
+/*
+ * @Description: 静态网页资源头文件
+ *
+ * 网页资源在构建时由tools/gzip_assets.py压缩，默认打包为www分区镜像，
+ * 启动时映射分区后直接从Flash发送 (CONFIG_WEB_ASSETS_PARTITION)；
+ * 或者作为SPIFFS中的<路径>.gz文件，清单assets.idx给出路径和ETag，
+ * SPIFFS在第一次请求时才挂载 (CONFIG_WEB_ASSETS_SPIFFS)。
+ * 响应带Content-Encoding: gzip、强ETag和Cache-Control，
+ * If-None-Match与ETag相同时返回304。
+ */
+
+#ifndef WEB_ASSETS_H
+#define WEB_ASSETS_H
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// SPIFFS挂载点 (CONFIG_WEB_ASSETS_SPIFFS)
+#define WEB_ASSETS_BASE_PATH    "/spiffs"
+
+/**
+ * @brief 初始化资源表 (映射www分区；SPIFFS方式推迟到第一次请求)
+ *
+ * @return esp_err_t ESP_OK成功，ESP_ERR_NOT_FOUND没有www分区，ESP_ERR_INVALID_STATE分区中没有有效镜像
+ */
+esp_err_t web_assets_init(void);
+
+/**
+ * @brief 静态资源GET处理函数，"/"和以"/"结尾的路径对应其下的index.html
+ *
+ * @param req HTTP请求
+ * @return esp_err_t ESP_OK成功
+ */
+esp_err_t web_assets_get_handler(httpd_req_t *req);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WEB_ASSETS_H */
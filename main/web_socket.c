@@ -1,114 +1,630 @@
 #include "esp_http_server.h" 
 #include "esp_log.h"          
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <inttypes.h>
 #include "web_socket.h" 
 #include "usbd_cdc.h"
+#include "cdc_ring.h"
+#include "cdc_pipeline.h"
+#include "stream_codec.h"
+#include "stream_reduce.h"
+#include "task_config.h"
+#include "trace.h"
+#include "metrics.h"
+#include "latency.h"
+#include "app_event.h"
+#include "ws_ctrl.h"
+#include "net_profile.h"
+#include "time_sync.h"
+#include "mem_pool.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+#include "esp_timer.h"
 
 // WebSocket配置常量
 #define WS_URI "/ws"
 #define WS_MAX_PAYLOAD_LEN 1024
-#define WS_TASK_STACK_SIZE 4096
-#define WS_TASK_PRIORITY 2
 #define WS_QUEUE_SIZE 10
+#define WS_CTRL_MSG_MAX_LEN WEBSOCKET_TEXT_MAX_LEN
+
+// 多客户端配置
+#define WS_MAX_CLIENTS CONFIG_WS_MAX_CLIENTS
+#define WS_CLIENT_MAX_LOST_RECORDS CONFIG_WS_CLIENT_MAX_LOST_RECORDS
+#define WS_CLIENT_RETRY_MS 10
+
+// 接收配置
+#define WS_RX_CHUNK_SIZE CONFIG_WS_RX_CHUNK_SIZE
+#define WS_CLOSE_PROTOCOL_ERROR 1002
+#define WS_CLOSE_MESSAGE_TOO_BIG 1009
+#define WS_QUERY_MAX_LEN 128
+
+// 压缩配置
+#define WS_CODEC_BLOCK_SIZE CONFIG_WS_CODEC_BLOCK_SIZE
+
+// 降采样配置
+#define WS_REDUCE_RECORDS_PER_ROUND 64     // 每轮最多处理的记录数，避免长时间占用客户端表
+#define WS_REDUCE_MSG_MAX_LEN 512
+#define WS_REDUCE_MAX_DECIMATE 10000
+#define WS_REDUCE_MAX_WINDOW_MS 60000
+
+// 批量发送配置 (可在运行时通过websocket_set_batch_config修改)
+#define WS_BATCH_MAX_FRAME_LEN CONFIG_WS_BATCH_MAX_FRAME_LEN
+#define WS_BATCH_FLUSH_BYTES CONFIG_WS_BATCH_FLUSH_BYTES
+#define WS_BATCH_FLUSH_TIMEOUT_MS CONFIG_WS_BATCH_FLUSH_TIMEOUT_MS
 
 // 数据处理常量
-#define WS_SEND_DELAY_MS 5
 #define WS_TEXT_DETECTION_MIN_CHAR 32
 #define WS_TEXT_DETECTION_MAX_CHAR 127
 
 static const char *TAG = "web_socket";
 
-// WebSocket消息类型
-typedef enum {
-    WS_MSG_TEXT,
-    WS_MSG_BINARY
-} ws_msg_type_t;
-
-// WebSocket消息结构
+// WebSocket控制消息结构 (数据内联存放，入队时由队列拷贝，无需动态分配；
+// 超过内联长度的控制协议响应放在mem_pool块中，由发送任务发送后释放)
 typedef struct {
-    ws_msg_type_t type;
-    void *data;
+    char data[WS_CTRL_MSG_MAX_LEN];
+    uint8_t *ext;               // 非NULL时数据在此块中
     size_t len;
+    httpd_ws_type_t type;       // 文本帧，或控制协议的二进制响应
+    int fd;                     // 目标客户端，-1表示广播
+    uint32_t session;           // 目标连接编号，0表示不检查 (异步响应用，防止发给复用了fd的新连接)
+    bool status_only;           // 只发给订阅了状态通道的客户端
 } ws_msg_t;
 
+// WebSocket客户端
+typedef struct {
+    int fd;                     // 套接字
+    uint32_t session;           // 连接编号，每次连接递增，fd被复用时区分新旧连接
+    int reader;                 // 在CDC环形缓冲区中的读者编号，-1表示不订阅数据 (dev=none)
+    bool active;
+    bool status;                // 是否订阅状态通道 (/ws?status=1)
+    bool ctrl;                  // 二进制帧按控制协议解析 (/ws?ctrl=1)
+    uint32_t frames_sent;
+    uint32_t throttled;         // 因套接字不可写而跳过的次数
+    uint32_t lost_records;      // 因发送过慢被覆盖而丢失的记录数
+    uint32_t tx_seq;            // 发往CDC设备的消息编号
+    httpd_ws_type_t rx_type;    // 正在接收的分片消息类型，CONTINUE表示无
+    ws_encoding_t encoding;     // 连接时协商的数据帧类型
+    bool compress;              // 是否使用压缩编码 (/ws?codec=lz4)
+    bool envelope;              // 数据帧前加ws_envelope_hdr_t (/ws?envelope=1)
+    stream_reduce_t reduce;     // 降采样订阅，NONE表示全速率
+    uint32_t devices;           // 订阅的设备掩码
+    uint8_t tx_dev;             // 客户端发来的数据转发到的设备
+    uint8_t last_dev;           // 上一帧数据所属的设备 (订阅多个设备时用于插入设备切换消息)
+    bool replay_pending;        // 回放起点消息尚未发送 (由发送任务在第一帧数据前发送)
+    uint32_t replay_live_seq;   // 连接时的最新记录序号
+    uint64_t bytes_sent;
+} ws_client_t;
+
 // WebSocket上下文
 typedef struct {
     httpd_handle_t server;
-    int client_fd;
-    bool connected;
+    ws_client_t clients[WS_MAX_CLIENTS];
+    SemaphoreHandle_t lock;     // 保护客户端表 (套接字写入期间不持有)
     QueueHandle_t msg_queue;
     TaskHandle_t task_handle;
+    ws_batch_config_t batch;
+    ws_stream_stats_t stats;
+    uint32_t next_session;      // 上一次分配的连接编号 (持锁访问)
+    int tx_fd;                  // 发送任务正在不持锁写入的套接字，-1表示没有 (持锁访问)
+    bool tx_close_pending;      // 写入期间会话已关闭，写入结束后由发送任务关闭套接字
+    bool profile_pending;       // 网络配置已切换，待发送任务更新套接字选项 (原子访问)
 } ws_ctx_t;
 
-static ws_ctx_t ws_ctx = {0};
+// 连接参数 (/ws?...)
+typedef struct {
+    ws_encoding_t encoding;
+    bool compress;
+    bool envelope;
+    bool replay;                // 是否从历史数据开始
+    uint32_t start_seq;         // 回放起始记录序号
+    int64_t since_us;           // 按时间回放的起点，0表示按序号
+    uint32_t devices;           // 订阅的设备掩码
+    int tx_dev;                 // 转发目标设备，-1表示按订阅选择
+    bool status;                // 订阅状态通道
+    bool ctrl;                  // 使用二进制控制协议
+    stream_reduce_config_t reduce;
+} ws_session_opts_t;
+
+// 数据帧类型名称，与ws_encoding_t顺序一致
+static const char *const ws_encoding_names[] = { "auto", "binary", "text" };
+
+// 按名称查找数据帧类型
+static bool ws_encoding_from_name(const char *name, ws_encoding_t *encoding) {
+    for (int i = 0; i < sizeof(ws_encoding_names) / sizeof(ws_encoding_names[0]); i++) {
+        if (strcmp(name, ws_encoding_names[i]) == 0) {
+            *encoding = (ws_encoding_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// 压缩输出缓冲区及其对应的切片 (只在发送任务中使用)
+static uint8_t s_codec_buf[STREAM_CODEC_BOUND(WS_CODEC_BLOCK_SIZE)];
+static struct {
+    uint32_t first_seq;
+    uint32_t count;
+    size_t src_len;
+    size_t len;
+    bool is_text;
+    uint8_t dev;
+} s_codec_cache;
+
+// 数据信封输出缓冲区 (只在发送任务中使用)，信封客户端每帧同样不超过一个压缩块
+static uint8_t s_envelope_buf[sizeof(ws_envelope_hdr_t) + STREAM_CODEC_BOUND(WS_CODEC_BLOCK_SIZE)];
+
+// 聚合结果输出缓冲区 (只在发送任务中使用)
+static char s_reduce_msg[WS_REDUCE_MSG_MAX_LEN];
 
-// 辅助函数：检查数据是否为文本格式
+// 接收缓冲区，大小固定，与消息总长度无关
+static uint8_t s_rx_chunk[WS_RX_CHUNK_SIZE + 1];
+
+// 控制协议响应缓冲区 (只在httpd任务中使用)
+static uint8_t s_ctrl_resp[WS_CTRL_MAX_RESPONSE];
+
+static ws_ctx_t ws_ctx = {
+    .batch = {
+        .max_frame_len = WS_BATCH_MAX_FRAME_LEN,
+        .flush_bytes = WS_BATCH_FLUSH_BYTES,
+        .flush_timeout_ms = WS_BATCH_FLUSH_TIMEOUT_MS,
+    },
+};
+
+// 检查单个字节是否为文本字符 (可打印ASCII或\r\n\t)
+static inline bool is_text_byte(uint8_t byte) {
+    bool is_printable = (byte >= WS_TEXT_DETECTION_MIN_CHAR && byte <= WS_TEXT_DETECTION_MAX_CHAR);
+    bool is_whitespace = (byte == '\r' || byte == '\n' || byte == '\t');
+    return is_printable || is_whitespace;
+}
+
+// 辅助函数：检查数据是否为文本格式，每次检查4个字节
 static bool is_data_text_format(const uint8_t *data, size_t len) {
-    for (size_t i = 0; i < len; i++) {
-        uint8_t byte = data[i];
-        // 检查是否包含非ASCII字符或控制字符(除了\r\n\t)
-        bool is_printable = (byte >= WS_TEXT_DETECTION_MIN_CHAR && byte <= WS_TEXT_DETECTION_MAX_CHAR);
-        bool is_whitespace = (byte == '\r' || byte == '\n' || byte == '\t');
+    size_t i = 0;
 
-        if (!is_printable && !is_whitespace) {
+    for (; i + sizeof(uint32_t) <= len; i += sizeof(uint32_t)) {
+        uint32_t w;
+        memcpy(&w, data + i, sizeof(w));
+        // 有非ASCII字节 (最高位为1) 直接判定为二进制
+        if (w & 0x80808080u) {
+            return false;
+        }
+        // 有小于0x20的字节时逐字节确认是否为\r\n\t
+        if ((w - 0x20202020u) & ~w & 0x80808080u) {
+            for (size_t k = 0; k < sizeof(uint32_t); k++) {
+                if (!is_text_byte(data[i + k])) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    for (; i < len; i++) {
+        if (!is_text_byte(data[i])) {
             return false;
         }
     }
     return true;
 }
 
+// 唤醒发送任务
+static inline void ws_wake_send_task(void) {
+    if (ws_ctx.task_handle != NULL) {
+        xTaskNotifyGive(ws_ctx.task_handle);
+    }
+}
+
+// 新记录写入后只在开始新一批数据(需要启动截止计时)或达到批量阈值时唤醒发送任务
+static void ws_ring_notify(uint32_t pending_records, size_t pending_bytes) {
+    if (pending_records == 1 || pending_bytes >= ws_ctx.batch.flush_bytes) {
+        ws_wake_send_task();
+    }
+}
+
+// 检查套接字当前是否可写 (不阻塞)
+static bool ws_client_writable(int fd) {
+    fd_set wfds;
+    FD_ZERO(&wfds);
+    FD_SET(fd, &wfds);
+    struct timeval tv = { 0 };
+    return select(fd + 1, NULL, &wfds, NULL, &tv) > 0;
+}
+
+// 移除客户端 (需持有锁)
+static void ws_client_remove_locked(ws_ctx_t *ctx, ws_client_t *client) {
+    if (!client->active) {
+        return;
+    }
+    cdc_ring_reader_close(client->reader);
+    ESP_LOGI(TAG, "WebSocket客户端已移除，fd=%d, 发送%"PRIu32"帧, 丢失%"PRIu32"条记录",
+             client->fd, client->frames_sent, client->lost_records);
+    app_event_post(APP_EVENT_WS_CLIENT_DISCONNECTED, &client->fd, sizeof(client->fd));
+    memset(client, 0, sizeof(ws_client_t));
+    client->fd = -1;
+    client->reader = -1;
+}
+
+// 断开客户端 (需持有锁)，会话关闭由httpd异步完成
+static void ws_client_drop_locked(ws_ctx_t *ctx, ws_client_t *client) {
+    int fd = client->fd;
+    ws_client_remove_locked(ctx, client);
+    httpd_sess_trigger_close(ctx->server, fd);
+}
+
+// 向单个客户端发送一帧数据 (只在发送任务中调用，需持有锁)
+// 套接字写入可能阻塞到httpd发送超时，写入期间释放锁，慢客户端不会阻塞httpd任务和事件循环；
+// 会话在此期间关闭时套接字推迟到写入结束后关闭，fd不会被新连接复用。
+// 返回ESP_ERR_INVALID_STATE表示写入期间客户端已被移除，调用者不能再使用其读者
+static esp_err_t ws_send_frame(ws_ctx_t *ctx, ws_client_t *client, httpd_ws_type_t type,
+                               const uint8_t *data, size_t len) {
+    httpd_ws_frame_t ws_frame = {
+        .final = true,
+        .fragmented = false,
+        .type = type,
+        .payload = (uint8_t *)data,
+        .len = len
+    };
+    int fd = client->fd;
+    uint32_t session = client->session;
+
+    ctx->tx_fd = fd;
+    xSemaphoreGive(ctx->lock);
+    esp_err_t ret = httpd_ws_send_frame_async(ctx->server, fd, &ws_frame);
+    xSemaphoreTake(ctx->lock, portMAX_DELAY);
+    ctx->tx_fd = -1;
+    if (ctx->tx_close_pending) {
+        ctx->tx_close_pending = false;
+        close(fd);
+    }
+    if (!client->active || client->session != session) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (ret != ESP_OK) {
+        // 只断开发送失败的客户端，不影响其他客户端
+        ESP_LOGE(TAG, "WebSocket发送失败(fd=%d): %s", client->fd, esp_err_to_name(ret));
+        metrics_add(METRIC_WS_SEND_ERRORS, 1);
+        ws_client_drop_locked(ctx, client);
+    } else {
+        client->frames_sent++;
+        client->bytes_sent += len;
+        ctx->stats.frames_sent++;
+        ctx->stats.bytes_sent += len;
+        TRACE_EVENT(TRACE_EVT_WS_SEND, client->fd, len);
+        metrics_add(METRIC_WS_SENT_FRAMES, 1);
+        metrics_add(METRIC_WS_SENT_BYTES, len);
+    }
+    return ret;
+}
+
+// 向所有客户端(fd为-1)或指定客户端发送控制消息，status_only时跳过未订阅状态通道的客户端
+static void ws_broadcast_msg(ws_ctx_t *ctx, const ws_msg_t *msg) {
+    xSemaphoreTake(ctx->lock, portMAX_DELAY);
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+        ws_client_t *client = &ctx->clients[i];
+        if (client->active && (msg->fd < 0 || client->fd == msg->fd) &&
+            (msg->session == 0 || client->session == msg->session) && (!msg->status_only || client->status)) {
+            ws_send_frame(ctx, client, msg->type, msg->ext ? msg->ext : (const uint8_t *)msg->data, msg->len);
+        }
+    }
+    xSemaphoreGive(ctx->lock);
+    mem_pool_free(msg->ext);
+}
+
+// 压缩一个切片，多个压缩客户端位于同一位置时复用上一次的结果
+static const uint8_t *ws_codec_encode(const cdc_ring_slice_t *slice, bool is_text, size_t *out_len) {
+    if (s_codec_cache.len == 0 || s_codec_cache.first_seq != slice->first_seq ||
+        s_codec_cache.count != slice->count || s_codec_cache.src_len != slice->len ||
+        s_codec_cache.is_text != is_text || s_codec_cache.dev != slice->dev) {
+        s_codec_cache.len = stream_codec_encode(slice->data, slice->len, is_text,
+                                                s_codec_buf, sizeof(s_codec_buf));
+        s_codec_cache.first_seq = slice->first_seq;
+        s_codec_cache.count = slice->count;
+        s_codec_cache.src_len = slice->len;
+        s_codec_cache.is_text = is_text;
+        s_codec_cache.dev = slice->dev;
+    }
+    *out_len = s_codec_cache.len;
+    return s_codec_buf;
+}
+
+// 单条记录必须能放进一个压缩块，否则ws_client_flush取出的第一条记录可能超过压缩和信封缓冲区
+_Static_assert(CONFIG_CDC_RING_MAX_RECORD_LEN <= WS_CODEC_BLOCK_SIZE,
+               "CDC_RING_MAX_RECORD_LEN不能超过WS_CODEC_BLOCK_SIZE");
+
+// 在切片数据 (或其压缩结果) 前加上信封报头，超过一个压缩块时返回NULL
+static const uint8_t *ws_envelope_wrap(const cdc_ring_slice_t *slice, uint8_t flags,
+                                       const uint8_t *payload, size_t *len) {
+    if (slice->len > WS_CODEC_BLOCK_SIZE || *len > sizeof(s_envelope_buf) - sizeof(ws_envelope_hdr_t)) {
+        return NULL;
+    }
+    ws_envelope_hdr_t hdr = {
+        .magic = WS_ENVELOPE_MAGIC,
+        .hdr_len = sizeof(ws_envelope_hdr_t),
+        .flags = flags,
+        .dev = slice->dev,
+        .seq = slice->first_seq,
+        .count = (uint16_t)slice->count,
+        .len = (uint16_t)*len,
+        .timestamp_us = slice->timestamp_us,
+    };
+    int64_t unix_us;
+    if (time_sync_unix_us(slice->timestamp_us, &unix_us)) {
+        hdr.timestamp_us = unix_us;
+        hdr.flags |= WS_ENVELOPE_FLAG_UNIX;
+    }
+    memcpy(s_envelope_buf, &hdr, sizeof(hdr));
+    memcpy(s_envelope_buf + sizeof(hdr), payload, *len);
+    *len += sizeof(hdr);
+    return s_envelope_buf;
+}
+
+// 发送一个切片并释放 (需持有锁)
+static esp_err_t ws_client_send_slice(ws_ctx_t *ctx, ws_client_t *client, const cdc_ring_slice_t *slice) {
+    // 按协商的模式确定帧类型，只有auto模式且类型未知时才检查数据
+    bool is_text;
+    if (client->encoding == WS_ENCODING_BINARY) {
+        is_text = false;
+    } else if (client->encoding == WS_ENCODING_TEXT) {
+        is_text = true;
+    } else if (slice->flags & CDC_RING_FLAG_TEXT) {
+        is_text = true;
+    } else if (slice->flags & CDC_RING_FLAG_BINARY) {
+        is_text = false;
+    } else {
+        is_text = is_data_text_format(slice->data, slice->len);
+    }
+
+    httpd_ws_type_t type = is_text ? HTTPD_WS_TYPE_TEXT : HTTPD_WS_TYPE_BINARY;
+    const uint8_t *payload = slice->data;
+    size_t payload_len = slice->len;
+    if (client->compress) {
+        payload = ws_codec_encode(slice, is_text, &payload_len);
+        type = HTTPD_WS_TYPE_BINARY;
+    }
+    if (client->envelope) {
+        uint8_t flags = (is_text ? WS_ENVELOPE_FLAG_TEXT : 0) | (client->compress ? WS_ENVELOPE_FLAG_LZ4 : 0);
+        payload = ws_envelope_wrap(slice, flags, payload, &payload_len);
+        if (payload == NULL) {
+            ESP_LOGW(TAG, "数据过长(%u字节)，跳过信封帧(fd=%d)", (unsigned)slice->len, client->fd);
+            client->lost_records += slice->count;
+            ctx->stats.records_lost += slice->count;
+            metrics_add(METRIC_LOST_RECORDS, slice->count);
+            cdc_ring_consume(client->reader, slice);
+            return ESP_ERR_INVALID_SIZE;
+        }
+        type = HTTPD_WS_TYPE_BINARY;
+    }
+
+    // 订阅多个设备时，数据所属设备变化前先发送一条设备切换消息 (信封中已有设备编号)
+    if (!client->envelope && client->devices != CDC_RING_DEV_MASK(slice->dev) && client->last_dev != slice->dev) {
+        char msg[32];
+        int n = snprintf(msg, sizeof(msg), "{\"event\":\"dev\",\"id\":%u}", slice->dev);
+        if (ws_send_frame(ctx, client, HTTPD_WS_TYPE_TEXT, (const uint8_t *)msg, n) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        client->last_dev = slice->dev;
+    }
+
+    // 发送失败或发送期间断开时客户端已被移除，其读者也已注销，无需再释放切片
+    esp_err_t ret = ws_send_frame(ctx, client, type, payload, payload_len);
+    if (ret == ESP_OK) {
+        // 切片时间戳为其中最早记录写入环形缓冲区(即USB接收回调)的时间
+        latency_record(LATENCY_USB_TO_WS, esp_timer_get_time() - slice->timestamp_us);
+        ctx->stats.records_sent += slice->count;
+        cdc_ring_consume(client->reader, slice);
+    }
+    return ret;
+}
+
+// 为降采样客户端处理CDC记录 (需持有锁)
+// 逐条处理记录，DECIMATE每N条转发1条，AGGREGATE在窗口结束时发送一条聚合结果
+static bool ws_client_flush_reduced(ws_ctx_t *ctx, ws_client_t *client, TickType_t *wait) {
+    stream_reduce_t *reduce = &client->reduce;
+    bool aggregate = (reduce->config.mode == STREAM_REDUCE_AGGREGATE);
+    int64_t now_us = esp_timer_get_time();
+    int64_t next_us = now_us;
+    uint32_t pending = cdc_ring_pending(client->reader, NULL, &next_us);
+
+    // 窗口已结束: 下一条记录晚于窗口，或没有新记录且已到截止时间
+    bool due = aggregate && stream_reduce_window_due(reduce, pending ? next_us : now_us);
+    if (!due && pending == 0) {
+        int64_t remaining = aggregate ? stream_reduce_window_remaining(reduce, now_us) : -1;
+        if (remaining >= 0) {
+            TickType_t t = pdMS_TO_TICKS((remaining + 999) / 1000);
+            *wait = t > 0 ? t : 1;
+        }
+        return false;
+    }
+
+    if (!ws_client_writable(client->fd)) {
+        client->throttled++;
+        *wait = pdMS_TO_TICKS(WS_CLIENT_RETRY_MS) > 0 ? pdMS_TO_TICKS(WS_CLIENT_RETRY_MS) : 1;
+        return false;
+    }
+
+    if (due) {
+        size_t len = stream_reduce_format(reduce, s_reduce_msg, sizeof(s_reduce_msg));
+        ws_send_frame(ctx, client, HTTPD_WS_TYPE_TEXT, (const uint8_t *)s_reduce_msg, len);
+        return true;
+    }
+
+    // 降采样按记录计数，每次只取一条；压缩和信封客户端每帧不超过一个压缩块 (与ws_client_flush相同)
+    size_t max_len = (client->compress || client->envelope) ? WS_CODEC_BLOCK_SIZE : SIZE_MAX;
+    cdc_ring_slice_t slice;
+    for (int n = 0; n < WS_REDUCE_RECORDS_PER_ROUND; n++) {
+        if (aggregate) {
+            // 下一条记录属于新窗口时先输出当前窗口
+            if (cdc_ring_pending(client->reader, NULL, &next_us) == 0 ||
+                stream_reduce_window_due(reduce, next_us)) {
+                break;
+            }
+        }
+        if (!cdc_ring_peek(client->reader, &slice, 0)) {
+            break;
+        }
+
+        if (!aggregate) {
+            if (stream_reduce_decimate(reduce)) {
+                if (slice.len > max_len) {
+                    // 超过压缩块的记录无法编码，按丢失计数
+                    client->lost_records++;
+                    ctx->stats.records_lost++;
+                    metrics_add(METRIC_LOST_RECORDS, 1);
+                    cdc_ring_consume(client->reader, &slice);
+                    return true;
+                }
+                ws_client_send_slice(ctx, client, &slice);
+                return true;
+            }
+        } else if (!(slice.flags & CDC_RING_FLAG_BINARY)) {
+            // 只聚合文本记录中的数值 (framing=line)
+            stream_reduce_feed(reduce, slice.data, slice.len, slice.timestamp_us);
+        }
+        cdc_ring_consume(client->reader, &slice);
+    }
+    return true;
+}
+
+// 为单个客户端发送一帧CDC数据 (需持有锁)
+// 返回true表示发送了数据，wait输出该客户端下一次需要检查的等待时间
+static bool ws_client_flush(ws_ctx_t *ctx, ws_client_t *client, TickType_t *wait) {
+    size_t pending;
+    int64_t oldest_us = 0;
+
+    if (client->reader < 0) {
+        return false;
+    }
+
+    // 回放客户端先收到回放起点 (记录序号按设备编号，这里给出订阅的第一个设备)，保证其先于任何数据帧
+    if (client->replay_pending) {
+        client->replay_pending = false;
+        uint8_t first_dev = __builtin_ctz(client->devices);
+        char hello[WS_CTRL_MSG_MAX_LEN];
+        int len = snprintf(hello, sizeof(hello),
+                           "{\"event\":\"replay\",\"dev\":%u,\"from_seq\":%"PRIu32",\"live_seq\":%"PRIu32"}",
+                           first_dev, cdc_ring_reader_seq(client->reader, first_dev), client->replay_live_seq);
+        return ws_send_frame(ctx, client, HTTPD_WS_TYPE_TEXT, (const uint8_t *)hello, len) == ESP_OK;
+    }
+
+    // 统计被覆盖的数据，超过阈值断开慢客户端
+    uint32_t lost = cdc_ring_reader_take_lost(client->reader);
+    if (lost > 0) {
+        client->lost_records += lost;
+        ctx->stats.records_lost += lost;
+        metrics_add(METRIC_LOST_RECORDS, lost);
+        if (WS_CLIENT_MAX_LOST_RECORDS > 0 && client->lost_records > WS_CLIENT_MAX_LOST_RECORDS) {
+            ESP_LOGW(TAG, "WebSocket客户端过慢(fd=%d)，丢失%"PRIu32"条记录，断开连接",
+                     client->fd, client->lost_records);
+            ws_client_drop_locked(ctx, client);
+            return false;
+        }
+    }
+
+    if (client->reduce.config.mode != STREAM_REDUCE_NONE) {
+        return ws_client_flush_reduced(ctx, client, wait);
+    }
+
+    if (cdc_ring_pending(client->reader, &pending, &oldest_us) == 0) {
+        return false;
+    }
+
+    // 未达到批量阈值且未超过最大延迟时继续攒数据
+    int64_t age_us = esp_timer_get_time() - oldest_us;
+    int64_t timeout_us = (int64_t)ctx->batch.flush_timeout_ms * 1000;
+    if (pending < ctx->batch.flush_bytes && age_us < timeout_us) {
+        TickType_t t = pdMS_TO_TICKS((timeout_us - age_us + 999) / 1000);
+        *wait = t > 0 ? t : 1;
+        return false;
+    }
+
+    // 套接字发送缓冲区已满时跳过该客户端，避免拖慢其他客户端
+    if (!ws_client_writable(client->fd)) {
+        client->throttled++;
+        *wait = pdMS_TO_TICKS(WS_CLIENT_RETRY_MS) > 0 ? pdMS_TO_TICKS(WS_CLIENT_RETRY_MS) : 1;
+        return false;
+    }
+
+    // 压缩和信封客户端每帧不超过一个压缩块
+    size_t max_len = ctx->batch.max_frame_len;
+    if ((client->compress || client->envelope) && max_len > WS_CODEC_BLOCK_SIZE) {
+        max_len = WS_CODEC_BLOCK_SIZE;
+    }
+
+    cdc_ring_slice_t slice;
+    if (!cdc_ring_peek(client->reader, &slice, max_len)) {
+        return false;
+    }
+
+    ws_client_send_slice(ctx, client, &slice);
+    return true;
+}
+
+// 轮流为每个客户端发送CDC数据，返回下一次需要检查的等待时间
+static TickType_t ws_flush_ring(ws_ctx_t *ctx) {
+    TickType_t wait;
+    bool sent;
+
+    xSemaphoreTake(ctx->lock, portMAX_DELAY);
+    do {
+        // 每轮每个客户端最多发送一帧，快客户端不会被慢客户端阻塞
+        sent = false;
+        wait = portMAX_DELAY;
+        for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+            ws_client_t *client = &ctx->clients[i];
+            TickType_t client_wait = portMAX_DELAY;
+            if (client->active && ws_client_flush(ctx, client, &client_wait)) {
+                sent = true;
+            }
+            if (client_wait < wait) {
+                wait = client_wait;
+            }
+        }
+    } while (sent);
+    xSemaphoreGive(ctx->lock);
+
+    return wait;
+}
+
+// 网络配置切换后更新已连接客户端的套接字选项 (在发送任务中)
+static void ws_apply_profile(ws_ctx_t *ctx) {
+    xSemaphoreTake(ctx->lock, portMAX_DELAY);
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+        if (ctx->clients[i].active) {
+            net_profile_apply_socket(ctx->clients[i].fd);
+        }
+    }
+    xSemaphoreGive(ctx->lock);
+}
+
 // 消息发送任务
 static void ws_send_task(void *pvParameters) {
     ws_ctx_t *ctx = (ws_ctx_t *)pvParameters;
     ws_msg_t msg;
+    TickType_t wait = portMAX_DELAY;
     
     ESP_LOGI(TAG, "WebSocket发送任务已启动");
     
     while (1) {
-        // 等待队列中的消息
-        if (xQueueReceive(ctx->msg_queue, &msg, portMAX_DELAY) == pdTRUE) {
-            // 检查连接状态
-            if (!ctx->connected || ctx->server == NULL || ctx->client_fd < 0) {
-                ESP_LOGW(TAG, "WebSocket未连接，丢弃消息");
-                if (msg.data) {
-                    free(msg.data);
-                }
-                continue;
-            }
-            
-            // 准备发送帧
-            httpd_ws_frame_t ws_frame = {
-                .final = true,
-                .fragmented = false,
-                .type = (msg.type == WS_MSG_TEXT) ? HTTPD_WS_TYPE_TEXT : HTTPD_WS_TYPE_BINARY,
-                .payload = msg.data,
-                .len = msg.len
-            };
-            
-            // 尝试发送数据 (修复：使用正确的async函数)
-            esp_err_t ret = httpd_ws_send_frame_async(ctx->server, ctx->client_fd, &ws_frame);
-            if (ret != ESP_OK) {
-                ESP_LOGE(TAG, "WebSocket发送失败: %s", esp_err_to_name(ret));
-                ctx->connected = false;
-                ctx->client_fd = -1;
-            } else {
-                ESP_LOGI(TAG, "%s数据发送成功: %d字节", 
-                         (msg.type == WS_MSG_TEXT) ? "文本" : "二进制", msg.len);
-            }
-            
-            // 释放数据
-            if (msg.data) {
-                free(msg.data);
-            }
-            
-            // 短暂延迟，让系统有时间处理其他任务
-            vTaskDelay(pdMS_TO_TICKS(WS_SEND_DELAY_MS));
+        // 等待控制消息、新的CDC数据或批量发送截止时间
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        if (__atomic_exchange_n(&ctx->profile_pending, false, __ATOMIC_ACQ_REL)) {
+            ws_apply_profile(ctx);
+        }
+
+        // 先广播控制消息
+        while (xQueueReceive(ctx->msg_queue, &msg, 0) == pdTRUE) {
+            ws_broadcast_msg(ctx, &msg);
         }
+
+        // 再直接从环形缓冲区为每个客户端批量发送CDC数据
+        wait = ws_flush_ring(ctx);
     }
 }
 
@@ -122,14 +638,36 @@ static void ws_init_ctx(httpd_handle_t server) {
     if (ws_ctx.task_handle != NULL) {
         vTaskDelete(ws_ctx.task_handle);
     }
+
+    if (ws_ctx.lock != NULL) {
+        vSemaphoreDelete(ws_ctx.lock);
+    }
     
-    // 初始化上下文
+    // 初始化上下文 (保留批量发送配置)
+    ws_batch_config_t batch = ws_ctx.batch;
     memset(&ws_ctx, 0, sizeof(ws_ctx_t));
+    ws_ctx.batch = batch;
     ws_ctx.server = server;
-    ws_ctx.client_fd = -1;
-    ws_ctx.connected = false;
+    ws_ctx.tx_fd = -1;
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+        ws_ctx.clients[i].fd = -1;
+        ws_ctx.clients[i].reader = -1;
+    }
+
+    // CDC数据环形缓冲区已由app_main初始化，这里只确保可用 (重复调用无副作用)
+    if (cdc_ring_init() != ESP_OK) {
+        ESP_LOGE(TAG, "初始化CDC数据环形缓冲区失败");
+        return;
+    }
+    cdc_pipeline_set_notify(ws_ring_notify);
+
+    ws_ctx.lock = xSemaphoreCreateMutex();
+    if (ws_ctx.lock == NULL) {
+        ESP_LOGE(TAG, "创建WebSocket客户端表互斥锁失败");
+        return;
+    }
     
-    // 创建消息队列
+    // 创建控制消息队列
     ws_ctx.msg_queue = xQueueCreate(WS_QUEUE_SIZE, sizeof(ws_msg_t));
     if (ws_ctx.msg_queue == NULL) {
         ESP_LOGE(TAG, "创建WebSocket消息队列失败");
@@ -137,14 +675,7 @@ static void ws_init_ctx(httpd_handle_t server) {
     }
     
     // 创建发送任务
-    BaseType_t task_created = xTaskCreate(
-        ws_send_task,
-        "ws_send_task",
-        WS_TASK_STACK_SIZE,
-        &ws_ctx,
-        WS_TASK_PRIORITY,
-        &ws_ctx.task_handle
-    );
+    BaseType_t task_created = task_config_create(TASK_CFG_WS_SEND, ws_send_task, &ws_ctx, &ws_ctx.task_handle);
     
     if (task_created != pdPASS) {
         ESP_LOGE(TAG, "创建WebSocket发送任务失败");
@@ -153,131 +684,562 @@ static void ws_init_ctx(httpd_handle_t server) {
     }
 }
 
+// 添加客户端
+// 解析连接参数:
+//   mode=auto|binary|text   数据帧类型，缺省为auto
+//   codec=none|lz4          压缩方式，缺省为none
+//   envelope=1              数据帧加序号和时间戳报头 (格式见web_socket.h的ws_envelope_hdr_t)
+//   replay=all              从最旧的保留数据开始回放
+//   replay_seq=N            从记录序号N开始回放
+//   replay_ms=M             回放最近M毫秒的数据
+//   dev=all|none|N          订阅的设备，缺省为all (多设备数据交替发送，设备切换前插入{"event":"dev"})，
+//                           none表示不接收CDC数据 (只用状态通道)
+//   status=1                订阅状态通道: WiFi连接/断开/获取IP/信号强度变化 ({"event":"wifi"})
+//   ctrl=1                  二进制帧为控制协议请求 (格式见ws_ctrl.h)，发往CDC设备的数据改用CDC_WRITE命令
+//   tx_dev=N                客户端发来的数据转发到的设备，缺省为订阅的设备 (all时为设备0)
+//   decimate=N              每N条记录只转发1条
+//   window_ms=M             每M毫秒发送一次各通道的最小值/最大值/平均值
+static bool ws_parse_session_opts(httpd_req_t *req, ws_session_opts_t *opts) {
+    char query[WS_QUERY_MAX_LEN];
+    char value[16];
+
+    memset(opts, 0, sizeof(ws_session_opts_t));
+    opts->encoding = WS_ENCODING_AUTO;
+    opts->start_seq = CDC_RING_SEQ_LIVE;
+    opts->devices = CDC_RING_DEV_ALL;
+    opts->tx_dev = -1;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK) {
+        return true;
+    }
+
+    char *end;
+    if (httpd_query_key_value(query, "dev", value, sizeof(value)) == ESP_OK && strcmp(value, "all") != 0) {
+        if (strcmp(value, "none") == 0) {
+            opts->devices = 0;
+        } else {
+            unsigned long dev = strtoul(value, &end, 10);
+            if (*end != '\0' || dev >= CDC_RING_DEVICES) {
+                return false;
+            }
+            opts->devices = CDC_RING_DEV_MASK(dev);
+        }
+    }
+    if (httpd_query_key_value(query, "tx_dev", value, sizeof(value)) == ESP_OK) {
+        unsigned long dev = strtoul(value, &end, 10);
+        if (*end != '\0' || dev >= CDC_RING_DEVICES) {
+            return false;
+        }
+        opts->tx_dev = (int)dev;
+    }
+
+    if (httpd_query_key_value(query, "status", value, sizeof(value)) == ESP_OK) {
+        if (strcmp(value, "1") != 0 && strcmp(value, "0") != 0) {
+            return false;
+        }
+        opts->status = value[0] == '1';
+    }
+
+    if (httpd_query_key_value(query, "ctrl", value, sizeof(value)) == ESP_OK) {
+        if (strcmp(value, "1") != 0 && strcmp(value, "0") != 0) {
+            return false;
+        }
+        opts->ctrl = value[0] == '1';
+    }
+
+    if (httpd_query_key_value(query, "envelope", value, sizeof(value)) == ESP_OK) {
+        if (strcmp(value, "1") != 0 && strcmp(value, "0") != 0) {
+            return false;
+        }
+        opts->envelope = value[0] == '1';
+    }
+
+    if (httpd_query_key_value(query, "mode", value, sizeof(value)) == ESP_OK &&
+        !ws_encoding_from_name(value, &opts->encoding)) {
+        return false;
+    }
+
+    if (httpd_query_key_value(query, "codec", value, sizeof(value)) == ESP_OK) {
+        if (strcmp(value, "lz4") == 0) {
+            opts->compress = true;
+        } else if (strcmp(value, "none") != 0) {
+            return false;
+        }
+    }
+
+    if (httpd_query_key_value(query, "replay", value, sizeof(value)) == ESP_OK) {
+        if (strcmp(value, "all") != 0) {
+            return false;
+        }
+        opts->replay = true;
+        opts->start_seq = 0;
+    } else if (httpd_query_key_value(query, "replay_seq", value, sizeof(value)) == ESP_OK) {
+        unsigned long seq = strtoul(value, &end, 10);
+        if (*end != '\0') {
+            return false;
+        }
+        opts->replay = true;
+        opts->start_seq = (uint32_t)seq;
+    } else if (httpd_query_key_value(query, "replay_ms", value, sizeof(value)) == ESP_OK) {
+        unsigned long ms = strtoul(value, &end, 10);
+        if (*end != '\0') {
+            return false;
+        }
+        opts->replay = true;
+        opts->since_us = esp_timer_get_time() - (int64_t)ms * 1000;
+    }
+
+    // 不订阅数据时没有可回放的内容
+    if (opts->devices == 0 && opts->replay) {
+        return false;
+    }
+
+    // 降采样与聚合只能二选一
+    if (httpd_query_key_value(query, "decimate", value, sizeof(value)) == ESP_OK) {
+        unsigned long n = strtoul(value, &end, 10);
+        if (*end != '\0' || n == 0 || n > WS_REDUCE_MAX_DECIMATE) {
+            return false;
+        }
+        opts->reduce.mode = STREAM_REDUCE_DECIMATE;
+        opts->reduce.decimate = (uint32_t)n;
+    }
+    if (httpd_query_key_value(query, "window_ms", value, sizeof(value)) == ESP_OK) {
+        unsigned long ms = strtoul(value, &end, 10);
+        if (*end != '\0' || ms == 0 || ms > WS_REDUCE_MAX_WINDOW_MS ||
+            opts->reduce.mode != STREAM_REDUCE_NONE) {
+            return false;
+        }
+        opts->reduce.mode = STREAM_REDUCE_AGGREGATE;
+        opts->reduce.window_ms = (uint32_t)ms;
+    }
+
+    return true;
+}
+
+// 添加客户端
+static esp_err_t ws_client_add(int fd, const ws_session_opts_t *opts) {
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    bool added = false;
+
+    xSemaphoreTake(ws_ctx.lock, portMAX_DELAY);
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+        ws_client_t *client = &ws_ctx.clients[i];
+        if (client->active && client->fd == fd) {
+            ret = ESP_OK;
+            break;
+        }
+    }
+
+    if (ret != ESP_OK) {
+        for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+            ws_client_t *client = &ws_ctx.clients[i];
+            if (client->active) {
+                continue;
+            }
+            int reader = -1;
+            if (opts->devices == 0) {
+                // 只用状态通道，不占用环形缓冲区读者
+            } else if (!opts->replay) {
+                reader = cdc_ring_reader_open(opts->devices);
+            } else if (opts->since_us != 0) {
+                reader = cdc_ring_reader_open_since(opts->devices, opts->since_us);
+            } else {
+                reader = cdc_ring_reader_open_at(opts->devices, opts->start_seq);
+            }
+            if (reader < 0 && opts->devices != 0) {
+                break;
+            }
+            uint8_t first_dev = opts->devices ? __builtin_ctz(opts->devices) : 0;
+            memset(client, 0, sizeof(ws_client_t));
+            client->fd = fd;
+            if (++ws_ctx.next_session == 0) {
+                ws_ctx.next_session = 1;
+            }
+            client->session = ws_ctx.next_session;
+            client->reader = reader;
+            client->encoding = opts->encoding;
+            client->compress = opts->compress;
+            client->envelope = opts->envelope;
+            stream_reduce_init(&client->reduce, &opts->reduce);
+            client->devices = opts->devices;
+            client->status = opts->status;
+            client->ctrl = opts->ctrl;
+            client->tx_dev = opts->tx_dev >= 0 ? (uint8_t)opts->tx_dev : first_dev;
+            client->last_dev = UINT8_MAX;
+            if (opts->replay) {
+                cdc_ring_stats_t ring;
+                cdc_ring_get_stats(first_dev, &ring);
+                client->replay_pending = true;
+                client->replay_live_seq = ring.next_seq;
+            }
+            client->active = true;
+            ret = ESP_OK;
+            added = true;
+            break;
+        }
+    }
+    xSemaphoreGive(ws_ctx.lock);
+
+    // 订阅者据此向新客户端推送当前状态
+    if (added) {
+        net_profile_apply_socket(fd);
+        app_event_post(APP_EVENT_WS_CLIENT_CONNECTED, &fd, sizeof(fd));
+    }
+    return ret;
+}
+
+// 网络配置切换 (在事件循环任务中)，不等待客户端表锁，交给发送任务更新套接字选项
+static void ws_on_profile_changed(void *arg, esp_event_base_t base, int32_t id, void *data) {
+    __atomic_store_n(&ws_ctx.profile_pending, true, __ATOMIC_RELEASE);
+    ws_wake_send_task();
+}
+
+// 按套接字移除客户端
+static void ws_client_remove(int fd) {
+    if (ws_ctx.lock == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(ws_ctx.lock, portMAX_DELAY);
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+        ws_client_t *client = &ws_ctx.clients[i];
+        if (client->active && client->fd == fd) {
+            ws_client_remove_locked(&ws_ctx, client);
+        }
+    }
+    xSemaphoreGive(ws_ctx.lock);
+}
+
 // 检查WebSocket连接状态
 bool websocket_is_connected(void) {
-    return ws_ctx.connected && ws_ctx.client_fd >= 0;
+    return websocket_client_count() > 0;
 }
 
-// 向队列添加文本消息
-esp_err_t websocket_server_send_text(const char *data) {
+// 获取已连接的WebSocket客户端数量
+int websocket_client_count(void) {
+    int count = 0;
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+        if (ws_ctx.clients[i].active) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// 获取客户端的连接编号，未连接时返回0
+uint32_t websocket_client_session(int fd) {
+    uint32_t session = 0;
+    if (ws_ctx.lock == NULL) {
+        return 0;
+    }
+
+    xSemaphoreTake(ws_ctx.lock, portMAX_DELAY);
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+        if (ws_ctx.clients[i].active && ws_ctx.clients[i].fd == fd) {
+            session = ws_ctx.clients[i].session;
+            break;
+        }
+    }
+    xSemaphoreGive(ws_ctx.lock);
+    return session;
+}
+
+// 向队列添加发往指定客户端(fd)或指定连接(session)的消息
+static esp_err_t ws_queue_msg(int fd, uint32_t session, httpd_ws_type_t type, bool status_only,
+                              const void *data, size_t len) {
     if (!data || !ws_ctx.msg_queue) {
         return ESP_ERR_INVALID_ARG;
     }
     
-    // 为消息数据创建副本
-    size_t len = strlen(data);
-    char *data_copy = malloc(len + 1);
-    if (!data_copy) {
-        ESP_LOGE(TAG, "无法分配内存");
-        return ESP_ERR_NO_MEM;
+    if (len > WS_CTRL_MAX_RESPONSE) {
+        ESP_LOGE(TAG, "控制消息过长: %d字节", len);
+        return ESP_ERR_INVALID_SIZE;
     }
+
+    // 创建消息结构，数据由队列拷贝，放不下时拷贝到mem_pool块
+    ws_msg_t msg;
+    msg.ext = NULL;
+    if (len < WS_CTRL_MSG_MAX_LEN) {
+        memcpy(msg.data, data, len);
+        msg.data[len] = '\0';
+    } else {
+        msg.ext = mem_pool_alloc(len);
+        if (msg.ext == NULL) {
+            ESP_LOGW(TAG, "为控制消息分配内存失败(%d字节)", len);
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(msg.ext, data, len);
+    }
+    msg.len = len;
+    msg.type = type;
+    msg.fd = fd;
+    msg.session = session;
+    msg.status_only = status_only;
     
-    memcpy(data_copy, data, len);
-    data_copy[len] = '\0';
-    
-    // 创建消息结构
-    ws_msg_t msg = {
-        .type = WS_MSG_TEXT,
-        .data = data_copy,
-        .len = len
-    };
-    
-    ESP_LOGI(TAG, "正在发送文本到队列: %s", data_copy);
-    
+    TRACE_EVENT(TRACE_EVT_WS_QUEUE_TEXT, fd, len);
+
     // 将消息发送到队列
     if (xQueueSend(ws_ctx.msg_queue, &msg, 0) != pdTRUE) {
+        metrics_add(METRIC_WS_MSG_QUEUE_FULL, 1);
         ESP_LOGW(TAG, "WebSocket消息队列已满，丢弃消息");
-        free(data_copy);
+        mem_pool_free(msg.ext);
         return ESP_FAIL;
     }
-    
+    metrics_hwm(METRIC_HWM_WS_MSG_QUEUE, uxQueueMessagesWaiting(ws_ctx.msg_queue));
+
+    ws_wake_send_task();
     return ESP_OK;
 }
 
-// 向队列添加二进制消息
+// 向队列添加发往指定客户端的文本消息
+static esp_err_t ws_queue_text(int fd, bool status_only, const char *data) {
+    if (!data) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ws_queue_msg(fd, 0, HTTPD_WS_TYPE_TEXT, status_only, data, strlen(data));
+}
+
+// 向队列添加文本消息 (广播给所有客户端)
+esp_err_t websocket_server_send_text(const char *data) {
+    return ws_queue_text(-1, false, data);
+}
+
+// 向队列添加发往指定客户端的文本消息
+esp_err_t websocket_send_text_to(int fd, const char *data) {
+    return ws_queue_text(fd, false, data);
+}
+
+// 向订阅了状态通道的客户端发送文本消息 (fd为-1时发给所有订阅者)
+esp_err_t websocket_send_status(int fd, const char *data) {
+    return ws_queue_text(fd, true, data);
+}
+
+// 向指定连接发送二进制控制消息 (控制协议的异步响应，连接已断开时丢弃)
+esp_err_t websocket_send_binary_to_session(uint32_t session, const uint8_t *data, size_t len) {
+    if (session == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ws_queue_msg(-1, session, HTTPD_WS_TYPE_BINARY, false, data, len);
+}
+
+// 检查是否有客户端订阅了状态通道
+bool websocket_has_status_subscribers(void) {
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+        if (ws_ctx.clients[i].active && ws_ctx.clients[i].status) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 向环形缓冲区添加二进制消息 (作为设备0的数据)
 esp_err_t websocket_server_send_binary(const uint8_t *data, size_t len) {
     if (!data || len == 0 || !ws_ctx.msg_queue) {
         return ESP_ERR_INVALID_ARG;
     }
     
-    // 打印二进制数据信息
-    ESP_LOGI(TAG, "二进制数据(%d字节)添加到发送队列", len);
-    
-    // 为消息数据创建副本
-    uint8_t *data_copy = malloc(len);
-    if (!data_copy) {
-        ESP_LOGE(TAG, "无法分配内存");
-        return ESP_ERR_NO_MEM;
-    }
-    
-    memcpy(data_copy, data, len);
-    
-    // 创建消息结构
-    ws_msg_t msg = {
-        .type = WS_MSG_BINARY,
-        .data = data_copy,
-        .len = len
-    };
-    
-    // 将消息发送到队列
-    if (xQueueSend(ws_ctx.msg_queue, &msg, 0) != pdTRUE) {
-        ESP_LOGW(TAG, "WebSocket消息队列已满，丢弃消息");
-        free(data_copy);
-        return ESP_FAIL;
+    TRACE_EVENT(TRACE_EVT_WS_BINARY, 0, len);
+
+    esp_err_t ret = cdc_pipeline_write(0, data, len, CDC_RING_FLAG_BINARY);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "WebSocket发送缓冲区已满，丢弃消息");
     }
-    
-    return ESP_OK;
+    return ret;
 }
 
 // 从USB CDC接收到数据的回调函数
-void usb_cdc_rx_callback(const uint8_t* data, size_t len) {
+void usb_cdc_rx_callback(uint8_t dev, const uint8_t* data, size_t len) {
+#if CONFIG_CDC_RING_RETAIN
+    // 无客户端时也写入环形缓冲区，供之后连接的客户端回放
+    if (!data || len == 0) {
+#else
     if (!websocket_is_connected() || !data || len == 0) {
-        ESP_LOGW(TAG, "未转发CDC数据：WebSocket未连接或数据无效");
+#endif
+        TRACE_EVENT(TRACE_EVT_CDC_RX_DISCARD, dev, len);
+        metrics_add(METRIC_DISCARDED_BYTES, len);
         return;
     }
     
-    // 打印接收到的数据
-    ESP_LOGI(TAG, "从CDC接收到数据: %d字节", len);
-    
-    // 检查数据是否是文本格式
-    bool is_text = is_data_text_format(data, len);
+    TRACE_EVENT(TRACE_EVT_WS_CDC_IN, dev, len);
+
+#ifdef CONFIG_LATENCY_ECHO_PROBE
+    // 设备回显的探测消息，向发起的客户端报告往返时间
+    latency_probe_result_t probes[2];
+    int n = latency_probe_scan(data, len, probes, 2);
+    for (int i = 0; i < n; i++) {
+        char msg[WS_CTRL_MSG_MAX_LEN];
+        snprintf(msg, sizeof(msg), "{\"event\":\"probe\",\"id\":%"PRIu32",\"rtt_us\":%"PRIu32"}",
+                 probes[i].id, probes[i].rtt_us);
+        ws_queue_text(probes[i].fd, false, msg);
+    }
+#endif
     
-    // 如果是文本数据，作为文本发送
-    if (is_text) {
-        // 创建字符串副本（确保以null结尾）
-        char *text_copy = malloc(len + 1);
-        if (!text_copy) {
-            ESP_LOGE(TAG, "内存分配失败");
-            return;
+    cdc_pipeline_input(dev, data, len);
+}
+
+// CDC异步发送完成回调 (在CDC发送任务中执行)，arg为发起的连接编号，向该连接回复确认
+static void ws_cdc_tx_done(uint32_t id, esp_err_t result, size_t len, void *arg) {
+    char ack[WS_CTRL_MSG_MAX_LEN];
+    snprintf(ack, sizeof(ack), "{\"event\":\"tx_ack\",\"seq\":%"PRIu32",\"len\":%u,\"status\":\"%s\"}",
+             id, (unsigned)len, result == ESP_OK ? "ok" : esp_err_to_name(result));
+    uint32_t session = (uint32_t)(uintptr_t)arg;
+    if (session != 0) {
+        ws_queue_msg(-1, session, HTTPD_WS_TYPE_TEXT, false, ack, strlen(ack));
+    }
+}
+
+// 客户端是否使用二进制控制协议
+static bool ws_client_is_ctrl(int fd) {
+    bool ctrl = false;
+    xSemaphoreTake(ws_ctx.lock, portMAX_DELAY);
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+        if (ws_ctx.clients[i].active && ws_ctx.clients[i].fd == fd) {
+            ctrl = ws_ctx.clients[i].ctrl;
+            break;
         }
-        
-        memcpy(text_copy, data, len);
-        text_copy[len] = '\0';
-        
-        // 作为文本消息发送
-        ESP_LOGI(TAG, "转发文本数据到WebSocket: %s", text_copy);
-        esp_err_t ret = websocket_server_send_text(text_copy);
-        free(text_copy);
-        
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "转发文本数据到WebSocket失败");
+    }
+    xSemaphoreGive(ws_ctx.lock);
+    return ctrl;
+}
+
+// 处理控制协议请求，同步响应同样由发送任务发送，与数据帧不会交错，httpd任务也不会阻塞于慢客户端
+static void ws_handle_ctrl(int fd, const uint8_t *data, size_t len) {
+    size_t resp_len = ws_ctrl_handle(fd, data, len, s_ctrl_resp);
+    if (resp_len == 0) {
+        return;
+    }
+    uint32_t session = websocket_client_session(fd);
+    if (session != 0) {
+        ws_queue_msg(-1, session, HTTPD_WS_TYPE_BINARY, false, s_ctrl_resp, resp_len);
+    }
+}
+
+// 将客户端发来的数据放入CDC发送队列，不等待USB传输
+static void ws_forward_to_cdc(int fd, const uint8_t *data, size_t len) {
+    uint32_t seq = 0;
+    uint32_t session = 0;
+    uint8_t dev = 0;
+
+    metrics_add(METRIC_WS_RX_BYTES, len);
+#ifdef CONFIG_LATENCY_ECHO_PROBE
+    latency_probe_start(data, len, fd);
+#endif
+
+    xSemaphoreTake(ws_ctx.lock, portMAX_DELAY);
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+        if (ws_ctx.clients[i].active && ws_ctx.clients[i].fd == fd) {
+            seq = ++ws_ctx.clients[i].tx_seq;
+            session = ws_ctx.clients[i].session;
+            dev = ws_ctx.clients[i].tx_dev;
+            break;
         }
     }
-    // 否则作为二进制数据发送
-    else {
-        uint8_t *data_copy = malloc(len);
-        if (!data_copy) {
-            ESP_LOGE(TAG, "内存分配失败");
-            return;
+    xSemaphoreGive(ws_ctx.lock);
+
+    esp_err_t ret = usbd_cdc_send_async(dev, data, len, seq, ws_cdc_tx_done, (void *)(uintptr_t)session);
+    if (ret != ESP_OK) {
+        // 未入队的请求立即回复失败
+        ESP_LOGW(TAG, "CDC发送队列拒绝数据(%d字节): %s", len, esp_err_to_name(ret));
+        ws_cdc_tx_done(seq, ret, len, (void *)(uintptr_t)session);
+    }
+}
+
+// 记录客户端分片消息状态，返回false表示分片序列不合法
+// 注意: httpd对未分片帧的fragmented为false，对分片消息的每一帧为true
+static bool ws_client_track_fragment(int fd, const httpd_ws_frame_t *frame, httpd_ws_type_t *msg_type) {
+    bool ok = true;
+
+    xSemaphoreTake(ws_ctx.lock, portMAX_DELAY);
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+        ws_client_t *client = &ws_ctx.clients[i];
+        if (!client->active || client->fd != fd) {
+            continue;
         }
-        
-        memcpy(data_copy, data, len);
-        esp_err_t ret = websocket_server_send_binary(data_copy, len);
-        free(data_copy);
-        
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "转发二进制数据到WebSocket失败");
+
+        if (frame->type == HTTPD_WS_TYPE_CONTINUE) {
+            // 后续分片必须属于一个已开始的消息
+            if (client->rx_type == HTTPD_WS_TYPE_CONTINUE) {
+                ok = false;
+            } else {
+                *msg_type = client->rx_type;
+            }
+        } else if (frame->type == HTTPD_WS_TYPE_TEXT || frame->type == HTTPD_WS_TYPE_BINARY) {
+            // 前一条分片消息未结束时不能开始新消息
+            if (client->rx_type != HTTPD_WS_TYPE_CONTINUE) {
+                ok = false;
+            }
+            client->rx_type = frame->type;
+        }
+
+        if (ok && frame->final) {
+            client->rx_type = HTTPD_WS_TYPE_CONTINUE;
+        }
+        break;
+    }
+    xSemaphoreGive(ws_ctx.lock);
+
+    return ok;
+}
+
+// 发送关闭帧并关闭会话
+static void ws_close_with_code(httpd_req_t *req, uint16_t code) {
+    uint8_t payload[2] = { code >> 8, code & 0xFF };
+    httpd_ws_frame_t close_frame = {
+        .final = true,
+        .type = HTTPD_WS_TYPE_CLOSE,
+        .payload = payload,
+        .len = sizeof(payload),
+    };
+    httpd_ws_send_frame(req, &close_frame);
+    httpd_sess_trigger_close(req->handle, httpd_req_to_sockfd(req));
+}
+
+// httpd会话关闭回调，清理对应的客户端
+void websocket_on_session_close(httpd_handle_t hd, int sockfd) {
+    ws_client_remove(sockfd);
+
+    // 发送任务正在向该套接字写入时由其在写入结束后关闭
+    bool deferred = false;
+    if (ws_ctx.lock != NULL) {
+        xSemaphoreTake(ws_ctx.lock, portMAX_DELAY);
+        if (ws_ctx.tx_fd == sockfd) {
+            ws_ctx.tx_close_pending = true;
+            deferred = true;
         }
+        xSemaphoreGive(ws_ctx.lock);
+    }
+    if (!deferred) {
+        close(sockfd);
+    }
+}
+
+// 设置批量发送参数
+esp_err_t websocket_set_batch_config(const ws_batch_config_t *config) {
+    if (!config || config->max_frame_len == 0 ||
+        config->max_frame_len > CONFIG_CDC_RING_DATA_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ws_ctx.batch = *config;
+    ESP_LOGI(TAG, "批量发送参数已更新: 最大帧%d字节, 阈值%d字节, 最大延迟%"PRIu32"ms",
+             config->max_frame_len, config->flush_bytes, config->flush_timeout_ms);
+
+    // 参数变化后立即重新评估待发送数据
+    ws_wake_send_task();
+    return ESP_OK;
+}
+
+// 获取批量发送参数
+void websocket_get_batch_config(ws_batch_config_t *config) {
+    if (config) {
+        *config = ws_ctx.batch;
+    }
+}
+
+// 获取转发统计信息
+void websocket_get_stream_stats(ws_stream_stats_t *stats) {
+    if (stats) {
+        *stats = ws_ctx.stats;
     }
 }
 
@@ -287,16 +1249,31 @@ static esp_err_t ws_handler(httpd_req_t *req) {
         // 处理WebSocket握手
         ESP_LOGI(TAG, "WebSocket握手成功");
         
-        // 更新连接信息
-        ws_ctx.client_fd = httpd_req_to_sockfd(req);
-        ws_ctx.connected = true;
+        // 解析会话参数并加入客户端表
+        int fd = httpd_req_to_sockfd(req);
+        ws_session_opts_t opts;
+        if (!ws_parse_session_opts(req, &opts)) {
+            ESP_LOGW(TAG, "WebSocket会话参数无效，拒绝连接fd=%d", fd);
+            httpd_sess_trigger_close(req->handle, fd);
+            return ESP_OK;
+        }
+
+        if (ws_client_add(fd, &opts) != ESP_OK) {
+            ESP_LOGW(TAG, "WebSocket客户端已满(%d)，拒绝连接fd=%d", WS_MAX_CLIENTS, fd);
+            httpd_sess_trigger_close(req->handle, fd);
+            return ESP_OK;
+        }
         
-        ESP_LOGI(TAG, "WebSocket客户端已连接，fd=%d", ws_ctx.client_fd);
+        ESP_LOGI(TAG, "WebSocket客户端已连接，fd=%d, 模式: %s%s%s%s%s%s, 当前客户端数: %d",
+                 fd, ws_encoding_names[opts.encoding], opts.compress ? "+lz4" : "", opts.envelope ? "+envelope" : "",
+                 opts.replay ? "+replay" : "", opts.status ? "+status" : "", opts.ctrl ? "+ctrl" : "",
+                 websocket_client_count());
         return ESP_OK;
     }
     
     httpd_ws_frame_t ws_frame;
     memset(&ws_frame, 0, sizeof(httpd_ws_frame_t));
+    int fd = httpd_req_to_sockfd(req);
     
     // 获取帧类型
     esp_err_t ret = httpd_ws_recv_frame(req, &ws_frame, 0);
@@ -308,63 +1285,67 @@ static esp_err_t ws_handler(httpd_req_t *req) {
     // 处理关闭帧
     if (ws_frame.type == HTTPD_WS_TYPE_CLOSE) {
         ESP_LOGI(TAG, "WebSocket客户端断开连接");
-        ws_ctx.connected = false;
-        ws_ctx.client_fd = -1;
+        ws_client_remove(fd);
+        return ESP_OK;
+    }
+
+    // httpd只能整帧读取载荷，超过接收缓冲区的单帧无法流式处理，
+    // 大数据需由客户端拆分为多个分片帧发送
+    if (ws_frame.len > WS_RX_CHUNK_SIZE) {
+        ESP_LOGW(TAG, "WebSocket帧过大(%d字节 > %d)，关闭连接", ws_frame.len, WS_RX_CHUNK_SIZE);
+        ws_close_with_code(req, WS_CLOSE_MESSAGE_TOO_BIG);
         return ESP_OK;
     }
     
-    // 接收数据
+    // 确定消息类型：分片消息的后续帧(CONTINUE)沿用第一帧的类型
+    httpd_ws_type_t msg_type = ws_frame.type;
+    if (!ws_client_track_fragment(fd, &ws_frame, &msg_type)) {
+        ESP_LOGW(TAG, "WebSocket分片序列错误(fd=%d)，关闭连接", fd);
+        ws_close_with_code(req, WS_CLOSE_PROTOCOL_ERROR);
+        return ESP_OK;
+    }
+
+    // 接收数据到静态接收缓冲区 (httpd在单个任务中串行调用处理函数)
     if (ws_frame.len) {
-        uint8_t *payload = malloc(ws_frame.len + 1);
-        if (!payload) {
-            ESP_LOGE(TAG, "内存分配失败");
-            return ESP_ERR_NO_MEM;
-        }
-        
-        // 接收帧数据
-        ws_frame.payload = payload;
-        ret = httpd_ws_recv_frame(req, &ws_frame, ws_frame.len);
+        ws_frame.payload = s_rx_chunk;
+        ret = httpd_ws_recv_frame(req, &ws_frame, WS_RX_CHUNK_SIZE);
         if (ret != ESP_OK) {
             ESP_LOGE(TAG, "接收WebSocket数据失败: %s", esp_err_to_name(ret));
-            free(payload);
             return ret;
         }
         
-        // 处理不同类型的消息
-        switch (ws_frame.type) {
+        // 处理不同类型的消息，每个分片收到后立即转发
+        switch (msg_type) {
             case HTTPD_WS_TYPE_TEXT:
-                payload[ws_frame.len] = 0; // 确保文本以null结尾
-                ESP_LOGI(TAG, "接收到WebSocket文本: %s", (char *)payload);
+                s_rx_chunk[ws_frame.len] = 0; // 确保文本以null结尾
+                TRACE_EVENT(TRACE_EVT_WS_RX, fd, ws_frame.len);
                 
                 // 转发到CDC设备
-                if (usbd_cdc_is_connected()) {
-                    ret = usbd_cdc_send_data(payload, ws_frame.len);
-                    if (ret == ESP_OK) {
-                        ESP_LOGI(TAG, "文本数据已转发到CDC");
-                    }
-                } else {
-                    ESP_LOGW(TAG, "CDC设备未连接，无法发送数据");
-                }
+                ws_forward_to_cdc(fd, s_rx_chunk, ws_frame.len);
                 break;
                 
             case HTTPD_WS_TYPE_BINARY:
-                ESP_LOGI(TAG, "接收到WebSocket二进制数据: %d字节", ws_frame.len);
+                TRACE_EVENT(TRACE_EVT_WS_RX, fd, ws_frame.len);
                 
-                // 转发到CDC设备
-                if (usbd_cdc_is_connected()) {
-                    ret = usbd_cdc_send_data(payload, ws_frame.len);
-                    if (ret == ESP_OK) {
-                        ESP_LOGI(TAG, "二进制数据已转发到CDC");
+                // 控制协议的每个请求是一个完整的帧
+                if (ws_client_is_ctrl(fd)) {
+                    if (ws_frame.fragmented) {
+                        ESP_LOGW(TAG, "控制请求不能分片(fd=%d)，关闭连接", fd);
+                        ws_close_with_code(req, WS_CLOSE_PROTOCOL_ERROR);
+                        return ESP_OK;
                     }
+                    ws_handle_ctrl(fd, s_rx_chunk, ws_frame.len);
+                    break;
                 }
+
+                // 转发到CDC设备
+                ws_forward_to_cdc(fd, s_rx_chunk, ws_frame.len);
                 break;
                 
             default:
                 ESP_LOGW(TAG, "未处理的WebSocket帧类型: %d", ws_frame.type);
                 break;
         }
-        
-        free(payload);
     }
     
     return ESP_OK;
@@ -379,6 +1360,12 @@ void websocket_start(httpd_handle_t server) {
     
     // 初始化WebSocket上下文
     ws_init_ctx(server);
+
+    static bool profile_handler_registered = false;
+    if (!profile_handler_registered) {
+        profile_handler_registered = esp_event_handler_instance_register(
+            APP_EVENT, APP_EVENT_NET_PROFILE_CHANGED, ws_on_profile_changed, NULL, NULL) == ESP_OK;
+    }
     
     // 注册WebSocket处理程序
     httpd_uri_t ws_uri = {
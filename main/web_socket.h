@@ -7,20 +7,95 @@ extern "C" {
 
 #include "esp_http_server.h"
 
+// 文本控制消息的最大长度 (含结尾'\0')
+#define WEBSOCKET_TEXT_MAX_LEN 256
+
+// 客户端连接时协商的数据帧类型 (/ws?mode=...)
+typedef enum {
+    WS_ENCODING_AUTO = 0,       // 按记录内容选择文本帧或二进制帧
+    WS_ENCODING_BINARY,         // 全部使用二进制帧
+    WS_ENCODING_TEXT,           // 全部使用文本帧 (设备只输出文本时使用)
+} ws_encoding_t;
+
+// 数据信封 (/ws?envelope=1): 每个CDC数据帧都是二进制帧 ws_envelope_hdr_t + 数据，
+// 客户端据此检测丢失、对齐多个读者的数据和计算延迟，不必额外请求
+#define WS_ENVELOPE_MAGIC       0xE7
+#define WS_ENVELOPE_FLAG_TEXT   (1 << 0)    // 数据为文本
+#define WS_ENVELOPE_FLAG_LZ4    (1 << 1)    // 数据为stream_codec编码的消息 (codec=lz4)
+#define WS_ENVELOPE_FLAG_UNIX   (1 << 2)    // timestamp_us为Unix时间 (已SNTP同步)，否则为启动后的时间
+
+// 数据信封报头 (小端)
+typedef struct __attribute__((packed)) {
+    uint8_t magic;              // WS_ENVELOPE_MAGIC
+    uint8_t hdr_len;            // 报头长度，之后的版本只在末尾追加字段
+    uint8_t flags;              // WS_ENVELOPE_FLAG_*
+    uint8_t dev;                // 设备编号
+    uint32_t seq;               // 第一条记录的序号 (按设备编号，与replay_seq和UDP的record_seq相同)
+    uint16_t count;             // 包含的记录数，同一设备下一帧的seq不等于seq+count说明中间的记录已丢失
+    uint16_t len;               // 之后的数据长度
+    int64_t timestamp_us;       // 第一条记录在USB接收回调中的时间
+} ws_envelope_hdr_t;
+
+// CDC数据批量发送参数
+typedef struct {
+    size_t max_frame_len;       // 单帧最大长度
+    size_t flush_bytes;         // 累积达到该字节数立即发送 (0表示来一条发一条)
+    uint32_t flush_timeout_ms;  // 最旧数据等待的最长时间
+} ws_batch_config_t;
+
+// CDC数据转发统计
+typedef struct {
+    uint32_t frames_sent;       // 发送的帧数 (所有客户端累计)
+    uint32_t records_sent;      // 发送的CDC记录数
+    uint32_t records_lost;      // 因客户端过慢被覆盖的记录数
+    uint64_t bytes_sent;        // 发送的字节数 (所有客户端累计)
+} ws_stream_stats_t;
+
 // 主动发送 WebSocket 文本消息
 esp_err_t websocket_server_send_text(const char *data);
 
-// 主动发送 WebSocket 二进制消息
+// 向指定客户端发送 WebSocket 文本消息 (fd为-1时广播)
+esp_err_t websocket_send_text_to(int fd, const char *data);
+
+// 向订阅了状态通道的客户端发送文本消息 (/ws?status=1，fd为-1时发给所有订阅者)
+esp_err_t websocket_send_status(int fd, const char *data);
+
+// 向指定连接发送二进制控制消息 (长度小于WEBSOCKET_TEXT_MAX_LEN，用于控制协议的异步响应；
+// 按连接编号投递，原连接断开后fd被新连接复用时不会误发)
+esp_err_t websocket_send_binary_to_session(uint32_t session, const uint8_t *data, size_t len);
+
+// 检查是否有客户端订阅了状态通道
+bool websocket_has_status_subscribers(void);
+
+// 主动发送 WebSocket 二进制消息 (作为设备0的数据)
 esp_err_t websocket_server_send_binary(const uint8_t *data, size_t len);
 
 // 启动WebSocket服务
 void websocket_start(httpd_handle_t server);
 
-// 检查WebSocket连接状态
+// 检查是否有WebSocket客户端连接
 bool websocket_is_connected(void);
 
-// USB CDC接收数据回调函数
-void usb_cdc_rx_callback(const uint8_t* data, size_t len);
+// 获取已连接的WebSocket客户端数量
+int websocket_client_count(void);
+
+// 获取客户端的连接编号 (每次连接唯一，未连接时返回0)
+uint32_t websocket_client_session(int fd);
+
+// httpd会话关闭回调 (作为httpd_config_t.close_fn使用)
+void websocket_on_session_close(httpd_handle_t hd, int sockfd);
+
+// 设置CDC数据批量发送参数
+esp_err_t websocket_set_batch_config(const ws_batch_config_t *config);
+
+// 获取CDC数据批量发送参数
+void websocket_get_batch_config(ws_batch_config_t *config);
+
+// 获取CDC数据转发统计
+void websocket_get_stream_stats(ws_stream_stats_t *stats);
+
+// USB CDC接收数据回调函数 (dev为设备编号)
+void usb_cdc_rx_callback(uint8_t dev, const uint8_t* data, size_t len);
 
 #ifdef __cplusplus
 }
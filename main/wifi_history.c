@@ -5,58 +5,214 @@
  */
 
 #include <string.h>
+#include <stdlib.h>
 #include <time.h>
 #include <inttypes.h>
 #include "esp_wifi.h"
 #include "esp_log.h"
+#include "esp_attr.h"
 #include "nvs_flash.h"
 #include "nvs.h"
-#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "wifi_history.h"
+#include "task_config.h"
+#include "mem_pool.h"
+#include "wifi_scan.h"
+#include "wifi_roam.h"
 
 static const char *TAG = "wifi_history";
 
-// NVS存储键名
+// NVS存储键名 (每个槽位一个键，只写有变化的槽位)
 #define NVS_NAMESPACE "wifi_history"
+#define NVS_KEY_ENTRY_FMT "net%d"
+// 旧版本整表保存的键，加载时迁移到槽位键后删除
 #define NVS_KEY_NETWORKS "networks"
 #define NVS_KEY_COUNT "count"
 #define NVS_KEY_TIMESTAMP "timestamp"
 
-// 全局WiFi历史管理结构
-static wifi_history_t s_wifi_history = {0};
+#define SAVE_DELAY_MS CONFIG_WIFI_HISTORY_SAVE_DELAY_MS  // 合并这段时间内的修改后一次提交
+
+#define AUTO_CONNECT_SCAN_TIMEOUT_MS 10000  // 等待扫描完成的超时时间
+
+// 槽位记录在NVS中的紧凑格式: 报头 + SSID + 密码 (不含'\0'和填充)，
+// 数据部分通常只占2个32字节的NVS条目，定长结构体要占4个
+#define NVS_RECORD_VERSION 1
+typedef struct __attribute__((packed)) {
+    uint8_t version;            // NVS_RECORD_VERSION
+    uint8_t priority;
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t authmode;
+    int8_t rssi;
+    uint8_t ssid_len;
+    uint8_t password_len;
+    uint32_t last_connected;
+    uint32_t connect_count;
+} nvs_record_hdr_t;
+
+#define NVS_RECORD_MAX_SIZE (sizeof(nvs_record_hdr_t) + WIFI_HISTORY_SSID_MAX_LEN + WIFI_HISTORY_PASSWORD_MAX_LEN)
+
+// SSID/BSSID散列索引: 开放寻址线性探测，表长为2的幂且不小于槽位数的2倍，
+// 装载率不超过50%，查找平均只比较一两次
+#define INDEX_SIZE (WIFI_HISTORY_MAX_NETWORKS <= 32  ? 64  : \
+                    WIFI_HISTORY_MAX_NETWORKS <= 64  ? 128 : \
+                    WIFI_HISTORY_MAX_NETWORKS <= 128 ? 256 : \
+                    WIFI_HISTORY_MAX_NETWORKS <= 256 ? 512 : 1024)
+#define INDEX_MASK (INDEX_SIZE - 1)
+#define INDEX_EMPTY 0xFFFF
+
+#define DIRTY_WORDS ((WIFI_HISTORY_MAX_NETWORKS + 31) / 32)
+
+// 全局WiFi历史管理结构 (有PSRAM时放在外部内存)
+EXT_RAM_BSS_ATTR static wifi_history_t s_wifi_history;
 static bool s_initialized = false;
 
+// 索引只包含有效槽位；BSSID索引只包含记录了BSSID的槽位
+static uint16_t s_ssid_index[INDEX_SIZE];
+static uint16_t s_bssid_index[INDEX_SIZE];
+static uint32_t s_ssid_hash[WIFI_HISTORY_MAX_NETWORKS];
+static uint32_t s_bssid_hash[WIFI_HISTORY_MAX_NETWORKS];
+
+// 延迟保存: 修改只标记槽位，由保存任务合并后写入
+static uint32_t s_dirty_slots[DIRTY_WORDS]; // 待写入的槽位位图
+static bool s_legacy_keys = false;          // NVS中还有旧格式的键
+static TaskHandle_t s_save_task = NULL;
+// 保护位图和记录内容: 修改记录与保存任务复制记录都在锁内进行，避免写入半条记录
+static portMUX_TYPE s_save_lock = portMUX_INITIALIZER_UNLOCKED;
+
 // 内部函数声明
 static uint32_t get_timestamp(void);
 static int find_network_index(const char* ssid);
+static int find_bssid_index(const uint8_t* bssid);
+static int find_ap_index(const wifi_ap_record_t* ap);
 static int find_empty_slot(void);
 static int find_lowest_priority_slot(void);
-static void sort_networks_by_priority(void);
+static void slot_index(int slot);
+static void slot_unindex(int slot);
+static void slot_set_bssid(int slot, const uint8_t* bssid);
+static void rebuild_index(void);
+static uint16_t* sorted_slots(int* count);
+static void mark_dirty(int index);
 
 /**
- * @brief 获取当前时间戳
+ * @brief 获取下一个连接序号
+ *
+ * 没有实时时钟，启动以来的秒数每次重启都从0开始，不能比较新旧。
+ * 改用随记录保存的递增序号，加载时从已保存的最大值继续，LRU淘汰跨重启仍然有效。
  */
 static uint32_t get_timestamp(void)
 {
-    return (uint32_t)(esp_timer_get_time() / 1000000); // 转换为秒
+    return s_wifi_history.next_timestamp++;
+}
+
+// FNV-1a散列
+static uint32_t hash_bytes(const void* data, size_t len)
+{
+    const uint8_t* p = data;
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+static bool bssid_is_set(const uint8_t* bssid)
+{
+    static const uint8_t zero_bssid[6] = {0};
+    return memcmp(bssid, zero_bssid, sizeof(zero_bssid)) != 0;
+}
+
+static void index_insert(uint16_t* index, const uint32_t* hashes, int slot)
+{
+    uint32_t pos = hashes[slot] & INDEX_MASK;
+    while (index[pos] != INDEX_EMPTY) {
+        pos = (pos + 1) & INDEX_MASK;
+    }
+    index[pos] = (uint16_t)slot;
 }
 
 /**
- * @brief 查找网络在历史记录中的索引
+ * @brief 从索引中删除槽位
+ *
+ * 删除后把同一探测链上后面的项前移 (backward shift)，不使用墓碑，
+ * 反复增删后查找长度也不会变长。
+ */
+static void index_remove(uint16_t* index, const uint32_t* hashes, int slot)
+{
+    uint32_t i = hashes[slot] & INDEX_MASK;
+    while (index[i] != slot) {
+        if (index[i] == INDEX_EMPTY) {
+            return;
+        }
+        i = (i + 1) & INDEX_MASK;
+    }
+
+    uint32_t j = i;
+    while (1) {
+        index[i] = INDEX_EMPTY;
+        while (1) {
+            j = (j + 1) & INDEX_MASK;
+            if (index[j] == INDEX_EMPTY) {
+                return;
+            }
+            // j项的起始位置在(i, j]之间时不能前移到i
+            uint32_t home = hashes[index[j]] & INDEX_MASK;
+            bool stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+            if (!stays) {
+                break;
+            }
+        }
+        index[i] = index[j];
+        i = j;
+    }
+}
+
+/**
+ * @brief 按SSID查找网络所在的槽位
  */
 static int find_network_index(const char* ssid)
 {
     if (!ssid) return -1;
     
-    for (int i = 0; i < WIFI_HISTORY_MAX_NETWORKS; i++) {
-        if (s_wifi_history.networks[i].is_valid && 
-            strcmp(s_wifi_history.networks[i].ssid, ssid) == 0) {
-            return i;
+    uint32_t h = hash_bytes(ssid, strlen(ssid));
+    for (uint32_t pos = h & INDEX_MASK; s_ssid_index[pos] != INDEX_EMPTY; pos = (pos + 1) & INDEX_MASK) {
+        int slot = s_ssid_index[pos];
+        if (s_ssid_hash[slot] == h && strcmp(s_wifi_history.networks[slot].ssid, ssid) == 0) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief 按BSSID查找网络所在的槽位
+ */
+static int find_bssid_index(const uint8_t* bssid)
+{
+    uint32_t h = hash_bytes(bssid, 6);
+    for (uint32_t pos = h & INDEX_MASK; s_bssid_index[pos] != INDEX_EMPTY; pos = (pos + 1) & INDEX_MASK) {
+        int slot = s_bssid_index[pos];
+        if (s_bssid_hash[slot] == h && memcmp(s_wifi_history.networks[slot].bssid, bssid, 6) == 0) {
+            return slot;
         }
     }
     return -1;
 }
 
+/**
+ * @brief 查找扫描结果对应的历史网络
+ *
+ * 按SSID查找；隐藏网络的扫描结果没有SSID，按上次连接的BSSID查找。
+ */
+static int find_ap_index(const wifi_ap_record_t* ap)
+{
+    if (ap->ssid[0] != '\0') {
+        return find_network_index((const char*)ap->ssid);
+    }
+    return find_bssid_index(ap->bssid);
+}
+
 /**
  * @brief 查找空闲槽位
  */
@@ -71,7 +227,7 @@ static int find_empty_slot(void)
 }
 
 /**
- * @brief 查找优先级最低的槽位
+ * @brief 查找要淘汰的槽位: 优先级最低的，优先级相同时最久未连接的
  */
 static int find_lowest_priority_slot(void)
 {
@@ -95,28 +251,135 @@ static int find_lowest_priority_slot(void)
 }
 
 /**
- * @brief 按优先级排序网络
+ * @brief 把有效槽位加入索引 (写入SSID和BSSID之后调用)
  */
-static void sort_networks_by_priority(void)
+static void slot_index(int slot)
 {
-    // 简单的冒泡排序，按优先级降序排列
-    for (int i = 0; i < WIFI_HISTORY_MAX_NETWORKS - 1; i++) {
-        for (int j = 0; j < WIFI_HISTORY_MAX_NETWORKS - 1 - i; j++) {
-            if (!s_wifi_history.networks[j].is_valid) continue;
-            if (!s_wifi_history.networks[j + 1].is_valid) continue;
-            
-            // 比较优先级，优先级高的排在前面
-            if (s_wifi_history.networks[j].priority < s_wifi_history.networks[j + 1].priority ||
-                (s_wifi_history.networks[j].priority == s_wifi_history.networks[j + 1].priority &&
-                 s_wifi_history.networks[j].last_connected < s_wifi_history.networks[j + 1].last_connected)) {
-                
-                // 交换位置
-                wifi_history_entry_t temp = s_wifi_history.networks[j];
-                s_wifi_history.networks[j] = s_wifi_history.networks[j + 1];
-                s_wifi_history.networks[j + 1] = temp;
-            }
+    const wifi_history_entry_t* e = &s_wifi_history.networks[slot];
+    s_ssid_hash[slot] = hash_bytes(e->ssid, strlen(e->ssid));
+    index_insert(s_ssid_index, s_ssid_hash, slot);
+    if (bssid_is_set(e->bssid)) {
+        s_bssid_hash[slot] = hash_bytes(e->bssid, 6);
+        index_insert(s_bssid_index, s_bssid_hash, slot);
+    }
+}
+
+/**
+ * @brief 把槽位移出索引 (清除记录之前调用)
+ */
+static void slot_unindex(int slot)
+{
+    index_remove(s_ssid_index, s_ssid_hash, slot);
+    if (bssid_is_set(s_wifi_history.networks[slot].bssid)) {
+        index_remove(s_bssid_index, s_bssid_hash, slot);
+    }
+}
+
+/**
+ * @brief 修改已索引槽位的BSSID并更新BSSID索引
+ */
+static void slot_set_bssid(int slot, const uint8_t* bssid)
+{
+    wifi_history_entry_t* e = &s_wifi_history.networks[slot];
+    if (memcmp(e->bssid, bssid, sizeof(e->bssid)) == 0) {
+        return;
+    }
+    if (bssid_is_set(e->bssid)) {
+        index_remove(s_bssid_index, s_bssid_hash, slot);
+    }
+    memcpy(e->bssid, bssid, sizeof(e->bssid));
+    if (bssid_is_set(e->bssid)) {
+        s_bssid_hash[slot] = hash_bytes(e->bssid, 6);
+        index_insert(s_bssid_index, s_bssid_hash, slot);
+    }
+}
+
+/**
+ * @brief 按当前记录重建两个索引
+ */
+static void rebuild_index(void)
+{
+    memset(s_ssid_index, 0xFF, sizeof(s_ssid_index));
+    memset(s_bssid_index, 0xFF, sizeof(s_bssid_index));
+    for (int i = 0; i < WIFI_HISTORY_MAX_NETWORKS; i++) {
+        if (s_wifi_history.networks[i].is_valid) {
+            slot_index(i);
+        }
+    }
+}
+
+// a的优先级是否高于b (优先级相同时上次连接较晚的优先)
+static bool ranks_higher(const wifi_history_entry_t* a, const wifi_history_entry_t* b)
+{
+    return a->priority > b->priority ||
+           (a->priority == b->priority && a->last_connected > b->last_connected);
+}
+
+static int compare_slots(const void* a, const void* b)
+{
+    const wifi_history_entry_t* ea = &s_wifi_history.networks[*(const uint16_t*)a];
+    const wifi_history_entry_t* eb = &s_wifi_history.networks[*(const uint16_t*)b];
+    if (ranks_higher(ea, eb)) return -1;
+    if (ranks_higher(eb, ea)) return 1;
+    return 0;
+}
+
+/**
+ * @brief 按优先级降序列出有效槽位 (只在列出全部网络时使用，选择连接目标不需要排序)
+ *
+ * 记录本身不移动，每个槽位始终对应同一个NVS键，排序不会引起写入。
+ * @param count 输出有效槽位数
+ * @return 槽位数组 (用mem_pool_free释放)，内存不足时为NULL
+ */
+static uint16_t* sorted_slots(int* count)
+{
+    uint16_t* order = mem_pool_alloc(sizeof(uint16_t) * WIFI_HISTORY_MAX_NETWORKS);
+    if (!order) {
+        return NULL;
+    }
+    int n = 0;
+    for (int i = 0; i < WIFI_HISTORY_MAX_NETWORKS; i++) {
+        if (s_wifi_history.networks[i].is_valid) {
+            order[n++] = (uint16_t)i;
         }
     }
+    qsort(order, n, sizeof(uint16_t), compare_slots);
+    *count = n;
+    return order;
+}
+
+/**
+ * @brief 标记槽位待保存并唤醒保存任务 (在修改记录之后调用)
+ */
+static void mark_dirty(int index)
+{
+    taskENTER_CRITICAL(&s_save_lock);
+    s_dirty_slots[index / 32] |= 1u << (index % 32);
+    taskEXIT_CRITICAL(&s_save_lock);
+    if (s_save_task) {
+        xTaskNotifyGive(s_save_task);
+    }
+}
+
+static bool any_dirty(void)
+{
+    for (int i = 0; i < DIRTY_WORDS; i++) {
+        if (s_dirty_slots[i]) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 保存任务：收到修改通知后等待一段时间，把期间的所有修改合并为一次提交
+ */
+static void wifi_history_save_task(void* arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        vTaskDelay(pdMS_TO_TICKS(SAVE_DELAY_MS));
+        ulTaskNotifyTake(pdTRUE, 0);
+        wifi_history_save();
+    }
 }
 
 esp_err_t wifi_history_init(void)
@@ -135,18 +398,14 @@ esp_err_t wifi_history_init(void)
     }
     
     s_initialized = true;
-    ESP_LOGI(TAG, "WiFi历史管理初始化完成");
-    
-    // 打印当前历史记录
-    ESP_LOGI(TAG, "当前WiFi历史记录:");
-    for (int i = 0; i < WIFI_HISTORY_MAX_NETWORKS; i++) {
-        if (s_wifi_history.networks[i].is_valid) {
-            ESP_LOGI(TAG, "  [%d] %s (优先级: %u, 连接次数: %"PRIu32")", 
-                     i, s_wifi_history.networks[i].ssid, 
-                     (unsigned int)s_wifi_history.networks[i].priority,
-                     s_wifi_history.networks[i].connect_count);
-        }
+    if (task_config_create(TASK_CFG_WIFI_HISTORY_SAVE, wifi_history_save_task, NULL, &s_save_task) != pdPASS) {
+        ESP_LOGW(TAG, "创建历史记录保存任务失败，修改将在下次调用wifi_history_save时写入");
     }
+    if (s_save_task && (any_dirty() || s_legacy_keys)) {
+        xTaskNotifyGive(s_save_task);
+    }
+    ESP_LOGI(TAG, "WiFi历史管理初始化完成 (%u/%d 个网络)",
+             (unsigned int)s_wifi_history.count, WIFI_HISTORY_MAX_NETWORKS);
     
     return ESP_OK;
 }
@@ -181,6 +440,7 @@ esp_err_t wifi_history_add_network(const char* ssid, const char* password,
         // 更新现有记录
         wifi_history_entry_t* entry = &s_wifi_history.networks[index];
         
+        taskENTER_CRITICAL(&s_save_lock);
         // 更新密码（如果提供）
         if (password) {
             strlcpy(entry->password, password, sizeof(entry->password));
@@ -188,14 +448,16 @@ esp_err_t wifi_history_add_network(const char* ssid, const char* password,
         
         // 更新其他信息
         if (bssid) {
-            memcpy(entry->bssid, bssid, 6);
+            slot_set_bssid(index, bssid);
         }
         entry->channel = channel;
         entry->authmode = authmode;
         entry->rssi = rssi;
         entry->last_connected = get_timestamp();
+        taskEXIT_CRITICAL(&s_save_lock);
         
         ESP_LOGI(TAG, "更新WiFi网络: %s", ssid);
+        mark_dirty(index);
     } else {
         // 添加新记录
         index = find_empty_slot();
@@ -203,11 +465,13 @@ esp_err_t wifi_history_add_network(const char* ssid, const char* password,
             // 没有空闲槽位，替换优先级最低的
             index = find_lowest_priority_slot();
             ESP_LOGW(TAG, "WiFi历史记录已满，替换网络: %s", s_wifi_history.networks[index].ssid);
+            slot_unindex(index);
         } else {
             s_wifi_history.count++;
         }
         
         wifi_history_entry_t* entry = &s_wifi_history.networks[index];
+        taskENTER_CRITICAL(&s_save_lock);
         memset(entry, 0, sizeof(wifi_history_entry_t));
         
         strlcpy(entry->ssid, ssid, sizeof(entry->ssid));
@@ -225,15 +489,17 @@ esp_err_t wifi_history_add_network(const char* ssid, const char* password,
         entry->connect_count = 1;
         entry->priority = 100; // 默认优先级
         entry->is_valid = true;
+        slot_index(index);
+        taskEXIT_CRITICAL(&s_save_lock);
         
         ESP_LOGI(TAG, "添加新WiFi网络: %s", ssid);
+        mark_dirty(index);
     }
     
-    // 保存到NVS
-    return wifi_history_save();
+    return ESP_OK;
 }
 
-esp_err_t wifi_history_update_success(const char* ssid)
+esp_err_t wifi_history_update_success(const char* ssid, const uint8_t* bssid, uint8_t channel)
 {
     if (!s_initialized) {
         ESP_LOGE(TAG, "WiFi历史管理未初始化");
@@ -251,28 +517,30 @@ esp_err_t wifi_history_update_success(const char* ssid)
     }
     
     wifi_history_entry_t* entry = &s_wifi_history.networks[index];
+    taskENTER_CRITICAL(&s_save_lock);
     entry->last_connected = get_timestamp();
     entry->connect_count++;
+    if (bssid != NULL && channel != 0) {
+        slot_set_bssid(index, bssid);
+        entry->channel = channel;
+    }
     
-    // 动态调整优先级：连接次数越多，优先级越高
+    // 动态调整优先级：连接次数越多，优先级越高 (封顶255，不能让uint8_t回绕成低优先级而被淘汰)
     if (entry->connect_count > 1) {
-        entry->priority = 100 + (entry->connect_count - 1) * 10;
-        // priority 是uint8_t类型，最大值就是255，不需要检查
-        // if (entry->priority > 255) {
-        //     entry->priority = 255;
-        // }
+        uint32_t priority = 100 + (entry->connect_count - 1) * 10;
+        entry->priority = priority > 255 || priority < 100 ? 255 : (uint8_t)priority;
     }
+    taskEXIT_CRITICAL(&s_save_lock);
     
     ESP_LOGI(TAG, "更新WiFi连接成功: %s (连接次数: %"PRIu32", 优先级: %u)", 
              ssid, entry->connect_count, (unsigned int)entry->priority);
     
-    // 重新排序
-    sort_networks_by_priority();
-    
-    return wifi_history_save();
+    // 只写这一个槽位，频繁重连时由保存任务合并
+    mark_dirty(index);
+    return ESP_OK;
 }
 
-esp_err_t wifi_history_get_networks(wifi_history_entry_t* networks, uint8_t* count)
+esp_err_t wifi_history_get_networks(wifi_history_entry_t* networks, uint16_t* count)
 {
     if (!s_initialized) {
         ESP_LOGE(TAG, "WiFi历史管理未初始化");
@@ -283,23 +551,49 @@ esp_err_t wifi_history_get_networks(wifi_history_entry_t* networks, uint8_t* cou
         return ESP_ERR_INVALID_ARG;
     }
     
-    uint8_t max_count = *count;
+    uint16_t max_count = *count;
     *count = 0;
     
-    // 先排序确保返回的是按优先级排列的
-    sort_networks_by_priority();
-    
-    for (int i = 0; i < WIFI_HISTORY_MAX_NETWORKS && *count < max_count; i++) {
-        if (s_wifi_history.networks[i].is_valid) {
-            memcpy(&networks[*count], &s_wifi_history.networks[i], sizeof(wifi_history_entry_t));
-            (*count)++;
-        }
+    // 按优先级顺序返回
+    int n;
+    uint16_t* order = sorted_slots(&n);
+    if (!order) {
+        return ESP_ERR_NO_MEM;
     }
+    for (int i = 0; i < n && *count < max_count; i++) {
+        memcpy(&networks[*count], &s_wifi_history.networks[order[i]], sizeof(wifi_history_entry_t));
+        (*count)++;
+    }
+    mem_pool_free(order);
     
     ESP_LOGI(TAG, "获取WiFi历史网络: %u 个", *count);
     return ESP_OK;
 }
 
+esp_err_t wifi_history_foreach(wifi_history_visit_t visit, void* arg)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    if (!visit) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    int n;
+    uint16_t* order = sorted_slots(&n);
+    if (!order) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < n; i++) {
+        if (!visit(&s_wifi_history.networks[order[i]], arg)) {
+            break;
+        }
+    }
+    mem_pool_free(order);
+    return ESP_OK;
+}
+
 esp_err_t wifi_history_remove_network(const char* ssid)
 {
     if (!s_initialized) {
@@ -318,12 +612,16 @@ esp_err_t wifi_history_remove_network(const char* ssid)
     }
     
     // 清除记录
+    taskENTER_CRITICAL(&s_save_lock);
+    slot_unindex(index);
     memset(&s_wifi_history.networks[index], 0, sizeof(wifi_history_entry_t));
     s_wifi_history.count--;
+    taskEXIT_CRITICAL(&s_save_lock);
     
     ESP_LOGI(TAG, "删除WiFi网络: %s", ssid);
     
-    return wifi_history_save();
+    mark_dirty(index);
+    return ESP_OK;
 }
 
 esp_err_t wifi_history_clear_all(void)
@@ -333,12 +631,56 @@ esp_err_t wifi_history_clear_all(void)
         return ESP_ERR_INVALID_STATE;
     }
     
-    memset(&s_wifi_history, 0, sizeof(wifi_history_t));
-    s_wifi_history.next_timestamp = 1;
+    // 只需擦除原来有记录的槽位
+    for (int i = 0; i < WIFI_HISTORY_MAX_NETWORKS; i++) {
+        if (s_wifi_history.networks[i].is_valid) {
+            taskENTER_CRITICAL(&s_save_lock);
+            memset(&s_wifi_history.networks[i], 0, sizeof(wifi_history_entry_t));
+            taskEXIT_CRITICAL(&s_save_lock);
+            mark_dirty(i);
+        }
+    }
+    s_wifi_history.count = 0;
+    rebuild_index();
     
     ESP_LOGI(TAG, "清空所有WiFi历史记录");
-    
-    return wifi_history_save();
+    return ESP_OK;
+}
+
+esp_err_t wifi_history_get_network(const char* ssid, wifi_history_entry_t* entry)
+{
+    if (!s_initialized || !entry) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int index = find_network_index(ssid);
+    if (index < 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    memcpy(entry, &s_wifi_history.networks[index], sizeof(wifi_history_entry_t));
+    return ESP_OK;
+}
+
+esp_err_t wifi_history_get_cached_ap(wifi_history_entry_t* entry)
+{
+    if (!s_initialized || !entry) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // 只需要优先级最高的一个，不排序
+    const wifi_history_entry_t* best = NULL;
+    for (int i = 0; i < WIFI_HISTORY_MAX_NETWORKS; i++) {
+        const wifi_history_entry_t* e = &s_wifi_history.networks[i];
+        if (e->is_valid && e->channel != 0 && bssid_is_set(e->bssid) &&
+            (best == NULL || ranks_higher(e, best))) {
+            best = e;
+        }
+    }
+    if (best == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    memcpy(entry, best, sizeof(wifi_history_entry_t));
+    return ESP_OK;
 }
 
 esp_err_t wifi_history_find_best_network(const wifi_ap_record_t* available_networks,
@@ -354,29 +696,32 @@ esp_err_t wifi_history_find_best_network(const wifi_ap_record_t* available_netwo
         return ESP_ERR_INVALID_ARG;
     }
     
-    // 先排序历史网络
-    sort_networks_by_priority();
-    
-    // 按优先级查找匹配的网络
-    for (int i = 0; i < WIFI_HISTORY_MAX_NETWORKS; i++) {
-        if (!s_wifi_history.networks[i].is_valid) continue;
-        
-        // 在可用网络中查找匹配的SSID
-        for (int j = 0; j < network_count; j++) {
-            if (strcmp(s_wifi_history.networks[i].ssid, (char*)available_networks[j].ssid) == 0) {
-                // 找到匹配的网络，检查信号强度是否可接受
-                if (available_networks[j].rssi > -80) { // 信号强度阈值
-                    memcpy(best_network, &s_wifi_history.networks[i], sizeof(wifi_history_entry_t));
-                    ESP_LOGI(TAG, "找到最佳网络: %s (优先级: %u, RSSI: %d)", 
-                             best_network->ssid, best_network->priority, available_networks[j].rssi);
-                    return ESP_OK;
-                }
-            }
+    // 逐个扫描结果查索引，选出其中优先级最高的历史网络
+    const wifi_history_entry_t* best = NULL;
+    int best_rssi = 0;
+    for (int j = 0; j < network_count; j++) {
+        if (available_networks[j].rssi <= -80) { // 信号强度阈值
+            continue;
+        }
+        int index = find_ap_index(&available_networks[j]);
+        if (index < 0) {
+            continue;
+        }
+        const wifi_history_entry_t* e = &s_wifi_history.networks[index];
+        if (best == NULL || ranks_higher(e, best)) {
+            best = e;
+            best_rssi = available_networks[j].rssi;
         }
     }
     
-    ESP_LOGW(TAG, "未找到合适的历史网络");
-    return ESP_ERR_NOT_FOUND;
+    if (best == NULL) {
+        ESP_LOGW(TAG, "未找到合适的历史网络");
+        return ESP_ERR_NOT_FOUND;
+    }
+    memcpy(best_network, best, sizeof(wifi_history_entry_t));
+    ESP_LOGI(TAG, "找到最佳网络: %s (优先级: %u, RSSI: %d)", 
+             best_network->ssid, best_network->priority, best_rssi);
+    return ESP_OK;
 }
 
 esp_err_t wifi_history_auto_connect(void)
@@ -396,97 +741,36 @@ esp_err_t wifi_history_auto_connect(void)
         return ESP_ERR_INVALID_STATE;
     }
     
-    // 检查WiFi状态并等待合适的扫描时机
-    wifi_ap_record_t ap_info;
-    bool was_connected = (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK);
-    
-    if (was_connected) {
-        ESP_LOGI(TAG, "断开当前WiFi连接以进行扫描");
+    // 扫描可用网络 (经扫描服务，不断开STA，缓存有效时直接使用)
+    bool cached;
+    esp_err_t ret = wifi_scan_request(CONFIG_WIFI_SCAN_CACHE_TTL_MS, &cached);
+    if (ret == ESP_ERR_WIFI_STATE) {
+        // 驱动正忙于连接时无法扫描，断开后重试
+        ESP_LOGI(TAG, "WiFi状态错误，尝试重置后重试...");
         esp_wifi_disconnect();
-        vTaskDelay(pdMS_TO_TICKS(2000)); // 等待断开完成
-    }
-    
-    // 停止可能正在进行的扫描
-    esp_wifi_scan_stop();
-    vTaskDelay(pdMS_TO_TICKS(500)); // 增加等待时间
-    
-    // 等待WiFi进入空闲状态
-    int retry_count = 0;
-    while (retry_count < 10) {
-        wifi_mode_t mode;
-        esp_wifi_get_mode(&mode);
-        if (mode & WIFI_MODE_STA) {
-            // 检查STA状态
-            wifi_ap_record_t temp_ap;
-            if (esp_wifi_sta_get_ap_info(&temp_ap) != ESP_OK) {
-                // STA未连接，可以扫描
-                break;
-            }
-        }
-        ESP_LOGD(TAG, "等待WiFi进入空闲状态... (%d/10)", retry_count + 1);
-        vTaskDelay(pdMS_TO_TICKS(500));
-        retry_count++;
+        vTaskDelay(pdMS_TO_TICKS(1000));
+        ret = wifi_scan_request(CONFIG_WIFI_SCAN_CACHE_TTL_MS, &cached);
     }
-    
-    if (retry_count >= 10) {
-        ESP_LOGW(TAG, "WiFi状态等待超时，强制进行扫描");
+    if (ret == ESP_OK && !cached) {
+        ret = wifi_scan_wait(AUTO_CONNECT_SCAN_TIMEOUT_MS);
     }
-    
-    // 扫描可用网络
-    wifi_scan_config_t scan_config = {
-        .ssid = NULL,
-        .bssid = NULL,
-        .channel = 0,
-        .show_hidden = true,
-        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
-        .scan_time = {
-            .active = {
-                .min = 100,
-                .max = 300
-            }
-        }
-    };
-    
-    esp_err_t ret = esp_wifi_scan_start(&scan_config, true);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "WiFi扫描失败: %s", esp_err_to_name(ret));
-        
-        // 如果扫描失败，尝试重置WiFi状态后重试
-        if (ret == ESP_ERR_WIFI_STATE) {
-            ESP_LOGI(TAG, "WiFi状态错误，尝试重置后重试...");
-            esp_wifi_disconnect();
-            vTaskDelay(pdMS_TO_TICKS(1000));
-            
-            ret = esp_wifi_scan_start(&scan_config, true);
-            if (ret != ESP_OK) {
-                ESP_LOGE(TAG, "重试扫描仍然失败: %s", esp_err_to_name(ret));
-                return ret;
-            }
-        } else {
-            return ret;
-        }
+        return ret;
     }
     
     // 获取扫描结果
-    uint16_t ap_count = 0;
-    esp_wifi_scan_get_ap_num(&ap_count);
-    
-    if (ap_count == 0) {
-        ESP_LOGW(TAG, "未扫描到任何WiFi网络");
-        return ESP_ERR_NOT_FOUND;
-    }
-    
-    wifi_ap_record_t *ap_records = malloc(sizeof(wifi_ap_record_t) * ap_count);
+    wifi_ap_record_t *ap_records = mem_pool_alloc(sizeof(wifi_ap_record_t) * WIFI_SCAN_MAX_APS);
     if (!ap_records) {
         ESP_LOGE(TAG, "分配内存失败");
         return ESP_ERR_NO_MEM;
     }
+    uint16_t ap_count = wifi_scan_get_results(ap_records, WIFI_SCAN_MAX_APS, NULL);
     
-    ret = esp_wifi_scan_get_ap_records(&ap_count, ap_records);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "获取扫描结果失败: %s", esp_err_to_name(ret));
-        free(ap_records);
-        return ret;
+    if (ap_count == 0) {
+        ESP_LOGW(TAG, "未扫描到任何WiFi网络");
+        mem_pool_free(ap_records);
+        return ESP_ERR_NOT_FOUND;
     }
     
     ESP_LOGI(TAG, "扫描到 %u 个WiFi网络", ap_count);
@@ -499,53 +783,35 @@ esp_err_t wifi_history_auto_connect(void)
                  ap_records[i].bssid[3], ap_records[i].bssid[4], ap_records[i].bssid[5]);
     }
     
-    // 打印历史网络
-    ESP_LOGI(TAG, "检查历史网络:");
-    for (int i = 0; i < WIFI_HISTORY_MAX_NETWORKS; i++) {
-        if (s_wifi_history.networks[i].is_valid) {
-            ESP_LOGI(TAG, "历史网络[%d]: %s (优先级: %u)", 
-                     i, s_wifi_history.networks[i].ssid, (unsigned int)s_wifi_history.networks[i].priority);
-        }
-    }
-    
-    // 查找最佳网络（按信号强度排序）
+    // 查找最佳网络（按信号强度排序）: 逐个扫描结果查索引，与历史记录数量无关
     wifi_history_entry_t best_network;
     int best_rssi = -100;
     bool found_network = false;
     wifi_ap_record_t best_ap_record;
     
-    // 遍历历史网络，找到信号最强的可用网络
-    for (int i = 0; i < WIFI_HISTORY_MAX_NETWORKS; i++) {
-        if (!s_wifi_history.networks[i].is_valid) continue;
+    for (uint16_t j = 0; j < ap_count; j++) {
+        if (ap_records[j].rssi <= -85) { // 信号强度阈值
+            continue;
+        }
+        int index = find_ap_index(&ap_records[j]);
+        if (index < 0) {
+            continue;
+        }
+        const wifi_history_entry_t* e = &s_wifi_history.networks[index];
         
-        // 检查是否在历史记录中
-        for (int j = 0; j < ap_count; j++) {
-            if (strcmp((char*)ap_records[j].ssid, s_wifi_history.networks[i].ssid) == 0 && 
-                ap_records[j].rssi > -85) { // 信号强度阈值
-                
-                ESP_LOGI(TAG, "发现历史网络: %s (RSSI: %d, 优先级: %d)", 
-                         s_wifi_history.networks[i].ssid, ap_records[j].rssi, s_wifi_history.networks[i].priority);
-                ESP_LOGI(TAG, "  扫描BSSID: %02x:%02x:%02x:%02x:%02x:%02x",
-                         ap_records[j].bssid[0], ap_records[j].bssid[1], ap_records[j].bssid[2],
-                         ap_records[j].bssid[3], ap_records[j].bssid[4], ap_records[j].bssid[5]);
-                ESP_LOGI(TAG, "  历史BSSID: %02x:%02x:%02x:%02x:%02x:%02x",
-                         s_wifi_history.networks[i].bssid[0], s_wifi_history.networks[i].bssid[1], s_wifi_history.networks[i].bssid[2],
-                         s_wifi_history.networks[i].bssid[3], s_wifi_history.networks[i].bssid[4], s_wifi_history.networks[i].bssid[5]);
-                
-                if (ap_records[j].rssi > best_rssi || 
-                    (ap_records[j].rssi == best_rssi && s_wifi_history.networks[i].priority > best_network.priority)) {
-                    best_rssi = ap_records[j].rssi;
-                    best_network = s_wifi_history.networks[i];
-                    best_ap_record = ap_records[j];
-                    found_network = true;
-                    ESP_LOGI(TAG, "选择此网络作为最佳候选");
-                }
-                break;
-            }
+        ESP_LOGI(TAG, "发现历史网络: %s (RSSI: %d, 优先级: %d)", 
+                 e->ssid, ap_records[j].rssi, e->priority);
+        
+        if (ap_records[j].rssi > best_rssi || 
+            (ap_records[j].rssi == best_rssi && e->priority > best_network.priority)) {
+            best_rssi = ap_records[j].rssi;
+            best_network = *e;
+            best_ap_record = ap_records[j];
+            found_network = true;
         }
     }
     
-    free(ap_records);
+    mem_pool_free(ap_records);
     
     if (!found_network) {
         ESP_LOGW(TAG, "未找到合适的历史网络进行连接");
@@ -562,6 +828,7 @@ esp_err_t wifi_history_auto_connect(void)
     wifi_config.sta.pmf_cfg.required = false;
     wifi_config.sta.threshold.authmode = WIFI_AUTH_OPEN; // 允许更宽松的认证模式
     wifi_config.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL; // 按信号强度排序
+    wifi_roam_apply_config(&wifi_config.sta);             // 启用802.11k/v
     
     // 设置信道
     wifi_config.sta.channel = best_ap_record.primary;
@@ -600,8 +867,20 @@ esp_err_t wifi_history_auto_connect(void)
         }
     }
     
+    // 扫描期间保持原连接，切换网络前才断开
+    wifi_ap_record_t current_ap;
+    if (esp_wifi_sta_get_ap_info(&current_ap) == ESP_OK) {
+        if (memcmp(current_ap.bssid, best_ap_record.bssid, 6) == 0) {
+            ESP_LOGI(TAG, "已连接到最佳网络: %s", best_network.ssid);
+            return ESP_OK;
+        }
+        ESP_LOGI(TAG, "断开当前WiFi连接以切换网络");
+        esp_wifi_disconnect();
+        vTaskDelay(pdMS_TO_TICKS(500));
+    }
+
     ESP_LOGI(TAG, "尝试连接到信号最强的WiFi: %s (RSSI: %d)", best_network.ssid, best_rssi);
-    
+
     ret = esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "设置WiFi配置失败: %s", esp_err_to_name(ret));
@@ -638,57 +917,159 @@ esp_err_t wifi_history_auto_connect(void)
     return ESP_OK;
 }
 
+/**
+ * @brief 把记录编码为NVS紧凑格式
+ * @return 编码后的长度
+ */
+static size_t encode_record(const wifi_history_entry_t* entry, uint8_t* buf)
+{
+    nvs_record_hdr_t hdr = {
+        .version = NVS_RECORD_VERSION,
+        .priority = entry->priority,
+        .channel = entry->channel,
+        .authmode = (uint8_t)entry->authmode,
+        .rssi = entry->rssi,
+        .ssid_len = (uint8_t)strnlen(entry->ssid, WIFI_HISTORY_SSID_MAX_LEN - 1),
+        .password_len = (uint8_t)strnlen(entry->password, WIFI_HISTORY_PASSWORD_MAX_LEN - 1),
+        .last_connected = entry->last_connected,
+        .connect_count = entry->connect_count,
+    };
+    memcpy(hdr.bssid, entry->bssid, sizeof(hdr.bssid));
+    
+    size_t len = 0;
+    memcpy(buf, &hdr, sizeof(hdr));
+    len += sizeof(hdr);
+    memcpy(buf + len, entry->ssid, hdr.ssid_len);
+    len += hdr.ssid_len;
+    memcpy(buf + len, entry->password, hdr.password_len);
+    len += hdr.password_len;
+    return len;
+}
+
+/**
+ * @brief 解码NVS紧凑格式的记录
+ * @return 格式正确返回true
+ */
+static bool decode_record(const uint8_t* buf, size_t len, wifi_history_entry_t* entry)
+{
+    nvs_record_hdr_t hdr;
+    if (len < sizeof(hdr)) {
+        return false;
+    }
+    memcpy(&hdr, buf, sizeof(hdr));
+    if (hdr.version != NVS_RECORD_VERSION || hdr.ssid_len == 0 ||
+        hdr.ssid_len >= WIFI_HISTORY_SSID_MAX_LEN || hdr.password_len >= WIFI_HISTORY_PASSWORD_MAX_LEN ||
+        len != sizeof(hdr) + hdr.ssid_len + hdr.password_len) {
+        return false;
+    }
+    
+    memset(entry, 0, sizeof(*entry));
+    memcpy(entry->ssid, buf + sizeof(hdr), hdr.ssid_len);
+    memcpy(entry->password, buf + sizeof(hdr) + hdr.ssid_len, hdr.password_len);
+    memcpy(entry->bssid, hdr.bssid, sizeof(entry->bssid));
+    entry->channel = hdr.channel;
+    entry->authmode = (wifi_auth_mode_t)hdr.authmode;
+    entry->rssi = hdr.rssi;
+    entry->last_connected = hdr.last_connected;
+    entry->connect_count = hdr.connect_count;
+    entry->priority = hdr.priority;
+    entry->is_valid = true;
+    return true;
+}
+
 esp_err_t wifi_history_save(void)
 {
     if (!s_initialized) {
         return ESP_ERR_INVALID_STATE;
     }
     
+    uint32_t dirty[DIRTY_WORDS];
+    bool any = false;
+    taskENTER_CRITICAL(&s_save_lock);
+    for (int w = 0; w < DIRTY_WORDS; w++) {
+        dirty[w] = s_dirty_slots[w];
+        s_dirty_slots[w] = 0;
+        any |= dirty[w] != 0;
+    }
+    taskEXIT_CRITICAL(&s_save_lock);
+    if (!any && !s_legacy_keys) {
+        return ESP_OK;
+    }
+    
     nvs_handle_t nvs_handle;
     esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "打开NVS失败: %s", esp_err_to_name(ret));
+        taskENTER_CRITICAL(&s_save_lock);
+        for (int w = 0; w < DIRTY_WORDS; w++) {
+            s_dirty_slots[w] |= dirty[w];
+        }
+        taskEXIT_CRITICAL(&s_save_lock);
         return ret;
     }
     
-    // 保存网络数据
-    ret = nvs_set_blob(nvs_handle, NVS_KEY_NETWORKS, 
-                       s_wifi_history.networks, 
-                       sizeof(s_wifi_history.networks));
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "保存网络数据失败: %s", esp_err_to_name(ret));
-        nvs_close(nvs_handle);
-        return ret;
-    }
-    
-    // 保存计数
-    ret = nvs_set_u8(nvs_handle, NVS_KEY_COUNT, s_wifi_history.count);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "保存网络计数失败: %s", esp_err_to_name(ret));
-        nvs_close(nvs_handle);
-        return ret;
+    // 逐个写入有变化的槽位，删除的槽位擦除其键
+    uint32_t failed[DIRTY_WORDS] = {0};
+    bool any_failed = false;
+    int written = 0;
+    for (int i = 0; i < WIFI_HISTORY_MAX_NETWORKS; i++) {
+        if (!(dirty[i / 32] & (1u << (i % 32)))) continue;
+        
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        snprintf(key, sizeof(key), NVS_KEY_ENTRY_FMT, i);
+        wifi_history_entry_t entry;
+        taskENTER_CRITICAL(&s_save_lock);
+        memcpy(&entry, &s_wifi_history.networks[i], sizeof(entry));
+        taskEXIT_CRITICAL(&s_save_lock);
+        
+        if (entry.is_valid) {
+            uint8_t record[NVS_RECORD_MAX_SIZE];
+            size_t len = encode_record(&entry, record);
+            ret = nvs_set_blob(nvs_handle, key, record, len);
+        } else {
+            ret = nvs_erase_key(nvs_handle, key);
+            if (ret == ESP_ERR_NVS_NOT_FOUND) {
+                ret = ESP_OK;
+            }
+        }
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "保存槽位%d失败: %s", i, esp_err_to_name(ret));
+            failed[i / 32] |= 1u << (i % 32);
+            any_failed = true;
+        } else {
+            written++;
+        }
     }
     
-    // 保存时间戳
-    ret = nvs_set_u32(nvs_handle, NVS_KEY_TIMESTAMP, s_wifi_history.next_timestamp);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "保存时间戳失败: %s", esp_err_to_name(ret));
-        nvs_close(nvs_handle);
-        return ret;
+    // 迁移完成后删除旧格式的整表
+    if (s_legacy_keys && !any_failed) {
+        nvs_erase_key(nvs_handle, NVS_KEY_NETWORKS);
+        nvs_erase_key(nvs_handle, NVS_KEY_COUNT);
+        nvs_erase_key(nvs_handle, NVS_KEY_TIMESTAMP);
+        s_legacy_keys = false;
     }
     
     ret = nvs_commit(nvs_handle);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "提交NVS失败: %s", esp_err_to_name(ret));
+        memcpy(failed, dirty, sizeof(failed));
+        any_failed = true;
     }
     
     nvs_close(nvs_handle);
     
-    if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "WiFi历史记录已保存");
+    // 失败的槽位留待下次保存
+    if (any_failed) {
+        taskENTER_CRITICAL(&s_save_lock);
+        for (int w = 0; w < DIRTY_WORDS; w++) {
+            s_dirty_slots[w] |= failed[w];
+        }
+        taskEXIT_CRITICAL(&s_save_lock);
+        return ret != ESP_OK ? ret : ESP_FAIL;
     }
     
-    return ret;
+    ESP_LOGI(TAG, "WiFi历史记录已保存 (%d个槽位)", written);
+    return ESP_OK;
 }
 
 esp_err_t wifi_history_load(void)
@@ -697,34 +1078,66 @@ esp_err_t wifi_history_load(void)
     esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
     if (ret != ESP_OK) {
         ESP_LOGW(TAG, "打开NVS失败: %s", esp_err_to_name(ret));
+        rebuild_index();
         return ret;
     }
     
-    // 加载网络数据
-    size_t required_size = sizeof(s_wifi_history.networks);
-    ret = nvs_get_blob(nvs_handle, NVS_KEY_NETWORKS, 
-                       s_wifi_history.networks, &required_size);
-    if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "加载网络数据失败: %s", esp_err_to_name(ret));
-        nvs_close(nvs_handle);
-        return ret;
-    }
-    
-    // 加载计数
-    ret = nvs_get_u8(nvs_handle, NVS_KEY_COUNT, &s_wifi_history.count);
-    if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "加载网络计数失败: %s", esp_err_to_name(ret));
-        s_wifi_history.count = 0;
+    // 加载各槽位。上一版本按定长结构体保存，长度恰好为sizeof(wifi_history_entry_t)，
+    // 读到后标记为待保存，由保存任务改写成紧凑格式
+    s_wifi_history.count = 0;
+    uint32_t max_timestamp = 0;
+    for (int i = 0; i < WIFI_HISTORY_MAX_NETWORKS; i++) {
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        snprintf(key, sizeof(key), NVS_KEY_ENTRY_FMT, i);
+        wifi_history_entry_t* entry = &s_wifi_history.networks[i];
+        uint8_t record[sizeof(wifi_history_entry_t) > NVS_RECORD_MAX_SIZE ?
+                       sizeof(wifi_history_entry_t) : NVS_RECORD_MAX_SIZE];
+        size_t size = sizeof(record);
+        bool ok = nvs_get_blob(nvs_handle, key, record, &size) == ESP_OK;
+        if (ok && size == sizeof(wifi_history_entry_t)) {
+            memcpy(entry, record, sizeof(*entry));
+            ok = entry->is_valid && memchr(entry->ssid, '\0', sizeof(entry->ssid)) != NULL &&
+                 memchr(entry->password, '\0', sizeof(entry->password)) != NULL;
+            if (ok) {
+                s_dirty_slots[i / 32] |= 1u << (i % 32);
+            }
+        } else if (ok) {
+            ok = decode_record(record, size, entry);
+        }
+        if (!ok) {
+            memset(entry, 0, sizeof(*entry));
+            continue;
+        }
+        s_wifi_history.count++;
+        if (entry->last_connected > max_timestamp) {
+            max_timestamp = entry->last_connected;
+        }
     }
     
-    // 加载时间戳
-    ret = nvs_get_u32(nvs_handle, NVS_KEY_TIMESTAMP, &s_wifi_history.next_timestamp);
-    if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "加载时间戳失败: %s", esp_err_to_name(ret));
-        s_wifi_history.next_timestamp = 1;
+    // 没有槽位键时读取旧格式的整表，由保存任务写成槽位键
+    if (s_wifi_history.count == 0) {
+        size_t required_size = sizeof(s_wifi_history.networks);
+        if (nvs_get_blob(nvs_handle, NVS_KEY_NETWORKS, s_wifi_history.networks, &required_size) == ESP_OK) {
+            s_legacy_keys = true;
+            for (int i = 0; i < WIFI_HISTORY_MAX_NETWORKS; i++) {
+                if (s_wifi_history.networks[i].is_valid) {
+                    s_wifi_history.count++;
+                    s_dirty_slots[i / 32] |= 1u << (i % 32);
+                    if (s_wifi_history.networks[i].last_connected > max_timestamp) {
+                        max_timestamp = s_wifi_history.networks[i].last_connected;
+                    }
+                }
+            }
+            ESP_LOGI(TAG, "迁移旧格式的WiFi历史记录");
+        } else {
+            memset(s_wifi_history.networks, 0, sizeof(s_wifi_history.networks));
+        }
     }
+    // 连接序号从已保存的最大值继续
+    s_wifi_history.next_timestamp = max_timestamp + 1;
     
     nvs_close(nvs_handle);
+    rebuild_index();
     
     ESP_LOGI(TAG, "WiFi历史记录加载完成，共 %u 个网络", s_wifi_history.count);
     return ESP_OK;
@@ -11,13 +11,14 @@
 #include <stdbool.h>
 #include "esp_err.h"
 #include "esp_wifi.h"
+#include "sdkconfig.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 // WiFi历史记录配置
-#define WIFI_HISTORY_MAX_NETWORKS 10
+#define WIFI_HISTORY_MAX_NETWORKS CONFIG_WIFI_HISTORY_MAX_NETWORKS
 #define WIFI_HISTORY_SSID_MAX_LEN 32
 #define WIFI_HISTORY_PASSWORD_MAX_LEN 64
 
@@ -29,7 +30,7 @@ typedef struct {
     uint8_t channel;
     wifi_auth_mode_t authmode;
     int8_t rssi;
-    uint32_t last_connected;  // 上次连接时间戳
+    uint32_t last_connected;  // 上次连接序号 (跨重启递增，越大越新)
     uint32_t connect_count;   // 连接次数
     uint8_t priority;         // 优先级 (0-255, 数值越大优先级越高)
     bool is_valid;            // 记录是否有效
@@ -38,10 +39,18 @@ typedef struct {
 // WiFi历史管理结构
 typedef struct {
     wifi_history_entry_t networks[WIFI_HISTORY_MAX_NETWORKS];
-    uint8_t count;
+    uint16_t count;
     uint32_t next_timestamp;
 } wifi_history_t;
 
+/**
+ * @brief wifi_history_foreach的回调
+ * @param entry 网络信息 (只在回调期间有效)
+ * @param arg 调用者参数
+ * @return true 继续，false 停止遍历
+ */
+typedef bool (*wifi_history_visit_t)(const wifi_history_entry_t* entry, void* arg);
+
 /**
  * @brief 初始化WiFi历史管理
  * @return esp_err_t ESP_OK成功，其他失败
@@ -63,11 +72,13 @@ esp_err_t wifi_history_add_network(const char* ssid, const char* password,
                                    wifi_auth_mode_t authmode, int8_t rssi);
 
 /**
- * @brief 更新网络连接成功记录
+ * @brief 更新网络连接成功记录，同时记下所连AP的BSSID和信道供快速重连使用
  * @param ssid WiFi网络名称
+ * @param bssid 所连AP的BSSID (可为NULL，不更新)
+ * @param channel 所连AP的信道
  * @return esp_err_t ESP_OK成功，其他失败
  */
-esp_err_t wifi_history_update_success(const char* ssid);
+esp_err_t wifi_history_update_success(const char* ssid, const uint8_t* bssid, uint8_t channel);
 
 /**
  * @brief 获取历史网络列表
@@ -75,7 +86,15 @@ esp_err_t wifi_history_update_success(const char* ssid);
  * @param count 输入：数组大小，输出：实际网络数量
  * @return esp_err_t ESP_OK成功，其他失败
  */
-esp_err_t wifi_history_get_networks(wifi_history_entry_t* networks, uint8_t* count);
+esp_err_t wifi_history_get_networks(wifi_history_entry_t* networks, uint16_t* count);
+
+/**
+ * @brief 按优先级顺序遍历历史网络，不复制整个列表
+ * @param visit 回调
+ * @param arg 传给回调的参数
+ * @return esp_err_t ESP_OK成功，ESP_ERR_NO_MEM内存不足
+ */
+esp_err_t wifi_history_foreach(wifi_history_visit_t visit, void* arg);
 
 /**
  * @brief 删除历史网络记录
@@ -108,7 +127,22 @@ esp_err_t wifi_history_find_best_network(const wifi_ap_record_t* available_netwo
                                          wifi_history_entry_t* best_network);
 
 /**
- * @brief 保存历史记录到NVS
+ * @brief 按SSID获取保存的网络
+ * @param ssid WiFi网络名称
+ * @param entry 输出网络信息
+ * @return esp_err_t ESP_OK找到网络，ESP_ERR_NOT_FOUND未保存该网络
+ */
+esp_err_t wifi_history_get_network(const char* ssid, wifi_history_entry_t* entry);
+
+/**
+ * @brief 获取优先级最高且记录了BSSID和信道的网络 (不扫描直接连接)
+ * @param entry 输出网络信息
+ * @return esp_err_t ESP_OK找到网络，ESP_ERR_NOT_FOUND没有可直接连接的网络
+ */
+esp_err_t wifi_history_get_cached_ap(wifi_history_entry_t* entry);
+
+/**
+ * @brief 立即把待保存的修改写入NVS (平时由保存任务延迟合并写入)
  * @return esp_err_t ESP_OK成功，其他失败
  */
 esp_err_t wifi_history_save(void);
@@ -1,15 +1,27 @@
 #include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/event_groups.h"
 #include "esp_mac.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_netif.h"
 #include "nvs_flash.h"
 #include "lwip/err.h"
 #include "lwip/sys.h"
 #include "wifi_manager.h"
 #include "wifi_history.h"
+#include "wifi_scan.h"
+#include "wifi_roam.h"
+#include "task_config.h"
+#include "app_event.h"
+#include "latency.h"
+#include "boot_timeline.h"
+#include "net_profile.h"
 
 #include "esp_mdns.h"  // mDNS支持
 
@@ -26,9 +38,162 @@ static bool history_initialized = false;
 
 #define MAX_RETRY_COUNT 5
 
+// 信号强度采样 (获取IP后运行，断开时停止)
+#define WIFI_RSSI_SAMPLE_MS     CONFIG_WIFI_STATUS_RSSI_INTERVAL_MS
+#define WIFI_RSSI_HYSTERESIS    CONFIG_WIFI_STATUS_RSSI_HYSTERESIS
+
+static esp_timer_handle_t s_rssi_timer = NULL;
+static int8_t s_reported_rssi = 0;      // 最近一次推送的信号强度 (事件循环与esp_timer任务共用)
+
+// 连接计时: 从发起连接到获取IP，按连接路径分别统计
+#define WIFI_CONN_GOT_IP_BIT    BIT0
+#define WIFI_CONN_FAIL_BIT      BIT1
+#define WIFI_FAST_CONNECT_TIMEOUT_MS    CONFIG_WIFI_FAST_CONNECT_TIMEOUT_MS
+#define WIFI_FAST_DISCONNECT_WAIT_MS    1000
+#define STA_START_TIMEOUT_MS            10000   // 自动连接任务等待STA启动
+#define SCAN_CONNECT_TIMEOUT_MS         15000   // 扫描路径发起连接后等待获取IP
+#define RECONNECT_GRACE_MS              10000   // 断开后先由事件处理重试和漫游重新关联
+
+static EventGroupHandle_t s_conn_events = NULL;
+static portMUX_TYPE s_conn_lock = portMUX_INITIALIZER_UNLOCKED;
+static int s_conn_path = -1;            // 正在计时的连接路径，-1表示没有
+static int64_t s_conn_start_us = 0;
+static wifi_connect_path_stats_t s_conn_stats[WIFI_CONNECT_PATH_MAX];
+static bool s_fast_connecting = false;  // 快速重连进行中，断开事件不触发重试
+
 // 函数声明
 static void wifi_auto_connect_task(void *pvParameters);
 
+// 状态变化类型名称，与wifi_status_change_t顺序一致
+static const char *const wifi_status_change_names[] = { "connected", "disconnected", "got_ip", "rssi" };
+
+const char *wifi_status_change_name(wifi_status_change_t change)
+{
+    if (change >= sizeof(wifi_status_change_names) / sizeof(wifi_status_change_names[0])) {
+        return "unknown";
+    }
+    return wifi_status_change_names[change];
+}
+
+static const char *const wifi_connect_path_names[WIFI_CONNECT_PATH_MAX] = { "fast", "scan" };
+
+const char *wifi_connect_path_name(wifi_connect_path_t path)
+{
+    return path < WIFI_CONNECT_PATH_MAX ? wifi_connect_path_names[path] : "unknown";
+}
+
+void wifi_get_connect_stats(wifi_connect_path_t path, wifi_connect_path_stats_t *stats)
+{
+    if (path >= WIFI_CONNECT_PATH_MAX) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    taskENTER_CRITICAL(&s_conn_lock);
+    *stats = s_conn_stats[path];
+    taskEXIT_CRITICAL(&s_conn_lock);
+}
+
+// 开始为一次连接计时，path为-1时取消计时 (手动连接不计入)
+static void wifi_conn_timing_start(int path)
+{
+    taskENTER_CRITICAL(&s_conn_lock);
+    s_conn_path = path;
+    s_conn_start_us = esp_timer_get_time();
+    if (path >= 0) {
+        s_conn_stats[path].attempts++;
+    }
+    taskEXIT_CRITICAL(&s_conn_lock);
+}
+
+// 获取IP时结束计时 (在事件循环任务中)
+static void wifi_conn_timing_done(void)
+{
+    int64_t elapsed_us = 0;
+
+    taskENTER_CRITICAL(&s_conn_lock);
+    int path = s_conn_path;
+    if (path >= 0) {
+        elapsed_us = esp_timer_get_time() - s_conn_start_us;
+        s_conn_stats[path].successes++;
+        s_conn_stats[path].last_ms = (uint32_t)(elapsed_us / 1000);
+        s_conn_path = -1;
+    }
+    taskEXIT_CRITICAL(&s_conn_lock);
+
+    if (path >= 0) {
+        latency_record(path == WIFI_CONNECT_PATH_FAST ? LATENCY_WIFI_FAST_TO_IP : LATENCY_WIFI_SCAN_TO_IP,
+                       elapsed_us);
+        ESP_LOGI(TAG, "连接耗时 %"PRId64" ms (%s)", elapsed_us / 1000, wifi_connect_path_name(path));
+    }
+}
+
+// 发布STA状态变化，由订阅者推送给WebSocket状态通道
+static void wifi_status_post(wifi_status_change_t change, uint8_t reason, int8_t rssi)
+{
+    wifi_status_event_t event = {
+        .change = change,
+        .reason = reason,
+        .rssi = rssi,
+    };
+    app_event_post(APP_EVENT_WIFI_STATUS, &event, sizeof(event));
+}
+
+// 周期采样信号强度 (在esp_timer任务中)，变化超过回差才发布
+static void wifi_rssi_timer_cb(void *arg)
+{
+    wifi_ap_record_t ap_info;
+    if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK) {
+        return;
+    }
+    int8_t reported = __atomic_load_n(&s_reported_rssi, __ATOMIC_RELAXED);
+    if (abs(ap_info.rssi - reported) >= WIFI_RSSI_HYSTERESIS) {
+        __atomic_store_n(&s_reported_rssi, ap_info.rssi, __ATOMIC_RELAXED);
+        wifi_status_post(WIFI_STATUS_RSSI, 0, ap_info.rssi);
+    }
+}
+
+void wifi_status_write_json(json_writer_t *w)
+{
+    wifi_ap_record_t ap_info;
+    if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK) {
+        json_writer_string(w, "status", "disconnected");
+        return;
+    }
+
+    json_writer_string(w, "status", "connected");
+    json_writer_string(w, "ssid", (char *)ap_info.ssid);
+    json_writer_int(w, "rssi", ap_info.rssi);
+    char bssid_str[18];
+    snprintf(bssid_str, sizeof(bssid_str), "%02X:%02X:%02X:%02X:%02X:%02X",
+             ap_info.bssid[0], ap_info.bssid[1], ap_info.bssid[2],
+             ap_info.bssid[3], ap_info.bssid[4], ap_info.bssid[5]);
+    json_writer_string(w, "bssid", bssid_str);
+
+    // 获取IP之前没有ip字段
+    esp_netif_ip_info_t ip_info;
+    esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    if (netif && esp_netif_get_ip_info(netif, &ip_info) == ESP_OK && ip_info.ip.addr != 0) {
+        char ip_str[16];
+        snprintf(ip_str, sizeof(ip_str), IPSTR, IP2STR(&ip_info.ip));
+        json_writer_string(w, "ip", ip_str);
+    }
+}
+
+// 更新NVS中的连接失败标志，值不变时不写入 (GOT_IP每次都会调用，避免反复擦写flash)
+static void wifi_state_set_failed(uint8_t failed)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open("wifi_state", NVS_READWRITE, &nvs_handle) != ESP_OK) {
+        return;
+    }
+    uint8_t stored = 0;
+    if (nvs_get_u8(nvs_handle, "connection_failed", &stored) != ESP_OK || stored != failed) {
+        nvs_set_u8(nvs_handle, "connection_failed", failed);
+        nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+}
+
 // WiFi事件处理函数
 static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                                     int32_t event_id, void* event_data)
@@ -47,6 +212,7 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                 break;
             case WIFI_EVENT_STA_START:
                 ESP_LOGI(TAG, "WIFI_EVENT_STA_START，STA已启动，等待连接命令...");
+                boot_timeline_mark(BOOT_PHASE_WIFI_STARTED);
                 // 不在这里调用esp_wifi_connect()，由自动连接任务或手动连接处理
                 break;
             case WIFI_EVENT_STA_CONNECTED:
@@ -57,15 +223,19 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                              connected_event->bssid[0], connected_event->bssid[1], connected_event->bssid[2],
                              connected_event->bssid[3], connected_event->bssid[4], connected_event->bssid[5]);
                     s_retry_num = 0; // 重置重试计数
+                    boot_timeline_mark(BOOT_PHASE_STA_CONNECTED);
                     
                     // 获取连接的AP信息并更新历史记录
                     wifi_ap_record_t ap_info;
                     if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
+                        __atomic_store_n(&s_reported_rssi, ap_info.rssi, __ATOMIC_RELAXED);
                         wifi_config_t wifi_config;
                         if (esp_wifi_get_config(ESP_IF_WIFI_STA, &wifi_config) == ESP_OK) {
-                            wifi_history_update_success((char*)wifi_config.sta.ssid);
+                            wifi_history_update_success((char*)wifi_config.sta.ssid,
+                                                        connected_event->bssid, connected_event->channel);
                         }
                     }
+                    wifi_status_post(WIFI_STATUS_CONNECTED, 0, 0);
                 }
                 break;
             case WIFI_EVENT_STA_DISCONNECTED:
@@ -106,6 +276,21 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                 }
                 
                 ESP_LOGW(TAG, "WiFi断开连接，原因:%d (%s)", event->reason, reason_str);
+                esp_timer_stop(s_rssi_timer);
+                wifi_status_post(WIFI_STATUS_DISCONNECTED, event->reason, 0);
+                xEventGroupClearBits(s_conn_events, WIFI_CONN_GOT_IP_BIT);
+                xEventGroupSetBits(s_conn_events, WIFI_CONN_FAIL_BIT);
+                
+                // 快速重连失败由自动连接任务改走扫描路径，不在这里重试
+                if (__atomic_load_n(&s_fast_connecting, __ATOMIC_RELAXED)) {
+                    break;
+                }
+#if CONFIG_WIFI_ROAM_ENABLE
+                // 漫游引起的断开由漫游管理重新关联
+                if (wifi_roam_on_disconnect(event->reason)) {
+                    break;
+                }
+#endif
                 
                 // 对于特定错误，尝试不指定BSSID的连接
                 if (event->reason == WIFI_REASON_NO_AP_FOUND) {
@@ -138,13 +323,7 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                 } else {
                     ESP_LOGW(TAG, "WiFi连接失败，达到最大重试次数");
                     // 保存当前状态到NVS
-                    nvs_handle_t nvs_handle;
-                    esp_err_t err = nvs_open("wifi_state", NVS_READWRITE, &nvs_handle);
-                    if (err == ESP_OK) {
-                        nvs_set_u8(nvs_handle, "connection_failed", 1);
-                        nvs_commit(nvs_handle);
-                        nvs_close(nvs_handle);
-                    }
+                    wifi_state_set_failed(1);
                 }
                 break;
         }
@@ -155,15 +334,21 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
             ESP_LOGI(TAG, "✅ 成功获取IP地址:" IPSTR ", 网关:" IPSTR ", 子网掩码:" IPSTR, 
                      IP2STR(&event->ip_info.ip), IP2STR(&event->ip_info.gw), IP2STR(&event->ip_info.netmask));
             s_retry_num = 0; // 重置重试计数
+            wifi_conn_timing_done();
+            boot_timeline_mark(BOOT_PHASE_GOT_IP);
+#if CONFIG_WIFI_ROAM_ENABLE
+            wifi_roam_on_got_ip();
+#endif
+            xEventGroupClearBits(s_conn_events, WIFI_CONN_FAIL_BIT);
+            xEventGroupSetBits(s_conn_events, WIFI_CONN_GOT_IP_BIT);
+            
+            // 推送状态并开始采样信号强度 (重新获取IP时定时器可能仍在运行)
+            wifi_status_post(WIFI_STATUS_GOT_IP, 0, 0);
+            esp_timer_stop(s_rssi_timer);
+            esp_timer_start_periodic(s_rssi_timer, (uint64_t)WIFI_RSSI_SAMPLE_MS * 1000);
             
             // 保存成功状态到NVS
-            nvs_handle_t nvs_handle;
-            esp_err_t err = nvs_open("wifi_state", NVS_READWRITE, &nvs_handle);
-            if (err == ESP_OK) {
-                nvs_set_u8(nvs_handle, "connection_failed", 0);
-                nvs_commit(nvs_handle);
-                nvs_close(nvs_handle);
-            }
+            wifi_state_set_failed(0);
             
             // ✅ 启动 mDNS（只执行一次）
             if (!mdns_initialized)
@@ -181,8 +366,7 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
 esp_err_t wifi_init_softap(void)
 {
     esp_err_t ret = ESP_OK;
-    ESP_ERROR_CHECK(esp_netif_init());  // 初始化底层TCP/IP堆栈
-    ESP_ERROR_CHECK(esp_event_loop_create_default());  // 创建默认事件循环
+    // TCP/IP堆栈和默认事件循环由app_main初始化 (USB和HTTP服务器同时启动，也要用到)
     esp_netif_create_default_wifi_ap();  // 创建默认WIFI AP
     esp_netif_create_default_wifi_sta(); // 创建默认WIFI STA
 
@@ -202,6 +386,27 @@ esp_err_t wifi_init_softap(void)
                                                       NULL,
                                                       NULL));
 
+    // 扫描服务 (所有扫描共用，结果带缓存)
+    ESP_ERROR_CHECK(wifi_scan_init());
+
+#if CONFIG_WIFI_ROAM_ENABLE
+    // 漫游管理 (信号弱时后台扫描并切换到更强的AP)
+    ESP_ERROR_CHECK(wifi_roam_init());
+#endif
+
+    // 自动连接任务等待连接结果
+    s_conn_events = xEventGroupCreate();
+    if (s_conn_events == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // 信号强度采样定时器 (获取IP后启动)
+    const esp_timer_create_args_t rssi_timer_args = {
+        .callback = wifi_rssi_timer_cb,
+        .name = "wifi_rssi",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&rssi_timer_args, &s_rssi_timer));
+
     // 配置AP参数
     wifi_config_t wifi_config = {
         .ap = {
@@ -243,6 +448,7 @@ esp_err_t wifi_init_softap(void)
             
             if (!connection_failed) {
                 ESP_LOGI(TAG, "找到已保存的WiFi配置，SSID: %s", sta_config.sta.ssid);
+                wifi_roam_apply_config(&sta_config.sta);
                 ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &sta_config));
             } else {
                 ESP_LOGW(TAG, "上次WiFi连接失败，跳过自动连接");
@@ -264,6 +470,7 @@ esp_err_t wifi_init_softap(void)
 
     // 启动WiFi
     ESP_ERROR_CHECK(esp_wifi_start());
+    net_profile_apply_wifi();
 
     ESP_LOGI(TAG, "WiFi初始化完成. SSID:%s 密码:%s 信道:%d",
              EXAMPLE_ESP_WIFI_SSID, EXAMPLE_ESP_WIFI_PASS, EXAMPLE_ESP_WIFI_CHANNEL);
@@ -271,7 +478,7 @@ esp_err_t wifi_init_softap(void)
     // 创建自动连接任务
     if (history_initialized) {
         ESP_LOGI(TAG, "创建WiFi自动连接任务...");
-        xTaskCreate(wifi_auto_connect_task, "wifi_auto_connect", 4096, NULL, 3, NULL);
+        task_config_create(TASK_CFG_WIFI_AUTO_CONNECT, wifi_auto_connect_task, NULL, NULL);
     }
     
     return ESP_OK;
@@ -282,81 +489,179 @@ esp_err_t wifi_reset_connection_retry(void)
     s_retry_num = 0;
     
     // 重置NVS中的连接失败标志
+    wifi_state_set_failed(0);
+    
+    return ESP_OK;
+}
+// 连接到指定网络并保存配置 (password为NULL时使用历史记录中保存的密码)
+esp_err_t wifi_connect_network(const char *ssid, const char *password)
+{
+    if (ssid == NULL || ssid[0] == '\0' || strlen(ssid) >= sizeof(((wifi_config_t *)0)->sta.ssid)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    wifi_config_t wifi_config = {0};
+    strlcpy((char *)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid));
+    if (password != NULL) {
+        strlcpy((char *)wifi_config.sta.password, password, sizeof(wifi_config.sta.password));
+    } else {
+        wifi_history_entry_t saved;
+        if (wifi_history_get_network(ssid, &saved) == ESP_OK) {
+            strlcpy((char *)wifi_config.sta.password, saved.password, sizeof(wifi_config.sta.password));
+        }
+    }
+
+    // 保存WiFi配置到NVS
     nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open("wifi_state", NVS_READWRITE, &nvs_handle);
+    esp_err_t err = nvs_open("wifi_config", NVS_READWRITE, &nvs_handle);
     if (err == ESP_OK) {
-        nvs_set_u8(nvs_handle, "connection_failed", 0);
-        nvs_commit(nvs_handle);
+        err = nvs_set_blob(nvs_handle, "sta_config", &wifi_config, sizeof(wifi_config_t));
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs_handle);
+        }
         nvs_close(nvs_handle);
     }
-    
-    return ESP_OK;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "保存WiFi配置失败: %s", esp_err_to_name(err));
+    } else {
+        ESP_LOGI(TAG, "WiFi配置已保存到NVS");
+    }
+
+    // 添加到WiFi历史记录
+    wifi_history_add_network(ssid, (char *)wifi_config.sta.password, NULL, 0, WIFI_AUTH_OPEN, -50);
+    wifi_conn_timing_start(-1);
+
+    wifi_roam_apply_config(&wifi_config.sta);
+    err = esp_wifi_set_mode(WIFI_MODE_APSTA);
+    if (err == ESP_OK) {
+        err = esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config);
+    }
+    if (err == ESP_OK) {
+        err = esp_wifi_connect();
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "连接到 %s 失败: %s", ssid, esp_err_to_name(err));
+    }
+    return err;
 }
-#define DEFAULT_SCAN_LIST_SIZE 10  // 默认扫描列表大小
 
-// 扫描周围WiFi网络
-esp_err_t wifi_scan_networks(wifi_ap_record_t **ap_records, uint16_t *ap_count)
+// 删除保存的网络，正在使用该网络时同时断开并清除STA配置
+esp_err_t wifi_forget_network(const char *ssid)
 {
-    esp_err_t ret;
-    uint16_t number = DEFAULT_SCAN_LIST_SIZE;
-
-    // 分配内存用于存储扫描结果
-    *ap_records = malloc(DEFAULT_SCAN_LIST_SIZE * sizeof(wifi_ap_record_t));
-    if (*ap_records == NULL) {
-        ESP_LOGE(TAG, "为扫描结果分配内存失败");
-        return ESP_ERR_NO_MEM;
+    if (ssid == NULL) {
+        return ESP_ERR_INVALID_ARG;
     }
 
-    // 配置扫描参数
-    wifi_scan_config_t scan_config = {
-        .ssid = NULL,
-        .bssid = NULL,
-        .channel = 0,
-        .show_hidden = false,
-        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
-        .scan_time.active.min = 120,
-        .scan_time.active.max = 150,
-    };
+    // 从WiFi历史记录中删除
+    esp_err_t err = wifi_history_remove_network(ssid);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "已从WiFi历史记录中删除: %s", ssid);
+    }
 
-    // 开始扫描
-    ret = esp_wifi_scan_start(&scan_config, true);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "开始扫描失败");
-        free(*ap_records);
-        *ap_records = NULL;
-        return ret;
+    wifi_config_t wifi_config;
+    if (esp_wifi_get_config(ESP_IF_WIFI_STA, &wifi_config) != ESP_OK ||
+        strcmp((char *)wifi_config.sta.ssid, ssid) != 0) {
+        return ESP_OK;
     }
 
-    // 获取扫描结果
-    ret = esp_wifi_scan_get_ap_records(&number, *ap_records);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "获取扫描结果失败");
-        free(*ap_records);
-        *ap_records = NULL;
-        return ret;
+    // 先断开WiFi连接
+    esp_wifi_disconnect();
+    vTaskDelay(pdMS_TO_TICKS(1000));  // 等待断开连接
+
+    // 清除运行时的WiFi配置
+    memset(&wifi_config, 0, sizeof(wifi_config_t));
+    esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config);
+
+    // 清除自定义NVS中的WiFi配置
+    nvs_handle_t nvs_handle;
+    err = nvs_open("wifi_config", NVS_READWRITE, &nvs_handle);
+    if (err == ESP_OK) {
+        err = nvs_erase_all(nvs_handle);
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs_handle);
+            ESP_LOGI(TAG, "已清除自定义NVS中的WiFi配置");
+        }
+        nvs_close(nvs_handle);
     }
 
-    // 获取找到的AP数量
-    ret = esp_wifi_scan_get_ap_num(ap_count);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "获取扫描到的AP数量失败");
-        free(*ap_records);
-        *ap_records = NULL;
-        return ret;
+    // 清除连接失败计数
+    wifi_state_set_failed(0);
+
+    // 停止并重启WiFi以确保配置被完全清除
+    esp_wifi_stop();
+    vTaskDelay(pdMS_TO_TICKS(500));
+    esp_wifi_start();
+
+    ESP_LOGI(TAG, "WiFi配置已完全删除");
+    return ESP_OK;
+}
+
+#if CONFIG_WIFI_FAST_CONNECT
+// 不扫描，直接用历史记录中保存的BSSID和信道连接优先级最高的网络，等待获取IP
+static bool wifi_fast_connect(void)
+{
+    wifi_history_entry_t entry;
+    if (wifi_history_get_cached_ap(&entry) != ESP_OK) {
+        return false;
     }
 
-    // 限制AP数量不超过默认扫描列表大小
-    if (*ap_count > DEFAULT_SCAN_LIST_SIZE) {
-        *ap_count = DEFAULT_SCAN_LIST_SIZE;
+    wifi_config_t wifi_config = {0};
+    strlcpy((char *)wifi_config.sta.ssid, entry.ssid, sizeof(wifi_config.sta.ssid));
+    strlcpy((char *)wifi_config.sta.password, entry.password, sizeof(wifi_config.sta.password));
+    wifi_config.sta.bssid_set = true;
+    memcpy(wifi_config.sta.bssid, entry.bssid, sizeof(wifi_config.sta.bssid));
+    wifi_config.sta.channel = entry.channel;
+    wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+    wifi_roam_apply_config(&wifi_config.sta);
+
+    ESP_LOGI(TAG, "快速重连: %s (信道%u, BSSID "MACSTR")", entry.ssid, entry.channel, MAC2STR(entry.bssid));
+
+    xEventGroupClearBits(s_conn_events, WIFI_CONN_GOT_IP_BIT | WIFI_CONN_FAIL_BIT);
+    __atomic_store_n(&s_fast_connecting, true, __ATOMIC_RELAXED);
+    wifi_conn_timing_start(WIFI_CONNECT_PATH_FAST);
+
+    esp_err_t err = esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config);
+    if (err == ESP_OK) {
+        err = esp_wifi_connect();
+    }
+    EventBits_t bits = 0;
+    if (err == ESP_OK) {
+        bits = xEventGroupWaitBits(s_conn_events, WIFI_CONN_GOT_IP_BIT | WIFI_CONN_FAIL_BIT,
+                                   pdFALSE, pdFALSE, pdMS_TO_TICKS(WIFI_FAST_CONNECT_TIMEOUT_MS));
+    }
+    if (bits & WIFI_CONN_GOT_IP_BIT) {
+        __atomic_store_n(&s_fast_connecting, false, __ATOMIC_RELAXED);
+        return true;
     }
 
-    // 打印扫描结果
-    ESP_LOGI(TAG, "发现 %d 个接入点:", *ap_count);
-    for (int i = 0; i < *ap_count; i++) {
-        ESP_LOGI(TAG, "SSID: %s, 信号强度: %d", (*ap_records)[i].ssid, (*ap_records)[i].rssi);
+    // 超时 (可能已关联但未获取IP) 时主动断开，等断开事件处理完再交给扫描路径
+    wifi_conn_timing_start(-1);
+    if (err == ESP_OK && !(bits & WIFI_CONN_FAIL_BIT)) {
+        esp_wifi_disconnect();
+        xEventGroupWaitBits(s_conn_events, WIFI_CONN_FAIL_BIT, pdFALSE, pdFALSE,
+                            pdMS_TO_TICKS(WIFI_FAST_DISCONNECT_WAIT_MS));
     }
+    __atomic_store_n(&s_fast_connecting, false, __ATOMIC_RELAXED);
+    ESP_LOGW(TAG, "快速重连失败 (%s)，改为扫描连接", err != ESP_OK ? esp_err_to_name(err) :
+             (bits & WIFI_CONN_FAIL_BIT) ? "连接断开" : "超时");
+    return false;
+}
+#else
+static bool wifi_fast_connect(void)
+{
+    return false;
+}
+#endif
 
-    return ESP_OK;
+// 扫描后连接最佳历史网络，计入扫描路径的连接耗时
+static esp_err_t wifi_scan_connect(void)
+{
+    wifi_conn_timing_start(WIFI_CONNECT_PATH_SCAN);
+    esp_err_t ret = wifi_history_auto_connect();
+    if (ret != ESP_OK) {
+        wifi_conn_timing_start(-1);
+    }
+    return ret;
 }
 
 // WiFi自动连接任务
@@ -364,8 +669,10 @@ static void wifi_auto_connect_task(void *pvParameters)
 {
     ESP_LOGI(TAG, "WiFi自动连接任务启动");
     
-    // 等待WiFi初始化完成和系统稳定
-    vTaskDelay(pdMS_TO_TICKS(10000)); // 增加等待时间到10秒
+    // 等待STA启动后立即连接，不再固定延时
+    if (!boot_timeline_wait(BOOT_PHASE_WIFI_STARTED, STA_START_TIMEOUT_MS)) {
+        ESP_LOGW(TAG, "等待STA启动超时");
+    }
     
     int failed_attempts = 0;
     
@@ -386,7 +693,15 @@ static void wifi_auto_connect_task(void *pvParameters)
         if (is_connected && esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
             ESP_LOGI(TAG, "WiFi已连接到: %s, IP: " IPSTR, ap_info.ssid, IP2STR(&ip_info.ip));
             failed_attempts = 0; // 重置失败计数
-            vTaskDelay(pdMS_TO_TICKS(30000)); // 已连接，30秒后再检查
+            // 已连接时不再定时检查，等待断开事件；之后先给事件处理中的重试和漫游留出时间
+            xEventGroupWaitBits(s_conn_events, WIFI_CONN_FAIL_BIT, pdTRUE, pdFALSE, portMAX_DELAY);
+            xEventGroupWaitBits(s_conn_events, WIFI_CONN_GOT_IP_BIT, pdFALSE, pdFALSE,
+                                pdMS_TO_TICKS(RECONNECT_GRACE_MS));
+            continue;
+        }
+        
+        // 先用保存的BSSID和信道直接连接，失败再扫描
+        if (failed_attempts < 3 && wifi_fast_connect()) {
             continue;
         }
         
@@ -407,15 +722,17 @@ static void wifi_auto_connect_task(void *pvParameters)
         if (failed_attempts < 3) { // 限制重试次数
             ESP_LOGI(TAG, "尝试智能连接到历史WiFi网络... (第%d次)", failed_attempts + 1);
             
-            // 等待一段时间确保WiFi系统稳定
-            vTaskDelay(pdMS_TO_TICKS(2000));
-            
-            esp_err_t ret = wifi_history_auto_connect();
+            xEventGroupClearBits(s_conn_events, WIFI_CONN_GOT_IP_BIT);
+            esp_err_t ret = wifi_scan_connect();
             if (ret == ESP_OK) {
                 ESP_LOGI(TAG, "智能连接启动成功");
                 failed_attempts = 0;
-                // 等待连接结果，给足够时间完成连接
-                vTaskDelay(pdMS_TO_TICKS(15000));
+                // 等待获取IP，获取后立即回到循环开头
+                EventBits_t bits = xEventGroupWaitBits(s_conn_events, WIFI_CONN_GOT_IP_BIT, pdFALSE, pdFALSE,
+                                                       pdMS_TO_TICKS(SCAN_CONNECT_TIMEOUT_MS));
+                if (bits & WIFI_CONN_GOT_IP_BIT) {
+                    continue;
+                }
             } else {
                 ESP_LOGW(TAG, "智能连接失败: %s", esp_err_to_name(ret));
                 failed_attempts++;
@@ -440,5 +757,5 @@ esp_err_t wifi_smart_connect(void)
     }
     
     ESP_LOGI(TAG, "开始智能WiFi连接...");
-    return wifi_history_auto_connect();
+    return wifi_scan_connect();
 }
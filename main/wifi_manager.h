@@ -4,12 +4,59 @@
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "wifi_history.h"
+#include "json_writer.h"
+
+// STA状态变化类型 (APP_EVENT_WIFI_STATUS)
+typedef enum {
+    WIFI_STATUS_CONNECTED = 0,      // 已关联到AP
+    WIFI_STATUS_DISCONNECTED,       // 连接断开
+    WIFI_STATUS_GOT_IP,             // 已获取IP地址
+    WIFI_STATUS_RSSI,               // 信号强度变化超过回差
+} wifi_status_change_t;
+
+// APP_EVENT_WIFI_STATUS的事件数据
+typedef struct {
+    wifi_status_change_t change;
+    uint8_t reason;                 // 断开原因 (wifi_err_reason_t)，仅WIFI_STATUS_DISCONNECTED有效
+    int8_t rssi;                    // 信号强度，仅WIFI_STATUS_RSSI有效
+} wifi_status_event_t;
+
+// 自动连接路径
+typedef enum {
+    WIFI_CONNECT_PATH_FAST = 0,     // 用历史记录中的BSSID和信道直接连接，不扫描
+    WIFI_CONNECT_PATH_SCAN,         // 扫描后选择最佳历史网络
+    WIFI_CONNECT_PATH_MAX,
+} wifi_connect_path_t;
+
+// 连接路径统计 (耗时为发起连接到获取IP)
+typedef struct {
+    uint32_t attempts;
+    uint32_t successes;
+    uint32_t last_ms;               // 最近一次成功的耗时
+} wifi_connect_path_stats_t;
 
 // WiFi初始化函数
 esp_err_t wifi_init_softap(void);
 esp_err_t wifi_init_ap(void);
-esp_err_t wifi_scan_networks(wifi_ap_record_t **ap_records, uint16_t *ap_count);
 esp_err_t wifi_smart_connect(void);
 esp_err_t wifi_reset_connection_retry(void);
 
+// 连接到指定网络并保存配置 (password为NULL时使用历史记录中保存的密码)
+esp_err_t wifi_connect_network(const char *ssid, const char *password);
+
+// 删除保存的网络，正在使用该网络时同时断开并清除STA配置
+esp_err_t wifi_forget_network(const char *ssid);
+
+// 写出当前STA状态 (status/ssid/rssi/bssid/ip，与GET /api/status相同)
+void wifi_status_write_json(json_writer_t *w);
+
+// 状态变化类型名称
+const char *wifi_status_change_name(wifi_status_change_t change);
+
+// 获取连接路径统计，耗时分布见LATENCY_WIFI_FAST_TO_IP/LATENCY_WIFI_SCAN_TO_IP
+void wifi_get_connect_stats(wifi_connect_path_t path, wifi_connect_path_stats_t *stats);
+
+// 连接路径名称
+const char *wifi_connect_path_name(wifi_connect_path_t path);
+
 #endif // WIFI_MANAGER_H
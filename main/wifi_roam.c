@@ -0,0 +1,383 @@
+/*
+ * @Description: WiFi漫游管理实现
+ *
+ * 状态: IDLE (未连接) -> MONITOR (已设置RSSI阈值) -信号低于阈值->
+ *       NEIGHBOR_WAIT (等待邻居报告) -> SCANNING (后台扫描) -> SWITCHING (已断开当前AP)
+ *       -> REASSOC (已向目标AP发起关联) -获取IP-> COOLDOWN -> MONITOR
+ * 没有合适的目标时进入COOLDOWN，冷却结束后重新设置阈值，信号仍弱时会再次触发。
+ */
+
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_mac.h"
+#if CONFIG_WIFI_ROAM_11KV
+#include "esp_rrm.h"
+#include "esp_wnm.h"
+#endif
+#include "app_event.h"
+#include "mem_pool.h"
+#include "latency.h"
+#include "wifi_history.h"
+#include "wifi_scan.h"
+#include "wifi_roam.h"
+
+static const char *TAG = "wifi_roam";
+
+#define ROAM_RSSI_THRESHOLD     CONFIG_WIFI_ROAM_RSSI_THRESHOLD
+#define ROAM_MARGIN_DB          CONFIG_WIFI_ROAM_MARGIN_DB
+#define ROAM_COOLDOWN_MS        CONFIG_WIFI_ROAM_COOLDOWN_MS
+#define ROAM_NEIGHBOR_WAIT_MS   1000        // 等待邻居报告的时间，超时直接扫描
+
+#define WLAN_EID_NEIGHBOR_REPORT    52
+#define NEIGHBOR_REPORT_MIN_LEN     13      // BSSID(6) + BSSID信息(4) + 操作类别 + 信道 + PHY类型
+
+typedef enum {
+    ROAM_IDLE = 0,
+    ROAM_MONITOR,
+    ROAM_NEIGHBOR_WAIT,
+    ROAM_SCANNING,
+    ROAM_SWITCHING,
+    ROAM_REASSOC,
+    ROAM_COOLDOWN,
+} roam_state_t;
+
+static struct {
+    roam_state_t state;
+    bool btm;                       // 当前切换由AP的BTM请求触发
+    int64_t switch_us;              // 断开当前AP的时间
+    wifi_config_t target;           // 切换目标 (SWITCHING时有效)
+    esp_timer_handle_t timer;       // 邻居报告超时和冷却
+    wifi_roam_stats_t stats;
+} s_roam;
+
+static portMUX_TYPE s_roam_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// 当前状态为from时切换到to
+static bool roam_transition(roam_state_t from, roam_state_t to)
+{
+    taskENTER_CRITICAL(&s_roam_lock);
+    bool ok = s_roam.state == from;
+    if (ok) {
+        s_roam.state = to;
+    }
+    taskEXIT_CRITICAL(&s_roam_lock);
+    return ok;
+}
+
+static void roam_set_state(roam_state_t state)
+{
+    taskENTER_CRITICAL(&s_roam_lock);
+    s_roam.state = state;
+    taskEXIT_CRITICAL(&s_roam_lock);
+}
+
+#define ROAM_STAT_INC(field) do {               \
+        taskENTER_CRITICAL(&s_roam_lock);       \
+        s_roam.stats.field++;                   \
+        taskEXIT_CRITICAL(&s_roam_lock);        \
+    } while (0)
+
+// 设置RSSI阈值，低于阈值时驱动发出一次WIFI_EVENT_STA_BSS_RSSI_LOW
+static void roam_monitor(void)
+{
+    roam_set_state(ROAM_MONITOR);
+    esp_err_t err = esp_wifi_set_rssi_threshold(ROAM_RSSI_THRESHOLD);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "设置RSSI阈值失败: %s", esp_err_to_name(err));
+    }
+}
+
+static void roam_cooldown(void)
+{
+    roam_set_state(ROAM_COOLDOWN);
+    esp_timer_stop(s_roam.timer);
+    esp_timer_start_once(s_roam.timer, (uint64_t)ROAM_COOLDOWN_MS * 1000);
+}
+
+// 后台扫描，结果在APP_EVENT_WIFI_SCAN_DONE中评估 (不使用缓存结果，保证信号强度是当前的)
+static void roam_start_scan(void)
+{
+    if (!roam_transition(ROAM_NEIGHBOR_WAIT, ROAM_SCANNING)) {
+        return;
+    }
+    ROAM_STAT_INC(scans);
+    bool cached;
+    esp_err_t err = wifi_scan_request(0, &cached);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "启动漫游扫描失败: %s", esp_err_to_name(err));
+        roam_cooldown();
+    }
+}
+
+#if CONFIG_WIFI_ROAM_11KV
+// 邻居报告 (在supplicant任务中)，报告中没有其他AP时不必扫描
+static void roam_neighbor_report_cb(void *ctx, const uint8_t *report, size_t report_len)
+{
+    ROAM_STAT_INC(neighbor_reports);
+
+    // 报告可能以对话令牌开头
+    const uint8_t *pos = report;
+    size_t len = report != NULL ? report_len : 0;
+    if (len > 0 && pos[0] != WLAN_EID_NEIGHBOR_REPORT) {
+        pos++;
+        len--;
+    }
+    wifi_ap_record_t current;
+    bool have_current = esp_wifi_sta_get_ap_info(&current) == ESP_OK;
+    int neighbors = 0;
+    while (len >= 2 && pos[0] == WLAN_EID_NEIGHBOR_REPORT && pos[1] + 2u <= len) {
+        if (pos[1] >= NEIGHBOR_REPORT_MIN_LEN &&
+            !(have_current && memcmp(&pos[2], current.bssid, 6) == 0)) {
+            ESP_LOGI(TAG, "邻居AP: "MACSTR" 信道%u", MAC2STR(&pos[2]), pos[2 + 11]);
+            neighbors++;
+        }
+        len -= pos[1] + 2;
+        pos += pos[1] + 2;
+    }
+
+    if (!roam_transition(ROAM_NEIGHBOR_WAIT, ROAM_NEIGHBOR_WAIT)) {
+        return;
+    }
+    esp_timer_stop(s_roam.timer);
+    if (neighbors == 0) {
+        ESP_LOGI(TAG, "邻居报告中没有其他AP，跳过扫描");
+        roam_cooldown();
+        return;
+    }
+    roam_start_scan();
+}
+#endif
+
+// 信号强度低于阈值 (在事件循环任务中)
+static void roam_rssi_low_handler(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    const wifi_event_bss_rssi_low_t *event = data;
+
+    if (!roam_transition(ROAM_MONITOR, ROAM_NEIGHBOR_WAIT)) {
+        return;
+    }
+    ROAM_STAT_INC(triggers);
+    ESP_LOGI(TAG, "信号强度%"PRId32" dBm低于阈值%d dBm，查找漫游目标", event->rssi, ROAM_RSSI_THRESHOLD);
+
+#if CONFIG_WIFI_ROAM_11KV
+    // AP支持BTM时请它推荐目标，收到BSS转移请求后由supplicant切换
+    if (esp_wnm_is_btm_supported_connection() &&
+        esp_wnm_send_bss_transition_mgmt_query(REASON_RSSI, NULL, 0) == 0) {
+        ROAM_STAT_INC(btm_queries);
+    }
+    if (esp_rrm_is_rrm_supported_connection() &&
+        esp_rrm_send_neighbor_rep_request(roam_neighbor_report_cb, NULL) == 0) {
+        esp_timer_start_once(s_roam.timer, (uint64_t)ROAM_NEIGHBOR_WAIT_MS * 1000);
+        return;
+    }
+#endif
+    roam_start_scan();
+}
+
+// 在扫描结果中选择历史记录中比当前AP强出余量的AP
+static bool roam_select_target(const wifi_ap_record_t *current, wifi_config_t *target, int8_t *rssi)
+{
+    wifi_ap_record_t *records = mem_pool_alloc(sizeof(wifi_ap_record_t) * WIFI_SCAN_MAX_APS);
+    if (records == NULL) {
+        return false;
+    }
+    size_t count = wifi_scan_get_results(records, WIFI_SCAN_MAX_APS, NULL);
+
+    const wifi_ap_record_t *best = NULL;
+    wifi_history_entry_t entry;
+    for (size_t i = 0; i < count; i++) {
+        const wifi_ap_record_t *r = &records[i];
+        if (memcmp(r->bssid, current->bssid, sizeof(r->bssid)) == 0 ||
+            r->rssi < current->rssi + ROAM_MARGIN_DB ||
+            (best != NULL && r->rssi <= best->rssi)) {
+            continue;
+        }
+        if (wifi_history_get_network((const char *)r->ssid, &entry) != ESP_OK) {
+            continue;
+        }
+        best = r;
+        memset(target, 0, sizeof(*target));
+        strlcpy((char *)target->sta.ssid, entry.ssid, sizeof(target->sta.ssid));
+        strlcpy((char *)target->sta.password, entry.password, sizeof(target->sta.password));
+    }
+    if (best != NULL) {
+        target->sta.bssid_set = true;
+        memcpy(target->sta.bssid, best->bssid, sizeof(target->sta.bssid));
+        target->sta.channel = best->primary;
+        target->sta.scan_method = WIFI_FAST_SCAN;
+        target->sta.pmf_cfg.capable = true;
+        wifi_roam_apply_config(&target->sta);
+        *rssi = best->rssi;
+    }
+
+    mem_pool_free(records);
+    return best != NULL;
+}
+
+// 扫描完成 (在事件循环任务中)
+static void roam_scan_done_handler(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    if (!roam_transition(ROAM_SCANNING, ROAM_SCANNING)) {
+        return;
+    }
+
+    wifi_ap_record_t current;
+    if (esp_wifi_sta_get_ap_info(&current) != ESP_OK) {
+        roam_set_state(ROAM_IDLE);
+        return;
+    }
+    int8_t rssi = 0;
+    if (*(esp_err_t *)data != ESP_OK || !roam_select_target(&current, &s_roam.target, &rssi)) {
+        ESP_LOGI(TAG, "没有比当前AP (%d dBm) 强%d dB以上的历史网络", current.rssi, ROAM_MARGIN_DB);
+        roam_cooldown();
+        return;
+    }
+
+    ESP_LOGI(TAG, "漫游: "MACSTR" (%d dBm) -> %s "MACSTR" (%d dBm, 信道%u)",
+             MAC2STR(current.bssid), current.rssi, (char *)s_roam.target.sta.ssid,
+             MAC2STR(s_roam.target.sta.bssid), rssi, s_roam.target.sta.channel);
+
+    // 断开事件中设置目标并关联 (见wifi_roam_on_disconnect)
+    taskENTER_CRITICAL(&s_roam_lock);
+    s_roam.state = ROAM_SWITCHING;
+    s_roam.btm = false;
+    s_roam.switch_us = esp_timer_get_time();
+    taskEXIT_CRITICAL(&s_roam_lock);
+    if (esp_wifi_disconnect() != ESP_OK) {
+        roam_cooldown();
+    }
+}
+
+// 邻居报告超时或冷却结束 (在esp_timer任务中)
+static void roam_timer_cb(void *arg)
+{
+    taskENTER_CRITICAL(&s_roam_lock);
+    roam_state_t state = s_roam.state;
+    taskEXIT_CRITICAL(&s_roam_lock);
+
+    if (state == ROAM_NEIGHBOR_WAIT) {
+        roam_start_scan();
+    } else if (state == ROAM_COOLDOWN) {
+        wifi_ap_record_t current;
+        if (esp_wifi_sta_get_ap_info(&current) == ESP_OK && roam_transition(ROAM_COOLDOWN, ROAM_MONITOR)) {
+            roam_monitor();
+        } else {
+            roam_transition(ROAM_COOLDOWN, ROAM_IDLE);
+        }
+    }
+}
+
+esp_err_t wifi_roam_init(void)
+{
+    const esp_timer_create_args_t timer_args = {
+        .callback = roam_timer_cb,
+        .name = "wifi_roam",
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &s_roam.timer);
+    if (err == ESP_OK) {
+        err = esp_event_handler_instance_register(WIFI_EVENT, WIFI_EVENT_STA_BSS_RSSI_LOW,
+                                                  roam_rssi_low_handler, NULL, NULL);
+    }
+    if (err == ESP_OK) {
+        err = esp_event_handler_instance_register(APP_EVENT, APP_EVENT_WIFI_SCAN_DONE,
+                                                  roam_scan_done_handler, NULL, NULL);
+    }
+    return err;
+}
+
+void wifi_roam_apply_config(wifi_sta_config_t *sta)
+{
+#if CONFIG_WIFI_ROAM_11KV
+    sta->rm_enabled = 1;
+    sta->btm_enabled = 1;
+#endif
+}
+
+void wifi_roam_on_got_ip(void)
+{
+    int64_t gap_us = 0;
+
+    taskENTER_CRITICAL(&s_roam_lock);
+    bool roamed = s_roam.state == ROAM_REASSOC;
+    if (roamed) {
+        gap_us = esp_timer_get_time() - s_roam.switch_us;
+        s_roam.stats.last_gap_ms = (uint32_t)(gap_us / 1000);
+        if (s_roam.btm) {
+            s_roam.stats.btm_roams++;
+        } else {
+            s_roam.stats.roams++;
+        }
+    }
+    taskEXIT_CRITICAL(&s_roam_lock);
+
+    if (roamed) {
+        latency_record(LATENCY_WIFI_ROAM_GAP, gap_us);
+        ESP_LOGI(TAG, "漫游完成，中断%"PRId64" ms", gap_us / 1000);
+        // 刚切换过，冷却后再监视，避免在两个AP之间来回切换
+        roam_cooldown();
+    } else {
+        esp_timer_stop(s_roam.timer);
+        roam_monitor();
+    }
+}
+
+bool wifi_roam_on_disconnect(uint8_t reason)
+{
+    bool handled = false;
+    bool connect = false;
+
+    taskENTER_CRITICAL(&s_roam_lock);
+    switch (s_roam.state) {
+        case ROAM_SWITCHING:
+            // 主动断开当前AP，接着关联目标
+            s_roam.state = ROAM_REASSOC;
+            connect = true;
+            handled = true;
+            break;
+        case ROAM_REASSOC:
+            s_roam.stats.failures++;
+            s_roam.state = ROAM_IDLE;
+            break;
+        default:
+            if (reason == WIFI_REASON_ROAMING) {
+                // supplicant按BTM请求切换AP，随后自行关联
+                s_roam.state = ROAM_REASSOC;
+                s_roam.btm = true;
+                s_roam.switch_us = esp_timer_get_time();
+                handled = true;
+            } else {
+                s_roam.state = ROAM_IDLE;
+            }
+            break;
+    }
+    taskEXIT_CRITICAL(&s_roam_lock);
+
+    if (!handled) {
+        esp_timer_stop(s_roam.timer);
+        return false;
+    }
+    if (connect) {
+        esp_err_t err = esp_wifi_set_config(ESP_IF_WIFI_STA, &s_roam.target);
+        if (err == ESP_OK) {
+            err = esp_wifi_connect();
+        }
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "关联漫游目标失败: %s", esp_err_to_name(err));
+            ROAM_STAT_INC(failures);
+            roam_set_state(ROAM_IDLE);
+            return false;
+        }
+    }
+    return true;
+}
+
+void wifi_roam_get_stats(wifi_roam_stats_t *stats)
+{
+    taskENTER_CRITICAL(&s_roam_lock);
+    *stats = s_roam.stats;
+    taskEXIT_CRITICAL(&s_roam_lock);
+}
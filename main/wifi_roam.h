@@ -0,0 +1,67 @@
+/*
+ * @Description: WiFi漫游管理头文件
+ *
+ * 信号强度低于阈值时，在保持关联的情况下后台扫描，历史记录中有比当前AP强出
+ * 一定余量的AP时直接按BSSID和信道重新关联，不经过完整的断开-扫描-连接流程。
+ * AP支持802.11k/v时先请求邻居报告 (没有邻居时省去扫描) 并发送BTM查询，
+ * AP发来的BSS转移请求由supplicant直接处理。
+ * 重新关联期间IP地址不变，已建立的TCP连接 (WebSocket/流服务器) 不会断开。
+ */
+
+#ifndef WIFI_ROAM_H
+#define WIFI_ROAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_wifi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 漫游统计
+typedef struct {
+    uint32_t triggers;          // 信号强度低于阈值的次数
+    uint32_t neighbor_reports;  // 收到的802.11k邻居报告
+    uint32_t btm_queries;       // 发出的802.11v BTM查询
+    uint32_t scans;             // 后台扫描次数
+    uint32_t roams;             // 成功切换次数 (不含supplicant处理的BTM转移)
+    uint32_t btm_roams;         // 由AP的BTM请求触发的切换
+    uint32_t failures;          // 切换后未能关联到目标AP
+    uint32_t last_gap_ms;       // 最近一次切换从断开到重新获取IP的时间
+} wifi_roam_stats_t;
+
+/**
+ * @brief 初始化漫游管理 (在WiFi初始化后调用)
+ */
+esp_err_t wifi_roam_init(void);
+
+/**
+ * @brief 为STA配置启用802.11k/v (所有连接路径在esp_wifi_set_config前调用)
+ */
+void wifi_roam_apply_config(wifi_sta_config_t *sta);
+
+/**
+ * @brief 获取IP时调用 (在事件循环任务中)，开始监视信号强度
+ */
+void wifi_roam_on_got_ip(void);
+
+/**
+ * @brief STA断开时调用 (在事件循环任务中)
+ *
+ * @param reason 断开原因
+ * @return true 断开由漫游引起且已处理，调用者不应再重试连接
+ */
+bool wifi_roam_on_disconnect(uint8_t reason);
+
+/**
+ * @brief 获取漫游统计
+ */
+void wifi_roam_get_stats(wifi_roam_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WIFI_ROAM_H */
@@ -0,0 +1,222 @@
+/*
+ * @Description: WiFi扫描服务实现
+ */
+
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "app_event.h"
+#include "mem_pool.h"
+#include "wifi_scan.h"
+
+static const char *TAG = "wifi_scan";
+
+#define WIFI_SCAN_DONE_BIT      BIT0
+#define WIFI_SCAN_STUCK_US      (15 * 1000 * 1000)     // 超过该时间未收到完成事件视为扫描丢失
+
+static struct {
+    SemaphoreHandle_t lock;             // 保护扫描结果
+    EventGroupHandle_t events;
+    wifi_ap_record_t records[WIFI_SCAN_MAX_APS];
+    uint16_t count;
+    int64_t done_us;                    // 最近一次成功扫描的完成时间，0表示没有结果
+    int64_t start_us;                   // 进行中扫描的开始时间
+    esp_err_t result;                   // 最近一次扫描的结果
+    bool scanning;
+    wifi_scan_stats_t stats;
+} s_scan = {
+    .result = ESP_ERR_INVALID_STATE,
+};
+
+static portMUX_TYPE s_state_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// 扫描结束 (在事件循环任务中)，读出结果后释放驱动中的列表
+static void wifi_scan_done_handler(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    const wifi_event_sta_scan_done_t *done = data;
+    esp_err_t result = ESP_FAIL;
+
+    xSemaphoreTake(s_scan.lock, portMAX_DELAY);
+    if (done->status == 0) {
+        uint16_t number = WIFI_SCAN_MAX_APS;
+        result = esp_wifi_scan_get_ap_records(&number, s_scan.records);
+        if (result == ESP_OK) {
+            s_scan.count = number;
+        }
+    }
+    xSemaphoreGive(s_scan.lock);
+    if (result != ESP_OK) {
+        esp_wifi_clear_ap_list();
+    }
+
+    taskENTER_CRITICAL(&s_state_lock);
+    s_scan.scanning = false;
+    s_scan.result = result;
+    if (result == ESP_OK) {
+        s_scan.done_us = esp_timer_get_time();
+    } else {
+        s_scan.stats.failures++;
+    }
+    taskEXIT_CRITICAL(&s_state_lock);
+    xEventGroupSetBits(s_scan.events, WIFI_SCAN_DONE_BIT);
+
+    if (result == ESP_OK) {
+        ESP_LOGI(TAG, "扫描完成: 找到%u个网络，缓存%u个", done->number, s_scan.count);
+    } else {
+        ESP_LOGW(TAG, "扫描失败 (状态%"PRIu32")", done->status);
+    }
+    app_event_post(APP_EVENT_WIFI_SCAN_DONE, &result, sizeof(result));
+}
+
+esp_err_t wifi_scan_init(void)
+{
+    if (s_scan.lock != NULL) {
+        return ESP_OK;
+    }
+    s_scan.lock = xSemaphoreCreateMutex();
+    s_scan.events = xEventGroupCreate();
+    if (s_scan.lock == NULL || s_scan.events == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    return esp_event_handler_instance_register(WIFI_EVENT, WIFI_EVENT_SCAN_DONE,
+                                               wifi_scan_done_handler, NULL, NULL);
+}
+
+esp_err_t wifi_scan_request(uint32_t max_age_ms, bool *cached)
+{
+    int64_t now = esp_timer_get_time();
+    bool stuck = false;
+
+    *cached = false;
+    taskENTER_CRITICAL(&s_state_lock);
+    if (s_scan.scanning && now - s_scan.start_us < WIFI_SCAN_STUCK_US) {
+        s_scan.stats.shared++;
+        taskEXIT_CRITICAL(&s_state_lock);
+        return ESP_OK;
+    }
+    if (!s_scan.scanning && s_scan.done_us != 0 && now - s_scan.done_us <= (int64_t)max_age_ms * 1000) {
+        s_scan.stats.cache_hits++;
+        taskEXIT_CRITICAL(&s_state_lock);
+        *cached = true;
+        return ESP_OK;
+    }
+    stuck = s_scan.scanning;
+    s_scan.scanning = true;
+    s_scan.start_us = now;
+    s_scan.stats.scans++;
+    taskEXIT_CRITICAL(&s_state_lock);
+
+    if (stuck) {
+        ESP_LOGW(TAG, "上次扫描未收到完成事件，重新开始");
+        esp_wifi_scan_stop();
+    }
+    xEventGroupClearBits(s_scan.events, WIFI_SCAN_DONE_BIT);
+
+    // 非阻塞扫描，不断开STA: 已连接时驱动在各信道之间回到工作信道收发数据
+    wifi_scan_config_t scan_config = {
+        .ssid = NULL,
+        .bssid = NULL,
+        .channel = 0,
+        .show_hidden = true,
+        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+        .scan_time = {
+            .active = {
+                .min = 100,
+                .max = 300
+            }
+        }
+    };
+    esp_err_t ret = esp_wifi_scan_start(&scan_config, false);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "启动扫描失败: %s", esp_err_to_name(ret));
+        taskENTER_CRITICAL(&s_state_lock);
+        s_scan.scanning = false;
+        s_scan.result = ret;
+        s_scan.stats.failures++;
+        taskEXIT_CRITICAL(&s_state_lock);
+        xEventGroupSetBits(s_scan.events, WIFI_SCAN_DONE_BIT);
+        return ret;
+    }
+    ESP_LOGI(TAG, "开始后台扫描");
+    return ESP_OK;
+}
+
+esp_err_t wifi_scan_wait(uint32_t timeout_ms)
+{
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = pdMS_TO_TICKS(timeout_ms);
+
+    while (true) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout) {
+            return ESP_ERR_TIMEOUT;
+        }
+        EventBits_t bits = xEventGroupWaitBits(s_scan.events, WIFI_SCAN_DONE_BIT, pdFALSE, pdTRUE,
+                                               timeout - elapsed);
+        if (!(bits & WIFI_SCAN_DONE_BIT)) {
+            return ESP_ERR_TIMEOUT;
+        }
+        // 刚启动的扫描可能还没清除上一次的完成位
+        taskENTER_CRITICAL(&s_state_lock);
+        bool scanning = s_scan.scanning;
+        esp_err_t result = s_scan.result;
+        taskEXIT_CRITICAL(&s_state_lock);
+        if (!scanning) {
+            return result;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+size_t wifi_scan_get_results(wifi_ap_record_t *records, size_t max, uint32_t *age_ms)
+{
+    xSemaphoreTake(s_scan.lock, portMAX_DELAY);
+    size_t n = s_scan.count < max ? s_scan.count : max;
+    memcpy(records, s_scan.records, n * sizeof(records[0]));
+    xSemaphoreGive(s_scan.lock);
+    if (age_ms) {
+        taskENTER_CRITICAL(&s_state_lock);
+        int64_t done_us = s_scan.done_us;
+        taskEXIT_CRITICAL(&s_state_lock);
+        *age_ms = done_us ? (uint32_t)((esp_timer_get_time() - done_us) / 1000) : 0;
+    }
+    return n;
+}
+
+esp_err_t wifi_scan_write_json(json_writer_t *w)
+{
+    // 先复制出来，输出 (可能阻塞在发送上) 时不持有锁
+    wifi_ap_record_t *records = mem_pool_alloc(sizeof(wifi_ap_record_t) * WIFI_SCAN_MAX_APS);
+    if (records == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    uint32_t age_ms;
+    size_t count = wifi_scan_get_results(records, WIFI_SCAN_MAX_APS, &age_ms);
+
+    json_writer_uint(w, "age_ms", age_ms);
+    json_writer_begin_array(w, "networks");
+    for (size_t i = 0; i < count; i++) {
+        json_writer_begin_object(w, NULL);
+        json_writer_string(w, "ssid", (char *)records[i].ssid);
+        json_writer_int(w, "rssi", records[i].rssi);
+        json_writer_int(w, "authmode", records[i].authmode);
+        json_writer_uint(w, "channel", records[i].primary);
+        json_writer_end_object(w);
+    }
+    json_writer_end_array(w);
+
+    mem_pool_free(records);
+    return ESP_OK;
+}
+
+void wifi_scan_get_stats(wifi_scan_stats_t *stats)
+{
+    taskENTER_CRITICAL(&s_state_lock);
+    *stats = s_scan.stats;
+    taskEXIT_CRITICAL(&s_state_lock);
+}
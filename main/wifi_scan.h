@@ -0,0 +1,88 @@
+/*
+ * @Description: WiFi扫描服务头文件
+ *
+ * 所有扫描 (网页扫描、历史网络自动连接) 都通过这里发起。扫描在后台进行，
+ * 不断开STA连接；结果缓存CONFIG_WIFI_SCAN_CACHE_TTL_MS，期间的请求直接使用缓存，
+ * 扫描进行中的请求共用同一次扫描。扫描完成后发布APP_EVENT_WIFI_SCAN_DONE。
+ */
+
+#ifndef WIFI_SCAN_H
+#define WIFI_SCAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "esp_wifi.h"
+#include "json_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 缓存的扫描结果条数上限
+#define WIFI_SCAN_MAX_APS       CONFIG_WIFI_SCAN_MAX_APS
+
+typedef struct {
+    uint32_t scans;             // 实际发起的扫描次数
+    uint32_t cache_hits;        // 直接使用缓存的请求数
+    uint32_t shared;            // 共用进行中扫描的请求数
+    uint32_t failures;          // 启动或完成失败的扫描数
+} wifi_scan_stats_t;
+
+/**
+ * @brief 初始化扫描服务 (在esp_wifi_init()和默认事件循环创建之后调用)
+ *
+ * @return esp_err_t ESP_OK成功
+ */
+esp_err_t wifi_scan_init(void);
+
+/**
+ * @brief 请求扫描结果
+ *
+ * 缓存不超过max_age_ms时*cached为true，可以直接读取结果；否则启动扫描或共用进行中的扫描，
+ * 完成后发布APP_EVENT_WIFI_SCAN_DONE，也可以用wifi_scan_wait()等待。
+ *
+ * @param max_age_ms 可接受的缓存时间
+ * @param cached 输出: 缓存是否可用
+ * @return esp_err_t ESP_OK成功，其他为启动扫描失败的错误码
+ */
+esp_err_t wifi_scan_request(uint32_t max_age_ms, bool *cached);
+
+/**
+ * @brief 等待进行中的扫描完成 (不能在事件循环任务中调用)
+ *
+ * @param timeout_ms 超时时间
+ * @return esp_err_t 最近一次扫描的结果，ESP_ERR_TIMEOUT超时
+ */
+esp_err_t wifi_scan_wait(uint32_t timeout_ms);
+
+/**
+ * @brief 复制最近一次扫描的结果
+ *
+ * @param records 输出数组
+ * @param max 数组大小
+ * @param age_ms 输出: 结果的时间 (可为NULL)
+ * @return size_t 复制的条数
+ */
+size_t wifi_scan_get_results(wifi_ap_record_t *records, size_t max, uint32_t *age_ms);
+
+/**
+ * @brief 将最近一次扫描结果写为当前JSON对象中的"age_ms"和"networks"
+ *
+ * @param w JSON输出
+ * @return esp_err_t ESP_OK成功，ESP_ERR_NO_MEM临时缓冲区分配失败
+ */
+esp_err_t wifi_scan_write_json(json_writer_t *w);
+
+/**
+ * @brief 获取统计信息
+ */
+void wifi_scan_get_stats(wifi_scan_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WIFI_SCAN_H */
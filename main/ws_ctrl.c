@@ -0,0 +1,385 @@
+/*
+ * @Description: WebSocket二进制控制协议实现
+ */
+
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_netif.h"
+#include "wifi_manager.h"
+#include "wifi_history.h"
+#include "wifi_scan.h"
+#include "web_socket.h"
+#include "cdc_framer.h"
+#include "data_logger.h"
+#include "usbd_cdc.h"
+#include "mem_pool.h"
+#include "net_profile.h"
+#include "ws_ctrl.h"
+
+static const char *TAG = "ws_ctrl";
+
+// 请求载荷读取位置，越界时置err，之后的读取均返回0
+typedef struct {
+    const uint8_t *p;
+    size_t len;
+    bool err;
+} ctrl_reader_t;
+
+// 响应载荷写入位置，空间不足时置err
+typedef struct {
+    uint8_t *p;
+    size_t cap;
+    size_t len;
+    bool err;
+} ctrl_writer_t;
+
+static const uint8_t *rd_take(ctrl_reader_t *r, size_t n)
+{
+    if (r->err || r->len < n) {
+        r->err = true;
+        return NULL;
+    }
+    const uint8_t *p = r->p;
+    r->p += n;
+    r->len -= n;
+    return p;
+}
+
+static uint8_t rd_u8(ctrl_reader_t *r)
+{
+    const uint8_t *p = rd_take(r, 1);
+    return p ? p[0] : 0;
+}
+
+static uint32_t rd_u32(ctrl_reader_t *r)
+{
+    const uint8_t *p = rd_take(r, 4);
+    return p ? (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24 : 0;
+}
+
+// 读取字符串到out (cap含'\0')，超长视为格式错误
+static void rd_str(ctrl_reader_t *r, char *out, size_t cap)
+{
+    uint8_t n = rd_u8(r);
+    const uint8_t *p = rd_take(r, n);
+    if (p == NULL || n >= cap) {
+        r->err = true;
+        out[0] = '\0';
+        return;
+    }
+    memcpy(out, p, n);
+    out[n] = '\0';
+}
+
+static void wr_bytes(ctrl_writer_t *w, const void *data, size_t n)
+{
+    if (w->err || w->cap - w->len < n) {
+        w->err = true;
+        return;
+    }
+    memcpy(w->p + w->len, data, n);
+    w->len += n;
+}
+
+static void wr_u8(ctrl_writer_t *w, uint8_t v)
+{
+    wr_bytes(w, &v, 1);
+}
+
+static void wr_u32(ctrl_writer_t *w, uint32_t v)
+{
+    uint8_t b[4] = { v, v >> 8, v >> 16, v >> 24 };
+    wr_bytes(w, b, sizeof(b));
+}
+
+static void wr_str(ctrl_writer_t *w, const char *s)
+{
+    size_t n = strnlen(s, UINT8_MAX);
+    wr_u8(w, n);
+    wr_bytes(w, s, n);
+}
+
+// 填写响应报头，返回整帧长度
+static size_t ctrl_finish(uint8_t *resp, uint8_t opcode, uint16_t id, ws_ctrl_status_t status, size_t payload_len)
+{
+    ws_ctrl_hdr_t hdr = {
+        .magic = WS_CTRL_MAGIC,
+        .version = WS_CTRL_VERSION,
+        .opcode = opcode | WS_CTRL_RESPONSE,
+        .status = status,
+        .id = id,
+        .len = payload_len,
+    };
+    memcpy(resp, &hdr, sizeof(hdr));
+    return sizeof(hdr) + payload_len;
+}
+
+// 执行失败的响应，载荷为esp_err_t
+static size_t ctrl_fail(uint8_t *resp, uint8_t opcode, uint16_t id, esp_err_t err)
+{
+    ctrl_writer_t w = { .p = resp + sizeof(ws_ctrl_hdr_t), .cap = sizeof(int32_t) };
+    wr_u32(&w, (uint32_t)err);
+    return ctrl_finish(resp, opcode, id, WS_CTRL_STATUS_FAILED, w.len);
+}
+
+static void ctrl_wifi_status(ctrl_writer_t *w)
+{
+    wifi_ap_record_t ap_info;
+    bool connected = esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK;
+    if (!connected) {
+        memset(&ap_info, 0, sizeof(ap_info));
+    }
+
+    uint32_t ip = 0;
+    esp_netif_ip_info_t ip_info;
+    esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    if (connected && netif && esp_netif_get_ip_info(netif, &ip_info) == ESP_OK) {
+        ip = ip_info.ip.addr;
+    }
+
+    wr_u8(w, connected);
+    wr_u8(w, (uint8_t)ap_info.rssi);
+    wr_bytes(w, ap_info.bssid, sizeof(ap_info.bssid));
+    wr_bytes(w, &ip, sizeof(ip));
+    wr_str(w, (char *)ap_info.ssid);
+}
+
+typedef struct {
+    ctrl_writer_t *w;
+    size_t count_pos;           // 个数字段在响应中的位置
+    uint8_t count;
+} ctrl_saved_ctx_t;
+
+// 按优先级写入，放不下 (或超过255个) 时只返回前面的部分
+static bool ctrl_saved_visit(const wifi_history_entry_t *entry, void *arg)
+{
+    ctrl_saved_ctx_t *ctx = arg;
+    ctrl_writer_t *w = ctx->w;
+    size_t need = 1 + 4 + 4 + 1 + strnlen(entry->ssid, UINT8_MAX);
+    if (ctx->count == UINT8_MAX || w->cap - w->len < need) {
+        return false;
+    }
+    wr_u8(w, entry->priority);
+    wr_u32(w, entry->connect_count);
+    wr_u32(w, entry->last_connected);
+    wr_str(w, entry->ssid);
+    ctx->count++;
+    return true;
+}
+
+static void ctrl_wifi_saved(ctrl_writer_t *w)
+{
+    ctrl_saved_ctx_t ctx = { .w = w, .count_pos = w->len, .count = 0 };
+    wr_u8(w, 0);
+    if (w->err) {
+        return;
+    }
+    wifi_history_foreach(ctrl_saved_visit, &ctx);
+    w->p[ctx.count_pos] = ctx.count;
+}
+
+// 缓存可用时返回结果，否则启动扫描 (或共用进行中的扫描) 并返回"扫描中"
+static esp_err_t ctrl_wifi_scan(ctrl_reader_t *r, ctrl_writer_t *w)
+{
+    uint32_t max_age_ms = r->len >= 4 ? rd_u32(r) : CONFIG_WIFI_SCAN_CACHE_TTL_MS;
+    bool cached;
+    esp_err_t err = wifi_scan_request(max_age_ms, &cached);
+    if (err != ESP_OK) {
+        return err;
+    }
+    wr_u8(w, cached);
+    if (!cached) {
+        return ESP_OK;
+    }
+
+    wifi_ap_record_t *records = mem_pool_alloc(sizeof(wifi_ap_record_t) * WIFI_SCAN_MAX_APS);
+    if (records == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    uint32_t age_ms;
+    size_t count = wifi_scan_get_results(records, WIFI_SCAN_MAX_APS, &age_ms);
+    wr_u32(w, age_ms);
+
+    // 驱动返回的记录按信号从强到弱排列，放不下的弱信号网络不返回
+    size_t count_pos = w->len;
+    uint8_t written = 0;
+    wr_u8(w, 0);
+    for (size_t i = 0; i < count; i++) {
+        size_t ssid_len = strnlen((char *)records[i].ssid, sizeof(records[i].ssid));
+        if (w->cap - w->len < 4 + ssid_len) {
+            break;
+        }
+        wr_u8(w, (uint8_t)records[i].rssi);
+        wr_u8(w, records[i].authmode);
+        wr_u8(w, records[i].primary);
+        wr_str(w, (char *)records[i].ssid);
+        written++;
+    }
+    if (!w->err) {
+        w->p[count_pos] = written;
+    }
+    mem_pool_free(records);
+    return ESP_OK;
+}
+
+static void ctrl_stream_get(ctrl_writer_t *w)
+{
+    ws_batch_config_t batch;
+    cdc_framer_config_t framing;
+    websocket_get_batch_config(&batch);
+    cdc_framer_get_config(&framing);
+    wr_u32(w, batch.max_frame_len);
+    wr_u32(w, batch.flush_bytes);
+    wr_u32(w, batch.flush_timeout_ms);
+    wr_u8(w, framing.mode);
+    wr_u8(w, framing.emit);
+}
+
+static esp_err_t ctrl_stream_set(ctrl_reader_t *r)
+{
+    ws_batch_config_t batch = {
+        .max_frame_len = rd_u32(r),
+        .flush_bytes = rd_u32(r),
+        .flush_timeout_ms = rd_u32(r),
+    };
+    cdc_framer_config_t framing = {
+        .mode = (cdc_framer_mode_t)rd_u8(r),
+        .emit = (cdc_framer_emit_t)rd_u8(r),
+    };
+    if (r->err) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    esp_err_t err = cdc_framer_set_config(&framing);
+    if (err == ESP_OK) {
+        err = websocket_set_batch_config(&batch);
+    }
+    return err;
+}
+
+// CDC发送完成 (在CDC发送任务中)，arg为发起请求的连接编号 (不用fd，断开后fd可能已被新连接复用)
+static void ctrl_cdc_write_done(uint32_t id, esp_err_t result, size_t len, void *arg)
+{
+    uint8_t resp[sizeof(ws_ctrl_hdr_t) + sizeof(uint32_t)];
+    size_t n;
+    if (result == ESP_OK) {
+        ctrl_writer_t w = { .p = resp + sizeof(ws_ctrl_hdr_t), .cap = sizeof(uint32_t) };
+        wr_u32(&w, len);
+        n = ctrl_finish(resp, WS_CTRL_OP_CDC_WRITE, id, WS_CTRL_STATUS_OK, w.len);
+    } else {
+        n = ctrl_fail(resp, WS_CTRL_OP_CDC_WRITE, id, result);
+    }
+    websocket_send_binary_to_session((uint32_t)(uintptr_t)arg, resp, n);
+}
+
+size_t ws_ctrl_handle(int fd, const uint8_t *req, size_t len, uint8_t *resp)
+{
+    ws_ctrl_hdr_t hdr;
+    if (len < sizeof(hdr)) {
+        return ctrl_finish(resp, 0, 0, WS_CTRL_STATUS_BAD_REQUEST, 0);
+    }
+    memcpy(&hdr, req, sizeof(hdr));
+    if (hdr.magic != WS_CTRL_MAGIC || hdr.version != WS_CTRL_VERSION) {
+        return ctrl_finish(resp, hdr.opcode, hdr.id, WS_CTRL_STATUS_BAD_VERSION, 0);
+    }
+    if (hdr.len != len - sizeof(hdr)) {
+        return ctrl_finish(resp, hdr.opcode, hdr.id, WS_CTRL_STATUS_BAD_REQUEST, 0);
+    }
+
+    ctrl_reader_t r = { .p = req + sizeof(hdr), .len = hdr.len };
+    ctrl_writer_t w = { .p = resp + sizeof(hdr), .cap = WS_CTRL_MAX_RESPONSE - sizeof(hdr) };
+    char ssid[WIFI_HISTORY_SSID_MAX_LEN];
+    char password[WIFI_HISTORY_PASSWORD_MAX_LEN];
+    esp_err_t err = ESP_OK;
+
+    switch (hdr.opcode) {
+        case WS_CTRL_OP_PING:
+            wr_u8(&w, WS_CTRL_VERSION);
+            wr_u32(&w, (uint32_t)(esp_timer_get_time() / 1000));
+            break;
+        case WS_CTRL_OP_WIFI_STATUS:
+            ctrl_wifi_status(&w);
+            break;
+        case WS_CTRL_OP_WIFI_CONNECT: {
+            rd_str(&r, ssid, sizeof(ssid));
+            bool has_password = r.len > 0;
+            if (has_password) {
+                rd_str(&r, password, sizeof(password));
+            }
+            if (!r.err) {
+                err = wifi_connect_network(ssid, has_password ? password : NULL);
+            }
+            break;
+        }
+        case WS_CTRL_OP_WIFI_FORGET:
+            rd_str(&r, ssid, sizeof(ssid));
+            if (!r.err) {
+                err = wifi_forget_network(ssid);
+            }
+            break;
+        case WS_CTRL_OP_WIFI_RESET_RETRY:
+            err = wifi_reset_connection_retry();
+            break;
+        case WS_CTRL_OP_WIFI_SAVED:
+            ctrl_wifi_saved(&w);
+            break;
+        case WS_CTRL_OP_WIFI_SCAN:
+            err = ctrl_wifi_scan(&r, &w);
+            break;
+        case WS_CTRL_OP_STREAM_GET:
+            ctrl_stream_get(&w);
+            break;
+        case WS_CTRL_OP_STREAM_SET:
+            err = ctrl_stream_set(&r);
+            break;
+        case WS_CTRL_OP_LOG_ENABLE: {
+            uint8_t enable = rd_u8(&r);
+            if (!r.err) {
+                err = data_logger_enable(enable != 0);
+            }
+            break;
+        }
+        case WS_CTRL_OP_NET_PROFILE_GET:
+            wr_u8(&w, (uint8_t)net_profile_get());
+            break;
+        case WS_CTRL_OP_NET_PROFILE_SET: {
+            uint8_t profile = rd_u8(&r);
+            if (!r.err) {
+                err = net_profile_set((net_profile_t)profile);
+            }
+            break;
+        }
+        case WS_CTRL_OP_CDC_WRITE: {
+            uint8_t dev = rd_u8(&r);
+            if (r.err || dev >= USBD_CDC_MAX_DEVICES || r.len == 0) {
+                return ctrl_finish(resp, hdr.opcode, hdr.id, WS_CTRL_STATUS_BAD_REQUEST, 0);
+            }
+            uint32_t session = websocket_client_session(fd);
+            if (session == 0) {
+                return 0;
+            }
+            // 入队成功后由完成回调响应
+            err = usbd_cdc_send_async(dev, r.p, r.len, hdr.id, ctrl_cdc_write_done, (void *)(uintptr_t)session);
+            if (err == ESP_OK) {
+                return 0;
+            }
+            break;
+        }
+        default:
+            return ctrl_finish(resp, hdr.opcode, hdr.id, WS_CTRL_STATUS_UNKNOWN_OP, 0);
+    }
+
+    if (r.err) {
+        return ctrl_finish(resp, hdr.opcode, hdr.id, WS_CTRL_STATUS_BAD_REQUEST, 0);
+    }
+    if (err == ESP_OK && w.err) {
+        err = ESP_ERR_NO_MEM;
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "命令0x%02x失败(fd=%d): %s", hdr.opcode, fd, esp_err_to_name(err));
+        return ctrl_fail(resp, hdr.opcode, hdr.id, err);
+    }
+    return ctrl_finish(resp, hdr.opcode, hdr.id, WS_CTRL_STATUS_OK, w.len);
+}
@@ -0,0 +1,98 @@
+/*
+ * @Description: WebSocket二进制控制协议头文件
+ *
+ * 以/ws?ctrl=1连接的客户端发来的二进制帧按本协议解析 (文本帧仍转发给CDC设备)，
+ * 配置和命令与数据共用一个连接，不再为每个操作建立HTTP请求。
+ * REST接口保留为兼容层，与这里调用相同的函数。
+ *
+ * 每个请求和响应都是一个完整的二进制帧 (不能分片): ws_ctrl_hdr_t + 载荷，多字节字段为小端。
+ * 响应的opcode为请求的opcode | WS_CTRL_RESPONSE，id与请求相同，客户端可以同时发出多个请求。
+ * status为WS_CTRL_STATUS_FAILED时载荷为int32 esp_err_t，其他错误状态时载荷为空。
+ * str表示 u8长度 + 字节 (不含'\0')；可选字段省略时载荷在此结束。
+ *
+ * 命令 (请求载荷 -> 响应载荷):
+ *   PING              任意 -> u8协议版本, u32运行时间(ms)
+ *   WIFI_STATUS       空 -> u8已连接, i8 RSSI, u8 BSSID[6], u32 IPv4地址 (网络字节序，0为未获取), str SSID
+ *   WIFI_CONNECT      str SSID, [str 密码，省略时使用保存的密码] -> 空
+ *   WIFI_FORGET       str SSID -> 空
+ *   WIFI_RESET_RETRY  空 -> 空
+ *   WIFI_SAVED        空 -> u8个数, 每个: u8优先级, u32连接次数, u32上次连接序号, str SSID
+ *                     (按优先级排列，超出响应长度的部分不返回)
+ *   WIFI_SCAN         [u32可接受的缓存时间(ms)] -> u8完成 (0: 扫描中，完成后服务器推送{"event":"scan_done"}),
+ *                     完成时接着 u32结果时间(ms), u8个数, 每个: i8 RSSI, u8认证方式, u8信道, str SSID
+ *   STREAM_GET        空 -> u32单帧最大长度, u32攒批字节数, u32最长等待(ms), u8分帧方式, u8输出方式
+ *   STREAM_SET        同STREAM_GET的响应 -> 空
+ *   LOG_ENABLE        u8启用 -> 空
+ *   NET_PROFILE_GET   空 -> u8网络配置 (net_profile_t)
+ *   NET_PROFILE_SET   u8网络配置 -> 空
+ *   CDC_WRITE         u8设备, 数据 -> u32已发送字节数 (发送完成后才响应)
+ */
+
+#ifndef WS_CTRL_H
+#define WS_CTRL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WS_CTRL_MAGIC           0xC5
+#define WS_CTRL_VERSION         1
+#define WS_CTRL_RESPONSE        0x80        // 响应opcode标志
+#define WS_CTRL_MAX_RESPONSE    1024        // 同步响应的最大长度 (含报头)
+
+// 请求/响应报头 (小端)
+typedef struct __attribute__((packed)) {
+    uint8_t magic;              // WS_CTRL_MAGIC
+    uint8_t version;            // WS_CTRL_VERSION
+    uint8_t opcode;             // ws_ctrl_op_t，响应时加WS_CTRL_RESPONSE
+    uint8_t status;             // 请求为0，响应为ws_ctrl_status_t
+    uint16_t id;                // 请求编号，原样返回
+    uint16_t len;               // 之后的载荷长度
+} ws_ctrl_hdr_t;
+
+// 命令
+typedef enum {
+    WS_CTRL_OP_PING             = 0x00,
+    WS_CTRL_OP_WIFI_STATUS      = 0x10,
+    WS_CTRL_OP_WIFI_CONNECT     = 0x11,
+    WS_CTRL_OP_WIFI_FORGET      = 0x12,
+    WS_CTRL_OP_WIFI_RESET_RETRY = 0x13,
+    WS_CTRL_OP_WIFI_SAVED       = 0x14,
+    WS_CTRL_OP_WIFI_SCAN        = 0x15,
+    WS_CTRL_OP_STREAM_GET       = 0x20,
+    WS_CTRL_OP_STREAM_SET       = 0x21,
+    WS_CTRL_OP_LOG_ENABLE       = 0x22,
+    WS_CTRL_OP_NET_PROFILE_GET  = 0x23,
+    WS_CTRL_OP_NET_PROFILE_SET  = 0x24,
+    WS_CTRL_OP_CDC_WRITE        = 0x30,
+} ws_ctrl_op_t;
+
+// 响应状态
+typedef enum {
+    WS_CTRL_STATUS_OK = 0,
+    WS_CTRL_STATUS_BAD_VERSION,     // 报头magic或版本不支持
+    WS_CTRL_STATUS_BAD_REQUEST,     // 载荷格式错误
+    WS_CTRL_STATUS_UNKNOWN_OP,      // 未知命令
+    WS_CTRL_STATUS_FAILED,          // 执行失败，载荷为esp_err_t
+} ws_ctrl_status_t;
+
+/**
+ * @brief 处理一个控制请求 (在httpd任务中调用)
+ *
+ * @param fd 发出请求的客户端
+ * @param req 请求帧
+ * @param len 请求帧长度
+ * @param resp 响应缓冲区 (至少WS_CTRL_MAX_RESPONSE字节)
+ * @return size_t 需要立即发送的响应长度，0表示响应在操作完成后经websocket_send_binary_to_session()发送
+ */
+size_t ws_ctrl_handle(int fd, const uint8_t *req, size_t len, uint8_t *resp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WS_CTRL_H */
@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+"""
+构建时处理网页资源: 压缩为gzip并生成ETag清单。
+
+用法:
+    gzip_assets.py <源目录> <输出目录>       输出SPIFFS镜像目录
+    gzip_assets.py --pack <源目录> <镜像文件>  输出www分区镜像
+
+输出目录时，每个文件输出为 <相对路径>.gz，清单 assets.idx 每行一个资源:
+    <相对路径> <ETag>
+ETag为压缩后内容SHA-256的前16个十六进制字符，内容不变时构建结果不变。
+
+分区镜像 (小端，固件映射后直接发送，格式见main/web_assets.c):
+    头部     magic "WPK1", 资源数 u32, 镜像总长 u32, 保留 u32
+    索引     每个资源56字节: 路径[28], 带引号的ETag[20], 数据偏移 u32, 数据长度 u32
+    数据     各资源的gzip内容，按4字节对齐
+
+HTML中引用其他资源的 src="x" / href="x" 会改写为 x?v=<ETag>，
+HTML本身每次加载都重新验证，引用的资源更新后浏览器会请求新的URL。
+"""
+
+import gzip
+import hashlib
+import os
+import re
+import struct
+import sys
+
+MANIFEST = 'assets.idx'
+PACK_MAGIC = b'WPK1'
+PACK_NAME_MAX = 28
+PACK_ETAG_MAX = 20
+
+
+def etag_of(data):
+    return hashlib.sha256(data).hexdigest()[:16]
+
+
+def compress(data):
+    # mtime固定为0，保证相同内容得到相同的压缩结果
+    return gzip.compress(data, compresslevel=9, mtime=0)
+
+
+def collect(src_dir):
+    assets = {}
+    for root, _, files in os.walk(src_dir):
+        for name in sorted(files):
+            path = os.path.join(root, name)
+            rel = os.path.relpath(path, src_dir).replace(os.sep, '/')
+            with open(path, 'rb') as f:
+                assets[rel] = f.read()
+    return assets
+
+
+def rewrite_refs(html, etags):
+    def repl(m):
+        ref = m.group(2)
+        if ref in etags:
+            return '%s="%s?v=%s"' % (m.group(1), ref, etags[ref])
+        return m.group(0)
+    return re.sub(r'\b(src|href)="([^"?#:]+)"', repl, html)
+
+
+def process(src_dir):
+    assets = collect(src_dir)
+
+    # 先处理非HTML资源，得到HTML中要引用的ETag
+    etags = {}
+    output = {}
+    for rel in sorted(assets):
+        if not rel.endswith('.html'):
+            output[rel] = compress(assets[rel])
+            etags[rel] = etag_of(output[rel])
+    for rel in sorted(assets):
+        if rel.endswith('.html'):
+            html = rewrite_refs(assets[rel].decode('utf-8'), etags)
+            output[rel] = compress(html.encode('utf-8'))
+            etags[rel] = etag_of(output[rel])
+    return assets, output, etags
+
+
+def write_dir(out_dir, assets, output, etags):
+    os.makedirs(out_dir, exist_ok=True)
+    # 清除上次构建留下的文件，避免已删除的资源仍被打包
+    for name in os.listdir(out_dir):
+        path = os.path.join(out_dir, name)
+        if os.path.isfile(path):
+            os.remove(path)
+
+    lines = []
+    for rel in sorted(output):
+        path = os.path.join(out_dir, rel + '.gz')
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        with open(path, 'wb') as f:
+            f.write(output[rel])
+        lines.append('%s %s\n' % (rel, etags[rel]))
+        print('%-24s %6d -> %6d bytes  %s' % (rel, len(assets[rel]), len(output[rel]), etags[rel]))
+
+    with open(os.path.join(out_dir, MANIFEST), 'w') as f:
+        f.writelines(lines)
+
+
+def write_pack(pack_file, assets, output, etags):
+    names = sorted(output)
+    offset = 16 + 56 * len(names)
+    index = b''
+    data = b''
+    for rel in names:
+        if len(rel.encode()) >= PACK_NAME_MAX:
+            raise SystemExit('asset path too long: %s' % rel)
+        blob = output[rel]
+        index += struct.pack('<%ds%dsII' % (PACK_NAME_MAX, PACK_ETAG_MAX),
+                             rel.encode(), ('"%s"' % etags[rel]).encode(),
+                             offset + len(data), len(blob))
+        data += blob + b'\0' * (-len(blob) % 4)
+        print('%-24s %6d -> %6d bytes  %s' % (rel, len(assets[rel]), len(blob), etags[rel]))
+    header = PACK_MAGIC + struct.pack('<III', len(names), offset + len(data), 0)
+
+    os.makedirs(os.path.dirname(os.path.abspath(pack_file)), exist_ok=True)
+    with open(pack_file, 'wb') as f:
+        f.write(header + index + data)
+
+
+def main():
+    args = sys.argv[1:]
+    pack = len(args) == 3 and args[0] == '--pack'
+    if pack:
+        args = args[1:]
+    if len(args) != 2:
+        print('usage: gzip_assets.py [--pack] <src_dir> <out_dir|image_file>', file=sys.stderr)
+        return 1
+    src_dir, dest = args
+
+    assets, output, etags = process(src_dir)
+    if pack:
+        write_pack(dest, assets, output, etags)
+    else:
+        write_dir(dest, assets, output, etags)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
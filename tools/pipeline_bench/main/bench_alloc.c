@@ -0,0 +1,47 @@
+/*
+ * @Description: 内存分配计数 (链接时以--wrap替换malloc/calloc/realloc/free)
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "bench_alloc.h"
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+static uint32_t s_allocs;
+static uint32_t s_frees;
+
+void *__wrap_malloc(size_t size)
+{
+    __atomic_fetch_add(&s_allocs, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    __atomic_fetch_add(&s_allocs, 1, __ATOMIC_RELAXED);
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    __atomic_fetch_add(&s_allocs, 1, __ATOMIC_RELAXED);
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr)
+{
+    if (ptr) {
+        __atomic_fetch_add(&s_frees, 1, __ATOMIC_RELAXED);
+    }
+    __real_free(ptr);
+}
+
+void bench_alloc_get(bench_alloc_stats_t *stats)
+{
+    stats->allocs = __atomic_load_n(&s_allocs, __ATOMIC_RELAXED);
+    stats->frees = __atomic_load_n(&s_frees, __ATOMIC_RELAXED);
+}
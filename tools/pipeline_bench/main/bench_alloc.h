@@ -0,0 +1,20 @@
+/*
+ * @Description: 内存分配计数头文件
+ */
+
+#ifndef BENCH_ALLOC_H
+#define BENCH_ALLOC_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t allocs;        // malloc/calloc/realloc调用次数
+    uint32_t frees;         // free调用次数 (不含free(NULL))
+} bench_alloc_stats_t;
+
+/**
+ * @brief 读取累计的分配次数
+ */
+void bench_alloc_get(bench_alloc_stats_t *stats);
+
+#endif /* BENCH_ALLOC_H */
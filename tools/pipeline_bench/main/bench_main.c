@@ -0,0 +1,245 @@
+/*
+ * @Description: CDC数据通路主机端基准测试
+ *
+ * 生产者任务按设定的速率和块大小输入合成的CDC数据 (模拟USB接收回调)，
+ * 消费者任务像WebSocket发送任务一样从环形缓冲区取出切片并计数。
+ * 参数默认取自menuconfig，也可以通过同名环境变量覆盖，例如:
+ *   BENCH_CHUNK_SIZE=512 BENCH_FRAMER=cobs ./build/pipeline_bench.elf
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "cdc_ring.h"
+#include "cdc_framer.h"
+#include "cdc_pipeline.h"
+#include "metrics.h"
+#include "bench_alloc.h"
+
+// 合成数据样本中的记录数，循环输入
+#define BENCH_PATTERN_RECORDS   256
+#define BENCH_LINE_LEN_MAX      1024
+#define BENCH_MAX_ENCODED_LEN   (BENCH_LINE_LEN_MAX + 8)
+#define BENCH_YIELD_CHUNKS      64
+
+typedef struct {
+    uint32_t total_bytes;
+    uint32_t chunk_size;
+    uint32_t rate_bps;
+    uint32_t line_len;
+    uint32_t frame_max;
+    cdc_framer_mode_t framer;
+} bench_params_t;
+
+typedef struct {
+    uint32_t frames;
+    uint32_t records;
+    uint32_t lost;
+    uint64_t bytes;
+} bench_result_t;
+
+static bench_params_t s_params;
+static bench_result_t s_result;
+static uint8_t *s_pattern;
+static size_t s_pattern_len;
+static TaskHandle_t s_consumer;
+static TaskHandle_t s_main;
+static volatile bool s_feeding_done;
+
+static uint32_t bench_env_int(const char *name, uint32_t def)
+{
+    const char *v = getenv(name);
+    return v ? (uint32_t)strtoul(v, NULL, 0) : def;
+}
+
+static void bench_load_params(void)
+{
+    s_params.total_bytes = bench_env_int("BENCH_TOTAL_BYTES", CONFIG_BENCH_TOTAL_BYTES);
+    s_params.chunk_size = bench_env_int("BENCH_CHUNK_SIZE", CONFIG_BENCH_CHUNK_SIZE);
+    s_params.rate_bps = bench_env_int("BENCH_RATE_BPS", CONFIG_BENCH_RATE_BPS);
+    s_params.line_len = bench_env_int("BENCH_LINE_LEN", CONFIG_BENCH_LINE_LEN);
+    s_params.frame_max = bench_env_int("BENCH_FRAME_MAX", CONFIG_BENCH_FRAME_MAX);
+
+    const char *framer = getenv("BENCH_FRAMER");
+    if (!cdc_framer_mode_from_name(framer ? framer : CONFIG_BENCH_FRAMER, &s_params.framer)) {
+        s_params.framer = CDC_FRAMER_LINE;
+    }
+    if (s_params.chunk_size == 0) {
+        s_params.chunk_size = 1;
+    }
+    if (s_params.line_len < 8) {
+        s_params.line_len = 8;
+    } else if (s_params.line_len > BENCH_LINE_LEN_MAX) {
+        s_params.line_len = BENCH_LINE_LEN_MAX;
+    }
+}
+
+// 按分帧方式编码一条记录，负载为不含0x00/0xC0/0xDB的ASCII文本
+static size_t bench_encode_record(uint8_t *out, uint32_t index)
+{
+    size_t payload_len = s_params.line_len - 1;
+    char payload[BENCH_LINE_LEN_MAX];
+    int n = snprintf(payload, sizeof(payload), "%" PRIu32 ",", index);
+    for (size_t i = n; i < payload_len; i++) {
+        payload[i] = '0' + (i % 10);
+    }
+
+    switch (s_params.framer) {
+    case CDC_FRAMER_COBS: {
+        // 负载无0x00，每254字节一个编码块
+        size_t pos = 0;
+        size_t done = 0;
+        while (done < payload_len) {
+            size_t block = payload_len - done > 254 ? 254 : payload_len - done;
+            out[pos++] = block == 254 ? 0xFF : (uint8_t)(block + 1);
+            memcpy(out + pos, payload + done, block);
+            pos += block;
+            done += block;
+        }
+        out[pos++] = 0x00;
+        return pos;
+    }
+    case CDC_FRAMER_SLIP:
+        memcpy(out, payload, payload_len);
+        out[payload_len] = 0xC0;
+        return payload_len + 1;
+    case CDC_FRAMER_LEN16:
+        out[0] = payload_len & 0xFF;
+        out[1] = payload_len >> 8;
+        memcpy(out + 2, payload, payload_len);
+        return payload_len + 2;
+    default:
+        memcpy(out, payload, payload_len);
+        out[payload_len] = '\n';
+        return payload_len + 1;
+    }
+}
+
+static bool bench_build_pattern(void)
+{
+    s_pattern = malloc(BENCH_PATTERN_RECORDS * BENCH_MAX_ENCODED_LEN);
+    if (!s_pattern) {
+        return false;
+    }
+    s_pattern_len = 0;
+    for (uint32_t i = 0; i < BENCH_PATTERN_RECORDS; i++) {
+        s_pattern_len += bench_encode_record(s_pattern + s_pattern_len, i);
+    }
+    return true;
+}
+
+// 与WebSocket发送任务相同的唤醒条件
+static void bench_notify(uint32_t pending_records, size_t pending_bytes)
+{
+    if (pending_records == 1 || pending_bytes >= s_params.frame_max) {
+        xTaskNotifyGive(s_consumer);
+    }
+}
+
+static void bench_consumer_task(void *arg)
+{
+    int reader = *(int *)arg;
+    cdc_ring_slice_t slice;
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+        while (cdc_ring_peek(reader, &slice, s_params.frame_max)) {
+            s_result.frames++;
+            s_result.records += slice.count;
+            s_result.bytes += slice.len;
+            cdc_ring_consume(reader, &slice);
+        }
+        s_result.lost += cdc_ring_reader_take_lost(reader);
+        if (s_feeding_done && cdc_ring_pending(reader, NULL, NULL) == 0) {
+            xTaskNotifyGive(s_main);
+            vTaskSuspend(NULL);
+        }
+    }
+}
+
+// 按设定速率输入数据，领先进度超过一个tick时让出CPU
+static void bench_feed(void)
+{
+    uint32_t fed = 0;
+    uint32_t chunks = 0;
+    size_t pos = 0;
+    int64_t start = esp_timer_get_time();
+
+    while (fed < s_params.total_bytes) {
+        size_t len = s_params.chunk_size;
+        if (len > s_params.total_bytes - fed) {
+            len = s_params.total_bytes - fed;
+        }
+        if (len > s_pattern_len - pos) {
+            len = s_pattern_len - pos;
+        }
+        metrics_add(METRIC_USB_IN_PACKETS, 1);
+        metrics_add(METRIC_USB_IN_BYTES, len);
+        cdc_pipeline_input(0, s_pattern + pos, len);
+        fed += len;
+        pos = (pos + len) % s_pattern_len;
+
+        if (s_params.rate_bps > 0) {
+            int64_t due_us = (int64_t)fed * 1000000 / s_params.rate_bps;
+            int64_t ahead_us = due_us - (esp_timer_get_time() - start);
+            if (ahead_us >= portTICK_PERIOD_MS * 1000) {
+                vTaskDelay(ahead_us / 1000 / portTICK_PERIOD_MS);
+            }
+        } else if (++chunks % BENCH_YIELD_CHUNKS == 0) {
+            // 全速模式下也定期让出CPU，使消费者有机会运行
+            taskYIELD();
+        }
+    }
+}
+
+void app_main(void)
+{
+    bench_load_params();
+    if (!bench_build_pattern() || cdc_ring_init() != ESP_OK) {
+        printf("BENCH init failed\n");
+        exit(1);
+    }
+    cdc_framer_config_t framer = { .mode = s_params.framer, .emit = CDC_FRAMER_EMIT_BATCH };
+    cdc_framer_set_config(&framer);
+
+    static int reader;
+    reader = cdc_ring_reader_open(CDC_RING_DEV_ALL);
+    s_main = xTaskGetCurrentTaskHandle();
+    cdc_pipeline_set_notify(bench_notify);
+    xTaskCreate(bench_consumer_task, "bench_consumer", 4096, &reader, uxTaskPriorityGet(NULL), &s_consumer);
+
+    metrics_reset();
+    bench_alloc_stats_t alloc_start;
+    bench_alloc_get(&alloc_start);
+    int64_t start = esp_timer_get_time();
+
+    bench_feed();
+    s_feeding_done = true;
+    xTaskNotifyGive(s_consumer);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    int64_t elapsed_us = esp_timer_get_time() - start;
+    bench_alloc_stats_t alloc_end;
+    bench_alloc_get(&alloc_end);
+
+    // 单行输出，便于脚本按提交记录对比
+    printf("BENCH framer=%s chunk=%" PRIu32 " rate_bps=%" PRIu32 " line=%" PRIu32 " frame_max=%" PRIu32
+           " in_bytes=%" PRIu32 " elapsed_us=%" PRId64 " throughput_kBps=%.1f"
+           " records_framed=%" PRIu32 " records_queued=%" PRIu32 " records_dropped=%" PRIu32
+           " frames_out=%" PRIu32 " records_out=%" PRIu32 " bytes_out=%" PRIu64 " lost=%" PRIu32
+           " allocs=%" PRIu32 " frees=%" PRIu32 "\n",
+           cdc_framer_mode_name(s_params.framer), s_params.chunk_size, s_params.rate_bps,
+           s_params.line_len, s_params.frame_max, metrics_counter_get(METRIC_USB_IN_BYTES), elapsed_us,
+           elapsed_us > 0 ? (double)metrics_counter_get(METRIC_USB_IN_BYTES) * 1000.0 / elapsed_us : 0.0,
+           metrics_counter_get(METRIC_FRAMED_RECORDS), metrics_counter_get(METRIC_QUEUED_RECORDS),
+           metrics_counter_get(METRIC_DROPPED_RECORDS), s_result.frames, s_result.records, s_result.bytes,
+           s_result.lost, alloc_end.allocs - alloc_start.allocs, alloc_end.frees - alloc_start.frees);
+
+    free(s_pattern);
+    exit(0);
+}
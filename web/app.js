@@ -0,0 +1,287 @@
+let isConfiguring = false;
+const SCAN_POLL_INTERVAL_MS = 1000;
+const SCAN_POLL_MAX = 10;
+const STATUS_POLL_FALLBACK_MS = 5000;
+const STATUS_RECONNECT_MS = 3000;
+
+function showStatus(message, type) {
+    const statusDiv = document.getElementById('status');
+    statusDiv.textContent = message;
+    statusDiv.className = type + ' show';
+}
+
+function getSignalStrengthIcon(rssi) {
+    if (rssi >= -50) return '📶';
+    if (rssi >= -60) return '📶';
+    if (rssi >= -70) return '📶';
+    return '📶';
+}
+
+async function scanWiFi() {
+    try {
+        const wifiList = document.getElementById('wifi-list');
+        wifiList.innerHTML = '<div style="text-align: center;">扫描中...</div>';
+
+        // 扫描在后台进行，返回scanning时稍后再取结果
+        let data;
+        for (let attempt = 0; attempt < SCAN_POLL_MAX; attempt++) {
+            const response = await fetch('/scan');
+            if (!response.ok) {
+                throw new Error(`HTTP error! status: ${response.status}`);
+            }
+            data = await response.json();
+            console.log('Received data:', data);  // 添加调试日志
+            if (data.status !== 'scanning') break;
+            await new Promise(resolve => setTimeout(resolve, SCAN_POLL_INTERVAL_MS));
+        }
+        if (data.status === 'scanning') {
+            throw new Error('扫描超时');
+        }
+
+        if (data.status === 'error') {
+            showStatus(data.message || '扫描失败', 'error');
+            return;
+        }
+
+        wifiList.innerHTML = '';
+        if (!data.networks || data.networks.length === 0) {
+            wifiList.innerHTML = '<div style="text-align: center;">未找到WiFi网络</div>';
+            return;
+        }
+
+        data.networks
+            .filter(network => network.ssid) // 过滤掉空SSID
+            .sort((a, b) => b.rssi - a.rssi)
+            .forEach(network => {
+                const div = document.createElement('div');
+                div.className = 'wifi-item';
+                div.innerHTML = `
+                    <span class="wifi-name">${network.ssid}</span>
+                    <span class="wifi-signal">${getSignalStrengthIcon(network.rssi)} (${network.rssi}dBm)</span>
+                `;
+                div.onclick = () => {
+                    document.getElementById('ssid').value = network.ssid;
+                    document.getElementById('password').focus();
+                };
+                wifiList.appendChild(div);
+            });
+    } catch (error) {
+        console.error('扫描错误:', error);
+        showStatus(`扫描WiFi失败: ${error.message}`, 'error');
+        wifiList.innerHTML = '<div style="text-align: center; color: red;">扫描失败</div>';
+    }
+}
+
+document.getElementById('wifi-form').addEventListener('submit', async function(e) {
+    e.preventDefault();
+    if (isConfiguring) return;
+
+    const submitBtn = document.getElementById('submit-btn');
+    const formData = new FormData(this);
+    const data = {
+        ssid: formData.get('ssid'),
+        password: formData.get('password')
+    };
+
+    try {
+        isConfiguring = true;
+        submitBtn.disabled = true;
+        showStatus('正在配置WiFi...', 'loading');
+
+        const response = await fetch('/configure', {
+            method: 'POST',
+            headers: {
+                'Content-Type': 'application/json',
+            },
+            body: JSON.stringify(data)
+        });
+
+        if (response.ok) {
+            showStatus('WiFi配置成功！设备正在连接到网络...', 'success');
+
+            // 等待设备连接到新网络
+            setTimeout(() => {
+                showStatus('配置完成！设备已连接到新网络', 'success');
+            }, 5000);
+        } else {
+            throw new Error('配置失败');
+        }
+    } catch (error) {
+        showStatus('配置失败：' + error.message, 'error');
+    } finally {
+        isConfiguring = false;
+        submitBtn.disabled = false;
+    }
+});
+
+// 显示WiFi状态 (GET /api/status的响应或状态通道的wifi事件)
+function renderWiFiStatus(data) {
+    const statusDiv = document.getElementById('wifi-status');
+
+    if (data.status === 'connected') {
+        statusDiv.innerHTML = `
+            <p><strong>状态:</strong> 已连接</p>
+            <p><strong>SSID:</strong> ${data.ssid}</p>
+            <p><strong>IP地址:</strong> ${data.ip || '获取中...'}</p>
+            <p><strong>信号强度:</strong> ${data.rssi} dBm ${getSignalStrengthIcon(data.rssi)}</p>
+            <p><strong>BSSID:</strong> ${data.bssid}</p>
+        `;
+    } else {
+        statusDiv.innerHTML = '<p><strong>状态:</strong> 未连接</p>';
+    }
+}
+
+// 获取WiFi状态
+async function getWiFiStatus() {
+    try {
+        const response = await fetch('/api/status');
+        renderWiFiStatus(await response.json());
+    } catch (error) {
+        console.error('获取WiFi状态失败:', error);
+        document.getElementById('wifi-status').innerHTML = '获取状态失败';
+    }
+}
+
+// 订阅状态通道: 只接收状态事件，不接收CDC数据；连接成功时服务器先推送一次快照。
+// 连接断开期间退回到轮询，重连成功后停止轮询
+let statusPollTimer = null;
+
+function connectStatusChannel() {
+    const ws = new WebSocket(`ws://${location.host}/ws?dev=none&status=1`);
+
+    ws.onopen = () => {
+        if (statusPollTimer) {
+            clearInterval(statusPollTimer);
+            statusPollTimer = null;
+        }
+    };
+    ws.onmessage = (e) => {
+        let msg;
+        try {
+            msg = JSON.parse(e.data);
+        } catch (error) {
+            return;
+        }
+        if (msg.event === 'wifi') {
+            renderWiFiStatus(msg);
+            if (msg.change === 'got_ip' || msg.change === 'disconnected') {
+                getSavedWiFi();
+            }
+        } else if (msg.event === 'scan_done' && msg.status === 'success') {
+            scanWiFi();
+        }
+    };
+    ws.onclose = () => {
+        if (!statusPollTimer) {
+            statusPollTimer = setInterval(getWiFiStatus, STATUS_POLL_FALLBACK_MS);
+        }
+        setTimeout(connectStatusChannel, STATUS_RECONNECT_MS);
+    };
+}
+
+// 获取已保存的WiFi列表
+async function getSavedWiFi() {
+    try {
+        const response = await fetch('/api/saved');
+        const data = await response.json();
+        const listDiv = document.getElementById('saved-wifi-list');
+
+        if (data.length === 0) {
+            listDiv.innerHTML = '<p>没有已保存的WiFi</p>';
+            return;
+        }
+
+        listDiv.innerHTML = data.map(wifi => `
+            <div class="saved-wifi-item">
+                <span>${wifi.ssid}</span>
+                <div class="btn-group">
+                    <button class="connect-btn" onclick="connectToWiFi('${wifi.ssid}')">连接</button>
+                    <button class="delete-btn" onclick="deleteWiFi('${wifi.ssid}')">删除</button>
+                </div>
+            </div>
+        `).join('');
+    } catch (error) {
+        console.error('获取已保存WiFi失败:', error);
+        document.getElementById('saved-wifi-list').innerHTML = '获取已保存WiFi失败';
+    }
+}
+
+// 连接到已保存的WiFi
+async function connectToWiFi(ssid) {
+    if (isConfiguring) return;
+    isConfiguring = true;
+
+    showStatus('正在连接到 ' + ssid + '...', 'loading');
+
+    try {
+        // 首先重置重试计数
+        await fetch('/api/reset_retry', {
+            method: 'POST',
+            headers: {
+                'Content-Type': 'application/json',
+            }
+        });
+
+        // 然后尝试连接
+        const response = await fetch('/api/connect', {
+            method: 'POST',
+            headers: {
+                'Content-Type': 'application/json',
+            },
+            body: JSON.stringify({ ssid: ssid })
+        });
+
+        // 获取连接状态
+        setTimeout(async () => {
+            const statusResponse = await fetch('/api/status');
+            const statusData = await statusResponse.json();
+
+            if (statusData.status === 'connected') {
+                showStatus('连接成功！', 'success');
+            } else {
+                showStatus('连接失败，请检查WiFi是否可用', 'error');
+            }
+
+            getWiFiStatus(); // 更新状态显示
+        }, 3000);
+    } catch (error) {
+        showStatus('连接失败: ' + error.message, 'error');
+    }
+
+    isConfiguring = false;
+}
+
+// 删除已保存的WiFi
+async function deleteWiFi(ssid) {
+    if (!confirm(`确定要删除 ${ssid} 吗？`)) return;
+
+    try {
+        const response = await fetch('/api/delete', {
+            method: 'POST',
+            headers: {
+                'Content-Type': 'application/json',
+            },
+            body: JSON.stringify({ ssid: ssid })
+        });
+
+        if (response.ok) {
+            showStatus('删除成功', 'success');
+            getSavedWiFi();
+            getWiFiStatus();
+        } else {
+            showStatus('删除失败', 'error');
+        }
+    } catch (error) {
+        showStatus('删除失败: ' + error.message, 'error');
+    }
+}
+
+// 页面加载完成后执行
+document.addEventListener('DOMContentLoaded', function() {
+    getWiFiStatus();
+    getSavedWiFi();
+    connectStatusChannel();
+});
+
+// 页面加载完成后自动扫描WiFi
+window.addEventListener('load', scanWiFi);